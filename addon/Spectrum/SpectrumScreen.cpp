@@ -20,10 +20,21 @@
 #include <circle/util.h>
 #include <assert.h>
 
+#define BITMAP_SIZE		6144
+#define ATTR_SIZE		768
+#define COLUMNS			32
+#define ROWS			24
+
+#define BORDER_LINES		32	// above the Spectrum screen
+#define BORDER_WORDS		5	// left of the Spectrum screen (8 pixels per word)
+
 CSpectrumScreen::CSpectrumScreen (void)
 :	m_pFrameBuffer (0),
 	m_pBuffer (0),
-	m_pVideoMem (0)
+	m_nPitch (0),
+	m_pVideoMem (0),
+	m_bFlash (FALSE),
+	m_bRedrawAll (TRUE)
 {
 }
 
@@ -70,88 +81,141 @@ boolean CSpectrumScreen::Initialize (u8 *pVideoMem)
 	m_pBuffer = (u32 *) (uintptr) m_pFrameBuffer->GetBuffer();
 	assert (m_pBuffer != 0);
 
+	m_nPitch = m_pFrameBuffer->GetPitch() / sizeof (u32);
+	assert (m_nPitch >= BORDER_WORDS + COLUMNS);
+
 	memset(m_pBuffer, 0xFF, m_pFrameBuffer->GetSize());
 
-	// Create a lookup table for draw the screen Faster Than Light :)
-	for (int attr = 0; attr < 128; attr++) {
-		unsigned ink = attr & 0x07;
-		unsigned paper = (attr & 0x78) >> 3;
-		if (attr & 0x40) {
-			ink |= 0x08;
-		}
-		for (int idx = 0; idx < 256; idx++) {
-			for (unsigned mask = 0x80; mask > 0; mask >>= 1) {
-				m_scrTable[attr][idx] <<= 4;
-				m_scrTable[attr + 128][idx] <<= 4;
-				if (idx & mask) {
-					m_scrTable[attr][idx] |= ink;
-					m_scrTable[attr + 128][idx] |= paper;
-				} else {
-					m_scrTable[attr][idx] |= paper;
-					m_scrTable[attr + 128][idx] |= ink;
-				}
+	// Create a lookup table, which expands each bit of a bitmap byte to a nibble.
+	// The pixels are composed of ink and paper color with this mask. It has 1 KB
+	// only, so that it stays in the L1 cache.
+	for (int idx = 0; idx < 256; idx++) {
+		u32 mask = 0;
+		for (unsigned bit = 0x80; bit > 0; bit >>= 1) {
+			mask <<= 4;
+			if (idx & bit) {
+				mask |= 0x0F;
 			}
-			m_scrTable[attr][idx] = bswap32(m_scrTable[attr][idx]);
-			m_scrTable[attr + 128][idx] = bswap32(m_scrTable[attr + 128][idx]);
 		}
+		m_maskTable[idx] = bswap32(mask);
 	}
 
+	Invalidate();
+
 	return TRUE;
 }
 
+void CSpectrumScreen::Invalidate (void)
+{
+	m_bRedrawAll = TRUE;
+}
+
+// Only the character cells, which have been changed since the last call, are redrawn.
+// A cell has changed, if one of its eight bitmap bytes or its attribute has changed,
+// or if it is flashing and the flash state has changed.
+
 void CSpectrumScreen::Update (boolean flash)
 {
 	assert (m_pBuffer != 0);
 	assert (m_pVideoMem != 0);
 
-	int bufIdx = 1413;
-	int attr = 6144;
-	for (int addr = 0; addr < 256; addr += 32) {
-		for (int col = 0; col < 32; col++) {
-			unsigned char color = m_pVideoMem[attr++];
-			if (!flash)
-				color &= 0x7F;
-			m_pBuffer[bufIdx + col] = m_scrTable[color][m_pVideoMem[addr + col]];
-			m_pBuffer[bufIdx + col + 44] = m_scrTable[color][m_pVideoMem[addr + col + 256]];
-			m_pBuffer[bufIdx + col + 88] = m_scrTable[color][m_pVideoMem[addr + col + 512]];
-			m_pBuffer[bufIdx + col + 132] = m_scrTable[color][m_pVideoMem[addr + col + 768]];
-			m_pBuffer[bufIdx + col + 176] = m_scrTable[color][m_pVideoMem[addr + col + 1024]];
-			m_pBuffer[bufIdx + col + 220] = m_scrTable[color][m_pVideoMem[addr + col + 1280]];
-			m_pBuffer[bufIdx + col + 264] = m_scrTable[color][m_pVideoMem[addr + col + 1536]];
-			m_pBuffer[bufIdx + col + 308] = m_scrTable[color][m_pVideoMem[addr + col + 1792]];
+	boolean bFlashChanged = flash != m_bFlash;
+	m_bFlash = flash;
+
+	for (unsigned row = 0; row < ROWS; row++) {
+		u32 cells = 0;		// one bit per column
+
+		// bitmap is divided into three thirds of eight character rows
+		unsigned bitmap = (row / 8) * 2048 + (row % 8) * COLUMNS;
+		for (unsigned line = 0; line < 8; line++) {
+			cells |= UpdateShadow (bitmap + line * 256);
+		}
+
+		unsigned attr = BITMAP_SIZE + row * COLUMNS;
+		cells |= UpdateShadow (attr);
+
+		if (bFlashChanged) {
+			cells |= GetFlashCells (attr);
+		}
+
+		if (m_bRedrawAll) {
+			cells = 0xFFFFFFFF;
+		}
+
+		if (cells != 0) {
+			DrawRow (row, cells, flash);
 		}
-		bufIdx += 352;
 	}
-	for (int addr = 2048; addr < 2304; addr += 32) {
-		for (int col = 0; col < 32; col++) {
-			unsigned char color = m_pVideoMem[attr++];
-			if (!flash)
-				color &= 0x7F;
-			m_pBuffer[bufIdx + col] = m_scrTable[color][m_pVideoMem[addr + col]];
-			m_pBuffer[bufIdx + col + 44] = m_scrTable[color][m_pVideoMem[addr + col + 256]];
-			m_pBuffer[bufIdx + col + 88] = m_scrTable[color][m_pVideoMem[addr + col + 512]];
-			m_pBuffer[bufIdx + col + 132] = m_scrTable[color][m_pVideoMem[addr + col + 768]];
-			m_pBuffer[bufIdx + col + 176] = m_scrTable[color][m_pVideoMem[addr + col + 1024]];
-			m_pBuffer[bufIdx + col + 220] = m_scrTable[color][m_pVideoMem[addr + col + 1280]];
-			m_pBuffer[bufIdx + col + 264] = m_scrTable[color][m_pVideoMem[addr + col + 1536]];
-			m_pBuffer[bufIdx + col + 308] = m_scrTable[color][m_pVideoMem[addr + col + 1792]];
+
+	m_bRedrawAll = FALSE;
+}
+
+u32 CSpectrumScreen::UpdateShadow (unsigned nOffset)
+{
+	assert (nOffset + COLUMNS <= BITMAP_SIZE + ATTR_SIZE);
+	const u8 *pVideoMem = m_pVideoMem + nOffset;
+	u8 *pShadow = m_Shadow + nOffset;
+
+	u32 cells = 0;
+	for (unsigned col = 0; col < COLUMNS; col++) {
+		// read only once, the video memory may be modified concurrently
+		u8 value = pVideoMem[col];
+		if (value != pShadow[col]) {
+			pShadow[col] = value;
+			cells |= 1U << col;
 		}
-		bufIdx += 352;
 	}
-	for (int addr = 4096; addr < 4352; addr += 32) {
-		for (int col = 0; col < 32; col++) {
-			unsigned char color = m_pVideoMem[attr++];
-			if (!flash)
-				color &= 0x7F;
-			m_pBuffer[bufIdx + col] = m_scrTable[color][m_pVideoMem[addr + col]];
-			m_pBuffer[bufIdx + col + 44] = m_scrTable[color][m_pVideoMem[addr + col + 256]];
-			m_pBuffer[bufIdx + col + 88] = m_scrTable[color][m_pVideoMem[addr + col + 512]];
-			m_pBuffer[bufIdx + col + 132] = m_scrTable[color][m_pVideoMem[addr + col + 768]];
-			m_pBuffer[bufIdx + col + 176] = m_scrTable[color][m_pVideoMem[addr + col + 1024]];
-			m_pBuffer[bufIdx + col + 220] = m_scrTable[color][m_pVideoMem[addr + col + 1280]];
-			m_pBuffer[bufIdx + col + 264] = m_scrTable[color][m_pVideoMem[addr + col + 1536]];
-			m_pBuffer[bufIdx + col + 308] = m_scrTable[color][m_pVideoMem[addr + col + 1792]];
+
+	return cells;
+}
+
+u32 CSpectrumScreen::GetFlashCells (unsigned nOffset) const
+{
+	assert (nOffset + COLUMNS <= BITMAP_SIZE + ATTR_SIZE);
+	const u8 *pAttr = m_Shadow + nOffset;
+
+	u32 cells = 0;
+	for (unsigned col = 0; col < COLUMNS; col++) {
+		if (pAttr[col] & 0x80) {
+			cells |= 1U << col;
+		}
+	}
+
+	return cells;
+}
+
+void CSpectrumScreen::DrawRow (unsigned nRow, u32 nCells, boolean flash)
+{
+	const u8 *pBitmap = m_Shadow + (nRow / 8) * 2048 + (nRow % 8) * COLUMNS;
+	const u8 *pAttr = m_Shadow + BITMAP_SIZE + nRow * COLUMNS;
+	u32 *pBuffer = m_pBuffer + (BORDER_LINES + nRow * 8) * m_nPitch + BORDER_WORDS;
+
+	for (unsigned col = 0; nCells != 0; col++, nCells >>= 1) {
+		if (!(nCells & 1)) {
+			continue;
+		}
+
+		u8 color = pAttr[col];
+		unsigned ink = color & 0x07;
+		unsigned paper = (color & 0x78) >> 3;
+		if (color & 0x40) {
+			ink |= 0x08;
+		}
+		if (flash && (color & 0x80)) {
+			unsigned temp = ink;
+			ink = paper;
+			paper = temp;
+		}
+
+		// all nibbles are set to the color
+		u32 inkWord = ink * 0x11111111U;
+		u32 paperWord = paper * 0x11111111U;
+
+		u32 *pCell = pBuffer + col;
+		for (unsigned line = 0; line < 8; line++) {
+			u32 mask = m_maskTable[pBitmap[col + line * 256]];
+			*pCell = (inkWord & mask) | (paperWord & ~mask);
+			pCell += m_nPitch;
 		}
-		bufIdx += 352;
 	}
 }
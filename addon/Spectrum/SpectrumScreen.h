@@ -32,11 +32,23 @@ public:
 
 	void Update (boolean flash);
 
+	// redraw the whole screen with the next Update()
+	void Invalidate (void);
+
+private:
+	u32 UpdateShadow (unsigned nOffset);
+	u32 GetFlashCells (unsigned nOffset) const;
+	void DrawRow (unsigned nRow, u32 nCells, boolean flash);
+
 private:
 	CBcmFrameBuffer	*m_pFrameBuffer;
 	u32		*m_pBuffer;		// Address of frame buffer
-	unsigned	 m_scrTable[256][256];	// lookup table
+	unsigned	 m_nPitch;		// in words
+	u32		 m_maskTable[256];	// lookup table (bitmap byte to pixel mask)
 	u8		*m_pVideoMem;		// Spectrum video memory
+	u8		 m_Shadow[6912];	// last drawn contents of video memory
+	boolean		 m_bFlash;		// flash state of last Update()
+	boolean		 m_bRedrawAll;
 };
 
 #endif
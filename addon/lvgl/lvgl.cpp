@@ -24,6 +24,8 @@
 #include <circle/string.h>
 #include <circle/new.h>
 
+static const char FromLVGL[] = "lvgl";
+
 CLVGL *CLVGL::s_pThis = 0;
 
 CLVGL::CLVGL (CScreenDevice *pScreen, CInterruptSystem *pInterrupt)
@@ -33,9 +35,20 @@ CLVGL::CLVGL (CScreenDevice *pScreen, CInterruptSystem *pInterrupt)
 	m_pFrameBuffer (0),
 	m_DMAChannel (DMA_CHANNEL_NORMAL, pInterrupt),
 	m_nLastUpdate (0),
+	m_bDirectMode (FALSE),
+	m_bPageFlipping (FALSE),
+	m_bVSync (FALSE),
+	m_pDisplay (0),
+	m_nFrontPage (0),
+	m_nPrevAreas (0),
+	m_bFlushPending (FALSE),
+	m_nBackPage (0),
 	m_pMouseDevice (0),
 	m_pTouchScreen (0),
-	m_nLastTouchUpdate (0)
+	m_nLastTouchUpdate (0),
+	m_PointerLock (IRQ_LEVEL),
+	m_LVGLLock (TASK_LEVEL),
+	m_FlushLock (TASK_LEVEL)
 {
 	assert (s_pThis == 0);
 	s_pThis = this;
@@ -52,9 +65,20 @@ CLVGL::CLVGL (CBcmFrameBuffer *pFrameBuffer, CInterruptSystem *pInterrupt)
 	m_pFrameBuffer (pFrameBuffer),
 	m_DMAChannel (DMA_CHANNEL_NORMAL, pInterrupt),
 	m_nLastUpdate (0),
+	m_bDirectMode (FALSE),
+	m_bPageFlipping (FALSE),
+	m_bVSync (FALSE),
+	m_pDisplay (0),
+	m_nFrontPage (0),
+	m_nPrevAreas (0),
+	m_bFlushPending (FALSE),
+	m_nBackPage (0),
 	m_pMouseDevice (0),
 	m_pTouchScreen (0),
-	m_nLastTouchUpdate (0)
+	m_nLastTouchUpdate (0),
+	m_PointerLock (IRQ_LEVEL),
+	m_LVGLLock (TASK_LEVEL),
+	m_FlushLock (TASK_LEVEL)
 {
 	assert (s_pThis == 0);
 	s_pThis = this;
@@ -70,6 +94,7 @@ CLVGL::~CLVGL (void)
 
 	m_pTouchScreen = 0;
 	m_pMouseDevice = 0;
+	m_pDisplay = 0;
 	m_pFrameBuffer = 0;
 	m_pScreen = 0;
 
@@ -79,6 +104,15 @@ CLVGL::~CLVGL (void)
 	m_pBuffer2 = 0;
 }
 
+void CLVGL::SetDirectMode (boolean bPageFlipping, boolean bVSync)
+{
+	assert (m_pBuffer1 == 0);
+
+	m_bDirectMode = TRUE;
+	m_bPageFlipping = bPageFlipping;
+	m_bVSync = bVSync;
+}
+
 boolean CLVGL::Initialize (void)
 {
 	if (m_pFrameBuffer == 0)
@@ -94,8 +128,37 @@ boolean CLVGL::Initialize (void)
 
 	lv_log_register_print_cb (LogPrint);
 
-	m_pBuffer1 = new (HEAP_DMA30) lv_color_t[LV_HOR_RES_MAX*10];
-	m_pBuffer2 = new (HEAP_DMA30) lv_color_t[LV_HOR_RES_MAX*10];
+	// in direct mode LVGL renders into two screen-sized buffers ("true double buffering")
+	unsigned nBufferSize = LV_HOR_RES_MAX*10;
+	if (m_bDirectMode)
+	{
+		if (   m_pFrameBuffer->GetWidth () < LV_HOR_RES_MAX
+		    || m_pFrameBuffer->GetHeight () < LV_VER_RES_MAX)
+		{
+			CLogger::Get ()->Write (FromLVGL, LogError,
+						"Frame buffer too small for direct mode");
+
+			return FALSE;
+		}
+
+		if (   m_bPageFlipping
+		    && (   m_pFrameBuffer->GetVirtHeight () < 2*m_pFrameBuffer->GetHeight ()
+			|| !m_pFrameBuffer->SetVirtualOffset (0, 0)))
+		{
+			CLogger::Get ()->Write (FromLVGL, LogWarning,
+						"Page flipping not possible, virtual height too small");
+
+			m_bPageFlipping = FALSE;
+		}
+
+		m_nFrontPage = 0;
+		m_nPrevAreas = 0;
+
+		nBufferSize = LV_HOR_RES_MAX*LV_VER_RES_MAX;
+	}
+
+	m_pBuffer1 = new (HEAP_DMA30) lv_color_t[nBufferSize];
+	m_pBuffer2 = new (HEAP_DMA30) lv_color_t[nBufferSize];
 	if (   m_pBuffer1 == 0
 	    || m_pBuffer2 == 0)
 	{
@@ -103,30 +166,17 @@ boolean CLVGL::Initialize (void)
 	}
 
 	static lv_disp_buf_t disp_buf;
-	lv_disp_buf_init (&disp_buf, m_pBuffer1, m_pBuffer2, LV_HOR_RES_MAX*10);
+	lv_disp_buf_init (&disp_buf, m_pBuffer1, m_pBuffer2, nBufferSize);
 
 	lv_disp_drv_t disp_drv;
 	lv_disp_drv_init (&disp_drv);
 	disp_drv.buffer = &disp_buf;
 	disp_drv.flush_cb = DisplayFlush;
-	lv_disp_drv_register (&disp_drv);
+	m_pDisplay = lv_disp_drv_register (&disp_drv);
+	assert (m_pDisplay != 0);
+	assert (!m_bDirectMode || lv_disp_is_true_double_buf (m_pDisplay));
 
-	m_pMouseDevice = (CMouseDevice *) CDeviceNameService::Get ()->GetDevice ("mouse1", FALSE);
-	if (m_pMouseDevice != 0)
-	{
-		if (m_pMouseDevice->Setup (m_pFrameBuffer->GetWidth (), m_pFrameBuffer->GetHeight ()))
-		{
-			m_pMouseDevice->ShowCursor (TRUE);
-
-			m_pMouseDevice->RegisterEventHandler (MouseEventHandler);
-
-			m_pMouseDevice->RegisterRemovedHandler (MouseRemovedHandler);
-		}
-		else
-		{
-			m_pMouseDevice = 0;
-		}
-	}
+	SetupMouse ();
 
 	if (m_pMouseDevice == 0)
 	{
@@ -148,25 +198,14 @@ boolean CLVGL::Initialize (void)
 
 void CLVGL::Update (boolean bPlugAndPlayUpdated)
 {
-	if (   bPlugAndPlayUpdated
-	    && m_pMouseDevice == 0)
-	{
-		m_pMouseDevice =
-			(CMouseDevice *) CDeviceNameService::Get ()->GetDevice ("mouse1", FALSE);
-		if (m_pMouseDevice != 0)
-		{
-			assert (m_pFrameBuffer != 0);
-			if (m_pMouseDevice->Setup (m_pFrameBuffer->GetWidth (),
-						   m_pFrameBuffer->GetHeight ()))
-			{
-				m_pMouseDevice->ShowCursor (TRUE);
+	UpdateDisplay ();
 
-				m_pMouseDevice->RegisterEventHandler (MouseEventHandler);
+	UpdateInput (bPlugAndPlayUpdated);
+}
 
-				m_pMouseDevice->RegisterRemovedHandler (MouseRemovedHandler);
-			}
-		}
-	}
+void CLVGL::UpdateDisplay (void)
+{
+	m_LVGLLock.Acquire ();
 
 	lv_task_handler ();
 
@@ -178,6 +217,32 @@ void CLVGL::Update (boolean bPlugAndPlayUpdated)
 		m_nLastUpdate = nTicks;
 	}
 
+	m_LVGLLock.Release ();
+
+	// the transfer to the frame buffer and the waits do not block other cores
+	if (m_bDirectMode)
+	{
+		m_FlushLock.Acquire ();
+
+		if (m_bFlushPending)
+		{
+			CompleteDirectFlush ();
+		}
+
+		m_FlushLock.Release ();
+	}
+}
+
+void CLVGL::UpdateInput (boolean bPlugAndPlayUpdated)
+{
+	if (   bPlugAndPlayUpdated
+	    && m_pMouseDevice == 0)
+	{
+		SetupMouse ();
+	}
+
+	unsigned nTicks = CTimer::Get ()->GetClockTicks ();
+
 	if (m_pMouseDevice != 0)
 	{
 		m_pMouseDevice->UpdateCursor ();
@@ -193,10 +258,41 @@ void CLVGL::Update (boolean bPlugAndPlayUpdated)
 	}
 }
 
+void CLVGL::SetupMouse (void)
+{
+	m_pMouseDevice = (CMouseDevice *) CDeviceNameService::Get ()->GetDevice ("mouse1", FALSE);
+	if (m_pMouseDevice != 0)
+	{
+		assert (m_pFrameBuffer != 0);
+		if (m_pMouseDevice->Setup (m_pFrameBuffer->GetWidth (), m_pFrameBuffer->GetHeight ()))
+		{
+			m_pMouseDevice->ShowCursor (TRUE);
+
+			m_pMouseDevice->RegisterEventHandler (MouseEventHandler);
+
+			m_pMouseDevice->RegisterRemovedHandler (MouseRemovedHandler);
+		}
+		else
+		{
+			m_pMouseDevice = 0;
+		}
+	}
+}
+
 void CLVGL::DisplayFlush (lv_disp_drv_t *pDriver, const lv_area_t *pArea, lv_color_t *pBuffer)
 {
 	assert (s_pThis != 0);
 
+	if (s_pThis->m_bDirectMode)
+	{
+		s_pThis->DirectFlush (pBuffer);
+
+		assert (pDriver != 0);
+		lv_disp_flush_ready (pDriver);
+
+		return;
+	}
+
 	assert (pArea != 0);
 	int32_t x1 = pArea->x1;
 	int32_t x2 = pArea->x2;
@@ -223,6 +319,133 @@ void CLVGL::DisplayFlush (lv_disp_drv_t *pDriver, const lv_area_t *pArea, lv_col
 	s_pThis->m_DMAChannel.Start ();
 }
 
+// In direct mode LVGL calls DisplayFlush() once per frame for the whole screen, but the
+// invalidated areas are still available in the display object. These areas are copied
+// from the rendered buffer with one chained DMA transfer. With page flipping the hidden
+// page missed the areas of the previous frame too, which are copied in the same go.
+// The transfer is only prepared here and is started by CompleteDirectFlush(), after
+// UpdateDisplay() released the LVGL lock. LVGL renders the next frame into the other
+// buffer, so the rendered buffer remains unchanged until then. The DMA chain and the
+// pending state are protected by m_FlushLock, because another core may render (e.g.
+// with lv_refr_now()) within Lock(), while the transfer is running.
+
+void CLVGL::DirectFlush (lv_color_t *pBuffer)
+{
+	assert (pBuffer != 0);
+	assert (m_pDisplay != 0);
+	assert (m_pFrameBuffer != 0);
+
+	m_FlushLock.Acquire ();
+
+	// rendered outside of UpdateDisplay() (e.g. lv_refr_now()) before the last completion
+	if (m_bFlushPending)
+	{
+		CompleteDirectFlush ();
+	}
+
+	unsigned nBackPage = m_bPageFlipping ? m_nFrontPage ^ 1 : 0;
+	uintptr nPage = m_pFrameBuffer->GetBuffer ()
+			+ nBackPage * m_pFrameBuffer->GetHeight () * m_pFrameBuffer->GetPitch ();
+
+	m_DMAChannel.SetupMemCopy2DChain (2*LV_INV_BUF_SIZE);
+
+	boolean bOK = TRUE;
+	for (unsigned i = 0; bOK && i < m_pDisplay->inv_p; i++)
+	{
+		if (!m_pDisplay->inv_area_joined[i])
+		{
+			bOK = AddDirectArea (&m_pDisplay->inv_areas[i], nPage, pBuffer);
+		}
+	}
+
+	if (m_bPageFlipping)
+	{
+		for (unsigned i = 0; bOK && i < m_nPrevAreas; i++)
+		{
+			bOK = AddDirectArea (&m_PrevAreas[i], nPage, pBuffer);
+		}
+	}
+
+	if (!bOK)
+	{
+		// chain is full, copy the whole screen instead
+		lv_area_t Screen = {0, 0, LV_HOR_RES_MAX-1, LV_VER_RES_MAX-1};
+
+		m_DMAChannel.SetupMemCopy2DChain (2*LV_INV_BUF_SIZE);
+		bOK = AddDirectArea (&Screen, nPage, pBuffer);
+		assert (bOK);
+	}
+
+	if (m_bPageFlipping)
+	{
+		m_nPrevAreas = 0;
+		for (unsigned i = 0; i < m_pDisplay->inv_p; i++)
+		{
+			if (!m_pDisplay->inv_area_joined[i])
+			{
+				m_PrevAreas[m_nPrevAreas++] = m_pDisplay->inv_areas[i];
+			}
+		}
+	}
+
+	m_nBackPage = nBackPage;
+	m_bFlushPending = TRUE;
+
+	m_FlushLock.Release ();
+}
+
+// m_FlushLock must be held by the caller
+void CLVGL::CompleteDirectFlush (void)
+{
+	assert (m_bFlushPending);
+	assert (m_pFrameBuffer != 0);
+
+	if (   m_bVSync
+	    && !m_bPageFlipping)
+	{
+		m_pFrameBuffer->WaitForVerticalSync ();
+	}
+
+	m_DMAChannel.Start ();
+	if (!m_DMAChannel.Wait ())
+	{
+		CLogger::Get ()->Write (FromLVGL, LogWarning, "DMA transfer failed");
+	}
+
+	if (m_bPageFlipping)
+	{
+		m_pFrameBuffer->SetVirtualOffset (0, m_nBackPage * m_pFrameBuffer->GetHeight ());
+
+		if (m_bVSync)
+		{
+			m_pFrameBuffer->WaitForVerticalSync ();
+		}
+
+		m_nFrontPage = m_nBackPage;
+	}
+
+	m_bFlushPending = FALSE;
+}
+
+boolean CLVGL::AddDirectArea (const lv_area_t *pArea, uintptr nPage, const lv_color_t *pBuffer)
+{
+	assert (pArea != 0);
+	assert (pArea->x1 <= pArea->x2);
+	assert (pArea->y1 <= pArea->y2);
+	assert (pArea->x2 < LV_HOR_RES_MAX);
+	assert (pArea->y2 < LV_VER_RES_MAX);
+
+	size_t nBlockLength = (pArea->x2-pArea->x1+1) * LV_COLOR_DEPTH/8;
+	size_t nSourcePitch = LV_HOR_RES_MAX * LV_COLOR_DEPTH/8;
+	size_t nDestPitch = m_pFrameBuffer->GetPitch ();
+
+	return m_DMAChannel.AddMemCopy2D ((void *) (nPage + pArea->y1*nDestPitch
+							  + pArea->x1*LV_COLOR_DEPTH/8),
+					  pBuffer + pArea->y1*LV_HOR_RES_MAX + pArea->x1,
+					  nBlockLength, pArea->y2-pArea->y1+1,
+					  nDestPitch - nBlockLength, nSourcePitch - nBlockLength);
+}
+
 void CLVGL::DisplayFlushComplete (unsigned nChannel, boolean bStatus, void *pParam)
 {
 	assert (bStatus);
@@ -237,10 +460,14 @@ bool CLVGL::PointerRead (lv_indev_drv_t *pDriver, lv_indev_data_t *pData)
 {
 	assert (s_pThis != 0);
 
+	s_pThis->m_PointerLock.Acquire ();
+
 	pData->state = s_pThis->m_PointerData.state;
 	pData->point.x = s_pThis->m_PointerData.point.x;
 	pData->point.y = s_pThis->m_PointerData.point.y;
 
+	s_pThis->m_PointerLock.Release ();
+
 	return false;
 }
 
@@ -249,6 +476,8 @@ void CLVGL::MouseEventHandler (TMouseEvent Event, unsigned nButtons,
 {
 	assert (s_pThis != 0);
 
+	s_pThis->m_PointerLock.Acquire ();
+
 	switch (Event)
 	{
 	case MouseEventMouseDown:
@@ -271,6 +500,8 @@ void CLVGL::MouseEventHandler (TMouseEvent Event, unsigned nButtons,
 	default:
 		break;
 	}
+
+	s_pThis->m_PointerLock.Release ();
 }
 
 void CLVGL::TouchScreenEventHandler (TTouchScreenEvent Event, unsigned nID,
@@ -278,6 +509,8 @@ void CLVGL::TouchScreenEventHandler (TTouchScreenEvent Event, unsigned nID,
 {
 	assert (s_pThis != 0);
 
+	s_pThis->m_PointerLock.Acquire ();
+
 	switch (Event)
 	{
 	case TouchScreenEventFingerDown:
@@ -300,6 +533,8 @@ void CLVGL::TouchScreenEventHandler (TTouchScreenEvent Event, unsigned nID,
 	default:
 		break;
 	}
+
+	s_pThis->m_PointerLock.Release ();
 }
 
 void CLVGL::LogPrint (lv_log_level_t Level, const char *pFile, uint32_t nLine,
@@ -29,6 +29,7 @@
 #include <circle/input/mouse.h>
 #include <circle/input/touchscreen.h>
 #include <circle/dmachannel.h>
+#include <circle/spinlock.h>
 #include <circle/types.h>
 #include <assert.h>
 
@@ -39,13 +40,35 @@ public:
 	CLVGL (CBcmFrameBuffer *pFrameBuffer, CInterruptSystem *pInterrupt);
 	~CLVGL (void);
 
+	// Call before Initialize() to render complete frames into two screen-sized buffers
+	// and to copy only the invalidated areas to the frame buffer with one chained DMA
+	// transfer per frame. With bPageFlipping the areas are copied to the hidden page
+	// and the pages are flipped (on vertical sync with bVSync). This requires that the
+	// frame buffer has a virtual height of twice its height (see SetVirtualSize()).
+	void SetDirectMode (boolean bPageFlipping = TRUE, boolean bVSync = TRUE);
+
 	boolean Initialize (void);
 
+	// handles input and renders the GUI, must be called on core 0
 	void Update (boolean bPlugAndPlayUpdated = FALSE);
 
+	// Update() split into two parts to run the renderer on a secondary core:
+	// UpdateInput() must be called on core 0, UpdateDisplay() on the rendering core.
+	// Other cores must call the LVGL API within Lock() and Unlock() then.
+	void UpdateInput (boolean bPlugAndPlayUpdated = FALSE);
+	void UpdateDisplay (void);
+
+	void Lock (void)	{ m_LVGLLock.Acquire (); }
+	void Unlock (void)	{ m_LVGLLock.Release (); }
+
 private:
+	void SetupMouse (void);
+
 	static void DisplayFlush (lv_disp_drv_t *pDriver, const lv_area_t *pArea,
 				  lv_color_t *pBuffer);
+	void DirectFlush (lv_color_t *pBuffer);
+	void CompleteDirectFlush (void);
+	boolean AddDirectArea (const lv_area_t *pArea, uintptr nPage, const lv_color_t *pBuffer);
 	static void DisplayFlushComplete (unsigned nChannel, boolean bStatus, void *pParam);
 
 	static bool PointerRead (lv_indev_drv_t *pDriver, lv_indev_data_t *pData);
@@ -68,10 +91,24 @@ private:
 	CDMAChannel m_DMAChannel;
 	unsigned m_nLastUpdate;
 
+	boolean m_bDirectMode;
+	boolean m_bPageFlipping;
+	boolean m_bVSync;
+	lv_disp_t *m_pDisplay;
+	unsigned m_nFrontPage;
+	unsigned m_nPrevAreas;			// invalidated in the previous frame
+	lv_area_t m_PrevAreas[LV_INV_BUF_SIZE];
+	boolean m_bFlushPending;		// DirectFlush() prepared a transfer
+	unsigned m_nBackPage;			// destination page of this transfer
+
 	CMouseDevice * volatile m_pMouseDevice;
 	CTouchScreenDevice *m_pTouchScreen;
 	unsigned m_nLastTouchUpdate;
 	lv_indev_data_t m_PointerData;
+	CSpinLock m_PointerLock;
+
+	CSpinLock m_LVGLLock;
+	CSpinLock m_FlushLock;			// protects m_DMAChannel and m_bFlushPending in direct mode
 
 	static CLVGL *s_pThis;
 };
@@ -0,0 +1,614 @@
+//
+// samplingprofiler.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2020  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <profile/samplingprofiler.h>
+#include <profile/gmon_out.h>
+#include <circle/exceptionstub.h>
+#include <circle/memory.h>
+#include <circle/synchronize.h>
+#include <circle/logger.h>
+#include <circle/string.h>
+#include <circle/util.h>
+#include <assert.h>
+
+#define BIN_SIZE		4		// bytes of code per histogram bin (one instruction)
+#define OUT_BUFFER_SIZE		4096
+
+#define CNTV_CTL_ENABLE		(1 << 0)
+#define CNTV_CTL_IMASK		(1 << 1)
+
+#if AARCH == 32
+	#define READ_CNTFRQ(value)	asm volatile ("mrc p15, 0, %0, c14, c0, 0" : "=r" (value))
+	#define WRITE_CNTV_TVAL(value)	asm volatile ("mcr p15, 0, %0, c14, c3, 0" :: "r" (value))
+	#define WRITE_CNTV_CTL(value)	asm volatile ("mcr p15, 0, %0, c14, c3, 1" :: "r" (value))
+#else
+	#define READ_CNTFRQ(value)	asm volatile ("mrs %0, CNTFRQ_EL0" : "=r" (value))
+	#define WRITE_CNTV_TVAL(value)	asm volatile ("msr CNTV_TVAL_EL0, %0" :: "r" ((u64) (value)))
+	#define WRITE_CNTV_CTL(value)	asm volatile ("msr CNTV_CTL_EL0, %0" :: "r" ((u64) (value)))
+#endif
+
+static const char From[] = "sprof";
+
+CSamplingProfiler::CSamplingProfiler (CInterruptSystem *pInterruptSystem,
+				      unsigned nSampleRate, boolean bCallStacks,
+				      unsigned nBufferSize,
+				      uintptr nTextStart, uintptr nTextEnd)
+:	m_pInterruptSystem (pInterruptSystem),
+	m_nSampleRate (nSampleRate),
+	m_bCallStacks (bCallStacks),
+	m_nBufferSize (nBufferSize),
+	m_nTextStart (nTextStart),
+	m_nTextEnd (nTextEnd),
+	m_nMemoryEnd (0),
+	m_bIRQConnected (FALSE),
+	m_nTimerInterval (0),
+	m_pFileSystem (0),
+	m_hFile (0),
+	m_pFile (0),
+	m_pDevice (0),
+	m_pOutBuffer (0),
+	m_nOutLength (0)
+{
+	assert (m_nSampleRate > 0);
+	assert (m_nBufferSize >= 1 + SAMPLING_PROFILER_MAX_DEPTH);
+	assert (m_nTextStart < m_nTextEnd);
+
+	for (unsigned nCore = 0; nCore < CORES; nCore++)
+	{
+		m_Core[nCore].pBuffer = 0;
+		m_Core[nCore].nUsed = 0;
+		m_Core[nCore].nSamples = 0;
+		m_Core[nCore].nDropped = 0;
+	}
+}
+
+CSamplingProfiler::~CSamplingProfiler (void)
+{
+	Stop ();
+
+	if (m_bIRQConnected)
+	{
+		assert (m_pInterruptSystem != 0);
+		m_pInterruptSystem->DisconnectIRQ (ARM_IRQLOCAL0_CNTV);
+
+		m_bIRQConnected = FALSE;
+	}
+
+	for (unsigned nCore = 0; nCore < CORES; nCore++)
+	{
+		delete [] m_Core[nCore].pBuffer;
+		m_Core[nCore].pBuffer = 0;
+	}
+
+	m_pInterruptSystem = 0;
+}
+
+boolean CSamplingProfiler::Initialize (void)
+{
+	u32 nCNTFRQ;
+	READ_CNTFRQ (nCNTFRQ);
+
+	m_nTimerInterval = nCNTFRQ / m_nSampleRate;
+	if (m_nTimerInterval == 0)
+	{
+		CLogger::Get ()->Write (From, LogError, "Sample rate too high (%u Hz)", m_nSampleRate);
+
+		return FALSE;
+	}
+
+	m_nMemoryEnd = CMemorySystem::Get ()->GetMemSize ();
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	for (unsigned nCore = 0; nCore < CORES; nCore++)
+#else
+	for (unsigned nCore = 0; nCore < 1; nCore++)
+#endif
+	{
+		m_Core[nCore].pBuffer = new uintptr[m_nBufferSize];
+		if (m_Core[nCore].pBuffer == 0)
+		{
+			CLogger::Get ()->Write (From, LogError, "Cannot allocate sample buffer");
+
+			return FALSE;
+		}
+	}
+
+	assert (m_pInterruptSystem != 0);
+	m_pInterruptSystem->ConnectIRQ (ARM_IRQLOCAL0_CNTV, InterruptStub, this);
+	m_bIRQConnected = TRUE;
+
+	return TRUE;
+}
+
+void CSamplingProfiler::Start (void)
+{
+	assert (m_bIRQConnected);
+	assert (m_Core[GetCore ()].pBuffer != 0);
+
+	// the local timer IRQs have to be enabled on each core
+	CInterruptSystem::EnableIRQ (ARM_IRQLOCAL0_CNTV);
+
+	WRITE_CNTV_TVAL (m_nTimerInterval);
+	WRITE_CNTV_CTL (CNTV_CTL_ENABLE);
+
+	InstructionSyncBarrier ();
+}
+
+void CSamplingProfiler::Stop (void)
+{
+	WRITE_CNTV_CTL (CNTV_CTL_IMASK);
+
+	InstructionSyncBarrier ();
+}
+
+boolean CSamplingProfiler::SaveResults (CFATFileSystem *pFileSystem, const char *pFileName,
+					TSamplingProfileFormat Format)
+{
+	assert (pFileSystem != 0);
+	assert (pFileName != 0);
+
+	m_hFile = pFileSystem->FileCreate (pFileName);
+	if (m_hFile == 0)
+	{
+		CLogger::Get ()->Write (From, LogError, "Cannot create file: %s", pFileName);
+
+		return FALSE;
+	}
+
+	m_pFileSystem = pFileSystem;
+
+	boolean bOK = WriteResults (Format);
+
+	if (!pFileSystem->FileClose (m_hFile))
+	{
+		bOK = FALSE;
+	}
+
+	m_pFileSystem = 0;
+	m_hFile = 0;
+
+	return bOK;
+}
+
+boolean CSamplingProfiler::SaveResults (FATFS *pFileSystem, const char *pFileName,
+					TSamplingProfileFormat Format)
+{
+	assert (pFileSystem != 0);
+	assert (pFileName != 0);
+
+	FIL File;
+	if (f_open (&File, pFileName, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK)
+	{
+		CLogger::Get ()->Write (From, LogError, "Cannot create file: %s", pFileName);
+
+		return FALSE;
+	}
+
+	m_pFile = &File;
+
+	boolean bOK = WriteResults (Format);
+
+	if (f_close (&File) != FR_OK)
+	{
+		bOK = FALSE;
+	}
+
+	m_pFile = 0;
+
+	return bOK;
+}
+
+boolean CSamplingProfiler::SaveResults (CDevice *pDevice, TSamplingProfileFormat Format)
+{
+	assert (pDevice != 0);
+	m_pDevice = pDevice;
+
+	boolean bOK = WriteResults (Format);
+
+	m_pDevice = 0;
+
+	return bOK;
+}
+
+unsigned CSamplingProfiler::GetSamples (unsigned nCore) const
+{
+	assert (nCore < CORES);
+	return m_Core[nCore].nSamples;
+}
+
+unsigned CSamplingProfiler::GetDropped (unsigned nCore) const
+{
+	assert (nCore < CORES);
+	return m_Core[nCore].nDropped;
+}
+
+void CSamplingProfiler::InterruptHandler (void)
+{
+	WRITE_CNTV_TVAL (m_nTimerInterval);		// acknowledges the interrupt too
+
+	unsigned nCore = GetCore ();
+	TCoreData *pCore = &m_Core[nCore];
+	const TIRQProfileContext *pContext = &IRQProfileContext[nCore];
+
+	unsigned nMaxWords = m_bCallStacks ? 1 + SAMPLING_PROFILER_MAX_DEPTH : 2;
+	if (   pCore->pBuffer == 0
+	    || pCore->nUsed + nMaxWords > m_nBufferSize)
+	{
+		pCore->nDropped++;
+
+		return;
+	}
+
+	uintptr *pSample = pCore->pBuffer + pCore->nUsed;
+
+	pSample[1] = pContext->nPC;
+	unsigned nDepth = 1;
+
+	if (m_bCallStacks)
+	{
+		nDepth += UnwindStack (pContext->nFP, &pSample[2], SAMPLING_PROFILER_MAX_DEPTH-1);
+	}
+
+	pSample[0] = nDepth;
+
+	pCore->nUsed += 1 + nDepth;
+	pCore->nSamples++;
+}
+
+void CSamplingProfiler::InterruptStub (void *pParam)
+{
+	CSamplingProfiler *pThis = (CSamplingProfiler *) pParam;
+	assert (pThis != 0);
+
+	pThis->InterruptHandler ();
+}
+
+// The frame record layout is defined by the ABI:
+//	AArch64: FP points to {previous FP, LR}
+//	AArch32 (GCC, ARM mode): FP points to saved LR, previous FP is stored below
+// Stack frames of callers are at higher addresses, which is used to detect a
+// corrupted or missing frame chain, because FP may be a general register otherwise.
+unsigned CSamplingProfiler::UnwindStack (uintptr nFP, uintptr *pBuffer, unsigned nMaxDepth) const
+{
+	unsigned nDepth = 0;
+	while (nDepth < nMaxDepth)
+	{
+		if (   nFP < MEM_KERNEL_END + sizeof (uintptr)
+		    || nFP > m_nMemoryEnd - 2*sizeof (uintptr)
+		    || (nFP & (sizeof (uintptr)-1)) != 0)
+		{
+			break;
+		}
+
+		const uintptr *pFrame = (const uintptr *) nFP;
+#if AARCH == 32
+		uintptr nLR = pFrame[0];
+		uintptr nNextFP = pFrame[-1];
+#else
+		uintptr nNextFP = pFrame[0];
+		uintptr nLR = pFrame[1];
+#endif
+
+		if (   nLR <= m_nTextStart
+		    || nLR > m_nTextEnd)
+		{
+			break;
+		}
+
+		pBuffer[nDepth++] = nLR - 4;		// address of the calling instruction
+
+		if (nNextFP <= nFP)
+		{
+			break;
+		}
+
+		nFP = nNextFP;
+	}
+
+	return nDepth;
+}
+
+boolean CSamplingProfiler::WriteResults (TSamplingProfileFormat Format)
+{
+	assert (m_pOutBuffer == 0);
+	m_pOutBuffer = new u8[OUT_BUFFER_SIZE];
+	if (m_pOutBuffer == 0)
+	{
+		return FALSE;
+	}
+
+	m_nOutLength = 0;
+
+	DataMemBarrier ();
+
+	boolean bOK = FALSE;
+	switch (Format)
+	{
+	case SamplingProfileGprof:
+		bOK = WriteGprof ();
+		break;
+
+	case SamplingProfileFoldedStacks:
+		bOK = WriteFoldedStacks ();
+		break;
+
+	default:
+		assert (0);
+		break;
+	}
+
+	if (   bOK
+	    && !Flush ())
+	{
+		bOK = FALSE;
+	}
+
+	delete [] m_pOutBuffer;
+	m_pOutBuffer = 0;
+
+	unsigned nSamples = 0;
+	unsigned nDropped = 0;
+	for (unsigned nCore = 0; nCore < CORES; nCore++)
+	{
+		nSamples += m_Core[nCore].nSamples;
+		nDropped += m_Core[nCore].nDropped;
+	}
+
+	if (bOK)
+	{
+		CLogger::Get ()->Write (From, LogDebug, "%u samples saved (%u dropped)",
+					nSamples, nDropped);
+	}
+	else
+	{
+		CLogger::Get ()->Write (From, LogError, "Cannot write profiling results");
+	}
+
+	return bOK;
+}
+
+boolean CSamplingProfiler::WriteGprof (void)
+{
+	unsigned nBins = (m_nTextEnd - m_nTextStart + BIN_SIZE-1) / BIN_SIZE;
+
+	u16 *pHistogram = new u16[nBins];
+	if (pHistogram == 0)
+	{
+		return FALSE;
+	}
+
+	memset (pHistogram, 0, nBins * sizeof (u16));
+
+	for (unsigned nCore = 0; nCore < CORES; nCore++)
+	{
+		const uintptr *pBuffer = m_Core[nCore].pBuffer;
+		unsigned nUsed = m_Core[nCore].nUsed;
+
+		for (unsigned i = 0; i < nUsed; i += 1 + pBuffer[i])
+		{
+			uintptr nPC = pBuffer[i+1];
+			if (   nPC >= m_nTextStart
+			    && nPC < m_nTextEnd)
+			{
+				unsigned nBin = (nPC - m_nTextStart) / BIN_SIZE;
+				if (pHistogram[nBin] < 0xFFFF)
+				{
+					pHistogram[nBin]++;
+				}
+			}
+		}
+	}
+
+	struct gmon_hdr Header;
+	memset (&Header, 0, sizeof Header);
+	memcpy (Header.cookie, GMON_MAGIC, sizeof Header.cookie);
+	u32 nVersion = GMON_VERSION;
+	memcpy (Header.version, &nVersion, sizeof Header.version);
+
+	u8 uchTag = GMON_TAG_TIME_HIST;
+
+	struct gmon_hist_hdr HistHeader;
+	memset (&HistHeader, 0, sizeof HistHeader);
+	uintptr nLowPC = m_nTextStart;
+	uintptr nHighPC = m_nTextStart + nBins * BIN_SIZE;
+	memcpy (HistHeader.low_pc, &nLowPC, sizeof HistHeader.low_pc);
+	memcpy (HistHeader.high_pc, &nHighPC, sizeof HistHeader.high_pc);
+	u32 nHistSize = nBins;
+	memcpy (HistHeader.hist_size, &nHistSize, sizeof HistHeader.hist_size);
+	u32 nProfRate = m_nSampleRate;
+	memcpy (HistHeader.prof_rate, &nProfRate, sizeof HistHeader.prof_rate);
+	strncpy (HistHeader.dimen, "seconds", sizeof HistHeader.dimen);
+	HistHeader.dimen_abbrev = 's';
+
+	boolean bOK =    Output (&Header, sizeof Header)
+		      && Output (&uchTag, sizeof uchTag)
+		      && Output (&HistHeader, sizeof HistHeader)
+		      && Output (pHistogram, nBins * sizeof (u16));
+
+	delete [] pHistogram;
+
+	return bOK;
+}
+
+boolean CSamplingProfiler::WriteFoldedStacks (void)
+{
+	// aggregate identical stacks using a hash table with open addressing
+	struct TStackEntry
+	{
+		const uintptr *pSample;
+		unsigned nCore;
+		unsigned nCount;
+	};
+
+	unsigned nSamples = 0;
+	for (unsigned nCore = 0; nCore < CORES; nCore++)
+	{
+		nSamples += m_Core[nCore].nSamples;
+	}
+
+	unsigned nTableSize = 16;
+	while (nTableSize < 2*nSamples)
+	{
+		nTableSize <<= 1;
+	}
+
+	TStackEntry *pTable = new TStackEntry[nTableSize];
+	if (pTable == 0)
+	{
+		return FALSE;
+	}
+
+	memset (pTable, 0, nTableSize * sizeof (TStackEntry));
+
+	for (unsigned nCore = 0; nCore < CORES; nCore++)
+	{
+		const uintptr *pBuffer = m_Core[nCore].pBuffer;
+		unsigned nUsed = m_Core[nCore].nUsed;
+
+		for (unsigned i = 0; i < nUsed; i += 1 + pBuffer[i])
+		{
+			const uintptr *pSample = &pBuffer[i];
+			unsigned nWords = 1 + pSample[0];
+
+			u32 nHash = 2166136261U ^ nCore;		// FNV-1a
+			for (unsigned j = 0; j < nWords; j++)
+			{
+				nHash = (nHash ^ (u32) pSample[j]) * 16777619U;
+			}
+
+			unsigned nIndex = nHash & (nTableSize-1);
+			while (pTable[nIndex].pSample != 0)
+			{
+				if (   pTable[nIndex].nCore == nCore
+				    && memcmp (pTable[nIndex].pSample, pSample,
+					       nWords * sizeof (uintptr)) == 0)
+				{
+					break;
+				}
+
+				nIndex = (nIndex + 1) & (nTableSize-1);
+			}
+
+			pTable[nIndex].pSample = pSample;
+			pTable[nIndex].nCore = nCore;
+			pTable[nIndex].nCount++;
+		}
+	}
+
+	boolean bOK = TRUE;
+	for (unsigned nIndex = 0; bOK && nIndex < nTableSize; nIndex++)
+	{
+		const uintptr *pSample = pTable[nIndex].pSample;
+		if (pSample == 0)
+		{
+			continue;
+		}
+
+		// the outermost caller comes first
+		CString Line;
+		Line.Format ("core%u", pTable[nIndex].nCore);
+
+		for (unsigned j = pSample[0]; j >= 1; j--)
+		{
+			CString Frame;
+			Frame.Format (";0x%lx", (unsigned long) pSample[j]);
+			Line.Append (Frame);
+		}
+
+		CString Count;
+		Count.Format (" %u\n", pTable[nIndex].nCount);
+		Line.Append (Count);
+
+		bOK = Output ((const char *) Line, Line.GetLength ());
+	}
+
+	delete [] pTable;
+
+	return bOK;
+}
+
+boolean CSamplingProfiler::Output (const void *pData, unsigned nLength)
+{
+	const u8 *pSource = (const u8 *) pData;
+
+	while (nLength > 0)
+	{
+		assert (m_pOutBuffer != 0);
+		unsigned nChunk = OUT_BUFFER_SIZE - m_nOutLength;
+		if (nChunk > nLength)
+		{
+			nChunk = nLength;
+		}
+
+		memcpy (m_pOutBuffer + m_nOutLength, pSource, nChunk);
+		m_nOutLength += nChunk;
+		pSource += nChunk;
+		nLength -= nChunk;
+
+		if (   m_nOutLength == OUT_BUFFER_SIZE
+		    && !Flush ())
+		{
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+boolean CSamplingProfiler::Flush (void)
+{
+	if (m_nOutLength == 0)
+	{
+		return TRUE;
+	}
+
+	boolean bOK = FALSE;
+	if (m_pFileSystem != 0)
+	{
+		bOK = m_pFileSystem->FileWrite (m_hFile, m_pOutBuffer, m_nOutLength) == m_nOutLength;
+	}
+	else if (m_pFile != 0)
+	{
+		UINT nWritten;
+		bOK =    f_write (m_pFile, m_pOutBuffer, m_nOutLength, &nWritten) == FR_OK
+		      && nWritten == m_nOutLength;
+	}
+	else
+	{
+		assert (m_pDevice != 0);
+		bOK = m_pDevice->Write (m_pOutBuffer, m_nOutLength) == (int) m_nOutLength;
+	}
+
+	m_nOutLength = 0;
+
+	return bOK;
+}
+
+unsigned CSamplingProfiler::GetCore (void)
+{
+#if AARCH == 32
+	u32 nMPIDR;
+	asm volatile ("mrc p15, 0, %0, c0, c0, 5" : "=r" (nMPIDR));
+#else
+	u64 nMPIDR;
+	asm volatile ("mrs %0, mpidr_el1" : "=r" (nMPIDR));
+#endif
+
+	return nMPIDR & (CORES-1);
+}
@@ -0,0 +1,156 @@
+//
+// samplingprofiler.h
+//
+// Statistical profiler, which samples all cores using the generic timer
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2020  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _profile_samplingprofiler_h
+#define _profile_samplingprofiler_h
+
+#include <circle/interrupt.h>
+#include <circle/fs/fat/fatfs.h>
+#include <circle/device.h>
+#include <circle/sysconfig.h>
+#include <circle/types.h>
+#include <fatfs/ff.h>
+
+#if RASPPI == 1
+	#error The sampling profiler requires the generic timer (Raspberry Pi 2 or later)!
+#endif
+
+#define SAMPLING_PROFILER_MAX_DEPTH	32	// maximum number of frames per sample
+
+extern u8 _start, _etext;
+
+enum TSamplingProfileFormat
+{
+	SamplingProfileGprof,		///< gmon.out histogram (flat profile only)
+	SamplingProfileFoldedStacks,	///< perf-style folded stacks ("core0;0x..;0x.. count")
+	SamplingProfileUnknown
+};
+
+/// \note Each core, which should be sampled, has to call Start() and Stop() itself.
+/// \note Call stacks are captured by walking the frame pointer chain. The profiled code\n
+///	  must be built with "-fno-omit-frame-pointer" (and "-marm" on AArch32) for this.
+
+class CSamplingProfiler		/// Samples the PC (and optionally the call stack) on all cores
+{
+public:
+	/// \param pInterruptSystem Pointer to the interrupt system object
+	/// \param nSampleRate Samples per second and core (e.g. 1000-10000)
+	/// \param bCallStacks Capture the call stack of each sample?
+	/// \param nBufferSize Size of the sample buffer of each core in words
+	/// \param nTextStart Start address of the code to be profiled
+	/// \param nTextEnd End address of the code to be profiled
+	CSamplingProfiler (CInterruptSystem *pInterruptSystem,
+			   unsigned nSampleRate = 1000,
+			   boolean bCallStacks = FALSE,
+			   unsigned nBufferSize = 0x10000,
+			   uintptr nTextStart = (uintptr) &_start,
+			   uintptr nTextEnd = (uintptr) &_etext);
+
+	~CSamplingProfiler (void);
+
+	/// \brief Allocate the sample buffers and connect the timer interrupt
+	/// \return Operation successful?
+	/// \note Must be called on core 0.
+	boolean Initialize (void);
+
+	/// \brief Start sampling on the calling core
+	void Start (void);
+	/// \brief Stop sampling on the calling core
+	void Stop (void);
+
+	/// \brief Save the results to a file
+	/// \param pFileSystem Pointer to the mounted file system object to be used
+	/// \param pFileName Name of the file to be created (e.g. "gmon.out")
+	/// \param Format Output format
+	/// \return Operation successful?
+	boolean SaveResults (CFATFileSystem *pFileSystem, const char *pFileName,
+			     TSamplingProfileFormat Format = SamplingProfileGprof);
+
+	/// \brief Save the results to a file
+	/// \param pFileSystem Pointer to the mounted FatFs file system struct to be used
+	/// \param pFileName Path of the file to be created (e.g. "SD:/gmon.out")
+	/// \param Format Output format
+	/// \return Operation successful?
+	boolean SaveResults (FATFS *pFileSystem, const char *pFileName,
+			     TSamplingProfileFormat Format = SamplingProfileGprof);
+
+	/// \brief Save the results to a device (e.g. CQEMUHostFile)
+	/// \param pDevice Pointer to the device, which is written
+	/// \param Format Output format
+	/// \return Operation successful?
+	boolean SaveResults (CDevice *pDevice,
+			     TSamplingProfileFormat Format = SamplingProfileFoldedStacks);
+
+	/// \param nCore Core number
+	/// \return Number of samples recorded on this core
+	unsigned GetSamples (unsigned nCore) const;
+	/// \param nCore Core number
+	/// \return Number of samples lost on this core, because the buffer was full
+	unsigned GetDropped (unsigned nCore) const;
+
+private:
+	void InterruptHandler (void);
+	static void InterruptStub (void *pParam);
+
+	unsigned UnwindStack (uintptr nFP, uintptr *pBuffer, unsigned nMaxDepth) const;
+
+	boolean WriteResults (TSamplingProfileFormat Format);
+	boolean WriteGprof (void);
+	boolean WriteFoldedStacks (void);
+
+	boolean Output (const void *pData, unsigned nLength);
+	boolean Flush (void);
+
+	static unsigned GetCore (void);
+
+private:
+	CInterruptSystem *m_pInterruptSystem;
+	unsigned m_nSampleRate;
+	boolean m_bCallStacks;
+	unsigned m_nBufferSize;
+	uintptr m_nTextStart;
+	uintptr m_nTextEnd;
+	uintptr m_nMemoryEnd;
+
+	boolean m_bIRQConnected;
+	u32 m_nTimerInterval;
+
+	struct TCoreData
+	{
+		uintptr *pBuffer;		// depth, PC, return addresses, depth, ...
+		volatile unsigned nUsed;	// in words
+		volatile unsigned nSamples;
+		volatile unsigned nDropped;
+	};
+
+	TCoreData m_Core[CORES];
+
+	// output
+	CFATFileSystem *m_pFileSystem;
+	unsigned m_hFile;
+	FIL *m_pFile;
+	CDevice *m_pDevice;
+
+	u8 *m_pOutBuffer;
+	unsigned m_nOutLength;
+};
+
+#endif
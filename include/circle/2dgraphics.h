@@ -0,0 +1,213 @@
+//
+// 2dgraphics.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2020  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_2dgraphics_h
+#define _circle_2dgraphics_h
+
+#include <circle/bcmframebuffer.h>
+#include <circle/chargenerator.h>
+#include <circle/dmachannel.h>
+#include <circle/screen.h>
+#include <circle/macros.h>
+#include <circle/types.h>
+
+#define GRAPHICS_MAX_BUFFERS	3		// triple buffering
+#define GRAPHICS_MAX_DIRTY	16		// rectangles per buffer, merged if exceeded
+
+/// \note The pixel format is the same as for CScreenDevice (TScreenColor, see DEPTH).
+/// \note All drawing operations go to the back buffer and are clipped to the screen.\n
+///	  UpdateDisplay() shows the back buffer and brings the next back buffer up to\n
+///	  date by copying only the regions, which have been changed in the meantime.
+/// \note The inner loops are compiled with MAXOPT, so that they are vectorized (NEON)\n
+///	  on the Raspberry Pi 2-4. This class must not be used from an IRQ handler.
+
+class C2DGraphics		/// Double/triple buffered 2D graphics with dirty rectangle tracking
+{
+public:
+	/// \param nWidth Screen width in pixels (0 for default resolution)
+	/// \param nHeight Screen height in pixels (0 for default resolution)
+	/// \param bVSync Wait for vertical sync on UpdateDisplay()?
+	/// \param nBuffers Number of frame buffers (1: no page flipping, 2: double, 3: triple)
+	/// \param nDisplay Zero-based display number (for Raspberry Pi 4)
+	C2DGraphics (unsigned nWidth, unsigned nHeight, boolean bVSync = TRUE,
+		     unsigned nBuffers = 2, unsigned nDisplay = 0);
+
+	~C2DGraphics (void);
+
+	/// \return Operation successful?
+	/// \note Falls back to fewer buffers, if the firmware does not provide enough memory.
+	boolean Initialize (void);
+
+	/// \return Screen width in pixels
+	unsigned GetWidth (void) const		{ return m_nWidth; }
+	/// \return Screen height in pixels
+	unsigned GetHeight (void) const		{ return m_nHeight; }
+	/// \return Number of frame buffers in use
+	unsigned GetBufferCount (void) const	{ return m_nBuffers; }
+
+	/// \return Pointer to frame buffer object (e.g. to set the palette with DEPTH 8)
+	CBcmFrameBuffer *GetFrameBuffer (void)	{ return m_pFrameBuffer; }
+
+	/// \brief Fill the whole screen
+	/// \param Color Fill color
+	void ClearScreen (TScreenColor Color);
+
+	/// \brief Draw a filled rectangle
+	/// \param nX X-Position of the upper left corner
+	/// \param nY Y-Position of the upper left corner
+	/// \param nWidth Width in pixels
+	/// \param nHeight Height in pixels
+	/// \param Color Fill color
+	void DrawRect (unsigned nX, unsigned nY, unsigned nWidth, unsigned nHeight,
+		       TScreenColor Color) MAXOPT;
+
+	/// \brief Draw a filled rectangle, which is blended with the background
+	/// \param nX X-Position of the upper left corner
+	/// \param nY Y-Position of the upper left corner
+	/// \param nWidth Width in pixels
+	/// \param nHeight Height in pixels
+	/// \param Color Fill color
+	/// \param uchAlpha Opacity (0: transparent, 255: opaque)
+	void DrawRectBlended (unsigned nX, unsigned nY, unsigned nWidth, unsigned nHeight,
+			      TScreenColor Color, u8 uchAlpha) MAXOPT;
+
+	/// \brief Draw the outline of a rectangle
+	/// \param nX X-Position of the upper left corner
+	/// \param nY Y-Position of the upper left corner
+	/// \param nWidth Width in pixels
+	/// \param nHeight Height in pixels
+	/// \param Color Line color
+	void DrawRectOutline (unsigned nX, unsigned nY, unsigned nWidth, unsigned nHeight,
+			      TScreenColor Color);
+
+	/// \brief Draw a line
+	/// \param nX1 X-Position of the start point
+	/// \param nY1 Y-Position of the start point
+	/// \param nX2 X-Position of the end point
+	/// \param nY2 Y-Position of the end point
+	/// \param Color Line color
+	void DrawLine (unsigned nX1, unsigned nY1, unsigned nX2, unsigned nY2, TScreenColor Color);
+
+	/// \brief Set a pixel
+	/// \param nX X-Position of the pixel
+	/// \param nY Y-Position of the pixel
+	/// \param Color Pixel color
+	void DrawPixel (unsigned nX, unsigned nY, TScreenColor Color);
+
+	/// \brief Copy an image to the screen
+	/// \param nX X-Position of the upper left corner
+	/// \param nY Y-Position of the upper left corner
+	/// \param nWidth Image width in pixels
+	/// \param nHeight Image height in pixels
+	/// \param pPixels Image data (nWidth * nHeight pixels, line by line)
+	void DrawImage (unsigned nX, unsigned nY, unsigned nWidth, unsigned nHeight,
+			const TScreenColor *pPixels) MAXOPT;
+
+	/// \brief Copy an image to the screen, pixels with a specific color are not copied
+	/// \param nX X-Position of the upper left corner
+	/// \param nY Y-Position of the upper left corner
+	/// \param nWidth Image width in pixels
+	/// \param nHeight Image height in pixels
+	/// \param pPixels Image data (nWidth * nHeight pixels, line by line)
+	/// \param TransparentColor Pixels with this color are not copied
+	void DrawImageTransparent (unsigned nX, unsigned nY, unsigned nWidth, unsigned nHeight,
+				   const TScreenColor *pPixels, TScreenColor TransparentColor) MAXOPT;
+
+	/// \brief Blend an image with the screen contents
+	/// \param nX X-Position of the upper left corner
+	/// \param nY Y-Position of the upper left corner
+	/// \param nWidth Image width in pixels
+	/// \param nHeight Image height in pixels
+	/// \param pPixels Image data (nWidth * nHeight pixels, line by line)
+	/// \param uchAlpha Opacity of the image (0: transparent, 255: opaque)
+	/// \note With DEPTH 8 (palette) the image is copied, if uchAlpha >= 128.
+	void DrawImageBlended (unsigned nX, unsigned nY, unsigned nWidth, unsigned nHeight,
+			       const TScreenColor *pPixels, u8 uchAlpha) MAXOPT;
+
+	/// \brief Draw a text with the font of CScreenDevice
+	/// \param nX X-Position of the upper left corner of the first character
+	/// \param nY Y-Position of the upper left corner of the first character
+	/// \param Color Text color (the background is not touched)
+	/// \param pText Text to be drawn (one line)
+	void DrawText (unsigned nX, unsigned nY, TScreenColor Color, const char *pText);
+
+	/// \return Pointer to the back buffer for direct access
+	/// \note Call MarkDirty() for the modified region afterwards.
+	TScreenColor *GetBuffer (void);
+	/// \return Distance between two lines in the buffer in pixels
+	unsigned GetPitch (void) const		{ return m_nPitch; }
+
+	/// \brief Mark a region of the back buffer as modified
+	/// \param nX X-Position of the upper left corner
+	/// \param nY Y-Position of the upper left corner
+	/// \param nWidth Width in pixels
+	/// \param nHeight Height in pixels
+	void MarkDirty (unsigned nX, unsigned nY, unsigned nWidth, unsigned nHeight);
+
+	/// \brief Display the back buffer (page flip) and prepare the next back buffer
+	void UpdateDisplay (void);
+
+private:
+	struct TRect
+	{
+		unsigned nX1, nY1;		// upper left corner
+		unsigned nX2, nY2;		// lower right corner (exclusive)
+	};
+
+private:
+	boolean Clip (unsigned nX, unsigned nY, unsigned *pWidth, unsigned *pHeight) const;
+
+	void AddDirty (unsigned nBuffer, const TRect &rRect);
+	void SyncBuffer (unsigned nToBuffer, unsigned nFromBuffer);
+
+	TScreenColor *GetBufferAddress (unsigned nBuffer) const
+	{
+		return m_pBufferBase + nBuffer * m_nHeight * m_nPitch;
+	}
+
+	static TScreenColor Blend (TScreenColor Foreground, TScreenColor Background,
+				   unsigned nAlpha);
+
+private:
+	unsigned m_nInitWidth;
+	unsigned m_nInitHeight;
+	boolean m_bVSync;
+	unsigned m_nBuffers;
+	unsigned m_nDisplay;
+
+	CBcmFrameBuffer *m_pFrameBuffer;
+	CCharGenerator m_CharGen;
+	CDMAChannel m_DMAChannel;
+
+	TScreenColor *m_pBufferBase;
+	unsigned m_nWidth;
+	unsigned m_nHeight;
+	unsigned m_nPitch;			// in pixels
+
+	unsigned m_nBackBuffer;
+
+	struct TDirtyList			// regions not yet copied to this buffer
+	{
+		unsigned nCount;
+		TRect Rect[GRAPHICS_MAX_DIRTY];
+	}
+	m_Dirty[GRAPHICS_MAX_BUFFERS];
+};
+
+#endif
@@ -0,0 +1,82 @@
+//
+// allocationsites.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2020  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_allocationsites_h
+#define _circle_allocationsites_h
+
+#include <circle/device.h>
+#include <circle/types.h>
+
+#define ALLOCATION_SITES	256		// must be a power of 2
+
+struct TAllocationSite
+{
+	uintptr	nCaller;			// return address of the allocating call
+	size_t	nBytes;				// live bytes
+	unsigned nBlocks;			// live blocks
+};
+
+/// \note Used by CHeapAllocator and CPageAllocator with HEAP_TRACKING enabled.\n
+///	  The caller has to serialize the access.
+
+class CAllocationSites		/// Accounts live allocations by call site in a fixed hash table
+{
+public:
+	CAllocationSites (void);
+	~CAllocationSites (void);
+
+	/// \param pTable Memory for the table (GetTableSize() bytes)
+	void Setup (void *pTable);
+
+	/// \return Is the table set up?
+	boolean IsSetUp (void) const		{ return m_pSite != 0; }
+
+	/// \return Size of the table memory in bytes
+	static size_t GetTableSize (void)	{ return ALLOCATION_SITES * sizeof (TAllocationSite); }
+
+	/// \param nCaller Call site (return address)
+	/// \param nBytes Size of the allocated block
+	void Add (uintptr nCaller, size_t nBytes);
+	/// \param nCaller Call site (return address), which has allocated the block
+	/// \param nBytes Size of the freed block
+	void Remove (uintptr nCaller, size_t nBytes);
+
+	/// \return Size of a snapshot in bytes
+	static size_t GetSnapshotSize (void)	{ return GetTableSize () + sizeof (TAllocationSite); }
+
+	/// \param pBuffer Table contents will be copied here (GetSnapshotSize() bytes)
+	void Snapshot (TAllocationSite *pBuffer) const;
+
+	/// \brief Write the call sites with most live bytes from a snapshot
+	/// \param pSource Source name for the log messages (e.g. heap name)
+	/// \param pSnapshot Snapshot of the table (will be sorted)
+	/// \param pTarget Device to write the report to (0 for logger)
+	/// \param nMaxSites Maximum number of call sites to be written
+	static void Report (const char *pSource, TAllocationSite *pSnapshot,
+			    CDevice *pTarget, unsigned nMaxSites);
+
+private:
+	TAllocationSite *Lookup (uintptr nCaller, boolean bInsert);
+
+private:
+	TAllocationSite *m_pSite;
+	TAllocationSite  m_Other;		// for unknown call sites or if the table is full
+};
+
+#endif
@@ -27,6 +27,7 @@
 #define GIC_SPI(n)		(32 + (n))	// shared between cores
 
 // IRQs
+#define ARM_IRQLOCAL0_CNTV	GIC_PPI (11)
 #define ARM_IRQLOCAL0_CNTPNS	GIC_PPI (14)
 
 #define ARM_IRQ_ARM_DOORBELL_0	GIC_SPI (34)
@@ -46,6 +46,9 @@ public:
 	void SetPalette (u8 nIndex, u16 nRGB565);	// with Depth <= 8 only
 	void SetPalette32 (u8 nIndex, u32 nRGBA);	// with Depth <= 8 only
 
+	// set the virtual size (e.g. for panning), must be called before Initialize()
+	void SetVirtualSize (unsigned nVirtualWidth, unsigned nVirtualHeight);
+
 	boolean Initialize (void);
 
 	u32 GetWidth (void) const;
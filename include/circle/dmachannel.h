@@ -66,6 +66,28 @@ public:
 			     size_t nBlockLength, unsigned nBlockCount, size_t nBlockStride,
 			     unsigned nBurstLength = 0);
 
+	// build a chain of 2D copies, which is executed with one Start() (e.g. to copy
+	// multiple areas between frame buffers), nMaxCopies control blocks are allocated
+	// on first use, the source cache is cleaned, destination cache is not touched
+	// (these methods are not supported with DMA_CHANNEL_LITE and _EXTENDED)
+	void SetupMemCopy2DChain (unsigned nMaxCopies, unsigned nBurstLength = 0);
+	// nDestinationStride and nSourceStride are the bytes skipped after each block,
+	// returns FALSE if the chain is full
+	boolean AddMemCopy2D (void *pDestination, const void *pSource,
+			      size_t nBlockLength, unsigned nBlockCount,
+			      size_t nDestinationStride, size_t nSourceStride);
+
+	// build a chain of linear copies, which is executed with one Start() (scatter-gather),
+	// nMaxCopies control blocks are allocated on first use, source and destination cache
+	// are cleaned and invalidated before, but not after the transfer
+	// (these methods are not supported with DMA_CHANNEL_EXTENDED)
+	void SetupMemCopyChain (unsigned nMaxCopies, unsigned nBurstLength = 0);
+	// returns FALSE if the chain is full
+	boolean AddMemCopy (void *pDestination, const void *pSource, size_t nLength);
+
+	// returns the maximum length of one copy (lower with DMA_CHANNEL_LITE)
+	size_t GetMaxCopyLength (void) const;
+
 	void SetCompletionRoutine (TDMACompletionRoutine *pRoutine, void *pParam);
 
 	void Start (void);
@@ -73,6 +95,8 @@ public:
 	boolean GetStatus (void);
 
 private:
+	void AllocateChain (unsigned nMaxCopies, unsigned nBurstLength);
+
 	void InterruptHandler (void);
 	static void InterruptStub (void *pParam);
 
@@ -82,6 +106,13 @@ private:
 	u8 *m_pControlBlockBuffer;
 	TDMAControlBlock *m_pControlBlock;
 
+	u8 *m_pChainBuffer;
+	TDMAControlBlock *m_pChain;
+	unsigned m_nChainSize;			// allocated control blocks
+	unsigned m_nChainLength;		// used control blocks
+	boolean m_bChain;			// chain set up, Start() runs the chain
+	unsigned m_nChainBurstLength;
+
 	CInterruptSystem *m_pInterruptSystem;
 	boolean m_bIRQConnected;
 
@@ -0,0 +1,203 @@
+//
+// dmaengine.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2020  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_dmaengine_h
+#define _circle_dmaengine_h
+
+#include <circle/dmachannel.h>
+#include <circle/interrupt.h>
+#include <circle/spinlock.h>
+#include <circle/types.h>
+
+#define DMA_ENGINE_MAX_CHANNELS		4	// channels in the pool
+#define DMA_ENGINE_MAX_SEGMENTS		16	// scatter-gather segments per request
+#define DMA_ENGINE_CHAIN_LENGTH		32	// control blocks per channel start
+
+#define DMA_ENGINE_MIN_COPY		4096	// smaller copies are done by the CPU
+
+class CDMARequest;
+
+typedef void TDMARequestCompletionRoutine (CDMARequest *pRequest, boolean bStatus,
+					   void *pParam);
+
+/// \note The completion routine is called from interrupt context on core 0. It may call\n
+///	  CSynchronizationEvent::Set() to wake up a task, which waits for the request.
+
+class CDMARequest	/// Scatter-gather memory copy request, which is processed by CDMAEngine
+{
+public:
+	CDMARequest (void);
+	~CDMARequest (void);
+
+	/// \brief Remove all segments to re-use the request
+	/// \note Must not be called while the request is pending.
+	void Reset (void);
+
+	/// \brief Append a segment to the request
+	/// \param pDestination Destination address (cached memory)
+	/// \param pSource Source address (cached memory)
+	/// \param nLength Length of the segment in bytes
+	/// \return FALSE if DMA_ENGINE_MAX_SEGMENTS are already used
+	boolean AddCopy (void *pDestination, const void *pSource, size_t nLength);
+
+	/// \param pRoutine Routine, which is called, when the request has been completed
+	/// \param pParam Parameter handed over to the completion routine
+	void SetCompletionRoutine (TDMARequestCompletionRoutine *pRoutine, void *pParam = 0);
+
+	/// \return Request has been completed?
+	boolean IsDone (void) const		{ return m_bDone; }
+	/// \return Request completed successfully? (valid if IsDone() returns TRUE)
+	boolean GetStatus (void) const		{ return m_bStatus; }
+
+	/// \return Total number of bytes to be copied
+	size_t GetLength (void) const;
+
+private:
+	friend class CDMAEngine;
+
+	struct TSegment
+	{
+		u8	 *pDestination;
+		const u8 *pSource;
+		size_t	  nLength;
+	};
+
+	TSegment m_Segment[DMA_ENGINE_MAX_SEGMENTS];
+	unsigned m_nSegments;
+
+	TDMARequestCompletionRoutine *m_pCompletionRoutine;
+	void *m_pCompletionParam;
+
+	volatile boolean m_bDone;
+	boolean m_bStatus;
+
+	// progress, while the request is processed
+	unsigned m_nNextSegment;
+	size_t m_nNextOffset;
+
+	CDMARequest *m_pNext;		// in the queue of CDMAEngine
+};
+
+/// \note On Raspberry Pi 4 the normal and lite DMA channels can only access the first\n
+///	  GB of memory. Requests are not checked for this, buffers above must not be used,\n
+///	  if the pool contains these channels (nChannels is greater than the number of free\n
+///	  DMA4 channels, which is normally 3, or bPreferExtended is not set).
+
+class CDMAEngine	/// Shared DMA service with a pool of channels and a request queue
+{
+public:
+	/// \param pInterruptSystem Pointer to the interrupt system object
+	/// \param nChannels Number of channels in the pool (<= DMA_ENGINE_MAX_CHANNELS)
+	/// \param bPreferExtended Allocate DMA4 channels first (on Raspberry Pi 4 only)
+	/// \param nBurstLength Burst length of the transfers (> 0 may congest the system bus)
+	CDMAEngine (CInterruptSystem *pInterruptSystem, unsigned nChannels = 2,
+		    boolean bPreferExtended = TRUE, unsigned nBurstLength = 2);
+
+	~CDMAEngine (void);
+
+	/// \brief Allocate the channels of the pool
+	/// \return Operation successful? (at least one channel available)
+	boolean Initialize (void);
+
+	/// \brief Queue a request for asynchronous execution
+	/// \param pRequest Request with at least one segment
+	/// \return Operation successful?
+	/// \note The request must not be modified or destroyed, until it is completed.
+	boolean Submit (CDMARequest *pRequest);
+
+	/// \brief Wait for the completion of a submitted request (busy waiting)
+	/// \param pRequest Submitted request
+	/// \return Request completed successfully?
+	/// \note Must not be called from interrupt context. Tasks should better wait for a\n
+	///	  CSynchronizationEvent, which is set by the completion routine.
+	boolean Wait (CDMARequest *pRequest);
+
+	/// \brief Copy memory synchronously, large copies are executed by DMA
+	/// \param pDestination Destination address
+	/// \param pSource Source address
+	/// \param nLength Number of bytes to be copied
+	/// \return pDestination
+	/// \note Must not be called from interrupt context.
+	void *MemCopy (void *pDestination, const void *pSource, size_t nLength);
+
+	/// \brief Copy memory asynchronously, small copies are done by the CPU immediately
+	/// \param pRequest Request object to be used (is reset before)
+	/// \param pDestination Destination address
+	/// \param pSource Source address
+	/// \param nLength Number of bytes to be copied
+	/// \param pRoutine Completion routine (may be called before this method returns)
+	/// \param pParam Parameter handed over to the completion routine
+	/// \return Operation successful?
+	boolean MemCopyAsync (CDMARequest *pRequest,
+			      void *pDestination, const void *pSource, size_t nLength,
+			      TDMARequestCompletionRoutine *pRoutine = 0, void *pParam = 0);
+
+	/// \return Number of channels in the pool
+	unsigned GetChannelCount (void) const	{ return m_nChannels; }
+
+	/// \return Number of completed requests
+	unsigned GetRequestCount (void) const	{ return m_nRequests; }
+	/// \return Number of requests, which had to wait for a free channel
+	unsigned GetQueuedCount (void) const	{ return m_nQueued; }
+	/// \return Number of requests completed with an error
+	unsigned GetErrorCount (void) const	{ return m_nErrors; }
+
+	/// \return Pointer to the only instance of CDMAEngine (0 if not constructed)
+	static CDMAEngine *Get (void);
+
+private:
+	struct TChannel;
+
+	void StartTransfer (TChannel *pChannel);
+	void CompleteRequest (CDMARequest *pRequest, boolean bStatus);
+
+	void CompletionRoutine (TChannel *pChannel, boolean bStatus);
+	static void CompletionStub (unsigned nChannel, boolean bStatus, void *pParam);
+
+private:
+	CInterruptSystem *m_pInterruptSystem;
+	unsigned m_nMaxChannels;
+	boolean m_bPreferExtended;
+	unsigned m_nBurstLength;
+
+	struct TChannel
+	{
+		CDMAEngine	*pThis;
+		CDMAChannel	*pChannel;
+		boolean		 bExtended;
+		size_t		 nMaxLength;
+		CDMARequest	*pRequest;	// active request (0 if idle)
+	};
+
+	TChannel m_Channel[DMA_ENGINE_MAX_CHANNELS];
+	unsigned m_nChannels;
+
+	CDMARequest *m_pQueueHead;
+	CDMARequest *m_pQueueTail;
+
+	volatile unsigned m_nRequests;
+	volatile unsigned m_nQueued;
+	volatile unsigned m_nErrors;
+
+	CSpinLock m_SpinLock;
+
+	static CDMAEngine *s_pThis;
+};
+
+#endif
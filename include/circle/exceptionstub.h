@@ -21,6 +21,7 @@
 #define _circle_exceptionstub_h
 
 #include <circle/macros.h>
+#include <circle/sysconfig.h>
 #include <circle/types.h>
 
 #ifdef __cplusplus
@@ -149,6 +150,20 @@ extern TFIQData FIQData;
 
 extern uintptr IRQReturnAddress;		// for profiling
 
+// interrupted context per core, for statistical profiling
+struct TIRQProfileContext
+{
+	uintptr nPC;				// return address of the IRQ
+	uintptr nFP;				// frame pointer of the interrupted code
+}
+PACKED;
+
+#if RASPPI == 1
+extern TIRQProfileContext IRQProfileContext[1];
+#else
+extern TIRQProfileContext IRQProfileContext[CORES];
+#endif
+
 #ifdef __cplusplus
 }
 #endif
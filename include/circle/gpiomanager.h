@@ -2,7 +2,7 @@
 // gpiomanager.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2014  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2014-2020  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -32,6 +32,18 @@ public:
 
 	boolean Initialize (void);
 
+	/// \brief Read the captured events of all pins, which use the event capture
+	/// \param pBuffer Events will be stored here (sorted by timestamp)
+	/// \param nMaxEvents Maximum number of events to be returned
+	/// \return Number of events returned (0 if none available)
+	/// \note Must be called from TASK_LEVEL on core 0.
+	unsigned ReadEvents (TGPIOEvent *pBuffer, unsigned nMaxEvents);
+
+	/// \return Current value of the counter used for event timestamps (CTimer::GetTicks64())
+	static u64 GetTimestamp (void);
+	/// \return Frequency of the timestamp counter in Hz
+	static u64 GetTimestampFrequency (void);
+
 private:
 	void ConnectInterrupt (CGPIOPin *pPin);
 	void DisconnectInterrupt (CGPIOPin *pPin);
@@ -40,6 +52,8 @@ private:
 	void InterruptHandler (void);
 	static void InterruptStub (void *pParam);
 
+	void HandleEvents (unsigned nBank, u32 nEventStatus, u64 ullTimestamp);
+
 private:
 	CInterruptSystem *m_pInterrupt;
 	boolean m_bIRQConnected;
@@ -68,6 +68,13 @@ enum TGPIOInterrupt
 
 typedef void TGPIOInterruptHandler (void *pParam);
 
+struct TGPIOEvent		/// Edge recorded by the event capture of CGPIOPin
+{
+	u64	 ullTimestamp;		///< see CGPIOManager::GetTimestamp()
+	unsigned nPin;			///< Physical (Broadcom) pin number
+	unsigned nLevel;		///< Level after the edge (LOW or HIGH)
+};
+
 class CGPIOManager;
 
 class CGPIOPin		/// Encapsulates a GPIO pin
@@ -110,8 +117,26 @@ public:
 	/// \note If bAutoAck = FALSE, must call AcknowledgeInterrupt() from interrupt handler!
 	void ConnectInterrupt (TGPIOInterruptHandler *pHandler, void *pParam,
 			       boolean bAutoAck = TRUE);
+	/// \brief Disconnect the interrupt handler or the event capture
 	void DisconnectInterrupt (void);
 
+	/// \brief Record GPIO events with timestamp into a ring buffer instead of calling a handler
+	/// \param nRingSize Number of events, which can be buffered (power of 2)
+	/// \note Select the edges with EnableInterrupt() and EnableInterrupt2() afterwards.
+	/// \note With both edges enabled the level is read from the pin, when the interrupt is\n
+	///	  handled, which may be wrong for very short pulses.
+	void ConnectEventCapture (unsigned nRingSize = 256);
+
+	/// \param pBuffer Captured events will be stored here (oldest first)
+	/// \param nMaxEvents Maximum number of events to be returned
+	/// \return Number of events returned (0 if none available)
+	/// \note Can be called from TASK_LEVEL on core 0, while events are captured.
+	unsigned ReadEvents (TGPIOEvent *pBuffer, unsigned nMaxEvents);
+	/// \return Number of events, which are waiting to be read
+	unsigned GetEventsAvail (void) const;
+	/// \return Number of events lost, because the ring buffer was full
+	unsigned GetEventOverrunCount (void) const	{ return m_nEventOverruns; }
+
 	/// \brief Enable interrupt on GPIO event
 	void EnableInterrupt (TGPIOInterrupt Interrupt);
 	void DisableInterrupt (void);
@@ -135,6 +160,10 @@ private:
 
 	void InterruptHandler (void);
 	static void DisableAllInterrupts (unsigned nPin);
+
+	void CaptureEvent (u64 ullTimestamp, u32 nLevels);
+	const TGPIOEvent *PeekEvent (void) const;
+	void SkipEvent (void);
 	friend class CGPIOManager;
 
 protected:
@@ -151,6 +180,12 @@ protected:
 	TGPIOInterrupt		 m_Interrupt;
 	TGPIOInterrupt		 m_Interrupt2;
 
+	TGPIOEvent		*m_pEventRing;
+	unsigned		 m_nEventRingSize;
+	volatile unsigned	 m_nEventInPtr;
+	volatile unsigned	 m_nEventOutPtr;
+	volatile unsigned	 m_nEventOverruns;
+
 	static CSpinLock s_SpinLock;
 };
 
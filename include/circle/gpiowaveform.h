@@ -0,0 +1,146 @@
+//
+// gpiowaveform.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2020  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_gpiowaveform_h
+#define _circle_gpiowaveform_h
+
+#include <circle/interrupt.h>
+#include <circle/gpioclock.h>
+#include <circle/dmachannel.h>
+#include <circle/types.h>
+
+enum TGPIOWaveformPacer
+{
+	GPIOWaveformPacerPWM,		///< PWM FIFO (PWM audio or CPWMOutput cannot be used)
+	GPIOWaveformPacerPCM,		///< PCM FIFO (I2S cannot be used, tick <= 102 us)
+	GPIOWaveformPacerUnknown
+};
+
+struct TGPIOWaveStep		/// One step of a waveform
+{
+	u32	 nSetMask;		///< GPIO0-31 to be set to HIGH (bit mask)
+	u32	 nClearMask;		///< GPIO0-31 to be set to LOW (bit mask)
+	unsigned nDelay;		///< Ticks to wait until the next step (>= 1)
+};
+
+typedef void TGPIOWaveformCompletionRoutine (boolean bStatus, void *pParam);
+
+/// \note The GPIO pins have to be set to GPIOModeOutput (e.g. using CGPIOPin) before.
+/// \note Steps are timed by a peripheral FIFO, which requests the next word in fixed\n
+///	  intervals (the tick) via its DMA request line. The DMA controller writes the\n
+///	  GPIO registers between these waits, the CPU is not involved.
+/// \note The waveform and capture buffers must be located in the first GB of memory\n
+///	  on Raspberry Pi 4 (e.g. allocated with HEAP_DMA30).
+
+class CGPIOWaveform	/// DMA-paced GPIO waveform generator and logic-analyzer capture
+{
+public:
+	/// \param pInterruptSystem Pointer to the interrupt system object
+	/// \param nTickUs Length of one tick in microseconds
+	/// \param Pacer Peripheral, which times the DMA transfers
+	CGPIOWaveform (CInterruptSystem *pInterruptSystem, unsigned nTickUs = 1,
+		       TGPIOWaveformPacer Pacer = GPIOWaveformPacerPWM);
+
+	~CGPIOWaveform (void);
+
+	/// \brief Start the pacer clock and device
+	/// \return Operation successful?
+	boolean Initialize (void);
+
+	/// \brief Translate a waveform into a DMA control block chain
+	/// \param pSteps Array of steps
+	/// \param nSteps Number of steps
+	/// \return Operation successful?
+	/// \note Must not be called while active.
+	boolean SetWaveform (const TGPIOWaveStep *pSteps, unsigned nSteps);
+
+	/// \brief Start playing the waveform set with SetWaveform()
+	/// \param bRepeat Repeat the waveform until Stop() is called?
+	void Start (boolean bRepeat = FALSE);
+
+	/// \brief Stop playing the waveform or the capture
+	/// \param bImmediately Stop at once (otherwise after the current cycle)
+	/// \note The completion routine is not called with bImmediately = TRUE.
+	/// \note A capture is always stopped at once.
+	void Stop (boolean bImmediately = FALSE);
+
+	/// \brief Sample the levels of GPIO0-31 into memory in fixed intervals
+	/// \param pBuffer Buffer for the samples (bit n is the level of GPIOn)
+	/// \param nSamples Number of samples to be taken
+	/// \param nIntervalTicks Ticks between two samples (1..16383)
+	/// \return Operation successful?
+	/// \note Must not be called while active. Two control blocks (64 bytes) per sample are\n
+	///	  allocated, the buffer is valid, when the completion routine is called or\n
+	///	  IsActive() returns FALSE. The waveform has to be set again afterwards.
+	boolean StartCapture (u32 *pBuffer, unsigned nSamples, unsigned nIntervalTicks = 1);
+
+	/// \return Waveform is playing or capture is running?
+	boolean IsActive (void) const		{ return m_bActive; }
+
+	/// \param pRoutine Routine, which is called from interrupt context on completion
+	/// \param pParam Parameter handed over to the completion routine
+	void SetCompletionRoutine (TGPIOWaveformCompletionRoutine *pRoutine, void *pParam = 0);
+
+private:
+	boolean AllocateChain (unsigned nControlBlocks, unsigned nDataWords);
+	TDMAControlBlock *AddControlBlock (u32 nTransferInformation, u32 nSourceAddress,
+					   u32 nDestinationAddress, u32 nTransferLength);
+	void AddPacing (unsigned nTicks);
+
+	void StartDMA (void);
+	void ResetDMA (void);
+
+	void RunPacer (void);
+	void StopPacer (void);
+
+	void InterruptHandler (void);
+	static void InterruptStub (void *pParam);
+
+private:
+	CInterruptSystem *m_pInterruptSystem;
+	unsigned m_nTickUs;
+	TGPIOWaveformPacer m_Pacer;
+
+	CGPIOClock m_Clock;
+	boolean m_bPacerRunning;
+
+	unsigned m_nDMAChannel;
+	boolean m_bIRQConnected;
+
+	u8 *m_pChainBuffer;
+	TDMAControlBlock *m_pChain;
+	unsigned m_nChainSize;			// allocated control blocks
+	unsigned m_nChainLength;		// used control blocks
+	u32 *m_pData;				// data words (set/clear masks, dummy word)
+	unsigned m_nDataSize;
+	unsigned m_nDataLength;
+
+	TDMAControlBlock *m_pLastStep;		// last control block of the waveform
+	TDMAControlBlock *m_pTerminator;	// raises the interrupt at the end
+
+	u32 *m_pCaptureBuffer;
+	unsigned m_nCaptureLength;		// in bytes
+
+	volatile boolean m_bActive;
+
+	TGPIOWaveformCompletionRoutine *m_pCompletionRoutine;
+	void *m_pCompletionParam;
+};
+
+#endif
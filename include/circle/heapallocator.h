@@ -23,29 +23,43 @@
 #include <circle/spinlock.h>
 #include <circle/synchronize.h>
 #include <circle/sysconfig.h>
+#include <circle/allocationsites.h>
+#include <circle/device.h>
 #include <circle/macros.h>
 #include <circle/types.h>
 #include <assert.h>
 
 //#define HEAP_DEBUG
 
+#if AARCH == 32
 ASSERT_STATIC (DATA_CACHE_LINE_LENGTH_MAX >= 16);
+#else
+ASSERT_STATIC (DATA_CACHE_LINE_LENGTH_MAX >= 32);
+#endif
 
 #define HEAP_BLOCK_ALIGN	DATA_CACHE_LINE_LENGTH_MAX
 #define HEAP_ALIGN_MASK		(HEAP_BLOCK_ALIGN-1)
 
 #define HEAP_BLOCK_MAX_BUCKETS	20
 
+#ifdef HEAP_TRACKING
+	#define HEAP_CALLER	((uintptr) __builtin_return_address (0))
+#else
+	#define HEAP_CALLER	0
+#endif
+
 struct THeapBlockHeader
 {
 	u32			 nMagic;
 #define HEAP_BLOCK_MAGIC	0x424C4D43
 	u32			 nSize;
 	THeapBlockHeader	*pNext;
+	uintptr			 nCaller;		// with HEAP_TRACKING only
 #if AARCH == 32
-	u32			 nPadding;
-#endif
 	u8			 Align[HEAP_BLOCK_ALIGN-16];
+#else
+	u8			 Align[HEAP_BLOCK_ALIGN-24];
+#endif
 	u8			 Data[0];
 }
 PACKED;
@@ -53,10 +67,11 @@ PACKED;
 struct THeapBlockBucket
 {
 	u32			 nSize;
-#ifdef HEAP_DEBUG
+#if defined (HEAP_DEBUG) || defined (HEAP_TRACKING)
 	unsigned		 nCount;
 	unsigned		 nMaxCount;
 #endif
+	unsigned		 nFreeCount;
 	THeapBlockHeader	*pFreeList;
 };
 
@@ -78,16 +93,21 @@ public:
 	/// \note Unused blocks on a free list do not count here.
 	size_t GetFreeSpace (void) const;
 
+	/// \return Space of the unused blocks on the free lists
+	size_t GetFreeListSpace (void) const;
+
 	/// \param nSize Block size to be allocated
+	/// \param nCaller Call site to be accounted with HEAP_TRACKING (0 for direct caller)
 	/// \return Pointer to new allocated block (0 if heap is full or not set-up)
 	/// \note Resulting block is always 16 bytes aligned
 	/// \note If nReserve in Setup() is non-zero, the system panics if heap is full.
-	void *Allocate (size_t nSize);
+	void *Allocate (size_t nSize, uintptr nCaller = 0);
 
 	/// \param pBlock Memory block to be reallocated
 	/// \param nSize  New block size
+	/// \param nCaller Call site to be accounted with HEAP_TRACKING (0 for direct caller)
 	/// \return Pointer to new block (block contents has been copied, if the block has moved)
-	void *ReAllocate (void *pBlock, size_t nSize);
+	void *ReAllocate (void *pBlock, size_t nSize, uintptr nCaller = 0);
 
 	/// \param pBlock Memory block to be freed
 	/// \note Memory space of blocks, which are bigger than the largest bucket size,\n
@@ -98,12 +118,22 @@ public:
 	void DumpStatus (void);
 #endif
 
+#ifdef HEAP_TRACKING
+	/// \brief Write a report of the bucket statistics and the live blocks by call site
+	/// \param pTarget Device to write the report to (0 for logger)
+	/// \param nMaxSites Maximum number of call sites to be reported
+	void DumpUsage (CDevice *pTarget = 0, unsigned nMaxSites = 20);
+#endif
+
 private:
 	const char	*m_pHeapName;
 	u8		*m_pNext;
 	u8		*m_pLimit;
 	size_t	 	 m_nReserve;
-	THeapBlockBucket m_Bucket[HEAP_BLOCK_MAX_BUCKETS+1];
+	THeapBlockBucket m_Bucket[HEAP_BLOCK_MAX_BUCKETS+1];	// last counts large blocks
+#ifdef HEAP_TRACKING
+	CAllocationSites m_Sites;
+#endif
 	CSpinLock	 m_SpinLock;
 
 	static u32 s_nBucketSize[];
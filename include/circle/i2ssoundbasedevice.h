@@ -2,7 +2,7 @@
 // i2ssoundbasedevice.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2014-2019  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2014-2020  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -38,6 +38,14 @@ enum TI2SSoundState
 	I2SSoundUnknown
 };
 
+enum TI2SDeviceMode
+{
+	I2SDeviceModeTXOnly,		///< output only (GPIO21 is DOUT)
+	I2SDeviceModeRXOnly,		///< input only (GPIO20 is DIN)
+	I2SDeviceModeTXRX,		///< full duplex, both directions start in the same frame
+	I2SDeviceModeUnknown
+};
+
 class CI2SSoundBaseDevice : public CSoundBaseDevice	/// Low level access to the I2S sound device
 {
 public:
@@ -45,9 +53,19 @@ public:
 	/// \param nSampleRate	sample rate in Hz
 	/// \param nChunkSize	twice the number of samples (words) to be handled\n
 	///			with one call to GetChunk() (one word per stereo channel)
+	/// \param nPeriods	number of DMA buffers (periods of nChunkSize words) in the ring\n
+	///			(2..SOUND_MAX_PERIODS)
+	/// \note The output latency is about (nPeriods-1) * nChunkSize/2 frames. Small chunks\n
+	///	  with more than two periods give a low latency, which is still robust\n
+	///	  against a delayed handling of the DMA interrupt.
+	/// \param DeviceMode	output, input or both (input uses the same chunk size\n
+	///			and number of periods)
+	/// \note In mode I2SDeviceModeTXRX the input stops together with the output.
 	CI2SSoundBaseDevice (CInterruptSystem *pInterrupt,
 			     unsigned	       nSampleRate = 192000,
-			     unsigned	       nChunkSize  = 8192);
+			     unsigned	       nChunkSize  = 8192,
+			     unsigned	       nPeriods    = 2,
+			     TI2SDeviceMode    DeviceMode  = I2SDeviceModeTXOnly);
 
 	virtual ~CI2SSoundBaseDevice (void);
 
@@ -66,6 +84,16 @@ public:
 	/// \return Is I2S and DMA operation running?
 	boolean IsActive (void) const;
 
+	/// \return Number of DMA underruns (the DMA controller had to replay a period,\n
+	///	    which was not refilled yet, because the interrupt was handled too late)
+	/// \note Can be called on any core.
+	unsigned GetXRunCount (void) const	{ return m_nXRuns; }
+
+	/// \return Number of DMA overruns on input (the DMA controller had to overwrite\n
+	///	    a period, which was not handed over yet)
+	/// \note Can be called on any core.
+	unsigned GetRXXRunCount (void) const	{ return m_nRXXRuns; }
+
 protected:
 	/// \brief May overload this to provide the sound samples!
 	/// \param pBuffer	buffer where the samples have to be placed
@@ -76,6 +104,13 @@ protected:
 	///	  Each word must be between GetRangeMin() and GetRangeMax()
 	/// virtual unsigned GetChunk (u32 *pBuffer, unsigned nChunkSize);
 
+	/// \brief May overload this to consume the captured sound samples!
+	/// \param pBuffer	buffer with the captured samples
+	/// \param nChunkSize	size of the buffer in words (same as given to constructor)
+	/// \note Each sample consists of two words (Left channel, right channel)\n
+	///	  Each word is between GetRangeMin() and GetRangeMax()
+	/// virtual void PutChunk (const u32 *pBuffer, unsigned nChunkSize);
+
 private:
 	boolean GetNextChunk (boolean bFirstCall = FALSE);
 
@@ -85,8 +120,19 @@ private:
 	void InterruptHandler (void);
 	static void InterruptStub (void *pParam);
 
+	boolean RefillPeriods (u32 nControlBlockAddress);
+	unsigned GetPeriodIndex (u32 nControlBlockAddress, boolean bRX = FALSE) const;
+	void StopAfterPeriod (unsigned nPeriod);
+
 	void SetupDMAControlBlock (unsigned nID);
 
+	void RXInterruptHandler (void);
+	static void RXInterruptStub (void *pParam);
+
+	void StopRX (void);
+
+	void SetupRXDMAControlBlock (unsigned nID);
+
 private:
 	CInterruptSystem *m_pInterruptSystem;
 	unsigned m_nChunkSize;
@@ -94,17 +140,35 @@ private:
 	CGPIOPin   m_PCMCLKPin;
 	CGPIOPin   m_PCMFSPin;
 	CGPIOPin   m_PCMDOUTPin;
+	CGPIOPin   m_PCMDINPin;
 	CGPIOClock m_Clock;
 
+	boolean m_bOutput;
+	boolean m_bInput;
+
 	boolean m_bIRQConnected;
+	boolean m_bRXIRQConnected;
 	volatile TI2SSoundState m_State;
 
 	unsigned m_nDMAChannel;
-	u32 *m_pDMABuffer[2];
-	u8 *m_pControlBlockBuffer[2];
-	TDMAControlBlock *m_pControlBlock[2];
+	unsigned m_nPeriods;
+	u32 *m_pDMABuffer[SOUND_MAX_PERIODS];
+	u8 *m_pControlBlockBuffer[SOUND_MAX_PERIODS];
+	TDMAControlBlock *m_pControlBlock[SOUND_MAX_PERIODS];
+
+	unsigned m_nNextBuffer;			// next period to be refilled
+	unsigned m_nLastPeriod;			// last period to be played, when terminating
+
+	volatile unsigned m_nXRuns;
+
+	unsigned m_nRXDMAChannel;
+	u32 *m_pRXBuffer[SOUND_MAX_PERIODS];
+	u8 *m_pRXControlBlockBuffer[SOUND_MAX_PERIODS];
+	TDMAControlBlock *m_pRXControlBlock[SOUND_MAX_PERIODS];
+
+	unsigned m_nRXNextBuffer;		// next period to be handed over
 
-	unsigned m_nNextBuffer;			// 0 or 1
+	volatile unsigned m_nRXXRuns;
 
 	CSpinLock m_SpinLock;
 };
@@ -2,7 +2,7 @@
 // interrupt.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2014-2019  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2014-2020  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -22,10 +22,18 @@
 
 #include <circle/bcm2835int.h>
 #include <circle/exceptionstub.h>
+#include <circle/irqstatistics.h>
+#include <circle/sysconfig.h>
 #include <circle/types.h>
 
 typedef void TIRQHandler (void *pParam);
 
+#ifdef ARM_ALLOW_MULTI_CORE
+	#define IRQ_CORES	CORES
+#else
+	#define IRQ_CORES	1
+#endif
+
 class CInterruptSystem
 {
 public:
@@ -46,6 +54,15 @@ public:
 	static void EnableFIQ (unsigned nFIQ);
 	static void DisableFIQ (void);
 
+	// returns the number of the IRQ, which has been handled last on this core
+	// (IRQ_LINES if none), can be used to find the cause of IRQ latencies
+	unsigned GetLastIRQ (void) const;
+
+#ifdef IRQ_STATISTICS
+	// returns the per-IRQ counters and handler times and the IRQ load of the cores
+	CIRQStatistics *GetStatistics (void);
+#endif
+
 	static CInterruptSystem *Get (void);
 
 	static void InterruptHandler (void);
@@ -66,6 +83,12 @@ private:
 	TIRQHandler	*m_apIRQHandler[IRQ_LINES];
 	void		*m_pParam[IRQ_LINES];
 
+	volatile unsigned m_nLastIRQ[IRQ_CORES];
+
+#ifdef IRQ_STATISTICS
+	CIRQStatistics	m_Statistics;
+#endif
+
 	static CInterruptSystem *s_pThis;
 };
 
@@ -0,0 +1,103 @@
+//
+// irqstatistics.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2020  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_irqstatistics_h
+#define _circle_irqstatistics_h
+
+#include <circle/bcm2835int.h>
+#include <circle/device.h>
+#include <circle/sysconfig.h>
+#include <circle/types.h>
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	#define IRQ_STATISTICS_CORES	CORES
+#else
+	#define IRQ_STATISTICS_CORES	1
+#endif
+
+struct TIRQStatistics
+{
+	unsigned nCount;			// number of handler calls
+	u64	 ullTotalTicks;			// cumulative handler time
+	u64	 ullMaxTicks;			// longest handler call
+};
+
+struct TIRQCoreStatistics
+{
+	u64	 ullIRQTicks;			// time spent in IRQ handlers
+	u64	 ullElapsedTicks;		// time since last reset
+	unsigned nNesting;			// current IRQ nesting depth
+	unsigned nMaxNesting;			// maximum IRQ nesting depth
+};
+
+/// \note Used by CInterruptSystem with IRQ_STATISTICS enabled. The dispatcher calls\n
+///	  EnterHandler() and LeaveHandler() with IRQs disabled on the respective core.
+/// \note Time is measured in ticks of CTimer::GetTicks64() (see GetTicks64Frequency()).\n
+///	  The time of nested handlers is included in the time of the interrupted\n
+///	  handler, but is counted only once for the core.
+
+class CIRQStatistics		/// Counts IRQs and accounts the handler time per IRQ line and core
+{
+public:
+	CIRQStatistics (void);
+	~CIRQStatistics (void);
+
+	/// \brief Clear all counters and start a new measurement period
+	/// \note Values of IRQs, which are handled on other cores meanwhile, may be inaccurate.
+	void Reset (void);
+
+	/// \brief Called by the IRQ dispatcher before the handler is called
+	/// \param nCore Number of the calling core
+	/// \return Start time to be given to LeaveHandler()
+	u64 EnterHandler (unsigned nCore);
+	/// \brief Called by the IRQ dispatcher after the handler has returned
+	/// \param nCore Number of the calling core
+	/// \param nIRQ Number of the handled IRQ
+	/// \param ullStartTicks Start time as returned by EnterHandler()
+	void LeaveHandler (unsigned nCore, unsigned nIRQ, u64 ullStartTicks);
+
+	/// \param nIRQ Number of the IRQ line
+	/// \param pResult Statistics of this IRQ (summed up for all cores) will be stored here
+	/// \return Has the IRQ been handled since the last reset?
+	boolean GetIRQStatistics (unsigned nIRQ, TIRQStatistics *pResult) const;
+
+	/// \param nCore Core number
+	/// \param pResult Statistics of this core will be stored here
+	void GetCoreStatistics (unsigned nCore, TIRQCoreStatistics *pResult) const;
+
+	/// \brief Write a report of the IRQs with the most handler time and of the IRQ load
+	/// \param pTarget Device to write the report to (0 for logger)
+	/// \param nMaxIRQs Maximum number of IRQ lines to be reported
+	void Dump (CDevice *pTarget = 0, unsigned nMaxIRQs = 16) const;
+
+private:
+	TIRQStatistics m_IRQ[IRQ_STATISTICS_CORES][IRQ_LINES];
+
+	struct TCoreData
+	{
+		u64	 ullIRQTicks;
+		unsigned nNesting;
+		unsigned nMaxNesting;
+	}
+	m_Core[IRQ_STATISTICS_CORES];
+
+	volatile u64 m_ullResetTicks;
+};
+
+#endif
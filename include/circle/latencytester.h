@@ -24,6 +24,24 @@
 #include <circle/spinlock.h>
 #include <circle/types.h>
 
+// The histogram is log-linear: Each power of two range of latencies is
+// divided into 16 linear sub-buckets, which gives a resolution of 1 us
+// below 32 us and a relative error of less than 6.25% above.
+#define LATENCY_SUB_BUCKET_BITS		4
+#define LATENCY_SUB_BUCKETS		(1 << LATENCY_SUB_BUCKET_BITS)
+#define LATENCY_MAX_EXPONENT		19		// latencies >= 2^20 us are clipped
+#define LATENCY_HISTOGRAM_BUCKETS	((LATENCY_MAX_EXPONENT - LATENCY_SUB_BUCKET_BITS + 2) \
+					 * LATENCY_SUB_BUCKETS)
+
+#define LATENCY_WORST_CASES		8
+
+struct TLatencyWorstCase
+{
+	unsigned nDelay;		// in microseconds
+	uintptr  nPC;			// address, at which the IRQ has been taken
+	unsigned nLastIRQ;		// IRQ handled before (IRQ_LINES if none)
+};
+
 /// \note CLatencyTester blocks the system timer 1, which is used by the class CUserTimer too.
 
 class CLatencyTester		/// Measures the IRQ latency of the running code
@@ -38,6 +56,9 @@ public:
 	/// \brief Stop measurement
 	void Stop (void);
 
+	/// \brief Clear the results (e.g. before the next benchmark run)
+	void Reset (void);
+
 	/// \return Minimum IRQ latency in microseconds
 	unsigned GetMin (void) const;
 	/// \return Maximum IRQ latency in microseconds
@@ -45,13 +66,31 @@ public:
 	/// \return Average IRQ latency in microseconds
 	unsigned GetAvg (void);
 
+	/// \return Number of measured samples
+	unsigned GetSamples (void) const;
+
+	/// \param nPerMille Percentile in 0.1% (e.g. 500 for the median, 999 for p99.9)
+	/// \return Upper bound of the latency in microseconds, below which the given\n
+	///	    part of the samples is
+	unsigned GetPercentile (unsigned nPerMille);
+
+	/// \param nIndex Index of the worst case (0 is the worst)
+	/// \param pWorstCase Information about the worst case will be returned here
+	/// \return FALSE if there is no such worst case
+	boolean GetWorstCase (unsigned nIndex, TLatencyWorstCase *pWorstCase);
+
 	/// \brief Dump results to logger
-	void Dump (void);
+	/// \param bHistogram Dump the latency histogram and the worst cases too?
+	void Dump (boolean bHistogram = FALSE);
 
 private:
 	void InterruptHandler (void);
 	static void InterruptStub (void *pParam);
 
+	static unsigned GetBucket (unsigned nDelay);
+	static unsigned GetBucketLowerBound (unsigned nBucket);
+	static unsigned GetBucketUpperBound (unsigned nBucket);
+
 private:
 	CInterruptSystem *m_pInterruptSystem;
 
@@ -61,9 +100,13 @@ private:
 	unsigned m_nMinDelay;
 	unsigned m_nMaxDelay;
 
-	unsigned m_nDelayAccu;
+	u64	 m_ullDelayAccu;
 	unsigned m_nSamples;
-	boolean  m_bOverflow;
+
+	unsigned m_Histogram[LATENCY_HISTOGRAM_BUCKETS];
+
+	TLatencyWorstCase m_WorstCase[LATENCY_WORST_CASES];	// sorted, worst first
+	unsigned m_nWorstCases;
 
 	CSpinLock m_SpinLock;
 };
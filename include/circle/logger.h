@@ -31,6 +31,9 @@
 #define LOG_MAX_MESSAGE		200
 #define LOG_QUEUE_SIZE		50
 
+#define LOG_BINARY_ENTRIES	256		// per core, must be a power of 2
+#define LOG_BINARY_MAX_ARGS	6
+
 enum TLogSeverity
 {
 	LogPanic,	// Halt the system after processing this message
@@ -41,6 +44,7 @@ enum TLogSeverity
 };
 
 struct TLogEvent;
+struct TLogBinaryRing;
 
 typedef void TLogEventNotificationHandler (void);
 typedef void TLogPanicHandler (void);
@@ -61,6 +65,23 @@ public:
 	// does not allocate memory, for critical (low memory) messages
 	void WriteNoAlloc (const char *pSource, TLogSeverity Severity, const char *pMessage);
 
+	// writes one line of a report to pTarget ("source: message\n"),
+	// or to the log with LogNotice, if pTarget is 0
+	static void WriteTo (CDevice *pTarget, const char *pSource, const char *pMessage, ...);
+
+	// Binary log mode: WriteBinary() does not format the message, but stores the
+	// pointers to source and message, a time stamp and the raw arguments into a
+	// lock-free per-core ring. DrainBinary() formats and writes them later (e.g.
+	// from a low priority task). pSource, pMessage and strings for %s must remain
+	// valid until then (e.g. string literals). Must not be called from FIQ.
+	// WriteBinary() falls back to WriteV() until EnableBinaryMode() is called.
+	boolean EnableBinaryMode (void);
+	void WriteBinary (const char *pSource, TLogSeverity Severity, const char *pMessage, ...);
+	// returns the number of entries written, nMaxEntries = 0 writes all
+	unsigned DrainBinary (unsigned nMaxEntries = 0);
+	// returns the number of entries, which were dropped because a ring was full
+	unsigned GetBinaryDropped (void) const;
+
 	int Read (void *pBuffer, unsigned nCount);
 
 	// returns FALSE if event is not available
@@ -95,6 +116,9 @@ private:
 	unsigned m_nEventOutPtr;
 	CSpinLock m_EventSpinLock;
 
+	TLogBinaryRing *m_pBinaryRing;
+	CSpinLock m_BinarySpinLock;
+
 	TLogEventNotificationHandler *m_pEventNotificationHandler;
 	TLogPanicHandler *m_pPanicHandler;
 
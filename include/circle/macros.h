@@ -24,9 +24,10 @@
 #define	ALIGN(n)	__attribute__ ((aligned (n)))
 #define NORETURN	__attribute__ ((noreturn))
 #define NOOPT		__attribute__ ((optimize (0)))
-#define STDOPT		__attribute__ ((optimize (2)))
+#define STDOPT		__attribute__ ((optimize (2, "no-tree-loop-distribute-patterns")))
 #define MAXOPT		__attribute__ ((optimize (3)))
 #define WEAK		__attribute__ ((weak))
+#define MAYALIAS	__attribute__ ((may_alias))
 
 #define likely(exp)	__builtin_expect (!!(exp), 1)
 #define unlikely(exp)	__builtin_expect (!!(exp), 0)
@@ -61,7 +61,7 @@ public:
 	static CMemorySystem *Get (void);
 
 public:
-	static void *HeapAllocate (size_t nSize, int nType)
+	static void *HeapAllocate (size_t nSize, int nType, uintptr nCaller = 0)	// nCaller for HEAP_TRACKING
 #define HEAP_LOW	0		// memory below 1 GB
 #define HEAP_HIGH	1		// memory above 1 GB
 #define HEAP_ANY	2		// high memory (if available) or low memory (otherwise)
@@ -72,36 +72,36 @@ public:
 
 		switch (nType)
 		{
-		case HEAP_LOW:	return s_pThis->m_HeapLow.Allocate (nSize);
-		case HEAP_HIGH: return s_pThis->m_HeapHigh.Allocate (nSize);
-		case HEAP_ANY:	return   (pBlock = s_pThis->m_HeapHigh.Allocate (nSize)) != 0
+		case HEAP_LOW:	return s_pThis->m_HeapLow.Allocate (nSize, nCaller);
+		case HEAP_HIGH: return s_pThis->m_HeapHigh.Allocate (nSize, nCaller);
+		case HEAP_ANY:	return   (pBlock = s_pThis->m_HeapHigh.Allocate (nSize, nCaller)) != 0
 				       ? pBlock
-				       : s_pThis->m_HeapLow.Allocate (nSize);
+				       : s_pThis->m_HeapLow.Allocate (nSize, nCaller);
 		default:	return 0;
 		}
 #else
 		switch (nType)
 		{
 		case HEAP_LOW:
-		case HEAP_ANY:	return s_pThis->m_HeapLow.Allocate (nSize);
+		case HEAP_ANY:	return s_pThis->m_HeapLow.Allocate (nSize, nCaller);
 		default:	return 0;
 		}
 #endif
 	}
 
-	static void *HeapReAllocate (void *pBlock, size_t nSize)	// pBlock may be 0
+	static void *HeapReAllocate (void *pBlock, size_t nSize, uintptr nCaller = 0)	// pBlock may be 0
 	{
 #if RASPPI >= 4
 		if ((uintptr) pBlock < MEM_HIGHMEM_START)
 		{
-			return s_pThis->m_HeapLow.ReAllocate (pBlock, nSize);
+			return s_pThis->m_HeapLow.ReAllocate (pBlock, nSize, nCaller);
 		}
 		else
 		{
-			return s_pThis->m_HeapHigh.ReAllocate (pBlock, nSize);
+			return s_pThis->m_HeapHigh.ReAllocate (pBlock, nSize, nCaller);
 		}
 #else
-		return s_pThis->m_HeapLow.ReAllocate (pBlock, nSize);
+		return s_pThis->m_HeapLow.ReAllocate (pBlock, nSize, nCaller);
 #endif
 	}
 
@@ -142,7 +142,7 @@ public:
 #endif
 	}
 
-	static void *PageAllocate (void)	{ return s_pThis->m_Pager.Allocate (); }
+	static void *PageAllocate (uintptr nCaller = 0)	{ return s_pThis->m_Pager.Allocate (nCaller); }
 	static void PageFree (void *pPage)	{ s_pThis->m_Pager.Free (pPage); }
 
 	static void DumpStatus (void)
@@ -159,6 +159,20 @@ public:
 #endif
 	}
 
+#ifdef HEAP_TRACKING
+	/// \brief Write a report of the heap and page usage by call site
+	/// \param pTarget Device to write the report to (0 for logger)
+	/// \param nMaxSites Maximum number of call sites to be reported per heap
+	static void DumpUsage (CDevice *pTarget = 0, unsigned nMaxSites = 20)
+	{
+		s_pThis->m_HeapLow.DumpUsage (pTarget, nMaxSites);
+#if RASPPI >= 4
+		s_pThis->m_HeapHigh.DumpUsage (pTarget, nMaxSites);
+#endif
+		s_pThis->m_Pager.DumpUsage (pTarget, nMaxSites);
+	}
+#endif
+
 private:
 	void EnableMMU (void);
 
@@ -22,6 +22,8 @@
 
 #include <circle/sysconfig.h>
 #include <circle/spinlock.h>
+#include <circle/allocationsites.h>
+#include <circle/device.h>
 #include <circle/macros.h>
 #include <circle/types.h>
 
@@ -48,9 +50,13 @@ public:
 	/// \note Unused pages on the free list do not count here.
 	size_t GetFreeSpace (void) const;
 
+	/// \return Space of the unused pages on the free list
+	size_t GetFreeListSpace (void) const;
+
+	/// \param nCaller Call site to be accounted with HEAP_TRACKING (0 for direct caller)
 	/// \return Pointer to a page with a size of PAGE_SIZE
 	/// \note Resulting page is always aligned to PAGE_SIZE
-	void *Allocate (void);
+	void *Allocate (uintptr nCaller = 0);
 
 	/// \param pPage Memory page to be freed
 	void Free (void *pPage);
@@ -59,13 +65,25 @@ public:
 	void DumpStatus (void);
 #endif
 
+#ifdef HEAP_TRACKING
+	/// \brief Write a report of the page statistics and the live pages by call site
+	/// \param pTarget Device to write the report to (0 for logger)
+	/// \param nMaxSites Maximum number of call sites to be reported
+	void DumpUsage (CDevice *pTarget = 0, unsigned nMaxSites = 20);
+#endif
+
 private:
 	u8		*m_pNext;
 	u8		*m_pLimit;
-#ifdef PAGE_DEBUG
+#if defined (PAGE_DEBUG) || defined (HEAP_TRACKING)
 	unsigned	 m_nCount;
 	unsigned	 m_nMaxCount;
 #endif
+#ifdef HEAP_TRACKING
+	u8		*m_pBase;
+	uintptr		*m_pCaller;		// side table, one entry per page (0 if free)
+#endif
+	unsigned	 m_nFreeCount;
 	TFreePage	*m_pFreeList;
 	CSpinLock	 m_SpinLock;
 };
@@ -0,0 +1,101 @@
+//
+// perfcounters.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2020  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_perfcounters_h
+#define _circle_perfcounters_h
+
+#include <circle/types.h>
+
+enum TPerformanceEvent		// architectural event numbers of ARMv7/ARMv8
+{
+	PerfEventL1ICacheRefill		= 0x01,
+	PerfEventL1ITLBRefill		= 0x02,
+	PerfEventL1DCacheRefill		= 0x03,
+	PerfEventL1DCacheAccess		= 0x04,
+	PerfEventL1DTLBRefill		= 0x05,
+	PerfEventInstructions		= 0x08,
+	PerfEventBranchMispredict	= 0x10,
+	PerfEventBranchPredictable	= 0x12,
+	PerfEventMemoryAccess		= 0x13,
+	PerfEventL2DCacheAccess		= 0x16,
+	PerfEventL2DCacheRefill		= 0x17,
+	PerfEventUnknown
+};
+
+#define PERF_MAX_EVENTS		6
+
+struct TPerformanceSnapshot
+{
+	u64	ullCycles;
+	u64	ullEvent[PERF_MAX_EVENTS];	// in the order given to Configure()
+};
+
+/// \note The PMU exists once per core. Configure(), Start(), Stop() and GetSnapshot()\n
+///	  operate on the PMU of the calling core and must be called on each core, which\n
+///	  should be measured.
+/// \note The event counters (and the cycle counter on Raspberry Pi 1-2 and Zero) are\n
+///	  32 bits wide, differences are correct as long as the measured interval is shorter\n
+///	  than one counter wrap.
+
+class CPerformanceCounters	/// Access to the Performance Monitoring Unit (PMU) of the ARM core
+{
+public:
+	CPerformanceCounters (void);
+	~CPerformanceCounters (void);
+
+	/// \brief Select the events to be counted
+	/// \param pEvents Array of events
+	/// \param nEvents Number of events (<= PERF_MAX_EVENTS)
+	/// \return Operation successful? (FALSE if not enough counters or event not supported)
+	boolean Configure (const TPerformanceEvent *pEvents, unsigned nEvents);
+
+	/// \brief Reset and start the cycle counter and the configured event counters
+	void Start (void);
+	/// \brief Stop all counters
+	void Stop (void);
+
+	/// \param pSnapshot Current counter values will be stored here
+	void GetSnapshot (TPerformanceSnapshot *pSnapshot) const;
+
+	/// \param pResult Difference of two snapshots will be stored here
+	/// \param pFrom Earlier snapshot
+	/// \param pTo Later snapshot
+	void GetDifference (TPerformanceSnapshot *pResult,
+			    const TPerformanceSnapshot *pFrom,
+			    const TPerformanceSnapshot *pTo) const;
+
+	/// \return Number of configured events
+	unsigned GetEventCount (void) const		{ return m_nEvents; }
+	/// \param nIndex Index of event (as given to Configure())
+	/// \return Configured event
+	TPerformanceEvent GetEvent (unsigned nIndex) const;
+
+	/// \param Event Event to get the name for
+	/// \return Short name of the event
+	static const char *GetEventName (TPerformanceEvent Event);
+
+	/// \return Number of event counters implemented by the PMU of this core
+	static unsigned GetHardwareCounters (void);
+
+private:
+	TPerformanceEvent m_Event[PERF_MAX_EVENTS];
+	unsigned m_nEvents;
+};
+
+#endif
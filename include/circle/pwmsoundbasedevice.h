@@ -2,7 +2,7 @@
 // pwmsoundbasedevice.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2014-2019  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2014-2020  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -45,9 +45,15 @@ public:
 	/// \param nSampleRate	sample rate in Hz
 	/// \param nChunkSize	twice the number of samples (words) to be handled\n
 	///			with one call to GetChunk() (one word per stereo channel)
+	/// \param nPeriods	number of DMA buffers (periods of nChunkSize words) in the ring\n
+	///			(2..SOUND_MAX_PERIODS)
+	/// \note The output latency is about (nPeriods-1) * nChunkSize/2 frames. Small chunks\n
+	///	  with more than two periods give a low latency, which is still robust\n
+	///	  against a delayed handling of the DMA interrupt.
 	CPWMSoundBaseDevice (CInterruptSystem *pInterrupt,
 			     unsigned	       nSampleRate = 44100,
-			     unsigned	       nChunkSize  = 2048);
+			     unsigned	       nChunkSize  = 2048,
+			     unsigned	       nPeriods    = 2);
 
 	virtual ~CPWMSoundBaseDevice (void);
 
@@ -68,6 +74,11 @@ public:
 	/// \return Is PWM and DMA operation running?
 	boolean IsActive (void) const;
 
+	/// \return Number of DMA underruns (the DMA controller had to replay a period,\n
+	///	    which was not refilled yet, because the interrupt was handled too late)
+	/// \note Can be called on any core.
+	unsigned GetXRunCount (void) const	{ return m_nXRuns; }
+
 protected:
 	/// \brief May overload this to provide the sound samples!
 	/// \param pBuffer	buffer where the samples have to be placed
@@ -87,6 +98,10 @@ private:
 	void InterruptHandler (void);
 	static void InterruptStub (void *pParam);
 
+	boolean RefillPeriods (u32 nControlBlockAddress);
+	unsigned GetPeriodIndex (u32 nControlBlockAddress) const;
+	void StopAfterPeriod (unsigned nPeriod);
+
 	void SetupDMAControlBlock (unsigned nID);
 
 private:
@@ -102,11 +117,15 @@ private:
 	volatile TPWMSoundState m_State;
 
 	unsigned m_nDMAChannel;
-	u32 *m_pDMABuffer[2];
-	u8 *m_pControlBlockBuffer[2];
-	TDMAControlBlock *m_pControlBlock[2];
+	unsigned m_nPeriods;
+	u32 *m_pDMABuffer[SOUND_MAX_PERIODS];
+	u8 *m_pControlBlockBuffer[SOUND_MAX_PERIODS];
+	TDMAControlBlock *m_pControlBlock[SOUND_MAX_PERIODS];
+
+	unsigned m_nNextBuffer;			// next period to be refilled
+	unsigned m_nLastPeriod;			// last period to be played, when terminating
 
-	unsigned m_nNextBuffer;			// 0 or 1
+	volatile unsigned m_nXRuns;
 
 	CSpinLock m_SpinLock;
 };
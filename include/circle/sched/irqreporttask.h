@@ -0,0 +1,55 @@
+//
+// irqreporttask.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2020  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_sched_irqreporttask_h
+#define _circle_sched_irqreporttask_h
+
+#include <circle/sched/task.h>
+#include <circle/irqstatistics.h>
+#include <circle/device.h>
+#include <circle/types.h>
+
+class CIRQReportTask : public CTask	/// Reports the IRQ statistics periodically
+{
+public:
+	/// \param pStatistics Pointer to the IRQ statistics (see CInterruptSystem::GetStatistics())
+	/// \param nIntervalSecs Report interval in seconds
+	/// \param bReset Reset the statistics after each report?
+	/// \param pTarget Device to write the report to (0 for logger)
+	/// \param nMaxIRQs Maximum number of IRQ lines to be reported
+	CIRQReportTask (CIRQStatistics *pStatistics, unsigned nIntervalSecs = 10,
+			boolean bReset = TRUE, CDevice *pTarget = 0, unsigned nMaxIRQs = 16);
+	~CIRQReportTask (void);
+
+	void Run (void);
+
+	/// \brief Stop reporting (the task terminates after the current interval)
+	void Stop (void);
+
+private:
+	CIRQStatistics *m_pStatistics;
+	unsigned m_nIntervalSecs;
+	boolean m_bReset;
+	CDevice *m_pTarget;
+	unsigned m_nMaxIRQs;
+
+	volatile boolean m_bStop;
+};
+
+#endif
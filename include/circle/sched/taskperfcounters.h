@@ -0,0 +1,73 @@
+//
+// taskperfcounters.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2020  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_sched_taskperfcounters_h
+#define _circle_sched_taskperfcounters_h
+
+#include <circle/sched/task.h>
+#include <circle/perfcounters.h>
+#include <circle/sysconfig.h>
+#include <circle/types.h>
+
+/// \note Registers the task switch and task termination handlers of the scheduler,\n
+///	  which therefore cannot be used otherwise (e.g. by the Linux driver emulation).
+
+class CTaskPerformanceCounters	/// Accumulates the PMU counters for each task of the scheduler
+{
+public:
+	/// \param pCounters Configured PMU counters (Start() is called here)
+	CTaskPerformanceCounters (CPerformanceCounters *pCounters);
+	~CTaskPerformanceCounters (void);
+
+	/// \param pTask Task to get the counters for
+	/// \param pResult Accumulated counter values will be stored here
+	/// \return FALSE if task is unknown (has not run yet or has been terminated)
+	boolean GetTaskCounters (CTask *pTask, TPerformanceSnapshot *pResult);
+
+	/// \brief Reset the accumulated values of all tasks
+	void Reset (void);
+
+	/// \brief Dump the counters of all tasks to the logger
+	void Dump (void);
+
+private:
+	void Account (void);
+
+	void TaskSwitchHandler (CTask *pTask);
+	static void TaskSwitchStub (CTask *pTask);
+	void TaskTerminationHandler (CTask *pTask);
+	static void TaskTerminationStub (CTask *pTask);
+
+private:
+	CPerformanceCounters *m_pCounters;
+
+	struct TTaskAccount
+	{
+		CTask			*pTask;		// 0 if entry is free
+		TPerformanceSnapshot	 Counters;
+	}
+	m_Account[MAX_TASKS];
+
+	CTask *m_pCurrentTask;
+	TPerformanceSnapshot m_LastSnapshot;
+
+	static CTaskPerformanceCounters *s_pThis;
+};
+
+#endif
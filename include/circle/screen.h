@@ -70,6 +70,9 @@
 	#error DEPTH must be 8, 16 or 32
 #endif
 
+#define SCREEN_GLYPH_WIDTH	8		// character width supported by the glyph blitter
+#define SCREEN_GLYPH_WORDS	(SCREEN_GLYPH_WIDTH * DEPTH / 32)	// per character line
+
 struct TScreenStatus
 {
 	TScreenColor   *pContent;
@@ -173,9 +176,15 @@ private:
 	void Tabulator (void);
 
 	void Scroll (void) MAXOPT;
+#ifdef SCREEN_PAN_FACTOR
+	boolean Pan (void) MAXOPT;
+	void ClearLines (unsigned nFromLine, unsigned nToLine) MAXOPT;	// in virtual buffer
+#endif
+	void CopyBlock (void *pTo, const void *pFrom, unsigned nSize) MAXOPT;
 
-	void DisplayChar (char chChar, unsigned nPosX, unsigned nPosY, TScreenColor Color);
-	void EraseChar (unsigned nPosX, unsigned nPosY);
+	void DisplayChar (char chChar, unsigned nPosX, unsigned nPosY, TScreenColor Color) MAXOPT;
+	void EraseChar (unsigned nPosX, unsigned nPosY) MAXOPT;
+	boolean CanBlitGlyph (unsigned nPosX, unsigned nPosY) const;
 	void InvertCursor (void);
 #endif
 
@@ -192,6 +201,13 @@ private:
 	TScreenColor  	*m_pBuffer;
 	unsigned	 m_nSize;
 	unsigned	 m_nPitch;
+	u32		 m_GlyphMask[256][SCREEN_GLYPH_WORDS];	// pixel masks of a character line
+#ifdef SCREEN_PAN_FACTOR
+	boolean		 m_bPanning;
+	TScreenColor	*m_pFrameBase;		// start of the virtual frame buffer
+	unsigned	 m_nVirtualHeight;
+	unsigned	 m_nPanOffset;		// first visible line in the virtual buffer
+#endif
 #endif
 	unsigned	 m_nWidth;
 	unsigned	 m_nHeight;
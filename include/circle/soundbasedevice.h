@@ -21,6 +21,7 @@
 #define _circle_soundbasedevice_h
 
 #include <circle/device.h>
+#include <circle/macros.h>
 #include <circle/spinlock.h>
 #include <circle/types.h>
 
@@ -28,6 +29,10 @@
 #define SOUND_MAX_SAMPLE_SIZE	(sizeof (u32))
 #define SOUND_MAX_FRAME_SIZE	(SOUND_HW_CHANNELS * SOUND_MAX_SAMPLE_SIZE)
 
+#define SOUND_CONVERT_FRAMES	64		// frames converted in one block
+
+#define SOUND_MAX_PERIODS	16		// maximum number of DMA periods of a device
+
 enum TSoundFormat			/// All supported formats are interleaved little endian
 {
 	SoundFormatUnsigned8,		/// Not supported as hardware format
@@ -38,11 +43,17 @@ enum TSoundFormat			/// All supported formats are interleaved little endian
 };
 
 typedef void TSoundNeedDataCallback (void *pParam);
+typedef void TSoundHaveDataCallback (void *pParam);
 
 /// \note There are two methods to provide the sound samples:\n
 ///	  1. By overloading GetChunk()\n
 ///	  2. By using Write()
 
+/// \note Devices with an input direction (e.g. CI2SSoundBaseDevice) deliver the\n
+///	  captured sound samples accordingly:\n
+///	  1. By overloading PutChunk()\n
+///	  2. By using Read()
+
 /// \note In a multi-core environment all methods, except if otherwise noted,
 ///	  have to be called or will be called (for callbacks) on core 0.
 
@@ -98,7 +109,10 @@ public:
 	/// \param nCount  Size of the buffer in bytes (multiple of frame size)
 	/// \return Number of bytes consumed
 	/// \note Not used, if GetChunk() is overloaded.
-	/// \note Can be called on any core.
+	/// \note Can be called on any core and from the need data callback. Concurrent\n
+	///	  producers are serialized, the consumer side of the queue is lock-free.
+	/// \note The conversion is vectorized. Calling this from the need data callback\n
+	///	  (interrupt context) requires SAVE_VFP_REGS_ON_IRQ on Raspberry Pi 2-4.
 	int Write (const void *pBuffer, size_t nCount);
 
 	/// \return Queue size in number of frames
@@ -111,6 +125,16 @@ public:
 	/// \note Can be called on any core.
 	unsigned GetQueueFramesAvail (void);
 
+	/// \return Number of frames, which can be written to the queue at the moment
+	/// \note Not used, if GetChunk() is overloaded.
+	/// \note Can be called on any core.
+	unsigned GetQueueFramesFree (void);
+
+	/// \return Number of queue underruns (the queue ran empty, while data was flowing)
+	/// \note Not used, if GetChunk() is overloaded.
+	/// \note Can be called on any core.
+	unsigned GetQueueUnderrunCount (void) const	{ return m_nQueueUnderruns; }
+
 	/// \param pCallback Callback which is called, when more sound data is needed
 	/// \param pParam User parameter to be handed over to the callback
 	/// \note Is called, when at least half of the queue is empty
@@ -120,6 +144,54 @@ public:
 	/// \return TRUE: Have to write right channel first into buffer in GetChunk()
 	boolean AreChannelsSwapped (void) const;
 
+	/// \brief Allocate the queue used for Read()
+	/// \param nSizeMsecs Size of the queue in milliseconds duration of the stream
+	/// \note Not used, if PutChunk() is overloaded.
+	boolean AllocateReadQueue (unsigned nSizeMsecs);
+
+	/// \param Format    Format of sound data returned by Read()
+	/// \param nChannels 1 (left channel only) or 2 channels
+	/// \note Not used, if PutChunk() is overloaded.
+	void SetReadFormat (TSoundFormat Format, unsigned nChannels = 2);
+
+	/// \param pBuffer    Buffer, where the captured samples are placed
+	/// \param nCount     Size of the buffer in bytes (multiple of frame size)
+	/// \param pTimestamp Capture time of the first returned frame will be stored here\n
+	///		      (in CTimer::GetClockTicks() units, may be 0)
+	/// \return Number of bytes returned
+	/// \note Not used, if PutChunk() is overloaded.
+	/// \note Can be called on any core, but from one task at a time only.
+	/// \note The timestamp is estimated from the system time, when a DMA period\n
+	///	  has been completed, and the sample rate. It is not exact after an overrun.
+	int Read (void *pBuffer, size_t nCount, unsigned *pTimestamp = 0);
+
+	/// \return Number of frames available in the queue waiting to be read
+	/// \note Not used, if PutChunk() is overloaded.
+	/// \note Can be called on any core.
+	unsigned GetReadQueueFramesAvail (void);
+
+	/// \return Number of read queue overruns (captured data had to be dropped)
+	/// \note Can be called on any core.
+	unsigned GetReadQueueOverrunCount (void) const	{ return m_nReadQueueOverruns; }
+
+	/// \param pCallback Callback which is called, when captured data has been queued
+	/// \param pParam User parameter to be handed over to the callback
+	/// \note Is called from interrupt context, should only wake up a task.
+	/// \note Not used, if PutChunk() is overloaded.
+	void RegisterHaveDataCallback (TSoundHaveDataCallback *pCallback, void *pParam);
+
+	/// \brief Convert samples to stereo frames of signed 32-bit samples (left aligned)
+	/// \param pTo Destination buffer (nFrames * 2 words)
+	/// \param pFrom Source samples
+	/// \param nFrames Number of frames to be converted
+	/// \param Format Format of the source samples (not SoundFormatUnsigned32)
+	/// \param nChannels Number of channels of the source (1 or 2)
+	/// \param bSwapChannels Swap stereo channels?
+	/// \note Can be called on any core, also by sound sources (e.g. CSoundMixerStream).
+	static void DecodeFrames (s32 *pTo, const void *pFrom, unsigned nFrames,
+				  TSoundFormat Format, unsigned nChannels,
+				  boolean bSwapChannels = FALSE) MAXOPT;
+
 protected:
 	/// \brief May overload this to provide the sound samples
 	/// \param pBuffer    Buffer where the samples have to be placed
@@ -131,15 +203,37 @@ protected:
 	virtual unsigned GetChunk (s16 *pBuffer, unsigned nChunkSize);
 	virtual unsigned GetChunk (u32 *pBuffer, unsigned nChunkSize);
 
+	/// \brief May overload this to consume the captured sound samples
+	/// \param pBuffer    Buffer with the captured samples
+	/// \param nChunkSize Number of words in the buffer
+	/// \note Each sample consists of two words (Left channel, right channel)\n
+	///	  Each word is between GetRangeMin() and GetRangeMax()
+	/// \note Is called from interrupt context.
+	virtual void PutChunk (const s16 *pBuffer, unsigned nChunkSize);
+	virtual void PutChunk (const u32 *pBuffer, unsigned nChunkSize);
+
+private:
+	struct TQueue			// lock-free single producer / single consumer ring buffer
+	{
+		u8 *pBuffer;
+		unsigned nSize;			// in bytes, 1 byte remains free
+		volatile unsigned nInPtr;	// written by the producer only
+		volatile unsigned nOutPtr;	// written by the consumer only
+	};
+
 private:
-	void ConvertSoundFormat (void *pTo, const void *pFrom);
+	void EncodeFrames (void *pTo, const s32 *pFrom, unsigned nFrames) MAXOPT;
+
+	void DecodeHWFrames (s32 *pTo, const void *pFrom, unsigned nFrames) MAXOPT;
+	void EncodeReadFrames (void *pTo, const s32 *pFrom, unsigned nFrames) MAXOPT;
 
 	unsigned GetChunkInternal (void *pBuffer, unsigned nChunkSize);
+	void PutChunkInternal (const void *pBuffer, unsigned nChunkSize);
 
-	unsigned GetQueueBytesFree (void);
-	unsigned GetQueueBytesAvail (void);
-	void Enqueue (const void *pBuffer, unsigned nCount);
-	void Dequeue (void *pBuffer, unsigned nCount);
+	static unsigned GetQueueBytesFree (const TQueue *pQueue);
+	static unsigned GetQueueBytesAvail (const TQueue *pQueue);
+	static void Enqueue (TQueue *pQueue, const void *pBuffer, unsigned nCount);
+	static void Dequeue (TQueue *pQueue, void *pBuffer, unsigned nCount);
 
 private:
 	TSoundFormat m_HWFormat;
@@ -148,7 +242,6 @@ private:
 
 	unsigned m_nHWSampleSize;
 	unsigned m_nHWFrameSize;
-	unsigned m_nQueueSize;
 	unsigned m_nNeedDataThreshold;
 
 	int m_nRangeMin;
@@ -160,14 +253,28 @@ private:
 	unsigned m_nWriteSampleSize;
 	unsigned m_nWriteFrameSize;
 
-	u8 *m_pQueue;			// Ring buffer
-	unsigned m_nInPtr;
-	unsigned m_nOutPtr;
+	TQueue m_Queue;			// Write() is the producer
+	boolean m_bQueueUnderrun;
+	volatile unsigned m_nQueueUnderruns;
+	CSpinLock m_WriteSpinLock;	// serializes the producers (task and callback)
 
 	TSoundNeedDataCallback *m_pCallback;
 	void *m_pCallbackParam;
 
-	CSpinLock m_SpinLock;
+	TSoundFormat m_ReadFormat;
+	unsigned m_nReadChannels;
+	unsigned m_nReadSampleSize;
+	unsigned m_nReadFrameSize;
+
+	TQueue m_ReadQueue;		// Read() is the consumer
+	u64 m_ullReadFrames;		// written by Read() only
+	u64 m_ullCapturedFrames;	// written by PutChunkInternal() only
+	volatile unsigned m_nCaptureTicksBase;	// capture time of frame 0 of the read stream
+	boolean m_bReadQueueOverrun;
+	volatile unsigned m_nReadQueueOverruns;
+
+	TSoundHaveDataCallback *m_pHaveDataCallback;
+	void *m_pHaveDataCallbackParam;
 };
 
 #endif
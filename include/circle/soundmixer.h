@@ -0,0 +1,132 @@
+//
+// soundmixer.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2020  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_soundmixer_h
+#define _circle_soundmixer_h
+
+#include <circle/soundbasedevice.h>
+#include <circle/spinlock.h>
+#include <circle/macros.h>
+#include <circle/types.h>
+
+#define SOUND_MIXER_MAX_STREAMS		8
+#define SOUND_MIXER_UNITY_GAIN		256		// gain 1.0
+
+class CSoundMixer;
+
+/// \note Write() can be called on any core, all other methods on core 0.
+
+class CSoundMixerStream		/// One input stream of CSoundMixer with own format and sample rate
+{
+public:
+	/// \param nSampleRate Sample rate of this stream in Hz
+	/// \param nQueueFrames Size of the queue of this stream in frames
+	CSoundMixerStream (unsigned nSampleRate, unsigned nQueueFrames);
+
+	~CSoundMixerStream (void);
+
+	/// \param Format    Format of sound data used for Write() (not SoundFormatUnsigned32)
+	/// \param nChannels 1 or 2 channels
+	void SetWriteFormat (TSoundFormat Format, unsigned nChannels = 2);
+
+	/// \param pBuffer Contains the samples
+	/// \param nCount  Size of the buffer in bytes (multiple of frame size)
+	/// \return Number of bytes consumed
+	/// \note Can be called on any core (not from interrupt context).
+	int Write (const void *pBuffer, size_t nCount);
+
+	/// \param nGain Gain of this stream (SOUND_MIXER_UNITY_GAIN is 1.0)
+	void SetGain (unsigned nGain);
+
+	/// \return Number of frames available in the queue waiting to be mixed
+	unsigned GetQueueFramesAvail (void);
+
+private:
+	void SetOutputRate (unsigned nOutputRate);
+
+	unsigned GetFramesReady (void);		// at the output rate
+
+	void Mix (s32 *pBuffer, unsigned nFrames);
+
+	unsigned GetQueueFramesFree (void) const;
+
+private:
+	unsigned m_nSampleRate;
+	unsigned m_nQueueSize;			// in frames
+	s32 *m_pQueue;				// stereo 24-bit samples in 32-bit words
+	unsigned m_nInPtr;
+	unsigned m_nOutPtr;
+
+	TSoundFormat m_WriteFormat;
+	unsigned m_nWriteChannels;
+	unsigned m_nWriteFrameSize;
+
+	volatile unsigned m_nGain;
+
+	u32 m_nStep;				// input frames per output frame (16.16)
+	u32 m_nPhase;				// position between two input frames (0.16)
+
+	CSpinLock m_SpinLock;
+
+	friend class CSoundMixer;
+};
+
+/// \note The mixer converts the sample rate of each stream to the rate of the device,\n
+///	  applies the gain and sums up the streams into the queue of the device, which\n
+///	  must have been allocated with AllocateQueue(). The device has to be started\n
+///	  by the application.
+/// \note All methods have to be called on core 0 at task level.
+
+class CSoundMixer		/// Mixes multiple sound streams into one sound device
+{
+public:
+	/// \param pDevice Pointer to the sound device, which is fed (uses Write())
+	/// \param nSampleRate Sample rate of the device in Hz
+	/// \param nChunkFrames Number of frames mixed at once
+	CSoundMixer (CSoundBaseDevice *pDevice, unsigned nSampleRate,
+		     unsigned nChunkFrames = 256);
+
+	~CSoundMixer (void);
+
+	/// \param pStream Stream to be added (the stream is not deleted by the mixer)
+	/// \return Operation successful?
+	boolean AddStream (CSoundMixerStream *pStream);
+	/// \param pStream Stream to be removed
+	void RemoveStream (CSoundMixerStream *pStream);
+
+	/// \brief Mixes the streams into the queue of the device, as long as there is space
+	/// \note Must be called frequently (e.g. in the application main loop).
+	void Update (void);
+
+private:
+	void Output (unsigned nFrames) MAXOPT;
+
+private:
+	CSoundBaseDevice *m_pDevice;
+	unsigned m_nSampleRate;
+	unsigned m_nChunkFrames;
+
+	boolean m_b24Bit;			// output format to device
+	s32 *m_pMixBuffer;
+	u8 *m_pOutBuffer;
+
+	CSoundMixerStream *m_pStream[SOUND_MIXER_MAX_STREAMS];
+};
+
+#endif
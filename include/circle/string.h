@@ -23,16 +23,22 @@
 #include <circle/stdarg.h>
 #include <circle/types.h>
 
+#define STRING_INLINE_SIZE	64	// strings up to this size (incl. '\0') need no heap
+
 class CString
 {
 public:
 	CString (void);
 	CString (const char *pString);
+	CString (const CString &rString);
+	CString (CString &&rrString);
+	CString (char *pBuffer, size_t nSize);		// uses fixed buffer, contents is truncated
 	virtual ~CString (void);
 
 	operator const char *(void) const;
 	const char *operator = (const char *pString);
 	const CString &operator = (const CString &rString);
+	const CString &operator = (CString &&rrString);
 
 	size_t GetLength (void) const;
 
@@ -45,10 +51,20 @@ public:
 	void Format (const char *pFormat, ...);		// supports only a small subset of printf(3)
 	void FormatV (const char *pFormat, va_list Args);
 
+	// format into caller-supplied buffer without heap allocation (like snprintf(3)),
+	// returns length of the (possibly truncated) result
+	static size_t FormatBuffer (char *pBuffer, size_t nSize, const char *pFormat, ...);
+	static size_t FormatBufferV (char *pBuffer, size_t nSize, const char *pFormat, va_list Args);
+
 private:
+	void Assign (const char *pString);
+	void Move (CString &rString);
+	void FreeBuffer (void);
+	void FormatInPlace (const char *pFormat, va_list Args);
+
 	void PutChar (char chChar, size_t nCount = 1);
 	void PutString (const char *pString);
-	void ReserveSpace (size_t nSpace);
+	size_t ReserveSpace (size_t nSpace);		// returns available space (<= nSpace)
 	
 	static char *ntoa (char *pDest, unsigned long ulNumber, unsigned nBase, boolean bUpcase);
 #if STDLIB_SUPPORT >= 1
@@ -57,9 +73,11 @@ private:
 	static char *ftoa (char *pDest, double fNumber, unsigned nPrecision);
 
 private:
-	char 	 *m_pBuffer;
-	unsigned  m_nSize;
+	char 	 *m_pBuffer;		// m_InlineBuffer, heap block or fixed buffer
+	size_t	  m_nSize;
 	char	 *m_pInPtr;
+	boolean	  m_bFixed;		// m_pBuffer has been supplied by the caller
+	char	  m_InlineBuffer[STRING_INLINE_SIZE];
 };
 
 #endif
@@ -81,6 +81,15 @@
 #define HEAP_BLOCK_BUCKET_SIZES	0x40,0x400,0x1000,0x4000,0x10000,0x40000,0x80000
 #endif
 
+// HEAP_TRACKING enables the accounting of the live heap blocks and
+// pages by the call site, which has allocated them, and per-bucket
+// statistics (live, peak and free list counts). A report can be
+// generated with CMemorySystem::DumpUsage(). This costs a small
+// side table at the start of each heap and of the page region and
+// a hash lookup on each allocate and free operation.
+
+//#define HEAP_TRACKING
+
 ///////////////////////////////////////////////////////////////////////
 //
 // Raspberry Pi 1 and Zero
@@ -169,9 +178,11 @@
 // USE_USB_SOF_INTR improves the compatibility with low-/full-speed
 // USB devices. If your application uses such devices, this option
 // should normally be set. Unfortunately this causes a heavily changed
-// system timing, because it triggers up to 8000 IRQs per second. For
-// USB plug-and-play operation this option must be set in any case.
-// This option has no influence on the Raspberry Pi 4.
+// system timing, because it triggers up to 8000 IRQs per second, while
+// USB transactions are waiting to be scheduled (the SOF interrupt is
+// disabled, when there are none). For USB plug-and-play operation this
+// option must be set in any case. This option has no influence on the
+// Raspberry Pi 4.
 
 #ifndef NO_USB_SOF_INTR
 #define USE_USB_SOF_INTR
@@ -188,6 +199,17 @@
 #define SCREEN_DMA_BURST_LENGTH	2
 #endif
 
+// SCREEN_PAN_FACTOR enables scrolling the screen by moving the visible
+// window (virtual offset) through a frame buffer, which is this factor
+// (2 or more) higher than the screen. Scrolling the whole screen costs
+// an update of the virtual offset and the clearing of one text line
+// then. The contents is copied only, when the window reaches the end
+// of the buffer. This option must not be used, when the application
+// accesses the frame buffer directly (e.g. with LVGL), because the
+// visible part of the buffer moves. It requires more GPU memory.
+
+//#define SCREEN_PAN_FACTOR	4
+
 // CALIBRATE_DELAY activates the calibration of the delay loop. Because
 // this loop is normally not used any more in Circle, the only use of
 // this option is that the "SpeedFactor" of your system is displayed.
@@ -215,6 +237,14 @@
 #define TASK_STACK_SIZE		0x8000
 #endif
 
+// NO_BUSY_WAIT lets drivers, which have to wait for the hardware at
+// TASK_LEVEL, yield to other tasks instead of busy waiting (currently
+// only CUSBSerialDevice::Write(), if its TX ring is full). The
+// scheduler library must be linked to the application then. The
+// drivers still busy wait, while the scheduler is not constructed.
+
+//#define NO_BUSY_WAIT
+
 ///////////////////////////////////////////////////////////////////////
 //
 // USB keyboard
@@ -298,6 +328,24 @@
 
 //#define SAVE_VFP_REGS_ON_FIQ
 
+// TRACE_POINTS enables the trace points in the scheduler, the IRQ
+// dispatcher, the USB host controller drivers and the TCP protocol
+// handler. They record events to the system tracer (class CTracer),
+// if an instance of it exists and tracing has been started. Without
+// this option the trace points are removed at compile time.
+
+//#define TRACE_POINTS
+
+// IRQ_STATISTICS enables counting the calls of the IRQ handlers and
+// measuring their cumulative and maximum run time per IRQ line, the
+// IRQ nesting depth and the share of time each core spends in IRQ
+// handlers. The values can be requested with the class CIRQStatistics
+// (see CInterruptSystem::GetStatistics()) and can be reported
+// periodically by the class CIRQReportTask. Each IRQ costs two timer
+// counter reads with this option.
+
+//#define IRQ_STATISTICS
+
 // LEAVE_QEMU_ON_HALT can be defined to exit QEMU when halt() is
 // called or main() returns EXIT_HALT. QEMU has to be started with the
 // -semihosting option, so that this works. This option must not be
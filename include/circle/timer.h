@@ -61,6 +61,12 @@ public:
 	static unsigned GetClockTicks (void);
 #define CLOCKHZ	1000000
 
+	/// \return Current value of a 64-bit counter, which runs synchronously on all cores\n
+	/// (generic timer on Raspberry Pi 2-4, system timer on Raspberry Pi 1)
+	static u64 GetTicks64 (void);
+	/// \return Frequency of the counter returned by GetTicks64() in Hz
+	static u64 GetTicks64Frequency (void);
+
 	/// \return 1/HZ seconds since system boot, may wrap
 	unsigned GetTicks (void) const;
 	/// \return Seconds since system boot (continous)
@@ -92,6 +98,10 @@ public:
 	/// resulting CString object must be deleted by caller\n
 	/// Current time according to our time zone
 	CString *GetTimeString (void);
+	/// \param nTime Local time, which has been returned by GetTime() before
+	/// \param nTicks Ticks, which have been returned by GetTicks() at the same time
+	/// \return Same format as GetTimeString() above, but for the given time
+	static CString *GetTimeString (unsigned nTime, unsigned nTicks);
 
 	/// \brief Starts a kernel timer which elapses after a given delay,\n
 	/// a timer handler gets called then
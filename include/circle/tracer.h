@@ -2,7 +2,7 @@
 // tracer.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2014  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2014-2020  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -20,40 +20,153 @@
 #ifndef _circle_tracer_h
 #define _circle_tracer_h
 
+#include <circle/device.h>
+#include <circle/sysconfig.h>
 #include <circle/types.h>
 
+enum TTracePhase
+{
+	TracePhaseInstant,
+	TracePhaseBegin,		// begin of a duration (nParam[0] identifies it)
+	TracePhaseEnd,			// end of a duration
+	TracePhaseFlowStart,		// start of an asynchronous operation (nParam[0] is its ID)
+	TracePhaseFlowEnd,		// end of an asynchronous operation
+	TracePhaseUnknown
+};
+
 struct TTraceEntry
 {
-	unsigned nClockTicks;
+	u64	 ullTimestamp;		// in timestamp ticks, relative to Start()
 	unsigned nEventID;
-#define TRACER_EVENT_STOP	0
-	unsigned nParam[4];
+#define TRACER_EVENT_STOP		0
+	// events of the system trace points
+#define TRACER_EVENT_IRQ		0x80000001	// IRQ number
+#define TRACER_EVENT_TASK_SWITCH	0x80000002	// next task, previous task
+#define TRACER_EVENT_USB_REQUEST	0x80000003	// URB, buffer or result length
+#define TRACER_EVENT_TCP_TX		0x80000004	// connection, data length
+#define TRACER_EVENT_TCP_RX		0x80000005	// connection, data length
+#define TRACER_EVENT_TCP_RECEIVE	0x80000006	// connection, data length
+	unsigned nPhase;		// TTracePhase
+	uintptr	 nParam[4];
 };
 
-class CTracer
+#define TRACER_MAX_EVENT_NAMES	32
+
+#if RASPPI == 1
+	#define TRACER_CORES	1
+#else
+	#define TRACER_CORES	CORES
+#endif
+
+// Trace points in system code are removed, if TRACE_POINTS is not defined
+#ifdef TRACE_POINTS
+	#define TRACE_POINT(phase, id, param1, param2)					\
+		CTracer::TracePoint (phase, id, (uintptr) (param1), (uintptr) (param2))
+#else
+	#define TRACE_POINT(phase, id, param1, param2)	((void) 0)
+#endif
+
+// Handler, which receives the output of the exporter
+typedef boolean TTracerOutputHandler (const void *pBuffer, unsigned nLength, void *pParam);
+
+class CTracer	/// Records events with time stamp into a ring buffer per core
 {
 public:
+	/// \param nDepth Number of entries of the ring buffer of each core
+	/// \param bStopIfFull Stop recording on a core, if its buffer is full
 	CTracer (unsigned nDepth, boolean bStopIfFull);
 	~CTracer (void);
 
 	void Start (void);
 	void Stop (void);
 
-	// not reentrant, use spin lock if required
-	void Event (unsigned nID, unsigned nParam1 = 0, unsigned nParam2 = 0, unsigned nParam3 = 0, unsigned nParam4 = 0);
+	/// \brief Record an instant event
+	/// \note Can be called on any core from TASK_LEVEL, IRQ_LEVEL and FIQ_LEVEL.
+	void Event (unsigned nID, uintptr nParam1 = 0, uintptr nParam2 = 0,
+		    uintptr nParam3 = 0, uintptr nParam4 = 0);
+
+	/// \brief Record the begin of a duration
+	/// \param nParam1 Distinguishes durations with the same ID
+	void EventBegin (unsigned nID, uintptr nParam1 = 0, uintptr nParam2 = 0);
+	/// \brief Record the end of a duration
+	void EventEnd (unsigned nID, uintptr nParam1 = 0, uintptr nParam2 = 0);
+
+	/// \brief Record the start of an asynchronous operation
+	/// \param nFlowID Identifies the operation (e.g. pointer to a request object)
+	void FlowStart (unsigned nID, uintptr nFlowID, uintptr nParam2 = 0);
+	/// \brief Record the completion of an asynchronous operation
+	void FlowEnd (unsigned nID, uintptr nFlowID, uintptr nParam2 = 0);
+
+	/// \brief Set the name, which is displayed for an event ID
+	/// \param pName Name (must be a constant string)
+	void SetEventName (unsigned nID, const char *pName);
 
+	/// \brief Write the recorded events to the logger
 	void Dump (void);
 
+	/// \brief Write the recorded events in the Chrome Trace Event JSON format
+	/// \param pHandler Handler, which writes the output (e.g. to a file)
+	/// \param pParam Parameter handed over to the handler
+	/// \return Operation successful?
+	/// \note The result can be loaded into chrome://tracing or ui.perfetto.dev.
+	boolean ExportChromeJSON (TTracerOutputHandler *pHandler, void *pParam = 0);
+	/// \param pDevice Device, to which the output is written (e.g. CQEMUHostFile)
+	boolean ExportChromeJSON (CDevice *pDevice);
+
+	/// \return Number of timestamp ticks per second
+	u64 GetTimestampFrequency (void) const	{ return m_ullTimestampHz; }
+
 	static CTracer *Get (void);
 
+	/// \brief Used by the macro TRACE_POINT()
+	static void TracePoint (TTracePhase Phase, unsigned nID, uintptr nParam1, uintptr nParam2)
+	{
+		if (s_pThis != 0)
+		{
+			s_pThis->Write (Phase, nID, nParam1, nParam2, 0, 0);
+		}
+	}
+
+private:
+	void Write (TTracePhase Phase, unsigned nID,
+		    uintptr nParam1, uintptr nParam2, uintptr nParam3, uintptr nParam4);
+
+	const char *GetEventName (unsigned nID) const;
+
+	boolean Output (const char *pString);
+	boolean Flush (void);
+
+	static boolean DeviceOutputHandler (const void *pBuffer, unsigned nLength, void *pParam);
+
 private:
-	unsigned	 m_nDepth;		// size of ring buffer
+	unsigned	 m_nDepth;		// size of ring buffer per core
 	boolean		 m_bStopIfFull;
-	boolean		 m_bActive;
-	unsigned	 m_nStartTicks;
-	TTraceEntry	*m_pEntry;		// array used as ring buffer
-	unsigned	 m_nEntries;		// valid entries in ring buffer
-	unsigned	 m_nCurrent;		// write index into ring buffer
+	volatile boolean m_bActive;
+	u64		 m_ullTimestampHz;
+	u64		 m_ullStartTimestamp;
+
+	struct TTraceRing
+	{
+		TTraceEntry	*pEntry;	// array used as ring buffer
+		unsigned	 nEntries;	// valid entries in ring buffer
+		unsigned	 nCurrent;	// write index into ring buffer
+		unsigned	 nDropped;	// entries not recorded, because buffer was full
+	};
+
+	TTraceRing	 m_Ring[TRACER_CORES];
+
+	struct
+	{
+		unsigned	 nID;
+		const char	*pName;
+	}
+	m_EventName[TRACER_MAX_EVENT_NAMES];
+	unsigned	 m_nEventNames;
+
+	TTracerOutputHandler *m_pOutputHandler;
+	void		*m_pOutputParam;
+	char		*m_pOutBuffer;
+	unsigned	 m_nOutLength;
 
 	static CTracer *s_pThis;
 };
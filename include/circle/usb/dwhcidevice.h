@@ -37,6 +37,20 @@
 
 #define DWHCI_WAIT_BLOCKS	DWHCI_MAX_CHANNELS
 
+#ifdef USE_USB_SOF_INTR
+// Periodic transactions without split are limited to this number per (micro)frame,
+// further transactions are deferred to the next (micro)frame
+#define DWHCI_PERIODIC_XACTS_PER_FRAME	4
+
+// This number of channels is kept free from periodic transactions without split,
+// so that control and bulk transfers can proceed with many interrupt endpoints
+#define DWHCI_NON_PERIODIC_CHANNELS	2
+
+// A periodic transaction may be delayed up to this number of (micro)frames
+// after its interval, to balance the load between the (micro)frames
+#define DWHCI_PERIODIC_MAX_SLIP		3
+#endif
+
 class CDWHCIDevice : public CUSBHostController
 {
 public:
@@ -88,6 +102,9 @@ private:
 	void QueueTransaction (CDWHCITransferStageData *pStageData);
 
 	void QueueDelayedTransaction (CDWHCITransferStageData *pStageData);
+
+	// enqueues the transaction and enables the SOF interrupt, if required
+	void EnqueueTransaction (CDWHCITransferStageData *pStageData, u16 usFrameNumber);
 #endif
 
 	void StartTransaction (CDWHCITransferStageData *pStageData);
@@ -105,7 +122,8 @@ private:
 	static void TimerStub (TKernelTimerHandle hTimer, void *pParam, void *pContext);
 #endif
 
-	unsigned AllocateChannel (void);
+	// if bPeriodic is TRUE, DWHCI_NON_PERIODIC_CHANNELS channels are kept free
+	unsigned AllocateChannel (boolean bPeriodic = FALSE);
 	void FreeChannel (unsigned nChannel);
 
 	unsigned AllocateWaitBlock (void);
@@ -131,6 +149,7 @@ private:
 
 #ifdef USE_USB_SOF_INTR
 	CDWHCITransactionQueue m_TransactionQueue;
+	boolean m_bSOFInterruptEnabled;			// protected by m_IntMaskSpinLock
 #endif
 
 	CDWHCITransferStageData *m_pStageData[DWHCI_MAX_CHANNELS];
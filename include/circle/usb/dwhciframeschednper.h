@@ -29,7 +29,7 @@
 class CDWHCIFrameSchedulerNonPeriodic : public CDWHCIFrameScheduler
 {
 public:
-	CDWHCIFrameSchedulerNonPeriodic (void);
+	CDWHCIFrameSchedulerNonPeriodic (boolean bBulk);
 	~CDWHCIFrameSchedulerNonPeriodic (void);
 
 	void StartSplit (void);
@@ -54,6 +54,8 @@ private:
 
 #ifdef USE_USB_SOF_INTR
 	u16 m_usFrameOffset;
+	boolean m_bNAKBackoff;		// back off on NAK (bulk transfers only)
+	u16 m_usNAKBackoff;		// (micro)frames until retry after NAK, grows while NAKed
 #endif
 
 	DECLARE_CLASS_ALLOCATOR
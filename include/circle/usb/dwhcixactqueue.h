@@ -28,6 +28,8 @@
 
 #ifdef USE_USB_SOF_INTR
 
+#define DWHCI_XACT_LOAD_FRAMES	256		// periodic load is tracked for this number of frames
+
 class CUSBDevice;
 
 class CDWHCITransactionQueue		// Queues coming USB transactions (FIFO)
@@ -48,9 +50,20 @@ public:
 	// dequeue next transaction to be processed at usFrameNumber (or earlier)
 	CDWHCITransferStageData *Dequeue (u16 usFrameNumber);
 
+	boolean IsEmpty (void);
+
+	// returns the frame in usFrameNumber..usFrameNumber+usMaxSlip,
+	// which has the least periodic transactions queued
+	u16 GetLeastLoadedFrame (u16 usFrameNumber, u16 usMaxSlip);
+
+private:
+	void RemoveLoad (CDWHCITransferStageData *pStageData, u16 usFrameNumber);
+
 private:
 	CPtrList m_List;
 
+	u8 m_uchPeriodicLoad[DWHCI_XACT_LOAD_FRAMES];
+
 	CSpinLock m_SpinLock;
 };
 
@@ -24,6 +24,7 @@
 #include <circle/usb/usbfunction.h>
 #include <circle/usb/usbendpoint.h>
 #include <circle/usb/usbrequest.h>
+#include <circle/usb/usbbulkinring.h>
 #include <circle/macaddress.h>
 #include <circle/types.h>
 
@@ -64,6 +65,9 @@ private:
 	CUSBEndpoint *m_pEndpointBulkIn;
 	CUSBEndpoint *m_pEndpointBulkOut;
 
+	CUSBBulkInRing *m_pRxRing;
+	unsigned m_nRxOffset;		// offset of next frame in current RX buffer
+
 	CMACAddress m_MACAddress;
 };
 
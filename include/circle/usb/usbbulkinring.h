@@ -0,0 +1,89 @@
+//
+// usbbulkinring.h
+//
+// Ring of receive buffers, which is continuously filled by chained bulk-in requests
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2020  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_usb_usbbulkinring_h
+#define _circle_usb_usbbulkinring_h
+
+#include <circle/usb/usbhostcontroller.h>
+#include <circle/usb/usbendpoint.h>
+#include <circle/usb/usbrequest.h>
+#include <circle/spinlock.h>
+#include <circle/types.h>
+
+#define USB_BULK_IN_RING_STOP_TIMEOUT	(CLOCKHZ / 2)	// wait for pending request on destruction
+
+class CUSBBulkInRing	/// Keeps a bulk-in endpoint busy, while received data is processed
+{
+public:
+	/// \param pHost Host controller, which serves the requests
+	/// \param pEndpoint Bulk-in endpoint to receive from
+	/// \param nBuffers Number of buffers in the ring (>= 2)
+	/// \param nBufferSize Size of each buffer (maximum transfer length)
+	/// \param bCompleteOnNAK Complete a request with length 0, if the device NAKs
+	CUSBBulkInRing (CUSBHostController *pHost, CUSBEndpoint *pEndpoint,
+			unsigned nBuffers, unsigned nBufferSize, boolean bCompleteOnNAK = FALSE);
+	~CUSBBulkInRing (void);
+
+	/// \brief Get the oldest buffer, which has been filled with received data
+	/// \param pLength Pointer to variable, which receives the valid data length
+	/// \return Pointer to the buffer, 0 if nothing has been received
+	/// \note The buffer must be handed back using ReleaseBuffer() after use.
+	/// \note Restarts the reception, if the endpoint is currently idle.
+	const u8 *GetBuffer (unsigned *pLength);
+
+	/// \brief Hand back the buffer returned by GetBuffer() to the ring
+	void ReleaseBuffer (void);
+
+	/// \return Number of transfers, which have been completed with data
+	unsigned GetTransferCount (void) const		{ return m_nTransferCount; }
+	/// \return Number of times, the reception had to pause, because the ring was full
+	unsigned GetOverrunCount (void) const		{ return m_nOverrunCount; }
+
+private:
+	boolean StartRequest (void);
+
+	void CompletionRoutine (CUSBRequest *pURB);
+	static void CompletionStub (CUSBRequest *pURB, void *pParam, void *pContext);
+
+private:
+	CUSBHostController *m_pHost;
+	CUSBEndpoint *m_pEndpoint;
+	unsigned m_nBuffers;
+	unsigned m_nBufferSize;
+	boolean m_bCompleteOnNAK;
+
+	u8 **m_ppBuffer;
+	volatile unsigned *m_pLength;
+
+	unsigned m_nInPtr;		// buffer to be filled next, written on completion only
+	unsigned m_nOutPtr;		// oldest filled buffer, written by ReleaseBuffer() only
+	volatile unsigned m_nFilled;	// number of filled buffers
+
+	volatile boolean m_bActive;	// a request is pending on the endpoint
+	volatile boolean m_bShutdown;	// destructor is waiting for the pending request
+
+	volatile unsigned m_nTransferCount;
+	volatile unsigned m_nOverrunCount;
+
+	CSpinLock m_SpinLock;
+};
+
+#endif
@@ -24,6 +24,7 @@
 #include <circle/usb/usbfunction.h>
 #include <circle/usb/usbendpoint.h>
 #include <circle/usb/usbrequest.h>
+#include <circle/usb/usbbulkinring.h>
 #include <circle/macaddress.h>
 #include <circle/types.h>
 
@@ -49,6 +50,8 @@ private:
 	CUSBEndpoint *m_pEndpointBulkIn;
 	CUSBEndpoint *m_pEndpointBulkOut;
 
+	CUSBBulkInRing *m_pRxRing;
+
 	CMACAddress m_MACAddress;
 };
 
@@ -30,7 +30,25 @@
 #define UMSD_BLOCK_MASK		(UMSD_BLOCK_SIZE-1)
 #define UMSD_BLOCK_SHIFT	9
 
-#define UMSD_MAX_OFFSET		0x1FFFFFFFFFFULL		// 2TB
+#define UMSD_MAX_OFFSET		0x1FFFFFFFFFFULL		// 2TB, above READ(16)/WRITE(16) is used
+
+// Requests are split into SCSI commands, which transfer this number of bytes at most
+#define UMSD_MAX_TRANSFER_SIZE	0x40000
+
+#if RASPPI <= 3
+#define UMSD_MAX_PACKETS	1023			// DWHCI allows up to 1023 packets per transfer
+#endif
+
+struct TUMSDStatistics
+{
+	u64	ullBytesRead;
+	u64	ullBytesWritten;
+	u64	ullReadMicros;			// time spent in read commands
+	u64	ullWriteMicros;			// time spent in write commands
+	unsigned nReadCommands;
+	unsigned nWriteCommands;
+	unsigned nErrors;			// failed tries, which caused a reset
+};
 
 class CUSBBulkOnlyMassStorageDevice : public CUSBFunction
 {
@@ -45,11 +63,17 @@ public:
 
 	u64 Seek (u64 ullOffset);
 
+	// returns number of blocks, limited to 0xFFFFFFFF for disks > 2TB
 	unsigned GetCapacity (void) const;
+	// returns number of blocks
+	u64 GetCapacity64 (void) const;
+
+	// returns throughput counters of this device
+	const TUMSDStatistics *GetStatistics (void) const;
 
 private:
-	int TryRead (void *pBuffer, size_t nCount);
-	int TryWrite (const void *pBuffer, size_t nCount);
+	int TryRead (void *pBuffer, size_t nCount, u64 ullOffset);
+	int TryWrite (const void *pBuffer, size_t nCount, u64 ullOffset);
 
 	int Command (void *pCmdBlk, size_t nCmdBlkLen, void *pBuffer, size_t nBufLen, boolean bIn);
 
@@ -60,9 +84,13 @@ private:
 	CUSBEndpoint *m_pEndpointOut;
 
 	unsigned m_nCWBTag;
-	unsigned m_nBlockCount;
+	u64 m_ullBlockCount;
 	u64 m_ullOffset;
 
+	size_t m_nMaxTransferSize;			// depends on the max. packet size on DWHCI
+
+	TUMSDStatistics m_Statistics;
+
 	CPartitionManager *m_pPartitionManager;
 
 	static CNumberPool s_DeviceNumberPool;
@@ -22,9 +22,18 @@
 
 #include <circle/usb/usbfunction.h>
 #include <circle/usb/usbendpoint.h>
+#include <circle/usb/usbrequest.h>
 #include <circle/numberpool.h>
+#include <circle/timer.h>
+#include <circle/spinlock.h>
 #include <circle/types.h>
 
+#define USB_SERIAL_RX_RING_SIZE		4096		// must be a power of 2
+#define USB_SERIAL_TX_RING_SIZE		4096		// must be a power of 2
+#define USB_SERIAL_MAX_PACKETS		8		// per bulk transfer
+#define USB_SERIAL_WRITE_TIMEOUT_MS	1000		// Write() waits this long for free space
+#define USB_SERIAL_RX_POLL_MS		10		// polls again after this, if no data
+
 enum TUSBSerialDataBits
 {
 	USBSerialDataBits5	 = 5,
@@ -46,6 +55,25 @@ enum TUSBSerialParity
 	USBSerialParityEven	 = 2,
 };
 
+enum TUSBSerialFlowControl
+{
+	USBSerialFlowControlNone,
+	USBSerialFlowControlHardware,		// RTS/CTS, handled by the device
+	USBSerialFlowControlSoftware		// XON/XOFF, handled by the driver
+};
+
+struct TUSBSerialStatistics
+{
+	u64	 ullBytesReceived;
+	u64	 ullBytesSent;
+	unsigned nRxTransfers;
+	unsigned nTxTransfers;		// several Write() calls can be batched into one
+	unsigned nRxOverruns;		// reception paused, because the RX ring was full
+	unsigned nRxErrors;
+	unsigned nTxErrors;
+	unsigned nTxDropped;		// bytes, which did not fit into the TX ring in time
+};
+
 class CUSBSerialDevice : public CUSBFunction
 {
 public:
@@ -55,34 +83,77 @@ public:
 
 	boolean Configure (void);
 
+	// queues the data for transmission, returns the number of bytes queued
+	// waits up to USB_SERIAL_WRITE_TIMEOUT_MS, if the TX ring is full
+	// (yields to other tasks meanwhile with NO_BUSY_WAIT in sysconfig.h)
 	int Write (const void *pBuffer, size_t nCount);
+	// returns received data from the RX ring, 0 if nothing is available
 	int Read (void *pBuffer, size_t nCount);
 
 	virtual boolean SetBaudRate (unsigned nBaudRate);
 	virtual boolean SetLineProperties (TUSBSerialDataBits nDataBits, TUSBSerialParity nParity, TUSBSerialStopBits nStopBits);
+	// USBSerialFlowControlHardware must be supported by the subclass
+	boolean SetFlowControl (TUSBSerialFlowControl FlowControl);
+
+	// returns the number of bytes, which have not been sent yet
+	size_t GetTxPending (void) const;
+
+	void GetStatistics (TUSBSerialStatistics *pStatistics) const;
+
+protected:
+	// enables/disables RTS/CTS handshake in the device, returns FALSE if not supported
+	virtual boolean SetHardwareFlowControl (boolean bEnable);
 
 private:
-	void CompletionRoutine (CUSBRequest *pURB);
-	static void CompletionStub (CUSBRequest *pURB, void *pParam, void *pContext);
+	void StartReception (void);
+	void SubmitReception (void);
+	void KickTransmission (void);
+
+	void SendFlowControlChar (u8 uchChar);
+
+	void RxCompletionRoutine (CUSBRequest *pURB);
+	static void RxCompletionStub (CUSBRequest *pURB, void *pParam, void *pContext);
+	void RxTimerHandler (TKernelTimerHandle hTimer);
+	static void RxTimerStub (TKernelTimerHandle hTimer, void *pParam, void *pContext);
+	void TxCompletionRoutine (CUSBRequest *pURB);
+	static void TxCompletionStub (CUSBRequest *pURB, void *pParam, void *pContext);
 
 protected:
 	unsigned m_nBaudRate;
 	TUSBSerialDataBits m_nDataBits;
 	TUSBSerialParity m_nParity;
 	TUSBSerialStopBits m_nStopBits;
+	TUSBSerialFlowControl m_FlowControl;
 
 private:
-	size_t m_nReadHeaderBytes;
+	size_t m_nReadHeaderBytes;		// at the begin of each packet
 
 	CUSBEndpoint *m_pEndpointIn;
 	CUSBEndpoint *m_pEndpointOut;
 
-	u8 *m_pBufferIn;
+	// RX ring: written from RxCompletionRoutine() only, read from Read() only
+	u8 *m_pBufferIn;			// bulk-in transfer buffer
 	size_t m_nBufferInSize;
-	size_t m_nBufferInValid;
-	unsigned m_nBufferInPtr;
-
-	volatile boolean m_bInRequestActive;
+	u8 m_RxRing[USB_SERIAL_RX_RING_SIZE];
+	volatile unsigned m_nRxIn;
+	volatile unsigned m_nRxOut;
+	volatile boolean m_bRxActive;		// a bulk-in request or the poll timer is pending
+	TKernelTimerHandle m_hRxTimer;		// polls again, after the device NAKed
+	volatile boolean m_bXOFFSent;
+
+	// TX ring: protected by m_TxSpinLock
+	u8 *m_pBufferOut;			// bulk-out transfer buffer
+	size_t m_nBufferOutSize;
+	u8 m_TxRing[USB_SERIAL_TX_RING_SIZE];
+	volatile unsigned m_nTxIn;
+	volatile unsigned m_nTxOut;
+	volatile boolean m_bTxActive;		// a bulk-out request is pending
+	volatile boolean m_bTxStopped;		// XOFF has been received
+	u8 m_uchTxControlChar;			// XON or XOFF to be sent first, or 0
+	CSpinLock m_TxSpinLock;
+	CSpinLock m_RxSpinLock;
+
+	TUSBSerialStatistics m_Statistics;
 
 	unsigned m_nDeviceNumber;
 	static CNumberPool s_DeviceNumberPool;
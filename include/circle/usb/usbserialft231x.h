@@ -36,6 +36,9 @@ public:
 				   TUSBSerialParity nParity, TUSBSerialStopBits nStopBits);
 
 	static const TUSBDeviceID *GetDeviceIDTable (void);
+
+protected:
+	boolean SetHardwareFlowControl (boolean bEnable);
 };
 
 #endif
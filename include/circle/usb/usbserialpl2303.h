@@ -36,6 +36,12 @@ public:
 				   TUSBSerialParity nParity, TUSBSerialStopBits nStopBits);
 
 	static const TUSBDeviceID *GetDeviceIDTable (void);
+
+protected:
+	boolean SetHardwareFlowControl (boolean bEnable);
+
+private:
+	boolean m_bLegacyType;
 };
 
 #endif
@@ -358,6 +358,8 @@ PACKED;
 #define XHCI_CMD_TRB_EVALUATE_CONTEXT_CONTROL_SLOTID__MASK	(0xFF << 24)
 
 // Transfer TRB
+#define XHCI_TRANSFER_TRB_STATUS_TRB_TRANSFER_LENGTH__MASK	0x1FFFF
+	#define XHCI_TRANSFER_TRB_MAX_LENGTH				0x10000	// must not cross 64K
 #define XHCI_TRANSFER_TRB_STATUS_TD_SIZE__SHIFT			17
 #define XHCI_TRANSFER_TRB_STATUS_TD_SIZE__MASK			(0x1F << 17)
 #define XHCI_TRANSFER_TRB_STATUS_INTERRUPTER_TARGET__SHIFT	22
@@ -371,6 +373,7 @@ PACKED;
 	#define XHCI_TRANSFER_TRB_CONTROL_TRT_IN			3
 
 #define XHCI_TRANSFER_TRB_CONTROL_ISP				(1 << 2)
+#define XHCI_TRANSFER_TRB_CONTROL_CH				(1 << 4)
 #define XHCI_TRANSFER_TRB_CONTROL_IOC				(1 << 5)
 #define XHCI_TRANSFER_TRB_CONTROL_IDT				(1 << 6)
 #define XHCI_TRANSFER_TRB_CONTROL_DIR_IN			(1 << 16)
@@ -38,11 +38,21 @@
 #define XHCI_CONFIG_MAX_SLOTS		32
 #define XHCI_CONFIG_MAX_PORTS		5
 
+#ifndef XHCI_CONFIG_EVENT_RING_SIZE
 #define XHCI_CONFIG_EVENT_RING_SIZE	64
+#endif
+#ifndef XHCI_CONFIG_CMD_RING_SIZE
 #define XHCI_CONFIG_CMD_RING_SIZE	64
-#define XHCI_CONFIG_TRANSFER_RING_SIZE	64
+#endif
+#ifndef XHCI_CONFIG_TRANSFER_RING_SIZE
+#define XHCI_CONFIG_TRANSFER_RING_SIZE	64		// TRBs per segment
+#endif
 
-#define XHCI_CONFIG_IMODI		500		// defines maximum interrupt rate
+#define XHCI_CONFIG_MAX_RING_SEGMENTS	8		// transfer rings grow up to this
+
+#ifndef XHCI_CONFIG_IMODI
+#define XHCI_CONFIG_IMODI		500		// defines maximum interrupt rate (initially)
+#endif
 
 #define XHCI_PAGE_SHIFT			12
 #define XHCI_PAGE_SIZE			(1 << XHCI_PAGE_SHIFT)
@@ -34,6 +34,17 @@
 #include <circle/usb/xhci.h>
 #include <circle/types.h>
 
+struct TXHCIStatistics
+{
+	unsigned nInterrupts;
+	unsigned nEvents;			// handled from the event ring
+	unsigned nMaxEventsPerInterrupt;
+	unsigned nTransferDescriptors;		// Normal TDs (bulk and interrupt)
+	unsigned nTransferTRBs;			// TRBs used for these TDs
+	unsigned nMaxTRBsPerTD;
+	unsigned nRingExpansions;		// segments added to transfer rings
+};
+
 class CXHCIDevice : public CUSBHostController	/// USB host controller interface (xHCI) driver
 {
 public:
@@ -48,6 +59,13 @@ public:
 	boolean SubmitBlockingRequest (CUSBRequest *pURB, unsigned nTimeoutMs = USB_TIMEOUT_NONE);
 	boolean SubmitAsyncRequest (CUSBRequest *pURB, unsigned nTimeoutMs = USB_TIMEOUT_NONE);
 
+	// set minimum interval between two interrupts (0 to disable moderation)
+	// trades interrupt load against latency, can be called at any time
+	void SetInterruptModeration (unsigned nMicroseconds);
+
+	void GetStatistics (TXHCIStatistics *pStatistics) const;
+	void ResetStatistics (void);
+
 public:
 	CXHCIMMIOSpace *GetMMIOSpace (void);
 	CXHCISlotManager *GetSlotManager (void);
@@ -59,6 +77,9 @@ public:
 				 size_t nBoundary = XHCI_PAGE_SIZE);
 	void FreeSharedMem (void *pBlock);
 
+	void CountTransferDescriptor (unsigned nTRBs);
+	void CountRingExpansion (void);
+
 #ifndef NDEBUG
 	void DumpStatus (void);
 #endif
@@ -86,6 +107,8 @@ private:
 	CXHCIRootHub *m_pRootHub;
 
 	boolean m_bShutdown;
+
+	TXHCIStatistics m_Statistics;
 };
 
 #endif
@@ -47,7 +47,7 @@ public:
 	boolean Transfer (CUSBRequest *pURB, unsigned nTimeoutMs);
 	boolean TransferAsync (CUSBRequest *pURB, unsigned nTimeoutMs);
 
-	void TransferEvent (u8 uchCompletionCode, u32 nTransferLength);
+	void TransferEvent (u8 uchCompletionCode, u32 nTransferLength, TXHCITRB *pTransferTRB);
 
 #ifndef NDEBUG
 	void DumpStatus (void);
@@ -57,8 +57,11 @@ private:
 	static void CompletionRoutine (CUSBRequest *pURB, void *pParam, void *pContext);
 
 	// Cycle bit and Interrupter Target are set automatically
-	boolean EnqueueTRB (u32 nControl, u32 nStatus = 0,
-			    u32 nParameter1 = 0, u32 nParameter2 = 0);
+	// returns the enqueued TRB or 0 if the ring is full
+	TXHCITRB *EnqueueTRB (u32 nControl, u32 nStatus = 0,
+			      u32 nParameter1 = 0, u32 nParameter2 = 0);
+
+	boolean EnqueueNormalTD (void *pBuffer, u32 nBufLen);
 
 	TXHCIInputContext *GetInputContextSetMaxPacketSize (void);
 	TXHCIInputContext *GetInputContextConfigureEndpoint (void);
@@ -86,6 +89,9 @@ private:
 	CUSBRequest	*m_pURB;
 	volatile boolean m_bTransferCompleted;
 
+	TXHCITRB	*m_pFirstTDTRB;		// TRBs of the pending Normal TD (0 for control TDs)
+	TXHCITRB	*m_pLastTDTRB;
+
 	u8		*m_pInputContextBuffer;
 };
 
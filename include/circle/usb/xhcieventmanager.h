@@ -38,6 +38,9 @@ public:
 	// returns next event dequeue TRB or 0 if event ring is empty
 	TXHCITRB *HandleEvents (void);
 
+	// usInterval in 250ns units, 0 disables interrupt moderation
+	void SetInterruptModeration (u16 usInterval);
+
 #ifndef NDEBUG
 	void DumpStatus (void);
 #endif
@@ -20,6 +20,7 @@
 #ifndef _circle_usb_xhciring_h
 #define _circle_usb_xhciring_h
 
+#include <circle/usb/xhciconfig.h>
 #include <circle/usb/xhci.h>
 #include <circle/types.h>
 
@@ -41,7 +42,7 @@ public:
 
 	boolean IsValid (void) const;
 
-	unsigned GetTRBCount (void) const;
+	unsigned GetTRBCount (void) const;	// per segment
 
 	TXHCITRB *GetFirstTRB (void);
 	TXHCITRB *GetDequeueTRB (void);		// returns 0 if empty
@@ -52,6 +53,16 @@ public:
 
 	u32 GetCycleState (void) const;
 
+	// transfer ring only: returns the TRB following pTRB, Link TRBs are skipped
+	TXHCITRB *GetNextTRB (TXHCITRB *pTRB);
+
+	// transfer ring only: returns the number of TRBs, which can be enqueued into the idle ring
+	unsigned GetCapacity (void) const;
+	// transfer ring only: inserts a new segment after the enqueue segment
+	// the ring must be idle (all enqueued TRBs have been processed by the xHC)
+	boolean Expand (void);
+	unsigned GetSegmentCount (void) const;
+
 #ifndef NDEBUG
 	void DumpStatus (const char *pFrom = 0);
 #endif
@@ -65,6 +76,10 @@ private:
 	unsigned	 m_nEnqueueIndex;
 	unsigned	 m_nDequeueIndex;
 	u32		 m_nCycleState;
+
+	unsigned	 m_nSegments;
+	TXHCITRB	*m_pSegment[XHCI_CONFIG_MAX_RING_SEGMENTS];	// in ring order
+	unsigned	 m_nEnqueueSegment;
 };
 
 #endif
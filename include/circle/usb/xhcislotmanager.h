@@ -46,7 +46,7 @@ public:
 
 private:
 	void TransferEvent (u8 uchCompletionCode, u32 nTransferLength,
-			    u8 uchSlotID, u8 uchEndpointID);
+			    u8 uchSlotID, u8 uchEndpointID, TXHCITRB *pTransferTRB);
 	friend class CXHCIEventManager;
 
 private:
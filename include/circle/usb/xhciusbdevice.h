@@ -46,7 +46,8 @@ public:
 
 	void RegisterEndpoint (u8 uchEndpointID, CXHCIEndpoint *pEndpoint);
 
-	void TransferEvent (u8 uchCompletionCode, u32 nTransferLength, u8 uchEndpointID);
+	void TransferEvent (u8 uchCompletionCode, u32 nTransferLength, u8 uchEndpointID,
+			    TXHCITRB *pTransferTRB);
 
 #ifndef NDEBUG
 	void DumpStatus (void);
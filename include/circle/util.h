@@ -32,13 +32,13 @@ void *memset (void *pBuffer, int nValue, size_t nLength) STDOPT;
 void *memcpy (void *pDest, const void *pSrc, size_t nLength);
 #define memcpyblk memcpy
 
-void *memmove (void *pDest, const void *pSrc, size_t nLength);
+void *memmove (void *pDest, const void *pSrc, size_t nLength) STDOPT;
 
-int memcmp (const void *pBuffer1, const void *pBuffer2, size_t nLength);
+int memcmp (const void *pBuffer1, const void *pBuffer2, size_t nLength) STDOPT;
 
-size_t strlen (const char *pString);
+size_t strlen (const char *pString) STDOPT;
 
-int strcmp (const char *pString1, const char *pString2);
+int strcmp (const char *pString1, const char *pString2) STDOPT;
 int strcasecmp (const char *pString1, const char *pString2);
 int strncmp (const char *pString1, const char *pString2, size_t nMaxLen);
 int strncasecmp (const char *pString1, const char *pString2, size_t nMaxLen);
@@ -64,19 +64,23 @@ int char2int (char chValue);			// with sign extension
 
 #define bswap16		__builtin_bswap16
 #define bswap32		__builtin_bswap32
+#define bswap64		__builtin_bswap64
 
 #else
 
 u16 bswap16 (u16 usValue);
 u32 bswap32 (u32 ulValue);
+u64 bswap64 (u64 ullValue);
 
 #endif
 
 #define le2be16		bswap16
 #define le2be32		bswap32
+#define le2be64		bswap64
 
 #define be2le16		bswap16
 #define be2le32		bswap32
+#define be2le64		bswap64
 
 #ifdef __cplusplus
 }
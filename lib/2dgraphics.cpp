@@ -0,0 +1,580 @@
+//
+// 2dgraphics.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2020  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/2dgraphics.h>
+#include <circle/sysconfig.h>
+#include <circle/util.h>
+#include <assert.h>
+
+#ifdef SCREEN_DMA_BURST_LENGTH
+	#define DMA_BURST_LENGTH	SCREEN_DMA_BURST_LENGTH
+#else
+	#define DMA_BURST_LENGTH	0
+#endif
+
+// regions larger than this are copied by DMA in whole lines on page flip
+#define DMA_THRESHOLD		0x4000
+
+C2DGraphics::C2DGraphics (unsigned nWidth, unsigned nHeight, boolean bVSync,
+			  unsigned nBuffers, unsigned nDisplay)
+:	m_nInitWidth (nWidth),
+	m_nInitHeight (nHeight),
+	m_bVSync (bVSync),
+	m_nBuffers (nBuffers),
+	m_nDisplay (nDisplay),
+	m_pFrameBuffer (0),
+	m_DMAChannel (DMA_CHANNEL_NORMAL),
+	m_pBufferBase (0),
+	m_nWidth (0),
+	m_nHeight (0),
+	m_nPitch (0),
+	m_nBackBuffer (0)
+{
+	assert (1 <= m_nBuffers && m_nBuffers <= GRAPHICS_MAX_BUFFERS);
+
+	memset (m_Dirty, 0, sizeof m_Dirty);
+}
+
+C2DGraphics::~C2DGraphics (void)
+{
+	m_pBufferBase = 0;
+
+	delete m_pFrameBuffer;
+	m_pFrameBuffer = 0;
+}
+
+boolean C2DGraphics::Initialize (void)
+{
+	m_pFrameBuffer = new CBcmFrameBuffer (m_nInitWidth, m_nInitHeight, DEPTH, 0, 0, m_nDisplay);
+	assert (m_pFrameBuffer != 0);
+
+	if (m_nBuffers > 1)
+	{
+		m_pFrameBuffer->SetVirtualSize (m_pFrameBuffer->GetWidth (),
+						m_pFrameBuffer->GetHeight () * m_nBuffers);
+	}
+
+#if DEPTH == 8
+	m_pFrameBuffer->SetPalette (NORMAL_COLOR, NORMAL_COLOR16);
+	m_pFrameBuffer->SetPalette (HIGH_COLOR,   HIGH_COLOR16);
+	m_pFrameBuffer->SetPalette (HALF_COLOR,   HALF_COLOR16);
+#endif
+
+	if (   !m_pFrameBuffer->Initialize ()
+	    || m_pFrameBuffer->GetDepth () != DEPTH)
+	{
+		return FALSE;
+	}
+
+	m_pBufferBase = (TScreenColor *) (uintptr) m_pFrameBuffer->GetBuffer ();
+	m_nWidth = m_pFrameBuffer->GetWidth ();
+	m_nHeight = m_pFrameBuffer->GetHeight ();
+
+	unsigned nPitch = m_pFrameBuffer->GetPitch ();
+	if (nPitch % sizeof (u32) != 0)
+	{
+		return FALSE;
+	}
+	m_nPitch = nPitch / sizeof (TScreenColor);
+
+	// the firmware may have granted a smaller virtual buffer
+	unsigned nAvailable = m_pFrameBuffer->GetSize () / (nPitch * m_nHeight);
+	if (nAvailable < m_nBuffers)
+	{
+		m_nBuffers = nAvailable > 0 ? nAvailable : 1;
+	}
+
+	if (   m_nBuffers > 1
+	    && !m_pFrameBuffer->SetVirtualOffset (0, 0))
+	{
+		m_nBuffers = 1;
+	}
+
+	// all buffers have the same contents at the beginning
+	memset (m_pBufferBase, 0, m_nBuffers * m_nHeight * nPitch);
+
+	m_nBackBuffer = m_nBuffers > 1 ? 1 : 0;
+
+	return TRUE;
+}
+
+void C2DGraphics::ClearScreen (TScreenColor Color)
+{
+	DrawRect (0, 0, m_nWidth, m_nHeight, Color);
+}
+
+void C2DGraphics::DrawRect (unsigned nX, unsigned nY, unsigned nWidth, unsigned nHeight,
+			    TScreenColor Color)
+{
+	if (!Clip (nX, nY, &nWidth, &nHeight))
+	{
+		return;
+	}
+
+	TScreenColor *pLine = GetBuffer () + nY * m_nPitch + nX;
+	for (unsigned y = 0; y < nHeight; y++)
+	{
+		for (unsigned x = 0; x < nWidth; x++)
+		{
+			pLine[x] = Color;
+		}
+
+		pLine += m_nPitch;
+	}
+
+	MarkDirty (nX, nY, nWidth, nHeight);
+}
+
+void C2DGraphics::DrawRectBlended (unsigned nX, unsigned nY, unsigned nWidth, unsigned nHeight,
+				   TScreenColor Color, u8 uchAlpha)
+{
+	if (!Clip (nX, nY, &nWidth, &nHeight))
+	{
+		return;
+	}
+
+	unsigned nAlpha = uchAlpha + (uchAlpha >> 7);		// 0..256
+
+	TScreenColor *pLine = GetBuffer () + nY * m_nPitch + nX;
+	for (unsigned y = 0; y < nHeight; y++)
+	{
+		for (unsigned x = 0; x < nWidth; x++)
+		{
+			pLine[x] = Blend (Color, pLine[x], nAlpha);
+		}
+
+		pLine += m_nPitch;
+	}
+
+	MarkDirty (nX, nY, nWidth, nHeight);
+}
+
+void C2DGraphics::DrawRectOutline (unsigned nX, unsigned nY, unsigned nWidth, unsigned nHeight,
+				   TScreenColor Color)
+{
+	if (   nWidth == 0
+	    || nHeight == 0)
+	{
+		return;
+	}
+
+	DrawRect (nX, nY, nWidth, 1, Color);
+	DrawRect (nX, nY + nHeight - 1, nWidth, 1, Color);
+	DrawRect (nX, nY, 1, nHeight, Color);
+	DrawRect (nX + nWidth - 1, nY, 1, nHeight, Color);
+}
+
+void C2DGraphics::DrawLine (unsigned nX1, unsigned nY1, unsigned nX2, unsigned nY2,
+			    TScreenColor Color)
+{
+	if (nY1 == nY2)
+	{
+		unsigned nX = nX1 < nX2 ? nX1 : nX2;
+		DrawRect (nX, nY1, (nX1 < nX2 ? nX2 - nX1 : nX1 - nX2) + 1, 1, Color);
+
+		return;
+	}
+
+	if (nX1 == nX2)
+	{
+		unsigned nY = nY1 < nY2 ? nY1 : nY2;
+		DrawRect (nX1, nY, 1, (nY1 < nY2 ? nY2 - nY1 : nY1 - nY2) + 1, Color);
+
+		return;
+	}
+
+	// Bresenham's algorithm
+	int nDeltaX = nX1 < nX2 ? nX2 - nX1 : nX1 - nX2;
+	int nDeltaY = nY1 < nY2 ? nY1 - nY2 : nY2 - nY1;		// negative
+	int nStepX = nX1 < nX2 ? 1 : -1;
+	int nStepY = nY1 < nY2 ? 1 : -1;
+	int nError = nDeltaX + nDeltaY;
+
+	TScreenColor *pBuffer = GetBuffer ();
+	int nX = nX1;
+	int nY = nY1;
+	while (1)
+	{
+		if (   (unsigned) nX < m_nWidth
+		    && (unsigned) nY < m_nHeight)
+		{
+			pBuffer[nY * m_nPitch + nX] = Color;
+		}
+
+		if (   nX == (int) nX2
+		    && nY == (int) nY2)
+		{
+			break;
+		}
+
+		int nError2 = 2 * nError;
+		if (nError2 >= nDeltaY)
+		{
+			nError += nDeltaY;
+			nX += nStepX;
+		}
+
+		if (nError2 <= nDeltaX)
+		{
+			nError += nDeltaX;
+			nY += nStepY;
+		}
+	}
+
+	unsigned nX0 = nX1 < nX2 ? nX1 : nX2;
+	unsigned nY0 = nY1 < nY2 ? nY1 : nY2;
+	MarkDirty (nX0, nY0, nDeltaX + 1, -nDeltaY + 1);
+}
+
+void C2DGraphics::DrawPixel (unsigned nX, unsigned nY, TScreenColor Color)
+{
+	if (   nX < m_nWidth
+	    && nY < m_nHeight)
+	{
+		GetBuffer ()[nY * m_nPitch + nX] = Color;
+
+		MarkDirty (nX, nY, 1, 1);
+	}
+}
+
+void C2DGraphics::DrawImage (unsigned nX, unsigned nY, unsigned nWidth, unsigned nHeight,
+			     const TScreenColor *pPixels)
+{
+	assert (pPixels != 0);
+
+	unsigned nImageWidth = nWidth;
+	if (!Clip (nX, nY, &nWidth, &nHeight))
+	{
+		return;
+	}
+
+	TScreenColor *pLine = GetBuffer () + nY * m_nPitch + nX;
+	for (unsigned y = 0; y < nHeight; y++)
+	{
+		memcpy (pLine, pPixels, nWidth * sizeof (TScreenColor));
+
+		pLine += m_nPitch;
+		pPixels += nImageWidth;
+	}
+
+	MarkDirty (nX, nY, nWidth, nHeight);
+}
+
+void C2DGraphics::DrawImageTransparent (unsigned nX, unsigned nY, unsigned nWidth, unsigned nHeight,
+					const TScreenColor *pPixels, TScreenColor TransparentColor)
+{
+	assert (pPixels != 0);
+
+	unsigned nImageWidth = nWidth;
+	if (!Clip (nX, nY, &nWidth, &nHeight))
+	{
+		return;
+	}
+
+	TScreenColor *pLine = GetBuffer () + nY * m_nPitch + nX;
+	for (unsigned y = 0; y < nHeight; y++)
+	{
+		for (unsigned x = 0; x < nWidth; x++)
+		{
+			if (pPixels[x] != TransparentColor)
+			{
+				pLine[x] = pPixels[x];
+			}
+		}
+
+		pLine += m_nPitch;
+		pPixels += nImageWidth;
+	}
+
+	MarkDirty (nX, nY, nWidth, nHeight);
+}
+
+void C2DGraphics::DrawImageBlended (unsigned nX, unsigned nY, unsigned nWidth, unsigned nHeight,
+				    const TScreenColor *pPixels, u8 uchAlpha)
+{
+	assert (pPixels != 0);
+
+	unsigned nImageWidth = nWidth;
+	if (!Clip (nX, nY, &nWidth, &nHeight))
+	{
+		return;
+	}
+
+	unsigned nAlpha = uchAlpha + (uchAlpha >> 7);		// 0..256
+
+	TScreenColor *pLine = GetBuffer () + nY * m_nPitch + nX;
+	for (unsigned y = 0; y < nHeight; y++)
+	{
+		for (unsigned x = 0; x < nWidth; x++)
+		{
+			pLine[x] = Blend (pPixels[x], pLine[x], nAlpha);
+		}
+
+		pLine += m_nPitch;
+		pPixels += nImageWidth;
+	}
+
+	MarkDirty (nX, nY, nWidth, nHeight);
+}
+
+void C2DGraphics::DrawText (unsigned nX, unsigned nY, TScreenColor Color, const char *pText)
+{
+	assert (pText != 0);
+
+	unsigned nCharWidth = m_CharGen.GetCharWidth ();
+	unsigned nCharHeight = m_CharGen.GetCharHeight ();
+
+	TScreenColor *pBuffer = GetBuffer ();
+	unsigned nPosX = nX;
+	for (; *pText != '\0' && nPosX < m_nWidth; pText++, nPosX += nCharWidth)
+	{
+		for (unsigned y = 0; y < nCharHeight && nY + y < m_nHeight; y++)
+		{
+			TScreenColor *pLine = pBuffer + (nY + y) * m_nPitch + nPosX;
+
+			if (nCharWidth <= 8)
+			{
+				u8 uchLine = m_CharGen.GetPixelLine (*pText, y);
+
+				for (unsigned x = 0; uchLine != 0 && nPosX + x < m_nWidth; x++)
+				{
+					if (uchLine & 0x80)
+					{
+						pLine[x] = Color;
+					}
+
+					uchLine <<= 1;
+				}
+			}
+			else
+			{
+				for (unsigned x = 0; x < nCharWidth && nPosX + x < m_nWidth; x++)
+				{
+					if (m_CharGen.GetPixel (*pText, x, y))
+					{
+						pLine[x] = Color;
+					}
+				}
+			}
+		}
+	}
+
+	MarkDirty (nX, nY, nPosX - nX, nCharHeight);
+}
+
+TScreenColor *C2DGraphics::GetBuffer (void)
+{
+	return GetBufferAddress (m_nBackBuffer);
+}
+
+void C2DGraphics::MarkDirty (unsigned nX, unsigned nY, unsigned nWidth, unsigned nHeight)
+{
+	if (   m_nBuffers <= 1
+	    || !Clip (nX, nY, &nWidth, &nHeight))
+	{
+		return;
+	}
+
+	TRect Rect = {nX, nY, nX + nWidth, nY + nHeight};
+
+	// all other buffers miss this modification now
+	for (unsigned nBuffer = 0; nBuffer < m_nBuffers; nBuffer++)
+	{
+		if (nBuffer != m_nBackBuffer)
+		{
+			AddDirty (nBuffer, Rect);
+		}
+	}
+}
+
+void C2DGraphics::UpdateDisplay (void)
+{
+	assert (m_pFrameBuffer != 0);
+
+	if (m_nBuffers > 1)
+	{
+		m_pFrameBuffer->SetVirtualOffset (0, m_nBackBuffer * m_nHeight);
+	}
+
+	if (m_bVSync)
+	{
+		m_pFrameBuffer->WaitForVerticalSync ();
+	}
+
+	if (m_nBuffers > 1)
+	{
+		unsigned nFrontBuffer = m_nBackBuffer;
+
+		if (++m_nBackBuffer == m_nBuffers)
+		{
+			m_nBackBuffer = 0;
+		}
+
+		SyncBuffer (m_nBackBuffer, nFrontBuffer);
+	}
+}
+
+boolean C2DGraphics::Clip (unsigned nX, unsigned nY, unsigned *pWidth, unsigned *pHeight) const
+{
+	assert (pWidth != 0);
+	assert (pHeight != 0);
+
+	if (   nX >= m_nWidth
+	    || nY >= m_nHeight
+	    || *pWidth == 0
+	    || *pHeight == 0)
+	{
+		return FALSE;
+	}
+
+	if (*pWidth > m_nWidth - nX)
+	{
+		*pWidth = m_nWidth - nX;
+	}
+
+	if (*pHeight > m_nHeight - nY)
+	{
+		*pHeight = m_nHeight - nY;
+	}
+
+	return TRUE;
+}
+
+void C2DGraphics::AddDirty (unsigned nBuffer, const TRect &rRect)
+{
+	assert (nBuffer < GRAPHICS_MAX_BUFFERS);
+	TDirtyList *pList = &m_Dirty[nBuffer];
+
+	for (unsigned i = 0; i < pList->nCount; i++)
+	{
+		TRect *pRect = &pList->Rect[i];
+
+		if (   pRect->nX1 <= rRect.nX1 && rRect.nX2 <= pRect->nX2
+		    && pRect->nY1 <= rRect.nY1 && rRect.nY2 <= pRect->nY2)
+		{
+			return;				// already covered
+		}
+
+		if (   rRect.nX1 <= pRect->nX1 && pRect->nX2 <= rRect.nX2
+		    && rRect.nY1 <= pRect->nY1 && pRect->nY2 <= rRect.nY2)
+		{
+			*pRect = rRect;			// replaces the smaller one
+
+			return;
+		}
+	}
+
+	if (pList->nCount < GRAPHICS_MAX_DIRTY)
+	{
+		pList->Rect[pList->nCount++] = rRect;
+
+		return;
+	}
+
+	// list is full, merge all into the bounding rectangle
+	TRect *pBounds = &pList->Rect[0];
+	for (unsigned i = 1; i <= pList->nCount; i++)
+	{
+		const TRect *pRect = i < pList->nCount ? &pList->Rect[i] : &rRect;
+
+		if (pBounds->nX1 > pRect->nX1) pBounds->nX1 = pRect->nX1;
+		if (pBounds->nY1 > pRect->nY1) pBounds->nY1 = pRect->nY1;
+		if (pBounds->nX2 < pRect->nX2) pBounds->nX2 = pRect->nX2;
+		if (pBounds->nY2 < pRect->nY2) pBounds->nY2 = pRect->nY2;
+	}
+
+	pList->nCount = 1;
+}
+
+// Brings a buffer up to date by copying the regions, which have been modified since it
+// was displayed last, from the buffer, which is currently displayed. Large regions are
+// copied in whole lines by DMA. This may copy pixels outside of the region too, but
+// the displayed buffer is never older than the other buffers.
+
+void C2DGraphics::SyncBuffer (unsigned nToBuffer, unsigned nFromBuffer)
+{
+	assert (nToBuffer < m_nBuffers);
+	assert (nFromBuffer < m_nBuffers);
+	TDirtyList *pList = &m_Dirty[nToBuffer];
+
+	TScreenColor *pTo = GetBufferAddress (nToBuffer);
+	const TScreenColor *pFrom = GetBufferAddress (nFromBuffer);
+
+	for (unsigned i = 0; i < pList->nCount; i++)
+	{
+		const TRect *pRect = &pList->Rect[i];
+
+		unsigned nOffset = pRect->nY1 * m_nPitch;
+		unsigned nLines = pRect->nY2 - pRect->nY1;
+		unsigned nWidth = pRect->nX2 - pRect->nX1;
+
+		if (nWidth * nLines * sizeof (TScreenColor) > DMA_THRESHOLD)
+		{
+			m_DMAChannel.SetupMemCopy (pTo + nOffset, pFrom + nOffset,
+						   nLines * m_nPitch * sizeof (TScreenColor),
+						   DMA_BURST_LENGTH, FALSE);
+
+			m_DMAChannel.Start ();
+			m_DMAChannel.Wait ();
+		}
+		else
+		{
+			nOffset += pRect->nX1;
+
+			for (unsigned y = 0; y < nLines; y++)
+			{
+				memcpy (pTo + nOffset, pFrom + nOffset, nWidth * sizeof (TScreenColor));
+
+				nOffset += m_nPitch;
+			}
+		}
+	}
+
+	pList->nCount = 0;
+}
+
+// The color components are blended in parallel. They are spread apart in a 32-bit
+// word, so that there is room for the intermediate results.
+
+TScreenColor C2DGraphics::Blend (TScreenColor Foreground, TScreenColor Background,
+				 unsigned nAlpha)
+{
+	assert (nAlpha <= 256);
+
+#if DEPTH == 8
+	return nAlpha >= 128 ? Foreground : Background;
+#elif DEPTH == 16
+	u32 nFG = (Foreground | (u32) Foreground << 16) & 0x07E0F81F;
+	u32 nBG = (Background | (u32) Background << 16) & 0x07E0F81F;
+
+	u32 nResult = ((((nFG - nBG) * (nAlpha >> 3)) >> 5) + nBG) & 0x07E0F81F;
+
+	return (TScreenColor) (nResult | nResult >> 16);
+#else
+	u32 nFG_RB = Foreground & 0x00FF00FF;
+	u32 nBG_RB = Background & 0x00FF00FF;
+	u32 nFG_GA = (Foreground >> 8) & 0x00FF00FF;
+	u32 nBG_GA = (Background >> 8) & 0x00FF00FF;
+
+	u32 nRB = ((((nFG_RB - nBG_RB) * nAlpha) >> 8) + nBG_RB) & 0x00FF00FF;
+	u32 nGA = ((((nFG_GA - nBG_GA) * nAlpha) >> 8) + nBG_GA) & 0x00FF00FF;
+
+	return nRB | nGA << 8;
+#endif
+}
@@ -25,7 +25,7 @@
 
 void *malloc (size_t nSize)
 {
-	return CMemorySystem::HeapAllocate (nSize, HEAP_DEFAULT_MALLOC);
+	return CMemorySystem::HeapAllocate (nSize, HEAP_DEFAULT_MALLOC, HEAP_CALLER);
 }
 
 void free (void *pBlock)
@@ -42,7 +42,7 @@ void *calloc (size_t nBlocks, size_t nSize)
 	}
 	assert (nSize >= nBlocks);
 
-	void *pNewBlock = CMemorySystem::HeapAllocate (nSize, HEAP_DEFAULT_MALLOC);
+	void *pNewBlock = CMemorySystem::HeapAllocate (nSize, HEAP_DEFAULT_MALLOC, HEAP_CALLER);
 	if (pNewBlock != 0)
 	{
 		memset (pNewBlock, 0, nSize);
@@ -53,12 +53,12 @@ void *calloc (size_t nBlocks, size_t nSize)
 
 void *realloc (void *pBlock, size_t nSize)
 {
-	return CMemorySystem::HeapReAllocate (pBlock, nSize);
+	return CMemorySystem::HeapReAllocate (pBlock, nSize, HEAP_CALLER);
 }
 
 void *palloc (void)
 {
-	return CMemorySystem::PageAllocate ();
+	return CMemorySystem::PageAllocate (HEAP_CALLER);
 }
 
 void pfree (void *pPage)
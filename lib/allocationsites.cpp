@@ -0,0 +1,175 @@
+//
+// allocationsites.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2020  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/allocationsites.h>
+#include <circle/logger.h>
+#include <circle/util.h>
+#include <assert.h>
+
+#define HASH_MULTIPLIER		2654435761U
+#define HASH_BITS		8		// log2 (ALLOCATION_SITES)
+
+#if (1 << HASH_BITS) != ALLOCATION_SITES
+	#error HASH_BITS does not match ALLOCATION_SITES
+#endif
+
+CAllocationSites::CAllocationSites (void)
+:	m_pSite (0)
+{
+	memset (&m_Other, 0, sizeof m_Other);
+}
+
+CAllocationSites::~CAllocationSites (void)
+{
+	m_pSite = 0;
+}
+
+void CAllocationSites::Setup (void *pTable)
+{
+	assert (pTable != 0);
+	m_pSite = (TAllocationSite *) pTable;
+
+	memset (m_pSite, 0, GetTableSize ());
+}
+
+void CAllocationSites::Add (uintptr nCaller, size_t nBytes)
+{
+	TAllocationSite *pSite = Lookup (nCaller, TRUE);
+	assert (pSite != 0);
+
+	pSite->nBytes += nBytes;
+	pSite->nBlocks++;
+}
+
+void CAllocationSites::Remove (uintptr nCaller, size_t nBytes)
+{
+	TAllocationSite *pSite = Lookup (nCaller, FALSE);
+	assert (pSite != 0);
+
+	if (pSite->nBlocks > 0)
+	{
+		assert (pSite->nBytes >= nBytes);
+		pSite->nBytes -= nBytes;
+		pSite->nBlocks--;
+	}
+}
+
+void CAllocationSites::Snapshot (TAllocationSite *pBuffer) const
+{
+	assert (pBuffer != 0);
+
+	if (m_pSite != 0)
+	{
+		memcpy (pBuffer, m_pSite, GetTableSize ());
+	}
+	else
+	{
+		memset (pBuffer, 0, GetTableSize ());
+	}
+
+	pBuffer[ALLOCATION_SITES] = m_Other;
+}
+
+void CAllocationSites::Report (const char *pSource, TAllocationSite *pSnapshot,
+			       CDevice *pTarget, unsigned nMaxSites)
+{
+	assert (pSnapshot != 0);
+
+	// insertion sort by live bytes, largest first
+	for (unsigned i = 1; i < ALLOCATION_SITES+1; i++)
+	{
+		TAllocationSite Site = pSnapshot[i];
+
+		unsigned j;
+		for (j = i; j > 0 && pSnapshot[j-1].nBytes < Site.nBytes; j--)
+		{
+			pSnapshot[j] = pSnapshot[j-1];
+		}
+
+		pSnapshot[j] = Site;
+	}
+
+	size_t nOtherBytes = 0;
+	unsigned nOtherBlocks = 0;
+	for (unsigned i = 0; i < ALLOCATION_SITES+1 && pSnapshot[i].nBlocks > 0; i++)
+	{
+		if (i < nMaxSites)
+		{
+			if (pSnapshot[i].nCaller != 0)
+			{
+				CLogger::WriteTo (pTarget, pSource, "%8lu bytes in %5u blocks from 0x%lX",
+						  (unsigned long) pSnapshot[i].nBytes, pSnapshot[i].nBlocks,
+						  (unsigned long) pSnapshot[i].nCaller);
+			}
+			else
+			{
+				CLogger::WriteTo (pTarget, pSource, "%8lu bytes in %5u blocks from untracked sites",
+						  (unsigned long) pSnapshot[i].nBytes, pSnapshot[i].nBlocks);
+			}
+		}
+		else
+		{
+			nOtherBytes += pSnapshot[i].nBytes;
+			nOtherBlocks += pSnapshot[i].nBlocks;
+		}
+	}
+
+	if (nOtherBlocks > 0)
+	{
+		CLogger::WriteTo (pTarget, pSource, "%8lu bytes in %5u blocks from other sites",
+				  (unsigned long) nOtherBytes, nOtherBlocks);
+	}
+}
+
+TAllocationSite *CAllocationSites::Lookup (uintptr nCaller, boolean bInsert)
+{
+	if (   nCaller == 0
+	    || m_pSite == 0)
+	{
+		return &m_Other;
+	}
+
+	// Fibonacci hashing, the upper bits of the product depend on all bits of the key
+	unsigned nIndex = ((u32) (nCaller >> 2) * HASH_MULTIPLIER) >> (32 - HASH_BITS);
+	for (unsigned i = 0; i < ALLOCATION_SITES; i++)
+	{
+		TAllocationSite *pSite = &m_pSite[nIndex];
+
+		if (pSite->nCaller == nCaller)
+		{
+			return pSite;
+		}
+
+		if (pSite->nCaller == 0)
+		{
+			if (!bInsert)
+			{
+				break;
+			}
+
+			pSite->nCaller = nCaller;
+
+			return pSite;
+		}
+
+		nIndex = (nIndex + 1) & (ALLOCATION_SITES-1);
+	}
+
+	return &m_Other;
+}
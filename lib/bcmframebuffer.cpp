@@ -19,6 +19,7 @@
 //
 #include <circle/bcmframebuffer.h>
 #include <circle/util.h>
+#include <assert.h>
 
 const TBcmFrameBufferInitTags CBcmFrameBuffer::s_InitTags =
 {
@@ -138,6 +139,17 @@ void CBcmFrameBuffer::SetPalette32 (u8 nIndex, u32 nRGBA)
 	}
 }
 
+void CBcmFrameBuffer::SetVirtualSize (unsigned nVirtualWidth, unsigned nVirtualHeight)
+{
+	assert (m_nBufferPtr == 0);
+
+	m_nVirtualWidth  = nVirtualWidth;
+	m_nVirtualHeight = nVirtualHeight;
+
+	m_InitTags.SetVirtWidthHeight.nWidth  = m_nVirtualWidth;
+	m_InitTags.SetVirtWidthHeight.nHeight = m_nVirtualHeight;
+}
+
 boolean CBcmFrameBuffer::Initialize (void)
 {
 	if (m_nDisplay >= GetNumDisplays ())
@@ -2,7 +2,7 @@
 // chargenerator.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2014  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2014-2020  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -92,3 +92,42 @@ boolean CCharGenerator::GetPixel (char chAscii, unsigned nPosX, unsigned nPosY)
 	return font_data[nIndex][nPosY] & (0x80 >> nPosX) ? TRUE : FALSE;
 #endif
 }
+
+u8 CCharGenerator::GetPixelLine (char chAscii, unsigned nPosY) const
+{
+	assert (m_nCharWidth <= 8);
+
+	unsigned nAscii = (u8) chAscii;
+	if (   nAscii < FIRSTCHAR
+	    || nAscii > LASTCHAR)
+	{
+		return 0;
+	}
+
+	unsigned nIndex = nAscii - FIRSTCHAR;
+	assert (nIndex < CHARCOUNT);
+
+#ifdef GIMP_HEADER
+	assert (nPosY < height);
+	unsigned nOffset = nPosY * width + nIndex * m_nCharWidth;
+
+	u8 uchLine = 0;
+	for (unsigned nPosX = 0; nPosX < m_nCharWidth; nPosX++)
+	{
+		assert (nOffset + nPosX < sizeof header_data / sizeof header_data[0]);
+		if (header_data[nOffset + nPosX])
+		{
+			uchLine |= 0x80 >> nPosX;
+		}
+	}
+
+	return uchLine;
+#else
+	if (nPosY >= height)
+	{
+		return 0;
+	}
+
+	return font_data[nIndex][nPosY];
+#endif
+}
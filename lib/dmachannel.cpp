@@ -62,6 +62,7 @@
 	#define TXFR_LEN_YLENGTH_SHIFT		16
 	#define TXFR_LEN_MAX			0x3FFFFFFF
 	#define TXFR_LEN_MAX_LITE		0xFFFF
+	#define LEN4_XLENGTH_MAX		0x3FFFFFFF	// DMA4 channel
 #define ARM_DMACHAN_STRIDE(chan)	(ARM_DMA_BASE + ((chan) * 0x100) + 0x18)
 	#define STRIDE_SRC_SHIFT		0
 	#define STRIDE_DEST_SHIFT		16
@@ -75,6 +76,12 @@ CDMAChannel::CDMAChannel (unsigned nChannel, CInterruptSystem *pInterruptSystem)
 :	m_nChannel (CMachineInfo::Get ()->AllocateDMAChannel (nChannel)),
 	m_pControlBlockBuffer (0),
 	m_pControlBlock (0),
+	m_pChainBuffer (0),
+	m_pChain (0),
+	m_nChainSize (0),
+	m_nChainLength (0),
+	m_bChain (FALSE),
+	m_nChainBurstLength (0),
 	m_pInterruptSystem (pInterruptSystem),
 	m_bIRQConnected (FALSE),
 	m_pCompletionRoutine (0),
@@ -165,6 +172,11 @@ CDMAChannel::~CDMAChannel (void)
 
 	CMachineInfo::Get ()->FreeDMAChannel (m_nChannel);
 
+	m_pChain = 0;
+
+	delete [] m_pChainBuffer;
+	m_pChainBuffer = 0;
+
 	m_pControlBlock = 0;
 
 	delete [] m_pControlBlockBuffer;
@@ -204,6 +216,8 @@ void CDMAChannel::SetupMemCopy (void *pDestination, const void *pSource, size_t
 	m_pControlBlock->n2DModeStride            = 0;
 	m_pControlBlock->nNextControlBlockAddress = 0;
 
+	m_bChain = FALSE;
+
 	if (bCached)
 	{
 		m_nDestinationAddress = (uintptr) pDestination;
@@ -252,6 +266,8 @@ void CDMAChannel::SetupIORead (void *pDestination, u32 nIOAddress, size_t nLengt
 	m_pControlBlock->n2DModeStride            = 0;
 	m_pControlBlock->nNextControlBlockAddress = 0;
 
+	m_bChain = FALSE;
+
 	m_nDestinationAddress = (uintptr) pDestination;
 	m_nBufferLength = nLength;
 
@@ -292,6 +308,8 @@ void CDMAChannel::SetupIOWrite (u32 nIOAddress, const void *pSource, size_t nLen
 	m_pControlBlock->n2DModeStride            = 0;
 	m_pControlBlock->nNextControlBlockAddress = 0;
 
+	m_bChain = FALSE;
+
 	m_nDestinationAddress = 0;
 
 	CleanAndInvalidateDataCacheRange ((uintptr) pSource, nLength);
@@ -337,11 +355,167 @@ void CDMAChannel::SetupMemCopy2D (void *pDestination, const void *pSource,
 	m_pControlBlock->n2DModeStride            = nBlockStride << STRIDE_DEST_SHIFT;
 	m_pControlBlock->nNextControlBlockAddress = 0;
 
+	m_bChain = FALSE;
+
 	m_nDestinationAddress = 0;
 
 	CleanAndInvalidateDataCacheRange ((uintptr) pSource, nBlockLength*nBlockCount);
 }
 
+void CDMAChannel::SetupMemCopy2DChain (unsigned nMaxCopies, unsigned nBurstLength)
+{
+#if RASPPI >= 4
+	assert (m_pDMA4Channel == 0);
+#endif
+
+	assert (!(read32 (ARM_DMACHAN_DEBUG (m_nChannel)) & DEBUG_LITE));
+
+	AllocateChain (nMaxCopies, nBurstLength);
+}
+
+boolean CDMAChannel::AddMemCopy2D (void *pDestination, const void *pSource,
+				   size_t nBlockLength, unsigned nBlockCount,
+				   size_t nDestinationStride, size_t nSourceStride)
+{
+	assert (pDestination != 0);
+	assert (pSource != 0);
+	assert (nBlockLength > 0);
+	assert (nBlockLength <= 0xFFFF);
+	assert (nBlockCount > 0);
+	assert (nBlockCount <= 0x3FFF);
+	assert (nDestinationStride <= 0x7FFF);		// strides are signed 16-bit values
+	assert (nSourceStride <= 0x7FFF);
+
+	assert (m_pChain != 0);
+	if (m_nChainLength >= m_nChainSize)
+	{
+		return FALSE;
+	}
+
+	TDMAControlBlock *pControlBlock = &m_pChain[m_nChainLength];
+
+	pControlBlock->nTransferInformation     =   (m_nChainBurstLength << TI_BURST_LENGTH_SHIFT)
+						  | TI_SRC_WIDTH
+						  | TI_SRC_INC
+						  | TI_DEST_WIDTH
+						  | TI_DEST_INC
+						  | TI_TDMODE;
+	pControlBlock->nSourceAddress           = BUS_ADDRESS ((uintptr) pSource);
+	pControlBlock->nDestinationAddress      = BUS_ADDRESS ((uintptr) pDestination);
+	pControlBlock->nTransferLength          =   ((nBlockCount-1) << TXFR_LEN_YLENGTH_SHIFT)
+						  | (nBlockLength << TXFR_LEN_XLENGTH_SHIFT);
+	pControlBlock->n2DModeStride            =   (nDestinationStride << STRIDE_DEST_SHIFT)
+						  | (nSourceStride << STRIDE_SRC_SHIFT);
+	pControlBlock->nNextControlBlockAddress = 0;
+
+	if (m_nChainLength > 0)
+	{
+		m_pChain[m_nChainLength-1].nNextControlBlockAddress =
+			BUS_ADDRESS ((uintptr) pControlBlock);
+	}
+
+	m_nChainLength++;
+
+	CleanAndInvalidateDataCacheRange ((uintptr) pSource,
+					    (nBlockLength + nSourceStride) * (nBlockCount-1)
+					  + nBlockLength);
+
+	return TRUE;
+}
+
+void CDMAChannel::SetupMemCopyChain (unsigned nMaxCopies, unsigned nBurstLength)
+{
+#if RASPPI >= 4
+	assert (m_pDMA4Channel == 0);
+#endif
+
+	AllocateChain (nMaxCopies, nBurstLength);
+}
+
+boolean CDMAChannel::AddMemCopy (void *pDestination, const void *pSource, size_t nLength)
+{
+	assert (pDestination != 0);
+	assert (pSource != 0);
+	assert (nLength > 0);
+	assert (nLength <= GetMaxCopyLength ());
+
+	assert (m_pChain != 0);
+	if (m_nChainLength >= m_nChainSize)
+	{
+		return FALSE;
+	}
+
+	TDMAControlBlock *pControlBlock = &m_pChain[m_nChainLength];
+
+	pControlBlock->nTransferInformation     =   (m_nChainBurstLength << TI_BURST_LENGTH_SHIFT)
+						  | TI_SRC_WIDTH
+						  | TI_SRC_INC
+						  | TI_DEST_WIDTH
+						  | TI_DEST_INC;
+	pControlBlock->nSourceAddress           = BUS_ADDRESS ((uintptr) pSource);
+	pControlBlock->nDestinationAddress      = BUS_ADDRESS ((uintptr) pDestination);
+	pControlBlock->nTransferLength          = nLength;
+	pControlBlock->n2DModeStride            = 0;
+	pControlBlock->nNextControlBlockAddress = 0;
+
+	if (m_nChainLength > 0)
+	{
+		m_pChain[m_nChainLength-1].nNextControlBlockAddress =
+			BUS_ADDRESS ((uintptr) pControlBlock);
+	}
+
+	m_nChainLength++;
+
+	CleanAndInvalidateDataCacheRange ((uintptr) pSource, nLength);
+	CleanAndInvalidateDataCacheRange ((uintptr) pDestination, nLength);
+
+	return TRUE;
+}
+
+size_t CDMAChannel::GetMaxCopyLength (void) const
+{
+#if RASPPI >= 4
+	if (m_pDMA4Channel != 0)
+	{
+		return LEN4_XLENGTH_MAX;
+	}
+#endif
+
+	assert (m_nChannel < DMA_CHANNELS);
+
+	return   read32 (ARM_DMACHAN_DEBUG (m_nChannel)) & DEBUG_LITE
+	       ? TXFR_LEN_MAX_LITE : TXFR_LEN_MAX;
+}
+
+void CDMAChannel::AllocateChain (unsigned nMaxCopies, unsigned nBurstLength)
+{
+	assert (nMaxCopies > 0);
+	assert (nBurstLength <= 15);
+
+	if (nMaxCopies > m_nChainSize)
+	{
+		delete [] m_pChainBuffer;
+
+		m_pChainBuffer = new (HEAP_DMA30) u8[nMaxCopies * sizeof (TDMAControlBlock) + 31];
+		assert (m_pChainBuffer != 0);
+
+		m_pChain = (TDMAControlBlock *) (((uintptr) m_pChainBuffer + 31) & ~31);
+		m_nChainSize = nMaxCopies;
+
+		for (unsigned i = 0; i < m_nChainSize; i++)
+		{
+			m_pChain[i].nReserved[0] = 0;
+			m_pChain[i].nReserved[1] = 0;
+		}
+	}
+
+	m_nChainLength = 0;
+	m_nChainBurstLength = nBurstLength;
+	m_bChain = TRUE;
+
+	m_nDestinationAddress = 0;
+}
+
 void CDMAChannel::SetCompletionRoutine (TDMACompletionRoutine *pRoutine, void *pParam)
 {
 #if RASPPI >= 4
@@ -383,11 +557,21 @@ void CDMAChannel::Start (void)
 	assert (m_nChannel < DMA_CHANNELS);
 	assert (m_pControlBlock != 0);
 
+	TDMAControlBlock *pControlBlock = m_pControlBlock;
+	unsigned nControlBlocks = 1;
+	if (m_bChain)
+	{
+		assert (m_pChain != 0);
+		assert (m_nChainLength > 0);
+		pControlBlock = m_pChain;
+		nControlBlocks = m_nChainLength;
+	}
+
 	if (m_pCompletionRoutine != 0)
 	{
 		assert (m_pInterruptSystem != 0);
 		assert (m_bIRQConnected);
-		m_pControlBlock->nTransferInformation |= TI_INTEN;
+		pControlBlock[nControlBlocks-1].nTransferInformation |= TI_INTEN;
 	}
 
 	PeripheralEntry ();
@@ -395,9 +579,10 @@ void CDMAChannel::Start (void)
 	assert (!(read32 (ARM_DMACHAN_CS (m_nChannel)) & CS_INT));
 	assert (!(read32 (ARM_DMA_INT_STATUS) & (1 << m_nChannel)));
 
-	write32 (ARM_DMACHAN_CONBLK_AD (m_nChannel), BUS_ADDRESS ((uintptr) m_pControlBlock));
+	write32 (ARM_DMACHAN_CONBLK_AD (m_nChannel), BUS_ADDRESS ((uintptr) pControlBlock));
 
-	CleanAndInvalidateDataCacheRange ((uintptr) m_pControlBlock, sizeof *m_pControlBlock);
+	CleanAndInvalidateDataCacheRange ((uintptr) pControlBlock,
+					  nControlBlocks * sizeof *pControlBlock);
 
 	write32 (ARM_DMACHAN_CS (m_nChannel),   CS_WAIT_FOR_OUTSTANDING_WRITES
 					      | (DEFAULT_PANIC_PRIORITY << CS_PANIC_PRIORITY_SHIFT)
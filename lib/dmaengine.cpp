@@ -0,0 +1,472 @@
+//
+// dmaengine.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2020  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/dmaengine.h>
+#include <circle/machineinfo.h>
+#include <circle/synchronize.h>
+#include <circle/logger.h>
+#include <circle/util.h>
+#include <assert.h>
+
+#define MAX_LENGTH_ALIGN	32		// split long segments at cache line boundaries
+
+static const char FromDMAEngine[] = "dmaeng";
+
+CDMARequest::CDMARequest (void)
+:	m_nSegments (0),
+	m_pCompletionRoutine (0),
+	m_pCompletionParam (0),
+	m_bDone (TRUE),
+	m_bStatus (FALSE),
+	m_nNextSegment (0),
+	m_nNextOffset (0),
+	m_pNext (0)
+{
+}
+
+CDMARequest::~CDMARequest (void)
+{
+	assert (m_bDone);
+
+	m_pCompletionRoutine = 0;
+}
+
+void CDMARequest::Reset (void)
+{
+	assert (m_bDone);
+
+	m_nSegments = 0;
+	m_pCompletionRoutine = 0;
+	m_pCompletionParam = 0;
+}
+
+boolean CDMARequest::AddCopy (void *pDestination, const void *pSource, size_t nLength)
+{
+	assert (m_bDone);
+	assert (pDestination != 0);
+	assert (pSource != 0);
+	assert (nLength > 0);
+
+	if (m_nSegments >= DMA_ENGINE_MAX_SEGMENTS)
+	{
+		return FALSE;
+	}
+
+	TSegment *pSegment = &m_Segment[m_nSegments++];
+
+	pSegment->pDestination = (u8 *) pDestination;
+	pSegment->pSource = (const u8 *) pSource;
+	pSegment->nLength = nLength;
+
+	return TRUE;
+}
+
+void CDMARequest::SetCompletionRoutine (TDMARequestCompletionRoutine *pRoutine, void *pParam)
+{
+	assert (m_bDone);
+
+	m_pCompletionRoutine = pRoutine;
+	m_pCompletionParam = pParam;
+}
+
+size_t CDMARequest::GetLength (void) const
+{
+	size_t nLength = 0;
+	for (unsigned i = 0; i < m_nSegments; i++)
+	{
+		nLength += m_Segment[i].nLength;
+	}
+
+	return nLength;
+}
+
+CDMAEngine *CDMAEngine::s_pThis = 0;
+
+CDMAEngine::CDMAEngine (CInterruptSystem *pInterruptSystem, unsigned nChannels,
+			boolean bPreferExtended, unsigned nBurstLength)
+:	m_pInterruptSystem (pInterruptSystem),
+	m_nMaxChannels (nChannels),
+	m_bPreferExtended (bPreferExtended),
+	m_nBurstLength (nBurstLength),
+	m_nChannels (0),
+	m_pQueueHead (0),
+	m_pQueueTail (0),
+	m_nRequests (0),
+	m_nQueued (0),
+	m_nErrors (0),
+	m_SpinLock (IRQ_LEVEL)
+{
+	assert (s_pThis == 0);
+	s_pThis = this;
+
+	assert (m_pInterruptSystem != 0);
+	assert (0 < m_nMaxChannels && m_nMaxChannels <= DMA_ENGINE_MAX_CHANNELS);
+	assert (m_nBurstLength <= 15);
+}
+
+CDMAEngine::~CDMAEngine (void)
+{
+	assert (m_pQueueHead == 0);
+
+	for (unsigned i = 0; i < m_nChannels; i++)
+	{
+		assert (m_Channel[i].pRequest == 0);
+
+		delete m_Channel[i].pChannel;
+		m_Channel[i].pChannel = 0;
+	}
+
+	m_nChannels = 0;
+
+	m_pInterruptSystem = 0;
+
+	s_pThis = 0;
+}
+
+boolean CDMAEngine::Initialize (void)
+{
+	static const unsigned Types[] =
+	{
+#if RASPPI >= 4
+		DMA_CHANNEL_EXTENDED,
+#endif
+		DMA_CHANNEL_NORMAL,
+		DMA_CHANNEL_LITE
+	};
+
+	CMachineInfo *pMachineInfo = CMachineInfo::Get ();
+	assert (pMachineInfo != 0);
+
+	for (unsigned i = 0; i < sizeof Types / sizeof Types[0]; i++)
+	{
+#if RASPPI >= 4
+		if (   Types[i] == DMA_CHANNEL_EXTENDED
+		    && !m_bPreferExtended)
+		{
+			continue;
+		}
+#endif
+
+		while (m_nChannels < m_nMaxChannels)
+		{
+			// probe for a free channel of this type, CDMAChannel asserts success
+			unsigned nChannel = pMachineInfo->AllocateDMAChannel (Types[i]);
+			if (nChannel == DMA_CHANNEL_NONE)
+			{
+				break;
+			}
+
+			pMachineInfo->FreeDMAChannel (nChannel);
+
+			TChannel *pChannel = &m_Channel[m_nChannels];
+
+			pChannel->pThis = this;
+			pChannel->pChannel = new CDMAChannel (nChannel, m_pInterruptSystem);
+			assert (pChannel->pChannel != 0);
+#if RASPPI >= 4
+			pChannel->bExtended = nChannel >= DMA_CHANNEL_EXT_MIN;
+#else
+			pChannel->bExtended = FALSE;
+#endif
+			pChannel->nMaxLength =   pChannel->pChannel->GetMaxCopyLength ()
+					       & ~(MAX_LENGTH_ALIGN-1);
+			pChannel->pRequest = 0;
+
+			pChannel->pChannel->SetCompletionRoutine (CompletionStub, pChannel);
+
+			m_nChannels++;
+		}
+	}
+
+	if (m_nChannels == 0)
+	{
+		CLogger::Get ()->Write (FromDMAEngine, LogError, "No DMA channel available");
+
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+boolean CDMAEngine::Submit (CDMARequest *pRequest)
+{
+	assert (pRequest != 0);
+	assert (pRequest->m_bDone);
+
+	if (   pRequest->m_nSegments == 0
+	    || m_nChannels == 0)
+	{
+		return FALSE;
+	}
+
+	pRequest->m_bDone = FALSE;
+	pRequest->m_bStatus = FALSE;
+	pRequest->m_nNextSegment = 0;
+	pRequest->m_nNextOffset = 0;
+	pRequest->m_pNext = 0;
+
+	m_SpinLock.Acquire ();
+
+	TChannel *pChannel = 0;
+	for (unsigned i = 0; i < m_nChannels; i++)
+	{
+		if (m_Channel[i].pRequest == 0)
+		{
+			pChannel = &m_Channel[i];
+			pChannel->pRequest = pRequest;
+
+			break;
+		}
+	}
+
+	if (pChannel == 0)
+	{
+		if (m_pQueueTail != 0)
+		{
+			m_pQueueTail->m_pNext = pRequest;
+		}
+		else
+		{
+			m_pQueueHead = pRequest;
+		}
+
+		m_pQueueTail = pRequest;
+
+		m_nQueued++;
+	}
+
+	m_SpinLock.Release ();
+
+	if (pChannel != 0)
+	{
+		StartTransfer (pChannel);
+	}
+
+	return TRUE;
+}
+
+boolean CDMAEngine::Wait (CDMARequest *pRequest)
+{
+	assert (pRequest != 0);
+
+	while (!pRequest->m_bDone)
+	{
+		// do nothing
+	}
+
+	DataMemBarrier ();
+
+	return pRequest->m_bStatus;
+}
+
+void *CDMAEngine::MemCopy (void *pDestination, const void *pSource, size_t nLength)
+{
+	if (   nLength < DMA_ENGINE_MIN_COPY
+	    || m_nChannels == 0)
+	{
+		return memcpy (pDestination, pSource, nLength);
+	}
+
+	CDMARequest Request;
+	Request.AddCopy (pDestination, pSource, nLength);
+
+	if (   !Submit (&Request)
+	    || !Wait (&Request))
+	{
+		memcpy (pDestination, pSource, nLength);
+	}
+
+	return pDestination;
+}
+
+boolean CDMAEngine::MemCopyAsync (CDMARequest *pRequest,
+				  void *pDestination, const void *pSource, size_t nLength,
+				  TDMARequestCompletionRoutine *pRoutine, void *pParam)
+{
+	assert (pRequest != 0);
+
+	pRequest->Reset ();
+	pRequest->SetCompletionRoutine (pRoutine, pParam);
+
+	if (   nLength >= DMA_ENGINE_MIN_COPY
+	    && m_nChannels > 0)
+	{
+		pRequest->AddCopy (pDestination, pSource, nLength);
+
+		return Submit (pRequest);
+	}
+
+	memcpy (pDestination, pSource, nLength);
+
+	pRequest->m_bStatus = TRUE;
+
+	if (pRoutine != 0)
+	{
+		(*pRoutine) (pRequest, TRUE, pParam);
+	}
+
+	return TRUE;
+}
+
+CDMAEngine *CDMAEngine::Get (void)
+{
+	return s_pThis;
+}
+
+// Starts the next part of the active request of a channel. Normal and lite channels
+// execute as many segments as fit into the control block chain with one start. DMA4
+// channels are started for each segment. Segments, which are longer than the maximum
+// transfer length of the channel, are split.
+
+void CDMAEngine::StartTransfer (TChannel *pChannel)
+{
+	assert (pChannel != 0);
+	CDMARequest *pRequest = pChannel->pRequest;
+	assert (pRequest != 0);
+	CDMAChannel *pDMAChannel = pChannel->pChannel;
+	assert (pDMAChannel != 0);
+
+	unsigned nControlBlocks = pChannel->bExtended ? 1 : DMA_ENGINE_CHAIN_LENGTH;
+	if (!pChannel->bExtended)
+	{
+		pDMAChannel->SetupMemCopyChain (DMA_ENGINE_CHAIN_LENGTH, m_nBurstLength);
+	}
+
+	while (   nControlBlocks > 0
+	       && pRequest->m_nNextSegment < pRequest->m_nSegments)
+	{
+		const CDMARequest::TSegment *pSegment =
+			&pRequest->m_Segment[pRequest->m_nNextSegment];
+
+		size_t nOffset = pRequest->m_nNextOffset;
+		size_t nLength = pSegment->nLength - nOffset;
+		if (nLength > pChannel->nMaxLength)
+		{
+			nLength = pChannel->nMaxLength;
+		}
+
+		if (pChannel->bExtended)
+		{
+			pDMAChannel->SetupMemCopy (pSegment->pDestination + nOffset,
+						   pSegment->pSource + nOffset,
+						   nLength, m_nBurstLength, TRUE);
+		}
+		else
+		{
+			boolean bOK = pDMAChannel->AddMemCopy (pSegment->pDestination + nOffset,
+							       pSegment->pSource + nOffset, nLength);
+			assert (bOK);
+			(void) bOK;
+		}
+
+		nControlBlocks--;
+
+		nOffset += nLength;
+		if (nOffset < pSegment->nLength)
+		{
+			pRequest->m_nNextOffset = nOffset;
+		}
+		else
+		{
+			pRequest->m_nNextSegment++;
+			pRequest->m_nNextOffset = 0;
+		}
+	}
+
+	pDMAChannel->Start ();
+}
+
+void CDMAEngine::CompleteRequest (CDMARequest *pRequest, boolean bStatus)
+{
+	assert (pRequest != 0);
+
+	// the destination may have been loaded into the cache (speculatively) meanwhile
+	for (unsigned i = 0; i < pRequest->m_nSegments; i++)
+	{
+		CleanAndInvalidateDataCacheRange ((uintptr) pRequest->m_Segment[i].pDestination,
+						  pRequest->m_Segment[i].nLength);
+	}
+
+	m_nRequests++;
+	if (!bStatus)
+	{
+		m_nErrors++;
+	}
+
+	TDMARequestCompletionRoutine *pRoutine = pRequest->m_pCompletionRoutine;
+	void *pParam = pRequest->m_pCompletionParam;
+
+	// the request may be re-used by the waiting side after this
+	pRequest->m_bStatus = bStatus;
+	DataMemBarrier ();
+	pRequest->m_bDone = TRUE;
+
+	if (pRoutine != 0)
+	{
+		(*pRoutine) (pRequest, bStatus, pParam);
+	}
+}
+
+void CDMAEngine::CompletionRoutine (TChannel *pChannel, boolean bStatus)
+{
+	assert (pChannel != 0);
+	CDMARequest *pRequest = pChannel->pRequest;
+	assert (pRequest != 0);
+
+	if (   bStatus
+	    && pRequest->m_nNextSegment < pRequest->m_nSegments)
+	{
+		StartTransfer (pChannel);
+
+		return;
+	}
+
+	m_SpinLock.Acquire ();
+
+	CDMARequest *pNextRequest = m_pQueueHead;
+	if (pNextRequest != 0)
+	{
+		m_pQueueHead = pNextRequest->m_pNext;
+		if (m_pQueueHead == 0)
+		{
+			m_pQueueTail = 0;
+		}
+	}
+
+	pChannel->pRequest = pNextRequest;
+
+	m_SpinLock.Release ();
+
+	// keep the channel busy, before the completion routine is called
+	if (pNextRequest != 0)
+	{
+		StartTransfer (pChannel);
+	}
+
+	CompleteRequest (pRequest, bStatus);
+}
+
+void CDMAEngine::CompletionStub (unsigned nChannel, boolean bStatus, void *pParam)
+{
+	TChannel *pChannel = (TChannel *) pParam;
+	assert (pChannel != 0);
+	assert (pChannel->pThis != 0);
+
+	pChannel->pThis->CompletionRoutine (pChannel, bStatus);
+}
@@ -22,6 +22,7 @@
 #include <circle/bcm2835.h>
 #include <circle/memio.h>
 #include <circle/synchronize.h>
+#include <circle/timer.h>
 #include <assert.h>
 
 #define GPIO_IRQ	ARM_IRQ_GPIO3		// shared IRQ line for all GPIOs
@@ -89,39 +90,112 @@ void CGPIOManager::DisconnectInterrupt (CGPIOPin *pPin)
 	m_apPin[nPin] = 0;
 }
 
-void CGPIOManager::InterruptHandler (void)
+unsigned CGPIOManager::ReadEvents (TGPIOEvent *pBuffer, unsigned nMaxEvents)
 {
-	assert (m_bIRQConnected);
+	assert (pBuffer != 0);
 
-	PeripheralEntry ();
+	unsigned nEvents = 0;
+	while (nEvents < nMaxEvents)
+	{
+		// merge the rings by taking the oldest event first
+		CGPIOPin *pOldestPin = 0;
+		u64 ullOldest = 0;
+		for (unsigned nPin = 0; nPin < GPIO_PINS; nPin++)
+		{
+			CGPIOPin *pPin = m_apPin[nPin];
+			if (pPin == 0)
+			{
+				continue;
+			}
 
-	u32 nEventStatus = read32 (ARM_GPIO_GPEDS0);
+			const TGPIOEvent *pEvent = pPin->PeekEvent ();
+			if (   pEvent != 0
+			    && (   pOldestPin == 0
+				|| (s64) (pEvent->ullTimestamp - ullOldest) < 0))
+			{
+				pOldestPin = pPin;
+				ullOldest = pEvent->ullTimestamp;
+			}
+		}
 
-	unsigned nPin = 0;
-	while (nPin < GPIO_PINS)
-	{
-		if (nEventStatus & 1)
+		if (pOldestPin == 0)
 		{
 			break;
 		}
-		nEventStatus >>= 1;
-		
-		if (++nPin % 32 == 0)
+
+		pBuffer[nEvents++] = *pOldestPin->PeekEvent ();
+
+		pOldestPin->SkipEvent ();
+	}
+
+	return nEvents;
+}
+
+u64 CGPIOManager::GetTimestamp (void)
+{
+	return CTimer::GetTicks64 ();
+}
+
+u64 CGPIOManager::GetTimestampFrequency (void)
+{
+	return CTimer::GetTicks64Frequency ();
+}
+
+// All pending pins are handled in one IRQ. The timestamp is taken once on entry, so
+// that simultaneous edges get the same timestamp.
+
+void CGPIOManager::InterruptHandler (void)
+{
+	assert (m_bIRQConnected);
+
+	u64 ullTimestamp = GetTimestamp ();
+
+	PeripheralEntry ();
+
+	for (unsigned nBank = 0; nBank < (GPIO_PINS+31) / 32; nBank++)
+	{
+		u32 nEventStatus = read32 (ARM_GPIO_GPEDS0 + nBank*4);
+		if (nEventStatus != 0)
 		{
-			nEventStatus = read32 (ARM_GPIO_GPEDS0 + 4);
+			HandleEvents (nBank, nEventStatus, ullTimestamp);
 		}
 	}
 
-	if (nPin < GPIO_PINS)
+	PeripheralExit ();
+}
+
+void CGPIOManager::HandleEvents (unsigned nBank, u32 nEventStatus, u64 ullTimestamp)
+{
+	u32 nLevels = read32 (ARM_GPIO_GPLEV0 + nBank*4);
+
+	u32 nAckMask = 0;
+	while (nEventStatus != 0)
 	{
+		unsigned nBit = 31 - __builtin_clz (nEventStatus);
+		u32 nMask = 1U << nBit;
+		nEventStatus &= ~nMask;
+
+		unsigned nPin = nBank*32 + nBit;
+		if (nPin >= GPIO_PINS)
+		{
+			continue;
+		}
+
 		CGPIOPin *pPin = m_apPin[nPin];
 		if (pPin != 0)
 		{
-			pPin->InterruptHandler ();
+			if (pPin->m_pEventRing != 0)
+			{
+				pPin->CaptureEvent (ullTimestamp, nLevels);
+			}
+			else
+			{
+				pPin->InterruptHandler ();
+			}
 
 			if (pPin->m_bAutoAck)
 			{
-				write32 (ARM_GPIO_GPEDS0 + pPin->m_nRegOffset, pPin->m_nRegMask);
+				nAckMask |= nMask;
 			}
 		}
 		else
@@ -129,11 +203,14 @@ void CGPIOManager::InterruptHandler (void)
 			// disable all interrupt sources
 			CGPIOPin::DisableAllInterrupts (nPin);
 
-			write32 (ARM_GPIO_GPEDS0 + (nPin / 32) * 4, 1 << (nPin % 32));
+			nAckMask |= nMask;
 		}
 	}
 
-	PeripheralExit ();
+	if (nAckMask != 0)
+	{
+		write32 (ARM_GPIO_GPEDS0 + nBank*4, nAckMask);
+	}
 }
 
 void CGPIOManager::InterruptStub (void *pParam)
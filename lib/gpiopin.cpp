@@ -34,7 +34,12 @@ CGPIOPin::CGPIOPin (void)
 	m_pManager (0),
 	m_pHandler (0),
 	m_Interrupt (GPIOInterruptUnknown),
-	m_Interrupt2 (GPIOInterruptUnknown)
+	m_Interrupt2 (GPIOInterruptUnknown),
+	m_pEventRing (0),
+	m_nEventRingSize (0),
+	m_nEventInPtr (0),
+	m_nEventOutPtr (0),
+	m_nEventOverruns (0)
 {
 }
 
@@ -44,7 +49,12 @@ CGPIOPin::CGPIOPin (unsigned nPin, TGPIOMode Mode, CGPIOManager *pManager)
 	m_pManager (pManager),
 	m_pHandler (0),
 	m_Interrupt (GPIOInterruptUnknown),
-	m_Interrupt2 (GPIOInterruptUnknown)
+	m_Interrupt2 (GPIOInterruptUnknown),
+	m_pEventRing (0),
+	m_nEventRingSize (0),
+	m_nEventInPtr (0),
+	m_nEventOutPtr (0),
+	m_nEventOverruns (0)
 {
 	AssignPin (nPin);
 
@@ -53,6 +63,9 @@ CGPIOPin::CGPIOPin (unsigned nPin, TGPIOMode Mode, CGPIOManager *pManager)
 
 CGPIOPin::~CGPIOPin (void)
 {
+	delete [] m_pEventRing;
+	m_pEventRing = 0;
+
 	m_pHandler = 0;
 	m_pManager = 0;
 	
@@ -213,11 +226,147 @@ void CGPIOPin::DisconnectInterrupt (void)
 	assert (m_Interrupt == GPIOInterruptUnknown);
 	assert (m_Interrupt2 == GPIOInterruptUnknown);
 
-	assert (m_pHandler != 0);
+	assert (m_pHandler != 0 || m_pEventRing != 0);
 	m_pHandler = 0;
 
 	assert (m_pManager != 0);
 	m_pManager->DisconnectInterrupt (this);
+
+	delete [] m_pEventRing;
+	m_pEventRing = 0;
+}
+
+void CGPIOPin::ConnectEventCapture (unsigned nRingSize)
+{
+	assert (   m_Mode == GPIOModeInput
+		|| m_Mode == GPIOModeInputPullUp
+		|| m_Mode == GPIOModeInputPullDown);
+
+	assert (m_Interrupt == GPIOInterruptUnknown);
+	assert (m_Interrupt2 == GPIOInterruptUnknown);
+
+	assert (m_pHandler == 0);
+	assert (m_pEventRing == 0);
+
+	assert (nRingSize >= 2);
+	assert (!(nRingSize & (nRingSize-1)));
+	m_nEventRingSize = nRingSize;
+
+	m_pEventRing = new TGPIOEvent[m_nEventRingSize];
+	assert (m_pEventRing != 0);
+
+	m_nEventInPtr = 0;
+	m_nEventOutPtr = 0;
+	m_nEventOverruns = 0;
+
+	m_bAutoAck = TRUE;
+
+	assert (m_pManager != 0);
+	m_pManager->ConnectInterrupt (this);
+}
+
+unsigned CGPIOPin::ReadEvents (TGPIOEvent *pBuffer, unsigned nMaxEvents)
+{
+	assert (pBuffer != 0);
+
+	unsigned nEvents = 0;
+	const TGPIOEvent *pEvent;
+	while (   nEvents < nMaxEvents
+	       && (pEvent = PeekEvent ()) != 0)
+	{
+		pBuffer[nEvents++] = *pEvent;
+
+		SkipEvent ();
+	}
+
+	return nEvents;
+}
+
+unsigned CGPIOPin::GetEventsAvail (void) const
+{
+	return (m_nEventInPtr - m_nEventOutPtr) & (m_nEventRingSize-1);
+}
+
+// Called from CGPIOManager on IRQ_LEVEL. The ring is single producer (this) and single
+// consumer (ReadEvents()), so no lock is needed. One entry stays unused to distinguish
+// a full from an empty ring.
+
+void CGPIOPin::CaptureEvent (u64 ullTimestamp, u32 nLevels)
+{
+	assert (m_pEventRing != 0);
+
+	unsigned nInPtr = m_nEventInPtr;
+	unsigned nNextInPtr = (nInPtr + 1) & (m_nEventRingSize-1);
+	if (nNextInPtr == m_nEventOutPtr)
+	{
+		m_nEventOverruns++;
+
+		return;
+	}
+
+	TGPIOEvent *pEvent = &m_pEventRing[nInPtr];
+	pEvent->ullTimestamp = ullTimestamp;
+	pEvent->nPin = m_nPin;
+
+	// with only one edge type enabled the level follows from it
+	TGPIOInterrupt Interrupt = m_Interrupt < GPIOInterruptUnknown ? m_Interrupt : m_Interrupt2;
+	if (   m_Interrupt  == GPIOInterruptUnknown
+	    || m_Interrupt2 == GPIOInterruptUnknown)
+	{
+		switch (Interrupt)
+		{
+		case GPIOInterruptOnRisingEdge:
+		case GPIOInterruptOnAsyncRisingEdge:
+		case GPIOInterruptOnHighLevel:
+			pEvent->nLevel = HIGH;
+			break;
+
+		case GPIOInterruptOnFallingEdge:
+		case GPIOInterruptOnAsyncFallingEdge:
+		case GPIOInterruptOnLowLevel:
+			pEvent->nLevel = LOW;
+			break;
+
+		default:
+			pEvent->nLevel = nLevels & m_nRegMask ? HIGH : LOW;
+			break;
+		}
+	}
+	else
+	{
+		pEvent->nLevel = nLevels & m_nRegMask ? HIGH : LOW;
+	}
+
+	DataMemBarrier ();
+
+	m_nEventInPtr = nNextInPtr;
+}
+
+const TGPIOEvent *CGPIOPin::PeekEvent (void) const
+{
+	if (m_pEventRing == 0)
+	{
+		return 0;
+	}
+
+	unsigned nOutPtr = m_nEventOutPtr;
+	if (nOutPtr == m_nEventInPtr)
+	{
+		return 0;
+	}
+
+	DataMemBarrier ();
+
+	return &m_pEventRing[nOutPtr];
+}
+
+void CGPIOPin::SkipEvent (void)
+{
+	assert (m_nEventOutPtr != m_nEventInPtr);
+
+	DataMemBarrier ();
+
+	m_nEventOutPtr = (m_nEventOutPtr + 1) & (m_nEventRingSize-1);
 }
 
 void CGPIOPin::EnableInterrupt (TGPIOInterrupt Interrupt)
@@ -225,7 +374,7 @@ void CGPIOPin::EnableInterrupt (TGPIOInterrupt Interrupt)
 	assert (   m_Mode == GPIOModeInput
 		|| m_Mode == GPIOModeInputPullUp
 		|| m_Mode == GPIOModeInputPullDown);
-	assert (m_pHandler != 0);
+	assert (m_pHandler != 0 || m_pEventRing != 0);
 
 	assert (m_Interrupt == GPIOInterruptUnknown);
 	assert (Interrupt < GPIOInterruptUnknown);
@@ -266,7 +415,7 @@ void CGPIOPin::EnableInterrupt2 (TGPIOInterrupt Interrupt)
 	assert (   m_Mode == GPIOModeInput
 		|| m_Mode == GPIOModeInputPullUp
 		|| m_Mode == GPIOModeInputPullDown);
-	assert (m_pHandler != 0);
+	assert (m_pHandler != 0 || m_pEventRing != 0);
 
 	assert (m_Interrupt2 == GPIOInterruptUnknown);
 	assert (Interrupt < GPIOInterruptUnknown);
@@ -0,0 +1,658 @@
+//
+// gpiowaveform.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2020  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/gpiowaveform.h>
+#include <circle/bcm2835.h>
+#include <circle/bcm2835int.h>
+#include <circle/memio.h>
+#include <circle/timer.h>
+#include <circle/synchronize.h>
+#include <circle/machineinfo.h>
+#include <circle/logger.h>
+#include <circle/new.h>
+#include <assert.h>
+
+#define PACER_CLOCK_RATE	10000000		// 10 MHz, 0.1 us resolution
+
+#define MAX_PACING_TICKS	(0xFFFF / 4)		// one word per tick, DMA lite limit
+
+#define IO_ADDRESS(reg)		(((reg) & 0xFFFFFF) + GPU_IO_BASE)
+
+//
+// PWM device selection
+//
+#if RASPPI <= 3
+	#define PWM_BASE	ARM_PWM_BASE
+	#define DREQ_PWM	DREQSourcePWM
+#else
+	#define PWM_BASE	ARM_PWM1_BASE
+	#define DREQ_PWM	DREQSourcePWM1
+#endif
+
+//
+// PWM registers
+//
+#define PWM_CTL			(PWM_BASE + 0x00)
+	#define ARM_PWM_CTL_PWEN1	(1 << 0)
+	#define ARM_PWM_CTL_USEF1	(1 << 5)
+	#define ARM_PWM_CTL_CLRF1	(1 << 6)
+#define PWM_DMAC		(PWM_BASE + 0x08)
+	#define ARM_PWM_DMAC_DREQ__SHIFT	0
+	#define ARM_PWM_DMAC_PANIC__SHIFT	8
+	#define ARM_PWM_DMAC_ENAB		(1 << 31)
+	#define PWM_DREQ_THRESHOLD		7	// DREQ active below this FIFO level
+#define PWM_RNG1		(PWM_BASE + 0x10)
+#define PWM_FIF1		(PWM_BASE + 0x18)
+
+//
+// PCM registers
+//
+#define CS_A_STBY		(1 << 25)
+#define CS_A_DMAEN		(1 << 9)
+#define CS_A_TXCLR		(1 << 3)
+#define CS_A_TXON		(1 << 2)
+#define CS_A_EN			(1 << 0)
+
+#define MODE_A_FLEN__SHIFT	10
+#define MODE_A_FLEN_MAX		1023
+#define MODE_A_FSLEN__SHIFT	0
+
+#define TXC_A_CH1EN		(1 << 30)
+
+#define DREQ_A_TX__SHIFT	8
+#define DREQ_A_TX__MASK		(0x7F << 8)
+#define DREQ_A_TX_THRESHOLD	0x10	// DREQ active below this FIFO level
+
+//
+// DMA controller
+//
+#define ARM_DMACHAN_CS(chan)		(ARM_DMA_BASE + ((chan) * 0x100) + 0x00)
+	#define CS_RESET			(1 << 31)
+	#define CS_ABORT			(1 << 30)
+	#define CS_WAIT_FOR_OUTSTANDING_WRITES	(1 << 28)
+	#define CS_PANIC_PRIORITY_SHIFT		20
+		#define DEFAULT_PANIC_PRIORITY		15
+	#define CS_PRIORITY_SHIFT		16
+		#define DEFAULT_PRIORITY		1
+	#define CS_ERROR			(1 << 8)
+	#define CS_INT				(1 << 2)
+	#define CS_END				(1 << 1)
+	#define CS_ACTIVE			(1 << 0)
+#define ARM_DMACHAN_CONBLK_AD(chan)	(ARM_DMA_BASE + ((chan) * 0x100) + 0x04)
+#define ARM_DMACHAN_TI(chan)		(ARM_DMA_BASE + ((chan) * 0x100) + 0x08)
+	#define TI_PERMAP_SHIFT			16
+	#define TI_DEST_DREQ			(1 << 6)
+	#define TI_DEST_INC			(1 << 4)
+	#define TI_WAIT_RESP			(1 << 3)
+	#define TI_INTEN			(1 << 0)
+#define ARM_DMACHAN_NEXTCONBK(chan)	(ARM_DMA_BASE + ((chan) * 0x100) + 0x1C)
+#define ARM_DMA_INT_STATUS		(ARM_DMA_BASE + 0xFE0)
+#define ARM_DMA_ENABLE			(ARM_DMA_BASE + 0xFF0)
+
+static const char FromWaveform[] = "gpiowave";
+
+CGPIOWaveform::CGPIOWaveform (CInterruptSystem *pInterruptSystem, unsigned nTickUs,
+			      TGPIOWaveformPacer Pacer)
+:	m_pInterruptSystem (pInterruptSystem),
+	m_nTickUs (nTickUs),
+	m_Pacer (Pacer),
+	m_Clock (Pacer == GPIOWaveformPacerPCM ? GPIOClockPCM : GPIOClockPWM),
+	m_bPacerRunning (FALSE),
+	m_nDMAChannel (CMachineInfo::Get ()->AllocateDMAChannel (DMA_CHANNEL_LITE)),
+	m_bIRQConnected (FALSE),
+	m_pChainBuffer (0),
+	m_pChain (0),
+	m_nChainSize (0),
+	m_nChainLength (0),
+	m_pData (0),
+	m_nDataSize (0),
+	m_nDataLength (0),
+	m_pLastStep (0),
+	m_pTerminator (0),
+	m_pCaptureBuffer (0),
+	m_nCaptureLength (0),
+	m_bActive (FALSE),
+	m_pCompletionRoutine (0),
+	m_pCompletionParam (0)
+{
+	assert (m_pInterruptSystem != 0);
+	assert (m_nTickUs > 0);
+	assert (m_Pacer < GPIOWaveformPacerUnknown);
+
+	// enable and reset DMA channel
+	PeripheralEntry ();
+
+	assert (m_nDMAChannel <= DMA_CHANNEL_MAX);
+	write32 (ARM_DMA_ENABLE, read32 (ARM_DMA_ENABLE) | (1 << m_nDMAChannel));
+	CTimer::SimpleusDelay (1000);
+
+	write32 (ARM_DMACHAN_CS (m_nDMAChannel), CS_RESET);
+	while (read32 (ARM_DMACHAN_CS (m_nDMAChannel)) & CS_RESET)
+	{
+		// do nothing
+	}
+
+	PeripheralExit ();
+}
+
+CGPIOWaveform::~CGPIOWaveform (void)
+{
+	if (m_bActive)
+	{
+		Stop (TRUE);
+	}
+
+	StopPacer ();
+
+	// reset and disable DMA channel
+	PeripheralEntry ();
+
+	assert (m_nDMAChannel <= DMA_CHANNEL_MAX);
+	write32 (ARM_DMA_ENABLE, read32 (ARM_DMA_ENABLE) & ~(1 << m_nDMAChannel));
+
+	PeripheralExit ();
+
+	if (m_bIRQConnected)
+	{
+		assert (m_pInterruptSystem != 0);
+		m_pInterruptSystem->DisconnectIRQ (ARM_IRQ_DMA0+m_nDMAChannel);
+	}
+
+	m_pInterruptSystem = 0;
+
+	CMachineInfo::Get ()->FreeDMAChannel (m_nDMAChannel);
+
+	m_pChain = 0;
+	m_pData = 0;
+
+	delete [] m_pChainBuffer;
+	m_pChainBuffer = 0;
+}
+
+boolean CGPIOWaveform::Initialize (void)
+{
+	assert (!m_bPacerRunning);
+
+	if (   m_Pacer == GPIOWaveformPacerPCM
+	    && PACER_CLOCK_RATE / 1000000 * m_nTickUs - 1 > MODE_A_FLEN_MAX)
+	{
+		CLogger::Get ()->Write (FromWaveform, LogError, "Tick too long for PCM (%u us)",
+					m_nTickUs);
+
+		return FALSE;
+	}
+
+	if (!m_Clock.StartRate (PACER_CLOCK_RATE))
+	{
+		CLogger::Get ()->Write (FromWaveform, LogError, "Cannot start clock");
+
+		return FALSE;
+	}
+
+	RunPacer ();
+
+	assert (m_pInterruptSystem != 0);
+	m_pInterruptSystem->ConnectIRQ (ARM_IRQ_DMA0+m_nDMAChannel, InterruptStub, this);
+	m_bIRQConnected = TRUE;
+
+	return TRUE;
+}
+
+// Each step is translated into a write to GPSET0 and GPCLR0 (if the mask is not 0) and
+// into writes of nDelay dummy words to the FIFO of the pacer, which accepts one word
+// per tick. The waveform is followed by a terminator, which raises the interrupt.
+
+boolean CGPIOWaveform::SetWaveform (const TGPIOWaveStep *pSteps, unsigned nSteps)
+{
+	assert (!m_bActive);
+	assert (pSteps != 0);
+	assert (nSteps > 0);
+
+	unsigned nControlBlocks = 1;
+	unsigned nDataWords = 0;
+	for (unsigned i = 0; i < nSteps; i++)
+	{
+		assert (pSteps[i].nDelay > 0);
+
+		if (pSteps[i].nSetMask != 0)
+		{
+			nControlBlocks++;
+			nDataWords++;
+		}
+
+		if (pSteps[i].nClearMask != 0)
+		{
+			nControlBlocks++;
+			nDataWords++;
+		}
+
+		nControlBlocks += (pSteps[i].nDelay + MAX_PACING_TICKS-1) / MAX_PACING_TICKS;
+	}
+
+	if (!AllocateChain (nControlBlocks, nDataWords))
+	{
+		return FALSE;
+	}
+
+	for (unsigned i = 0; i < nSteps; i++)
+	{
+		if (pSteps[i].nSetMask != 0)
+		{
+			m_pData[m_nDataLength] = pSteps[i].nSetMask;
+
+			AddControlBlock (TI_WAIT_RESP, BUS_ADDRESS ((uintptr) &m_pData[m_nDataLength++]),
+					 IO_ADDRESS (ARM_GPIO_GPSET0), sizeof (u32));
+		}
+
+		if (pSteps[i].nClearMask != 0)
+		{
+			m_pData[m_nDataLength] = pSteps[i].nClearMask;
+
+			AddControlBlock (TI_WAIT_RESP, BUS_ADDRESS ((uintptr) &m_pData[m_nDataLength++]),
+					 IO_ADDRESS (ARM_GPIO_GPCLR0), sizeof (u32));
+		}
+
+		AddPacing (pSteps[i].nDelay);
+	}
+
+	m_pLastStep = &m_pChain[m_nChainLength-1];
+
+	m_pTerminator = AddControlBlock (TI_WAIT_RESP | TI_INTEN, BUS_ADDRESS ((uintptr) &m_pData[0]),
+					 BUS_ADDRESS ((uintptr) &m_pData[1]), sizeof (u32));
+	assert (m_nChainLength == nControlBlocks);
+
+	return TRUE;
+}
+
+void CGPIOWaveform::Start (boolean bRepeat)
+{
+	assert (!m_bActive);
+	assert (m_pLastStep != 0);
+	assert (m_pTerminator != 0);
+
+	m_pLastStep->nNextControlBlockAddress =
+		BUS_ADDRESS ((uintptr) (bRepeat ? &m_pChain[0] : m_pTerminator));
+
+	m_pCaptureBuffer = 0;
+
+	StartDMA ();
+}
+
+void CGPIOWaveform::Stop (boolean bImmediately)
+{
+	if (!m_bActive)
+	{
+		return;
+	}
+
+	// a capture has no cycle to be completed, stop it at once
+	if (   bImmediately
+	    || m_pCaptureBuffer != 0)
+	{
+		ResetDMA ();
+
+		if (m_pCaptureBuffer != 0)
+		{
+			CleanAndInvalidateDataCacheRange ((uintptr) m_pCaptureBuffer, m_nCaptureLength);
+		}
+
+		m_bActive = FALSE;
+
+		return;
+	}
+
+	// open the ring, the terminator completes the current cycle
+	assert (m_pLastStep != 0);
+	assert (m_pTerminator != 0);
+	m_pLastStep->nNextControlBlockAddress = BUS_ADDRESS ((uintptr) m_pTerminator);
+
+	CleanAndInvalidateDataCacheRange ((uintptr) m_pLastStep, sizeof (TDMAControlBlock));
+
+	// the last control block may have been loaded by the DMA controller already,
+	// pause the DMA to check this safely
+	PeripheralEntry ();
+
+	u32 nCS = read32 (ARM_DMACHAN_CS (m_nDMAChannel)) & ~(CS_INT | CS_END);
+	write32 (ARM_DMACHAN_CS (m_nDMAChannel), nCS & ~CS_ACTIVE);
+
+	if (read32 (ARM_DMACHAN_CONBLK_AD (m_nDMAChannel)) == BUS_ADDRESS ((uintptr) m_pLastStep))
+	{
+		write32 (ARM_DMACHAN_NEXTCONBK (m_nDMAChannel), BUS_ADDRESS ((uintptr) m_pTerminator));
+	}
+
+	write32 (ARM_DMACHAN_CS (m_nDMAChannel), nCS);
+
+	PeripheralExit ();
+}
+
+boolean CGPIOWaveform::StartCapture (u32 *pBuffer, unsigned nSamples, unsigned nIntervalTicks)
+{
+	assert (!m_bActive);
+	assert (pBuffer != 0);
+	assert (nSamples > 0);
+	assert (0 < nIntervalTicks && nIntervalTicks <= MAX_PACING_TICKS);
+
+	if (!AllocateChain (nSamples*2 + 1, 0))
+	{
+		return FALSE;
+	}
+
+	for (unsigned i = 0; i < nSamples; i++)
+	{
+		AddControlBlock (TI_WAIT_RESP, IO_ADDRESS (ARM_GPIO_GPLEV0),
+				 BUS_ADDRESS ((uintptr) &pBuffer[i]), sizeof (u32));
+
+		AddPacing (nIntervalTicks);
+	}
+
+	m_pTerminator = AddControlBlock (TI_WAIT_RESP | TI_INTEN, BUS_ADDRESS ((uintptr) &m_pData[0]),
+					 BUS_ADDRESS ((uintptr) &m_pData[1]), sizeof (u32));
+
+	m_pLastStep = 0;		// waveform has been overwritten
+
+	m_pCaptureBuffer = pBuffer;
+	m_nCaptureLength = nSamples * sizeof (u32);
+	CleanAndInvalidateDataCacheRange ((uintptr) m_pCaptureBuffer, m_nCaptureLength);
+
+	StartDMA ();
+
+	return TRUE;
+}
+
+void CGPIOWaveform::SetCompletionRoutine (TGPIOWaveformCompletionRoutine *pRoutine, void *pParam)
+{
+	assert (!m_bActive);
+
+	m_pCompletionRoutine = pRoutine;
+	m_pCompletionParam = pParam;
+}
+
+// The data words 0 and 1 are reserved as source and destination of dummy transfers.
+
+boolean CGPIOWaveform::AllocateChain (unsigned nControlBlocks, unsigned nDataWords)
+{
+	nDataWords += 2;
+
+	if (   nControlBlocks > m_nChainSize
+	    || nDataWords > m_nDataSize)
+	{
+		delete [] m_pChainBuffer;
+
+		if (nControlBlocks < m_nChainSize)
+		{
+			nControlBlocks = m_nChainSize;
+		}
+
+		if (nDataWords < m_nDataSize)
+		{
+			nDataWords = m_nDataSize;
+		}
+
+		m_pChainBuffer = new (HEAP_DMA30) u8[  nControlBlocks * sizeof (TDMAControlBlock)
+						     + nDataWords * sizeof (u32) + 31];
+		if (m_pChainBuffer == 0)
+		{
+			m_pChain = 0;
+			m_nChainSize = 0;
+			m_pData = 0;
+			m_nDataSize = 0;
+
+			CLogger::Get ()->Write (FromWaveform, LogError, "Cannot allocate %u control blocks",
+						nControlBlocks);
+
+			return FALSE;
+		}
+
+		m_pChain = (TDMAControlBlock *) (((uintptr) m_pChainBuffer + 31) & ~31);
+		m_nChainSize = nControlBlocks;
+
+		m_pData = (u32 *) &m_pChain[m_nChainSize];
+		m_nDataSize = nDataWords;
+	}
+
+	m_nChainLength = 0;
+
+	assert (m_pData != 0);
+	m_pData[0] = 0;
+	m_nDataLength = 2;
+
+	m_pLastStep = 0;
+	m_pTerminator = 0;
+
+	return TRUE;
+}
+
+TDMAControlBlock *CGPIOWaveform::AddControlBlock (u32 nTransferInformation, u32 nSourceAddress,
+						  u32 nDestinationAddress, u32 nTransferLength)
+{
+	assert (m_pChain != 0);
+	assert (m_nChainLength < m_nChainSize);
+	TDMAControlBlock *pControlBlock = &m_pChain[m_nChainLength];
+
+	pControlBlock->nTransferInformation     = nTransferInformation;
+	pControlBlock->nSourceAddress           = nSourceAddress;
+	pControlBlock->nDestinationAddress      = nDestinationAddress;
+	pControlBlock->nTransferLength          = nTransferLength;
+	pControlBlock->n2DModeStride            = 0;
+	pControlBlock->nNextControlBlockAddress = 0;
+	pControlBlock->nReserved[0]             = 0;
+	pControlBlock->nReserved[1]             = 0;
+
+	if (m_nChainLength > 0)
+	{
+		m_pChain[m_nChainLength-1].nNextControlBlockAddress =
+			BUS_ADDRESS ((uintptr) pControlBlock);
+	}
+
+	m_nChainLength++;
+
+	return pControlBlock;
+}
+
+void CGPIOWaveform::AddPacing (unsigned nTicks)
+{
+	assert (nTicks > 0);
+
+	u32 nFIFO = m_Pacer == GPIOWaveformPacerPCM ? IO_ADDRESS (ARM_PCM_FIFO_A)
+						    : IO_ADDRESS (PWM_FIF1);
+	u32 nDREQ = m_Pacer == GPIOWaveformPacerPCM ? DREQSourcePCMTX : DREQ_PWM;
+
+	while (nTicks > 0)
+	{
+		unsigned nCount = nTicks < MAX_PACING_TICKS ? nTicks : MAX_PACING_TICKS;
+
+		// the source address is not incremented
+		AddControlBlock (  (nDREQ << TI_PERMAP_SHIFT)
+				 | TI_DEST_DREQ
+				 | TI_WAIT_RESP,
+				 BUS_ADDRESS ((uintptr) &m_pData[0]), nFIFO,
+				 nCount * sizeof (u32));
+
+		nTicks -= nCount;
+	}
+}
+
+void CGPIOWaveform::StartDMA (void)
+{
+	assert (m_bIRQConnected);
+	assert (m_pChain != 0);
+	assert (m_nChainLength > 0);
+
+	CleanAndInvalidateDataCacheRange ((uintptr) m_pChain,
+					    m_nChainSize * sizeof (TDMAControlBlock)
+					  + m_nDataSize * sizeof (u32));
+
+	m_bActive = TRUE;
+
+	PeripheralEntry ();
+
+	// fill the FIFO of the pacer up to the DREQ threshold, so that the first pacing
+	// write has to wait one tick, but not more (the FIFO is drained while idle)
+	if (m_Pacer == GPIOWaveformPacerPCM)
+	{
+		for (unsigned i = 0; i < DREQ_A_TX_THRESHOLD; i++)
+		{
+			write32 (ARM_PCM_FIFO_A, 0);
+		}
+	}
+	else
+	{
+		for (unsigned i = 0; i < PWM_DREQ_THRESHOLD; i++)
+		{
+			write32 (PWM_FIF1, 0);
+		}
+	}
+
+	assert (!(read32 (ARM_DMACHAN_CS (m_nDMAChannel)) & CS_INT));
+	assert (!(read32 (ARM_DMA_INT_STATUS) & (1 << m_nDMAChannel)));
+
+	write32 (ARM_DMACHAN_CONBLK_AD (m_nDMAChannel), BUS_ADDRESS ((uintptr) m_pChain));
+
+	write32 (ARM_DMACHAN_CS (m_nDMAChannel),   CS_WAIT_FOR_OUTSTANDING_WRITES
+					         | (DEFAULT_PANIC_PRIORITY << CS_PANIC_PRIORITY_SHIFT)
+					         | (DEFAULT_PRIORITY << CS_PRIORITY_SHIFT)
+					         | CS_ACTIVE);
+
+	PeripheralExit ();
+}
+
+void CGPIOWaveform::ResetDMA (void)
+{
+	PeripheralEntry ();
+
+	write32 (ARM_DMACHAN_CS (m_nDMAChannel), CS_RESET);
+	while (read32 (ARM_DMACHAN_CS (m_nDMAChannel)) & CS_RESET)
+	{
+		// do nothing
+	}
+
+	write32 (ARM_DMA_INT_STATUS, 1 << m_nDMAChannel);
+
+	PeripheralExit ();
+}
+
+void CGPIOWaveform::RunPacer (void)
+{
+	PeripheralEntry ();
+
+	if (m_Pacer == GPIOWaveformPacerPCM)
+	{
+		// one channel of 8 bits per frame, a frame is one tick
+		write32 (ARM_PCM_CS_A, 0);
+		CTimer::SimpleusDelay (10);
+
+		write32 (ARM_PCM_CS_A, CS_A_TXCLR);
+		CTimer::SimpleusDelay (10);
+
+		write32 (ARM_PCM_TXC_A, TXC_A_CH1EN);
+		write32 (ARM_PCM_MODE_A,   ((PACER_CLOCK_RATE / 1000000 * m_nTickUs - 1)
+					    << MODE_A_FLEN__SHIFT)
+					 | (1 << MODE_A_FSLEN__SHIFT));
+		write32 (ARM_PCM_DREQ_A,   (read32 (ARM_PCM_DREQ_A) & ~DREQ_A_TX__MASK)
+					 | (DREQ_A_TX_THRESHOLD << DREQ_A_TX__SHIFT));
+
+		write32 (ARM_PCM_CS_A, CS_A_STBY);
+		CTimer::SimpleusDelay (50);
+
+		write32 (ARM_PCM_CS_A, CS_A_STBY | CS_A_EN | CS_A_DMAEN | CS_A_TXON);
+	}
+	else
+	{
+		// one FIFO word is sent per range cycle, which is one tick
+		write32 (PWM_RNG1, PACER_CLOCK_RATE / 1000000 * m_nTickUs);
+
+		write32 (PWM_CTL, ARM_PWM_CTL_PWEN1 | ARM_PWM_CTL_USEF1 | ARM_PWM_CTL_CLRF1);
+		CTimer::SimpleusDelay (2000);
+
+		write32 (PWM_DMAC,   ARM_PWM_DMAC_ENAB
+				   | (7 << ARM_PWM_DMAC_PANIC__SHIFT)
+				   | (PWM_DREQ_THRESHOLD << ARM_PWM_DMAC_DREQ__SHIFT));
+	}
+
+	PeripheralExit ();
+
+	m_bPacerRunning = TRUE;
+}
+
+void CGPIOWaveform::StopPacer (void)
+{
+	if (!m_bPacerRunning)
+	{
+		return;
+	}
+
+	PeripheralEntry ();
+
+	if (m_Pacer == GPIOWaveformPacerPCM)
+	{
+		write32 (ARM_PCM_CS_A, 0);
+	}
+	else
+	{
+		write32 (PWM_DMAC, 0);
+		write32 (PWM_CTL, ARM_PWM_CTL_CLRF1);
+	}
+
+	CTimer::SimpleusDelay (50);
+
+	PeripheralExit ();
+
+	m_Clock.Stop ();
+
+	m_bPacerRunning = FALSE;
+}
+
+void CGPIOWaveform::InterruptHandler (void)
+{
+	PeripheralEntry ();
+
+	u32 nIntMask = 1 << m_nDMAChannel;
+	if (!(read32 (ARM_DMA_INT_STATUS) & nIntMask))
+	{
+		PeripheralExit ();
+
+		return;
+	}
+	write32 (ARM_DMA_INT_STATUS, nIntMask);
+
+	u32 nCS = read32 (ARM_DMACHAN_CS (m_nDMAChannel));
+	write32 (ARM_DMACHAN_CS (m_nDMAChannel), CS_INT);
+
+	PeripheralExit ();
+
+	if (m_pCaptureBuffer != 0)
+	{
+		CleanAndInvalidateDataCacheRange ((uintptr) m_pCaptureBuffer, m_nCaptureLength);
+	}
+
+	m_bActive = FALSE;
+
+	if (m_pCompletionRoutine != 0)
+	{
+		(*m_pCompletionRoutine) (nCS & CS_ERROR ? FALSE : TRUE, m_pCompletionParam);
+	}
+}
+
+void CGPIOWaveform::InterruptStub (void *pParam)
+{
+	CGPIOWaveform *pThis = (CGPIOWaveform *) pParam;
+	assert (pThis != 0);
+
+	pThis->InterruptHandler ();
+}
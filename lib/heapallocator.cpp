@@ -50,6 +50,16 @@ CHeapAllocator::~CHeapAllocator (void)
 
 void CHeapAllocator::Setup (uintptr nBase, size_t nSize, size_t nReserve)
 {
+#ifdef HEAP_TRACKING
+	size_t nTableSize = (CAllocationSites::GetTableSize () + HEAP_ALIGN_MASK) & ~HEAP_ALIGN_MASK;
+	assert (nSize > nTableSize);
+
+	m_Sites.Setup ((void *) nBase);
+
+	nBase += nTableSize;
+	nSize -= nTableSize;
+#endif
+
 	m_pNext = (u8 *) nBase;
 	m_pLimit = (u8 *) (nBase + nSize);
 	m_nReserve = nReserve;
@@ -60,13 +70,32 @@ size_t CHeapAllocator::GetFreeSpace (void) const
 	return m_pLimit - m_pNext;
 }
 
-void *CHeapAllocator::Allocate (size_t nSize)
+size_t CHeapAllocator::GetFreeListSpace (void) const
+{
+	size_t nResult = 0;
+
+	for (const THeapBlockBucket *pBucket = m_Bucket; pBucket->nSize > 0; pBucket++)
+	{
+		nResult += (size_t) pBucket->nFreeCount * pBucket->nSize;
+	}
+
+	return nResult;
+}
+
+void *CHeapAllocator::Allocate (size_t nSize, uintptr nCaller)
 {
 	if (m_pNext == 0)
 	{
 		return 0;
 	}
 
+#ifdef HEAP_TRACKING
+	if (nCaller == 0)
+	{
+		nCaller = (uintptr) __builtin_return_address (0);
+	}
+#endif
+
 	m_SpinLock.Acquire ();
 
 	THeapBlockBucket *pBucket;
@@ -76,13 +105,6 @@ void *CHeapAllocator::Allocate (size_t nSize)
 		{
 			nSize = pBucket->nSize;
 
-#ifdef HEAP_DEBUG
-			if (++pBucket->nCount > pBucket->nMaxCount)
-			{
-				pBucket->nMaxCount = pBucket->nCount;
-			}
-#endif
-
 			break;
 		}
 	}
@@ -93,6 +115,9 @@ void *CHeapAllocator::Allocate (size_t nSize)
 	{
 		assert (pBlockHeader->nMagic == HEAP_BLOCK_MAGIC);
 		pBucket->pFreeList = pBlockHeader->pNext;
+
+		assert (pBucket->nFreeCount > 0);
+		pBucket->nFreeCount--;
 	}
 	else
 	{
@@ -134,6 +159,18 @@ void *CHeapAllocator::Allocate (size_t nSize)
 		pBlockHeader->nSize = (u32) nSize;
 	}
 
+#if defined (HEAP_DEBUG) || defined (HEAP_TRACKING)
+	if (++pBucket->nCount > pBucket->nMaxCount)	// large blocks are counted in last entry
+	{
+		pBucket->nMaxCount = pBucket->nCount;
+	}
+#endif
+
+#ifdef HEAP_TRACKING
+	pBlockHeader->nCaller = nCaller;
+	m_Sites.Add (nCaller, pBlockHeader->nSize);
+#endif
+
 	m_SpinLock.Release ();
 
 	pBlockHeader->pNext = 0;
@@ -144,11 +181,18 @@ void *CHeapAllocator::Allocate (size_t nSize)
 	return pResult;
 }
 
-void *CHeapAllocator::ReAllocate (void *pBlock, size_t nSize)
+void *CHeapAllocator::ReAllocate (void *pBlock, size_t nSize, uintptr nCaller)
 {
+#ifdef HEAP_TRACKING
+	if (nCaller == 0)
+	{
+		nCaller = (uintptr) __builtin_return_address (0);
+	}
+#endif
+
 	if (pBlock == 0)
 	{
-		return Allocate (nSize);
+		return Allocate (nSize, nCaller);
 	}
 
 	if (nSize == 0)
@@ -166,7 +210,7 @@ void *CHeapAllocator::ReAllocate (void *pBlock, size_t nSize)
 		return pBlock;
 	}
 
-	void *pNewBlock = Allocate (nSize);
+	void *pNewBlock = Allocate (nSize, nCaller);
 	if (pNewBlock == 0)
 	{
 		return 0;
@@ -198,17 +242,39 @@ void CHeapAllocator::Free (void *pBlock)
 
 			pBlockHeader->pNext = pBucket->pFreeList;
 			pBucket->pFreeList = pBlockHeader;
+			pBucket->nFreeCount++;
 
-#ifdef HEAP_DEBUG
+#if defined (HEAP_DEBUG) || defined (HEAP_TRACKING)
 			pBucket->nCount--;
 #endif
 
+#ifdef HEAP_TRACKING
+			m_Sites.Remove (pBlockHeader->nCaller, pBlockHeader->nSize);
+#endif
+
 			m_SpinLock.Release ();
 
 			return;
 		}
 	}
 
+#ifdef HEAP_TRACKING
+	m_SpinLock.Acquire ();
+
+	THeapBlockBucket *pLargeBucket = m_Bucket;
+	while (pLargeBucket->nSize > 0)
+	{
+		pLargeBucket++;
+	}
+
+	assert (pLargeBucket->nCount > 0);
+	pLargeBucket->nCount--;
+
+	m_Sites.Remove (pBlockHeader->nCaller, pBlockHeader->nSize);
+
+	m_SpinLock.Release ();
+#endif
+
 #ifdef HEAP_DEBUG
 	CLogger::Get ()->Write (m_pHeapName, LogDebug, "Trying to free large block (size %u)",
 				pBlockHeader->nSize);
@@ -227,3 +293,54 @@ void CHeapAllocator::DumpStatus (void)
 }
 
 #endif
+
+#ifdef HEAP_TRACKING
+
+void CHeapAllocator::DumpUsage (CDevice *pTarget, unsigned nMaxSites)
+{
+	if (m_pNext == 0)
+	{
+		return;
+	}
+
+	TAllocationSite *pSnapshot = new TAllocationSite[ALLOCATION_SITES+1];
+	if (pSnapshot == 0)
+	{
+		return;
+	}
+
+	unsigned nBuckets = 0;
+	while (m_Bucket[nBuckets].nSize > 0)
+	{
+		nBuckets++;
+	}
+
+	THeapBlockBucket Bucket[HEAP_BLOCK_MAX_BUCKETS+1];
+
+	m_SpinLock.Acquire ();
+
+	memcpy (Bucket, m_Bucket, sizeof Bucket);
+	m_Sites.Snapshot (pSnapshot);
+
+	m_SpinLock.Release ();
+
+	CLogger::WriteTo (pTarget, m_pHeapName, "%lu bytes free, %lu bytes on free lists",
+			  (unsigned long) GetFreeSpace (), (unsigned long) GetFreeListSpace ());
+
+	for (unsigned i = 0; i < nBuckets; i++)
+	{
+		CLogger::WriteTo (pTarget, m_pHeapName,
+				  "bucket %6lu: %5u live (peak %5u), %5u free",
+				  (unsigned long) Bucket[i].nSize, Bucket[i].nCount,
+				  Bucket[i].nMaxCount, Bucket[i].nFreeCount);
+	}
+
+	CLogger::WriteTo (pTarget, m_pHeapName, "large blocks: %5u live (peak %5u)",
+			  Bucket[nBuckets].nCount, Bucket[nBuckets].nMaxCount);
+
+	CAllocationSites::Report (m_pHeapName, pSnapshot, pTarget, nMaxSites);
+
+	delete [] pSnapshot;
+}
+
+#endif
@@ -2,7 +2,7 @@
 // i2ssoundbasedevice.cpp
 //
 // Supports:
-//	BCM283x/BCM2711 I2S output
+//	BCM283x/BCM2711 I2S output and input
 //	two 24-bit audio channels
 //	sample rate up to 192 KHz
 //	tested with PCM5102A DAC only
@@ -46,9 +46,11 @@
 //
 #define CS_A_STBY		(1 << 25)
 #define CS_A_SYNC		(1 << 24)
+#define CS_A_RXSEX		(1 << 23)
 #define CS_A_TXE		(1 << 21)
 #define CS_A_TXD		(1 << 19)
 #define CS_A_TXW		(1 << 17)
+#define CS_A_RXERR		(1 << 16)
 #define CS_A_TXERR		(1 << 15)
 #define CS_A_TXSYNC		(1 << 13)
 #define CS_A_DMAEN		(1 << 9)
@@ -56,6 +58,7 @@
 #define CS_A_RXCLR		(1 << 4)
 #define CS_A_TXCLR		(1 << 3)
 #define CS_A_TXON		(1 << 2)
+#define CS_A_RXON		(1 << 1)
 #define CS_A_EN			(1 << 0)
 
 #define MODE_A_CLKI		(1 << 22)
@@ -63,7 +66,7 @@
 #define MODE_A_FLEN__SHIFT	10
 #define MODE_A_FSLEN__SHIFT	0
 
-#define TXC_A_CH1WEX		(1 << 31)
+#define TXC_A_CH1WEX		(1 << 31)		// RXC_A has the same layout
 #define TXC_A_CH1EN		(1 << 30)
 #define TXC_A_CH1POS__SHIFT	20
 #define TXC_A_CH1WID__SHIFT	16
@@ -123,27 +126,78 @@
 
 CI2SSoundBaseDevice::CI2SSoundBaseDevice (CInterruptSystem *pInterrupt,
 					  unsigned	    nSampleRate,
-					  unsigned	    nChunkSize)
+					  unsigned	    nChunkSize,
+					  unsigned	    nPeriods,
+					  TI2SDeviceMode    DeviceMode)
 :	CSoundBaseDevice (SoundFormatSigned24, 0, nSampleRate),
 	m_pInterruptSystem (pInterrupt),
 	m_nChunkSize (nChunkSize),
 	m_PCMCLKPin (18, GPIOModeAlternateFunction0),
 	m_PCMFSPin (19, GPIOModeAlternateFunction0),
-	m_PCMDOUTPin (21, GPIOModeAlternateFunction0),
 	m_Clock (GPIOClockPCM, GPIOClockSourcePLLD),
+	m_bOutput (DeviceMode != I2SDeviceModeRXOnly),
+	m_bInput (DeviceMode != I2SDeviceModeTXOnly),
 	m_bIRQConnected (FALSE),
+	m_bRXIRQConnected (FALSE),
 	m_State (I2SSoundIdle),
-	m_nDMAChannel (CMachineInfo::Get ()->AllocateDMAChannel (DMA_CHANNEL_LITE))
+	m_nDMAChannel (DMA_CHANNEL_NONE),
+	m_nPeriods (nPeriods),
+	m_nXRuns (0),
+	m_nRXDMAChannel (DMA_CHANNEL_NONE),
+	m_nRXXRuns (0)
 {
 	assert (m_pInterruptSystem != 0);
 	assert (m_nChunkSize >= 32);
 	assert ((m_nChunkSize & 1) == 0);
+	assert (2 <= m_nPeriods && m_nPeriods <= SOUND_MAX_PERIODS);
+	assert (DeviceMode < I2SDeviceModeUnknown);
 
-	// setup and concatenate DMA buffers and control blocks
-	SetupDMAControlBlock (0);
-	SetupDMAControlBlock (1);
-	m_pControlBlock[0]->nNextControlBlockAddress = BUS_ADDRESS ((uintptr) m_pControlBlock[1]);
-	m_pControlBlock[1]->nNextControlBlockAddress = BUS_ADDRESS ((uintptr) m_pControlBlock[0]);
+	// setup DMA buffers and control blocks (output ring is concatenated in Start())
+	for (unsigned i = 0; i < m_nPeriods; i++)
+	{
+		m_pDMABuffer[i] = 0;
+		m_pControlBlockBuffer[i] = 0;
+		m_pControlBlock[i] = 0;
+
+		m_pRXBuffer[i] = 0;
+		m_pRXControlBlockBuffer[i] = 0;
+		m_pRXControlBlock[i] = 0;
+	}
+
+	if (m_bOutput)
+	{
+		m_PCMDOUTPin.AssignPin (21);
+		m_PCMDOUTPin.SetMode (GPIOModeAlternateFunction0);
+
+		m_nDMAChannel = CMachineInfo::Get ()->AllocateDMAChannel (DMA_CHANNEL_LITE);
+
+		for (unsigned i = 0; i < m_nPeriods; i++)
+		{
+			SetupDMAControlBlock (i);
+		}
+	}
+
+	if (m_bInput)
+	{
+		m_PCMDINPin.AssignPin (20);
+		m_PCMDINPin.SetMode (GPIOModeAlternateFunction0);
+
+		m_nRXDMAChannel = CMachineInfo::Get ()->AllocateDMAChannel (DMA_CHANNEL_LITE);
+
+		for (unsigned i = 0; i < m_nPeriods; i++)
+		{
+			SetupRXDMAControlBlock (i);
+		}
+
+		for (unsigned i = 0; i < m_nPeriods; i++)
+		{
+			m_pRXControlBlock[i]->nNextControlBlockAddress =
+				BUS_ADDRESS ((uintptr) m_pRXControlBlock[(i+1) % m_nPeriods]);
+
+			CleanAndInvalidateDataCacheRange ((uintptr) m_pRXControlBlock[i],
+							  sizeof (TDMAControlBlock));
+		}
+	}
 
 	// start clock and I2S device
 	unsigned nClockFreq = CMachineInfo::Get ()->GetGPIOClockSourceRate (GPIOClockSourcePLLD);
@@ -164,17 +218,33 @@ CI2SSoundBaseDevice::CI2SSoundBaseDevice (CInterruptSystem *pInterrupt,
 
 	RunI2S ();
 
-	// enable and reset DMA channel
+	// enable and reset DMA channel(s)
 	PeripheralEntry ();
 
-	assert (m_nDMAChannel <= DMA_CHANNEL_MAX);
-	write32 (ARM_DMA_ENABLE, read32 (ARM_DMA_ENABLE) | (1 << m_nDMAChannel));
-	CTimer::SimpleusDelay (1000);
+	if (m_bOutput)
+	{
+		assert (m_nDMAChannel <= DMA_CHANNEL_MAX);
+		write32 (ARM_DMA_ENABLE, read32 (ARM_DMA_ENABLE) | (1 << m_nDMAChannel));
+		CTimer::SimpleusDelay (1000);
 
-	write32 (ARM_DMACHAN_CS (m_nDMAChannel), CS_RESET);
-	while (read32 (ARM_DMACHAN_CS (m_nDMAChannel)) & CS_RESET)
+		write32 (ARM_DMACHAN_CS (m_nDMAChannel), CS_RESET);
+		while (read32 (ARM_DMACHAN_CS (m_nDMAChannel)) & CS_RESET)
+		{
+			// do nothing
+		}
+	}
+
+	if (m_bInput)
 	{
-		// do nothing
+		assert (m_nRXDMAChannel <= DMA_CHANNEL_MAX);
+		write32 (ARM_DMA_ENABLE, read32 (ARM_DMA_ENABLE) | (1 << m_nRXDMAChannel));
+		CTimer::SimpleusDelay (1000);
+
+		write32 (ARM_DMACHAN_CS (m_nRXDMAChannel), CS_RESET);
+		while (read32 (ARM_DMACHAN_CS (m_nRXDMAChannel)) & CS_RESET)
+		{
+			// do nothing
+		}
 	}
 
 	PeripheralExit ();
@@ -191,45 +261,79 @@ CI2SSoundBaseDevice::~CI2SSoundBaseDevice (void)
 	// stop I2S device and clock
 	StopI2S ();
 
-	// reset and disable DMA channel
+	// reset and disable DMA channel(s)
 	PeripheralEntry ();
 
-	assert (m_nDMAChannel <= DMA_CHANNEL_MAX);
-
-	write32 (ARM_DMACHAN_CS (m_nDMAChannel), CS_RESET);
-	while (read32 (ARM_DMACHAN_CS (m_nDMAChannel)) & CS_RESET)
+	if (m_bOutput)
 	{
-		// do nothing
+		assert (m_nDMAChannel <= DMA_CHANNEL_MAX);
+
+		write32 (ARM_DMACHAN_CS (m_nDMAChannel), CS_RESET);
+		while (read32 (ARM_DMACHAN_CS (m_nDMAChannel)) & CS_RESET)
+		{
+			// do nothing
+		}
+
+		write32 (ARM_DMA_ENABLE, read32 (ARM_DMA_ENABLE) & ~(1 << m_nDMAChannel));
 	}
 
-	write32 (ARM_DMA_ENABLE, read32 (ARM_DMA_ENABLE) & ~(1 << m_nDMAChannel));
+	if (m_bInput)
+	{
+		assert (m_nRXDMAChannel <= DMA_CHANNEL_MAX);
+
+		write32 (ARM_DMACHAN_CS (m_nRXDMAChannel), CS_RESET);
+		while (read32 (ARM_DMACHAN_CS (m_nRXDMAChannel)) & CS_RESET)
+		{
+			// do nothing
+		}
+
+		write32 (ARM_DMA_ENABLE, read32 (ARM_DMA_ENABLE) & ~(1 << m_nRXDMAChannel));
+	}
 
 	PeripheralExit ();
 
-	// disconnect IRQ
+	// disconnect IRQ(s)
 	assert (m_pInterruptSystem != 0);
 	if (m_bIRQConnected)
 	{
 		m_pInterruptSystem->DisconnectIRQ (ARM_IRQ_DMA0+m_nDMAChannel);
 	}
 
+	if (m_bRXIRQConnected)
+	{
+		m_pInterruptSystem->DisconnectIRQ (ARM_IRQ_DMA0+m_nRXDMAChannel);
+	}
+
 	m_pInterruptSystem = 0;
 
-	// free DMA channel
-	CMachineInfo::Get ()->FreeDMAChannel (m_nDMAChannel);
+	// free DMA channel(s)
+	if (m_bOutput)
+	{
+		CMachineInfo::Get ()->FreeDMAChannel (m_nDMAChannel);
+	}
+
+	if (m_bInput)
+	{
+		CMachineInfo::Get ()->FreeDMAChannel (m_nRXDMAChannel);
+	}
 
 	// free buffers
-	m_pControlBlock[0] = 0;
-	m_pControlBlock[1] = 0;
-	delete [] m_pControlBlockBuffer[0];
-	m_pControlBlockBuffer[0] = 0;
-	delete [] m_pControlBlockBuffer[1];
-	m_pControlBlockBuffer[1] = 0;
-
-	delete [] m_pDMABuffer[0];
-	m_pDMABuffer[0] = 0;
-	delete [] m_pDMABuffer[1];
-	m_pDMABuffer[1] = 0;
+	for (unsigned i = 0; i < m_nPeriods; i++)
+	{
+		m_pControlBlock[i] = 0;
+		delete [] m_pControlBlockBuffer[i];
+		m_pControlBlockBuffer[i] = 0;
+
+		delete [] m_pDMABuffer[i];
+		m_pDMABuffer[i] = 0;
+
+		m_pRXControlBlock[i] = 0;
+		delete [] m_pRXControlBlockBuffer[i];
+		m_pRXControlBlockBuffer[i] = 0;
+
+		delete [] m_pRXBuffer[i];
+		m_pRXBuffer[i] = 0;
+	}
 }
 
 int CI2SSoundBaseDevice::GetRangeMin (void) const
@@ -246,30 +350,85 @@ boolean CI2SSoundBaseDevice::Start (void)
 {
 	assert (m_State == I2SSoundIdle);
 
-	// fill buffer 0
-	m_nNextBuffer = 0;
-
-	if (!GetNextChunk (TRUE))
+	if (m_bOutput)
 	{
-		return FALSE;
+		// concatenate the control blocks to a ring (may have been opened on termination)
+		for (unsigned i = 0; i < m_nPeriods; i++)
+		{
+			assert (m_pControlBlock[i] != 0);
+			m_pControlBlock[i]->nNextControlBlockAddress =
+				BUS_ADDRESS ((uintptr) m_pControlBlock[(i+1) % m_nPeriods]);
+		}
+
+		// fill buffer 0
+		m_nNextBuffer = 0;
+
+		if (!GetNextChunk (TRUE))
+		{
+			return FALSE;
+		}
 	}
 
 	m_State = I2SSoundRunning;
 
-	// connect IRQ
-	assert (m_nDMAChannel <= DMA_CHANNEL_MAX);
+	if (m_bOutput)
+	{
+		// fill the other buffers, before the DMA is started
+		while (m_nNextBuffer != 0)
+		{
+			if (!GetNextChunk ())
+			{
+				StopAfterPeriod (m_nNextBuffer-1);
+
+				m_State = I2SSoundTerminating;
 
-	if (!m_bIRQConnected)
+				break;
+			}
+		}
+	}
+
+	if (m_bInput)
 	{
-		assert (m_pInterruptSystem != 0);
+		// the DMA controller must not find dirty cache lines later
+		for (unsigned i = 0; i < m_nPeriods; i++)
+		{
+			CleanAndInvalidateDataCacheRange ((uintptr) m_pRXBuffer[i],
+							  m_nChunkSize * sizeof (u32));
+		}
+
+		m_nRXNextBuffer = 0;
+	}
+
+	// connect IRQ(s)
+	assert (m_pInterruptSystem != 0);
+
+	if (   m_bOutput
+	    && !m_bIRQConnected)
+	{
+		assert (m_nDMAChannel <= DMA_CHANNEL_MAX);
 		m_pInterruptSystem->ConnectIRQ (ARM_IRQ_DMA0+m_nDMAChannel, InterruptStub, this);
 
 		m_bIRQConnected = TRUE;
 	}
 
-	// enable I2S DMA operation
+	if (   m_bInput
+	    && !m_bRXIRQConnected)
+	{
+		assert (m_nRXDMAChannel <= DMA_CHANNEL_MAX);
+		m_pInterruptSystem->ConnectIRQ (ARM_IRQ_DMA0+m_nRXDMAChannel, RXInterruptStub, this);
+
+		m_bRXIRQConnected = TRUE;
+	}
+
+	// Stop TX and RX and clear the FIFOs. Both directions are started with one
+	// register write below, so that input and output start in the same frame.
 	PeripheralEntry ();
 
+	write32 (ARM_PCM_CS_A, read32 (ARM_PCM_CS_A) & ~(CS_A_TXON | CS_A_RXON));
+	write32 (ARM_PCM_CS_A, read32 (ARM_PCM_CS_A) | CS_A_TXCLR | CS_A_RXCLR);
+	CTimer::Get ()->usDelay (10);
+
+	// enable I2S DMA operation
 	if (m_nChunkSize < 64)
 	{
 		write32 (ARM_PCM_DREQ_A,   (read32 (ARM_PCM_DREQ_A) & ~DREQ_A_TX__MASK)
@@ -283,35 +442,48 @@ boolean CI2SSoundBaseDevice::Start (void)
 	// start DMA
 	PeripheralEntry ();
 
-	assert (!(read32 (ARM_DMACHAN_CS (m_nDMAChannel)) & CS_INT));
-	assert (!(read32 (ARM_DMA_INT_STATUS) & (1 << m_nDMAChannel)));
+	if (m_bOutput)
+	{
+		assert (!(read32 (ARM_DMACHAN_CS (m_nDMAChannel)) & CS_INT));
+		assert (!(read32 (ARM_DMA_INT_STATUS) & (1 << m_nDMAChannel)));
 
-	assert (m_pControlBlock[0] != 0);
-	write32 (ARM_DMACHAN_CONBLK_AD (m_nDMAChannel), BUS_ADDRESS ((uintptr) m_pControlBlock[0]));
+		assert (m_pControlBlock[0] != 0);
+		write32 (ARM_DMACHAN_CONBLK_AD (m_nDMAChannel),
+			 BUS_ADDRESS ((uintptr) m_pControlBlock[0]));
 
-	write32 (ARM_DMACHAN_CS (m_nDMAChannel),   CS_WAIT_FOR_OUTSTANDING_WRITES
-					         | (DEFAULT_PANIC_PRIORITY << CS_PANIC_PRIORITY_SHIFT)
-					         | (DEFAULT_PRIORITY << CS_PRIORITY_SHIFT)
-					         | CS_ACTIVE);
+		write32 (ARM_DMACHAN_CS (m_nDMAChannel),   CS_WAIT_FOR_OUTSTANDING_WRITES
+						         | (DEFAULT_PANIC_PRIORITY << CS_PANIC_PRIORITY_SHIFT)
+						         | (DEFAULT_PRIORITY << CS_PRIORITY_SHIFT)
+						         | CS_ACTIVE);
+	}
+
+	if (m_bInput)
+	{
+		assert (!(read32 (ARM_DMACHAN_CS (m_nRXDMAChannel)) & CS_INT));
+		assert (!(read32 (ARM_DMA_INT_STATUS) & (1 << m_nRXDMAChannel)));
+
+		assert (m_pRXControlBlock[0] != 0);
+		write32 (ARM_DMACHAN_CONBLK_AD (m_nRXDMAChannel),
+			 BUS_ADDRESS ((uintptr) m_pRXControlBlock[0]));
+
+		write32 (ARM_DMACHAN_CS (m_nRXDMAChannel),   CS_WAIT_FOR_OUTSTANDING_WRITES
+							   | (DEFAULT_PANIC_PRIORITY << CS_PANIC_PRIORITY_SHIFT)
+							   | (DEFAULT_PRIORITY << CS_PRIORITY_SHIFT)
+							   | CS_ACTIVE);
+	}
 
 	PeripheralExit ();
 
-	// fill buffer 1
-	if (!GetNextChunk ())
-	{
-		m_SpinLock.Acquire ();
+	// let the DMA controller fill the TX FIFO, then start the enabled direction(s)
+	CTimer::Get ()->usDelay (10);
 
-		if (m_State == I2SSoundRunning)
-		{
-			PeripheralEntry ();
-			write32 (ARM_DMACHAN_NEXTCONBK (m_nDMAChannel), 0);
-			PeripheralExit ();
+	PeripheralEntry ();
 
-			m_State = I2SSoundTerminating;
-		}
+	write32 (ARM_PCM_CS_A,   read32 (ARM_PCM_CS_A)
+			       | (m_bOutput ? CS_A_TXON : 0)
+			       | (m_bInput ? CS_A_RXON : 0));
 
-		m_SpinLock.Release ();
-	}
+	PeripheralExit ();
 
 	return TRUE;
 }
@@ -361,7 +533,10 @@ boolean CI2SSoundBaseDevice::GetNextChunk (boolean bFirstCall)
 	CleanAndInvalidateDataCacheRange ((uintptr) m_pDMABuffer[m_nNextBuffer], nTransferLength);
 	CleanAndInvalidateDataCacheRange ((uintptr) m_pControlBlock[m_nNextBuffer], sizeof (TDMAControlBlock));
 
-	m_nNextBuffer ^= 1;
+	if (++m_nNextBuffer == m_nPeriods)
+	{
+		m_nNextBuffer = 0;
+	}
 
 	return TRUE;
 }
@@ -387,6 +562,14 @@ void CI2SSoundBaseDevice::RunI2S (void)
 				| TXC_A_CH2EN
 				| ((CHANLEN+1) << TXC_A_CH2POS__SHIFT)
 				| (0 << TXC_A_CH2WID__SHIFT));
+	write32 (ARM_PCM_RXC_A,   TXC_A_CH1WEX
+				| TXC_A_CH1EN
+				| (1 << TXC_A_CH1POS__SHIFT)
+				| (0 << TXC_A_CH1WID__SHIFT)
+				| TXC_A_CH2WEX
+				| TXC_A_CH2EN
+				| ((CHANLEN+1) << TXC_A_CH2POS__SHIFT)
+				| (0 << TXC_A_CH2WID__SHIFT));
 	write32 (ARM_PCM_MODE_A,   MODE_A_CLKI
 				 | MODE_A_FSI
 				 | ((CHANS*CHANLEN-1) << MODE_A_FLEN__SHIFT)
@@ -396,12 +579,9 @@ void CI2SSoundBaseDevice::RunI2S (void)
 	write32 (ARM_PCM_CS_A, read32 (ARM_PCM_CS_A) | CS_A_STBY);
 	CTimer::Get ()->usDelay (50);
 
-	// enable I2S
-	write32 (ARM_PCM_CS_A, read32 (ARM_PCM_CS_A) | CS_A_EN);
-	CTimer::Get ()->usDelay (10);
-
-	// enable TX
-	write32 (ARM_PCM_CS_A, read32 (ARM_PCM_CS_A) | CS_A_TXON);
+	// enable I2S, received 24-bit samples are sign extended,
+	// TX and RX are enabled in Start()
+	write32 (ARM_PCM_CS_A, read32 (ARM_PCM_CS_A) | CS_A_EN | CS_A_RXSEX);
 	CTimer::Get ()->usDelay (10);
 
 	PeripheralExit ();
@@ -421,11 +601,13 @@ void CI2SSoundBaseDevice::StopI2S (void)
 
 void CI2SSoundBaseDevice::InterruptHandler (void)
 {
-	assert (m_State != I2SSoundIdle);
 	assert (m_nDMAChannel <= DMA_CHANNEL_MAX);
 
 	PeripheralEntry ();
 
+	// read before acknowledging the interrupt, so that no completed period is missed
+	u32 nControlBlockAddress = read32 (ARM_DMACHAN_CONBLK_AD (m_nDMAChannel));
+
 #ifndef NDEBUG
 	u32 nIntStatus = read32 (ARM_DMA_INT_STATUS);
 #endif
@@ -439,6 +621,11 @@ void CI2SSoundBaseDevice::InterruptHandler (void)
 
 	PeripheralExit ();
 
+	if (m_State == I2SSoundIdle)		// completion was already detected in state Terminating
+	{
+		return;
+	}
+
 	if (nCS & CS_ERROR)
 	{
 		m_State = I2SSoundError;
@@ -451,22 +638,43 @@ void CI2SSoundBaseDevice::InterruptHandler (void)
 	switch (m_State)
 	{
 	case I2SSoundRunning:
-		if (GetNextChunk ())
+		if (RefillPeriods (nControlBlockAddress))
 		{
 			break;
 		}
 		// fall through
 
 	case I2SSoundCancelled:
-		PeripheralEntry ();
-		write32 (ARM_DMACHAN_NEXTCONBK (m_nDMAChannel), 0);
-		PeripheralExit ();
+		if (m_State == I2SSoundCancelled)
+		{
+			// stop after the currently active period
+			m_nLastPeriod = m_nPeriods;
+
+			PeripheralEntry ();
+			write32 (ARM_DMACHAN_NEXTCONBK (m_nDMAChannel), 0);
+			PeripheralExit ();
+		}
 
 		m_State = I2SSoundTerminating;
 		break;
 
 	case I2SSoundTerminating:
-		m_State = I2SSoundIdle;
+		// more than one period may be pending, wait until the DMA controller stopped
+		PeripheralEntry ();
+
+		if (   !(read32 (ARM_DMACHAN_CS (m_nDMAChannel)) & CS_ACTIVE)
+		    || (   GetPeriodIndex (read32 (ARM_DMACHAN_CONBLK_AD (m_nDMAChannel))) == m_nLastPeriod
+			&& read32 (ARM_DMACHAN_TXFR_LEN (m_nDMAChannel)) == 0))
+		{
+			if (m_bInput)
+			{
+				StopRX ();
+			}
+
+			m_State = I2SSoundIdle;
+		}
+
+		PeripheralExit ();
 		break;
 
 	default:
@@ -477,6 +685,81 @@ void CI2SSoundBaseDevice::InterruptHandler (void)
 	m_SpinLock.Release ();
 }
 
+boolean CI2SSoundBaseDevice::RefillPeriods (u32 nControlBlockAddress)
+{
+	// more than one period has been completed, if the interrupt was handled late
+	unsigned nCompleted = 1;
+
+	unsigned nActive = GetPeriodIndex (nControlBlockAddress);
+	if (nActive < m_nPeriods)
+	{
+		nCompleted = (nActive + m_nPeriods - m_nNextBuffer) % m_nPeriods;
+		if (nCompleted == 0)
+		{
+			// The DMA controller wrapped around and replays the period, which
+			// should have been refilled. Continue with the following one.
+			m_nXRuns++;
+
+			if (++m_nNextBuffer == m_nPeriods)
+			{
+				m_nNextBuffer = 0;
+			}
+
+			nCompleted = m_nPeriods-1;
+		}
+	}
+
+	for (; nCompleted > 0; nCompleted--)
+	{
+		if (!GetNextChunk ())
+		{
+			// no more sound data, stop after the last filled period
+			StopAfterPeriod ((m_nNextBuffer + m_nPeriods-1) % m_nPeriods);
+
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+unsigned CI2SSoundBaseDevice::GetPeriodIndex (u32 nControlBlockAddress, boolean bRX) const
+{
+	TDMAControlBlock * const *ppControlBlock = bRX ? m_pRXControlBlock : m_pControlBlock;
+
+	for (unsigned i = 0; i < m_nPeriods; i++)
+	{
+		assert (ppControlBlock[i] != 0);
+		if (nControlBlockAddress == (u32) BUS_ADDRESS ((uintptr) ppControlBlock[i]))
+		{
+			return i;
+		}
+	}
+
+	return m_nPeriods;		// not one of our control blocks (e.g. 0 if stopped)
+}
+
+void CI2SSoundBaseDevice::StopAfterPeriod (unsigned nPeriod)
+{
+	assert (nPeriod < m_nPeriods);
+	m_nLastPeriod = nPeriod;
+
+	assert (m_pControlBlock[nPeriod] != 0);
+	m_pControlBlock[nPeriod]->nNextControlBlockAddress = 0;
+
+	CleanAndInvalidateDataCacheRange ((uintptr) m_pControlBlock[nPeriod], sizeof (TDMAControlBlock));
+
+	// the control block may have been loaded by the DMA controller already
+	PeripheralEntry ();
+
+	if (GetPeriodIndex (read32 (ARM_DMACHAN_CONBLK_AD (m_nDMAChannel))) == nPeriod)
+	{
+		write32 (ARM_DMACHAN_NEXTCONBK (m_nDMAChannel), 0);
+	}
+
+	PeripheralExit ();
+}
+
 void CI2SSoundBaseDevice::InterruptStub (void *pParam)
 {
 	CI2SSoundBaseDevice *pThis = (CI2SSoundBaseDevice *) pParam;
@@ -487,7 +770,7 @@ void CI2SSoundBaseDevice::InterruptStub (void *pParam)
 
 void CI2SSoundBaseDevice::SetupDMAControlBlock (unsigned nID)
 {
-	assert (nID <= 1);
+	assert (nID < SOUND_MAX_PERIODS);
 
 	m_pDMABuffer[nID] = new (HEAP_DMA30) u32[m_nChunkSize];
 	assert (m_pDMABuffer[nID] != 0);
@@ -509,3 +792,135 @@ void CI2SSoundBaseDevice::SetupDMAControlBlock (unsigned nID)
 	m_pControlBlock[nID]->nReserved[0]	       = 0;
 	m_pControlBlock[nID]->nReserved[1]	       = 0;
 }
+
+void CI2SSoundBaseDevice::RXInterruptHandler (void)
+{
+	assert (m_nRXDMAChannel <= DMA_CHANNEL_MAX);
+
+	PeripheralEntry ();
+
+	// read before acknowledging the interrupt, so that no completed period is missed
+	u32 nControlBlockAddress = read32 (ARM_DMACHAN_CONBLK_AD (m_nRXDMAChannel));
+
+	write32 (ARM_DMA_INT_STATUS, 1 << m_nRXDMAChannel);
+
+	u32 nCS = read32 (ARM_DMACHAN_CS (m_nRXDMAChannel));
+	write32 (ARM_DMACHAN_CS (m_nRXDMAChannel), nCS);	// reset CS_INT
+
+	PeripheralExit ();
+
+	if (m_State == I2SSoundIdle)		// input has been stopped already
+	{
+		return;
+	}
+
+	if (nCS & CS_ERROR)
+	{
+		m_State = I2SSoundError;
+
+		return;
+	}
+
+	m_SpinLock.Acquire ();
+
+	if (   !m_bOutput
+	    && m_State == I2SSoundCancelled)
+	{
+		StopRX ();
+
+		m_State = I2SSoundIdle;
+	}
+	else
+	{
+		// more than one period has been completed, if the interrupt was handled late
+		unsigned nCompleted = 1;
+
+		unsigned nActive = GetPeriodIndex (nControlBlockAddress, TRUE);
+		if (nActive < m_nPeriods)
+		{
+			nCompleted = (nActive + m_nPeriods - m_nRXNextBuffer) % m_nPeriods;
+			if (nCompleted == 0)
+			{
+				// The DMA controller wrapped around and overwrites the period,
+				// which has not been handed over. Continue with the following one.
+				m_nRXXRuns++;
+
+				if (++m_nRXNextBuffer == m_nPeriods)
+				{
+					m_nRXNextBuffer = 0;
+				}
+
+				nCompleted = m_nPeriods-1;
+			}
+		}
+
+		for (; nCompleted > 0; nCompleted--)
+		{
+			u32 *pBuffer = m_pRXBuffer[m_nRXNextBuffer];
+			assert (pBuffer != 0);
+
+			CleanAndInvalidateDataCacheRange ((uintptr) pBuffer, m_nChunkSize * sizeof (u32));
+
+			PutChunk (pBuffer, m_nChunkSize);
+
+			if (++m_nRXNextBuffer == m_nPeriods)
+			{
+				m_nRXNextBuffer = 0;
+			}
+		}
+	}
+
+	m_SpinLock.Release ();
+}
+
+void CI2SSoundBaseDevice::RXInterruptStub (void *pParam)
+{
+	CI2SSoundBaseDevice *pThis = (CI2SSoundBaseDevice *) pParam;
+	assert (pThis != 0);
+
+	pThis->RXInterruptHandler ();
+}
+
+void CI2SSoundBaseDevice::StopRX (void)
+{
+	PeripheralEntry ();
+
+	write32 (ARM_PCM_CS_A, read32 (ARM_PCM_CS_A) & ~CS_A_RXON);
+
+	assert (m_nRXDMAChannel <= DMA_CHANNEL_MAX);
+	write32 (ARM_DMACHAN_CS (m_nRXDMAChannel), CS_RESET);
+	while (read32 (ARM_DMACHAN_CS (m_nRXDMAChannel)) & CS_RESET)
+	{
+		// do nothing
+	}
+
+	write32 (ARM_DMA_INT_STATUS, 1 << m_nRXDMAChannel);
+
+	PeripheralExit ();
+}
+
+void CI2SSoundBaseDevice::SetupRXDMAControlBlock (unsigned nID)
+{
+	assert (nID < SOUND_MAX_PERIODS);
+
+	m_pRXBuffer[nID] = new (HEAP_DMA30) u32[m_nChunkSize];
+	assert (m_pRXBuffer[nID] != 0);
+
+	m_pRXControlBlockBuffer[nID] = new (HEAP_DMA30) u8[sizeof (TDMAControlBlock) + 31];
+	assert (m_pRXControlBlockBuffer[nID] != 0);
+	m_pRXControlBlock[nID] = (TDMAControlBlock *) (((uintptr) m_pRXControlBlockBuffer[nID] + 31) & ~31);
+
+	m_pRXControlBlock[nID]->nTransferInformation     =   (DREQSourcePCMRX << TI_PERMAP_SHIFT)
+							   | (DEFAULT_BURST_LENGTH << TI_BURST_LENGTH_SHIFT)
+							   | TI_SRC_DREQ
+							   | TI_DEST_WIDTH
+							   | TI_DEST_INC
+							   | TI_WAIT_RESP
+							   | TI_INTEN;
+	m_pRXControlBlock[nID]->nSourceAddress           = (ARM_PCM_FIFO_A & 0xFFFFFF) + GPU_IO_BASE;
+	m_pRXControlBlock[nID]->nDestinationAddress      = BUS_ADDRESS ((uintptr) m_pRXBuffer[nID]);
+	m_pRXControlBlock[nID]->nTransferLength          = m_nChunkSize * sizeof (u32);
+	m_pRXControlBlock[nID]->n2DModeStride            = 0;
+	m_pRXControlBlock[nID]->nReserved[0]	         = 0;
+	m_pRXControlBlock[nID]->nReserved[1]	         = 0;
+}
@@ -2,7 +2,7 @@
 // interrupt.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2014-2019  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2014-2020  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -20,6 +20,7 @@
 #include <circle/interrupt.h>
 #include <circle/synchronize.h>
 #include <circle/multicore.h>
+#include <circle/tracer.h>
 #include <circle/bcm2835.h>
 #include <circle/bcm2836.h>
 #include <circle/memio.h>
@@ -29,6 +30,23 @@
 
 #define ARM_IC_IRQ_REGS		3
 
+#ifdef ARM_ALLOW_MULTI_CORE
+	#define THIS_CORE()	CMultiCoreSupport::ThisCore ()
+#else
+	#define THIS_CORE()	0
+#endif
+
+#if RASPPI >= 2
+	// per core registers of the ARM local peripherals
+	#define ARM_LOCAL_TIMER_INT_CONTROL(core)	(ARM_LOCAL_TIMER_INT_CONTROL0 + 4*(core))
+	#define ARM_LOCAL_IRQ_PENDING(core)		(ARM_LOCAL_IRQ_PENDING0 + 4*(core))
+
+	// local IRQs implemented so far and their bit in the timer interrupt control register
+	#define ARM_LOCAL_TIMER_IRQ_MASK(irq)	(  (irq) == ARM_IRQLOCAL0_CNTPNS	\
+						 ? 1 << 1				\
+						 : 1 << 3)
+#endif
+
 #define ARM_IC_IRQ_PENDING(irq)	(  (irq) < ARM_IRQ2_BASE	\
 				 ? ARM_IC_IRQ_PENDING_1		\
 				 : ((irq) < ARM_IRQBASIC_BASE	\
@@ -56,6 +74,11 @@ CInterruptSystem::CInterruptSystem (void)
 		m_pParam[nIRQ] = 0;
 	}
 
+	for (unsigned nCore = 0; nCore < IRQ_CORES; nCore++)
+	{
+		m_nLastIRQ[nCore] = IRQ_LINES;
+	}
+
 	s_pThis = this;
 }
 
@@ -173,9 +196,11 @@ void CInterruptSystem::EnableIRQ (unsigned nIRQ)
 	else
 	{
 #if RASPPI >= 2
-		assert (nIRQ == ARM_IRQLOCAL0_CNTPNS);	// the only implemented local IRQ so far
-		write32 (ARM_LOCAL_TIMER_INT_CONTROL0,
-			 read32 (ARM_LOCAL_TIMER_INT_CONTROL0) | (1 << 1));
+		assert (   nIRQ == ARM_IRQLOCAL0_CNTPNS
+			|| nIRQ == ARM_IRQLOCAL0_CNTV);	// the only implemented local IRQs so far
+		unsigned nCore = THIS_CORE ();
+		write32 (ARM_LOCAL_TIMER_INT_CONTROL (nCore),
+			 read32 (ARM_LOCAL_TIMER_INT_CONTROL (nCore)) | ARM_LOCAL_TIMER_IRQ_MASK (nIRQ));
 #else
 		assert (0);
 #endif
@@ -197,9 +222,11 @@ void CInterruptSystem::DisableIRQ (unsigned nIRQ)
 	else
 	{
 #if RASPPI >= 2
-		assert (nIRQ == ARM_IRQLOCAL0_CNTPNS);	// the only implemented local IRQ so far
-		write32 (ARM_LOCAL_TIMER_INT_CONTROL0,
-			 read32 (ARM_LOCAL_TIMER_INT_CONTROL0) & ~(1 << 1));
+		assert (   nIRQ == ARM_IRQLOCAL0_CNTPNS
+			|| nIRQ == ARM_IRQLOCAL0_CNTV);	// the only implemented local IRQs so far
+		unsigned nCore = THIS_CORE ();
+		write32 (ARM_LOCAL_TIMER_INT_CONTROL (nCore),
+			 read32 (ARM_LOCAL_TIMER_INT_CONTROL (nCore)) & ~ARM_LOCAL_TIMER_IRQ_MASK (nIRQ));
 #else
 		assert (0);
 #endif
@@ -228,6 +255,20 @@ void CInterruptSystem::DisableFIQ (void)
 	PeripheralExit ();
 }
 
+unsigned CInterruptSystem::GetLastIRQ (void) const
+{
+	return m_nLastIRQ[THIS_CORE ()];
+}
+
+#ifdef IRQ_STATISTICS
+
+CIRQStatistics *CInterruptSystem::GetStatistics (void)
+{
+	return &m_Statistics;
+}
+
+#endif
+
 CInterruptSystem *CInterruptSystem::Get (void)
 {
 	assert (s_pThis != 0);
@@ -241,7 +282,22 @@ boolean CInterruptSystem::CallIRQHandler (unsigned nIRQ)
 
 	if (pHandler != 0)
 	{
+		TRACE_POINT (TracePhaseBegin, TRACER_EVENT_IRQ, nIRQ, 0);
+
+#ifdef IRQ_STATISTICS
+		unsigned nCore = THIS_CORE ();
+		u64 ullStartTicks = m_Statistics.EnterHandler (nCore);
+#endif
+
 		(*pHandler) (m_pParam[nIRQ]);
+
+#ifdef IRQ_STATISTICS
+		m_Statistics.LeaveHandler (nCore, nIRQ, ullStartTicks);
+#endif
+
+		TRACE_POINT (TracePhaseEnd, TRACER_EVENT_IRQ, nIRQ, 0);
+
+		m_nLastIRQ[THIS_CORE ()] = nIRQ;
 		
 		return TRUE;
 	}
@@ -258,14 +314,21 @@ void CInterruptSystem::InterruptHandler (void)
 	assert (s_pThis != 0);
 
 #if RASPPI >= 2
-	u32 nLocalPending = read32 (ARM_LOCAL_IRQ_PENDING0);
-	assert (!(nLocalPending & ~(1 << 1 | 1 << 8)));
-	if (nLocalPending & (1 << 1))		// the only implemented local IRQ so far
+	u32 nLocalPending = read32 (ARM_LOCAL_IRQ_PENDING (THIS_CORE ()));
+	assert (!(nLocalPending & ~(1 << 1 | 1 << 3 | 0xF << 4 | 1 << 8)));
+	if (nLocalPending & (1 << 1))		// the only implemented local IRQs so far
 	{
 		s_pThis->CallIRQHandler (ARM_IRQLOCAL0_CNTPNS);
 
 		return;
 	}
+
+	if (nLocalPending & (1 << 3))
+	{
+		s_pThis->CallIRQHandler (ARM_IRQLOCAL0_CNTV);
+
+		return;
+	}
 #endif
 
 #ifdef ARM_ALLOW_MULTI_CORE
@@ -22,6 +22,7 @@
 #include <circle/interrupt.h>
 #include <circle/synchronize.h>
 #include <circle/multicore.h>
+#include <circle/tracer.h>
 #include <circle/bcm2711.h>
 #include <circle/memio.h>
 #include <circle/logger.h>
@@ -29,6 +30,12 @@
 #include <circle/types.h>
 #include <assert.h>
 
+#ifdef ARM_ALLOW_MULTI_CORE
+	#define THIS_CORE()	CMultiCoreSupport::ThisCore ()
+#else
+	#define THIS_CORE()	0
+#endif
+
 // The following definitions are valid for non-secure access,
 // if not labeled otherwise.
 
@@ -94,6 +101,11 @@ CInterruptSystem::CInterruptSystem (void)
 		m_pParam[nIRQ] = 0;
 	}
 
+	for (unsigned nCore = 0; nCore < IRQ_CORES; nCore++)
+	{
+		m_nLastIRQ[nCore] = IRQ_LINES;
+	}
+
 	s_pThis = this;
 }
 
@@ -266,6 +278,20 @@ void CInterruptSystem::DisableFIQ (void)	// may be called, when FIQ is not enabl
 	}
 }
 
+unsigned CInterruptSystem::GetLastIRQ (void) const
+{
+	return m_nLastIRQ[THIS_CORE ()];
+}
+
+#ifdef IRQ_STATISTICS
+
+CIRQStatistics *CInterruptSystem::GetStatistics (void)
+{
+	return &m_Statistics;
+}
+
+#endif
+
 CInterruptSystem *CInterruptSystem::Get (void)
 {
 	assert (s_pThis != 0);
@@ -279,7 +305,22 @@ boolean CInterruptSystem::CallIRQHandler (unsigned nIRQ)
 
 	if (pHandler != 0)
 	{
+		TRACE_POINT (TracePhaseBegin, TRACER_EVENT_IRQ, nIRQ, 0);
+
+#ifdef IRQ_STATISTICS
+		unsigned nCore = THIS_CORE ();
+		u64 ullStartTicks = m_Statistics.EnterHandler (nCore);
+#endif
+
 		(*pHandler) (m_pParam[nIRQ]);
+
+#ifdef IRQ_STATISTICS
+		m_Statistics.LeaveHandler (nCore, nIRQ, ullStartTicks);
+#endif
+
+		TRACE_POINT (TracePhaseEnd, TRACER_EVENT_IRQ, nIRQ, 0);
+
+		m_nLastIRQ[THIS_CORE ()] = nIRQ;
 		
 		return TRUE;
 	}
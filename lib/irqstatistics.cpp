@@ -0,0 +1,199 @@
+//
+// irqstatistics.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2020  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/irqstatistics.h>
+#include <circle/synchronize.h>
+#include <circle/logger.h>
+#include <circle/timer.h>
+#include <circle/util.h>
+#include <assert.h>
+
+static const char FromIRQStatistics[] = "irqstat";
+
+CIRQStatistics::CIRQStatistics (void)
+{
+	memset (m_IRQ, 0, sizeof m_IRQ);
+	memset (m_Core, 0, sizeof m_Core);
+
+	m_ullResetTicks = CTimer::GetTicks64 ();
+}
+
+CIRQStatistics::~CIRQStatistics (void)
+{
+}
+
+void CIRQStatistics::Reset (void)
+{
+	EnterCritical (IRQ_LEVEL);
+
+	memset (m_IRQ, 0, sizeof m_IRQ);
+
+	for (unsigned nCore = 0; nCore < IRQ_STATISTICS_CORES; nCore++)
+	{
+		m_Core[nCore].ullIRQTicks = 0;
+		m_Core[nCore].nMaxNesting = m_Core[nCore].nNesting;
+	}
+
+	m_ullResetTicks = CTimer::GetTicks64 ();
+
+	LeaveCritical ();
+}
+
+u64 CIRQStatistics::EnterHandler (unsigned nCore)
+{
+	assert (nCore < IRQ_STATISTICS_CORES);
+	TCoreData *pCore = &m_Core[nCore];
+
+	if (++pCore->nNesting > pCore->nMaxNesting)
+	{
+		pCore->nMaxNesting = pCore->nNesting;
+	}
+
+	return CTimer::GetTicks64 ();
+}
+
+void CIRQStatistics::LeaveHandler (unsigned nCore, unsigned nIRQ, u64 ullStartTicks)
+{
+	u64 ullTicks = CTimer::GetTicks64 () - ullStartTicks;
+
+	assert (nCore < IRQ_STATISTICS_CORES);
+	assert (nIRQ < IRQ_LINES);
+	TIRQStatistics *pIRQ = &m_IRQ[nCore][nIRQ];
+
+	pIRQ->nCount++;
+	pIRQ->ullTotalTicks += ullTicks;
+	if (pIRQ->ullMaxTicks < ullTicks)
+	{
+		pIRQ->ullMaxTicks = ullTicks;
+	}
+
+	TCoreData *pCore = &m_Core[nCore];
+	assert (pCore->nNesting > 0);
+	if (--pCore->nNesting == 0)		// count nested handlers only once
+	{
+		pCore->ullIRQTicks += ullTicks;
+	}
+}
+
+boolean CIRQStatistics::GetIRQStatistics (unsigned nIRQ, TIRQStatistics *pResult) const
+{
+	assert (nIRQ < IRQ_LINES);
+	assert (pResult != 0);
+	memset (pResult, 0, sizeof *pResult);
+
+	for (unsigned nCore = 0; nCore < IRQ_STATISTICS_CORES; nCore++)
+	{
+		const TIRQStatistics *pIRQ = &m_IRQ[nCore][nIRQ];
+
+		pResult->nCount += pIRQ->nCount;
+		pResult->ullTotalTicks += pIRQ->ullTotalTicks;
+		if (pResult->ullMaxTicks < pIRQ->ullMaxTicks)
+		{
+			pResult->ullMaxTicks = pIRQ->ullMaxTicks;
+		}
+	}
+
+	return pResult->nCount > 0;
+}
+
+void CIRQStatistics::GetCoreStatistics (unsigned nCore, TIRQCoreStatistics *pResult) const
+{
+	assert (nCore < IRQ_STATISTICS_CORES);
+	assert (pResult != 0);
+
+	const TCoreData *pCore = &m_Core[nCore];
+
+	pResult->ullIRQTicks = pCore->ullIRQTicks;
+	pResult->ullElapsedTicks = CTimer::GetTicks64 () - m_ullResetTicks;
+	pResult->nNesting = pCore->nNesting;
+	pResult->nMaxNesting = pCore->nMaxNesting;
+}
+
+void CIRQStatistics::Dump (CDevice *pTarget, unsigned nMaxIRQs) const
+{
+	u64 ullTicksPerMs = CTimer::GetTicks64Frequency () / 1000;
+	assert (ullTicksPerMs > 0);
+
+	u64 ullElapsed = CTimer::GetTicks64 () - m_ullResetTicks;
+	if (ullElapsed == 0)
+	{
+		ullElapsed = 1;
+	}
+
+	CLogger::WriteTo (pTarget, FromIRQStatistics, "IRQ statistics of the last %lu ms",
+			  (unsigned long) (ullElapsed / ullTicksPerMs));
+
+	// report the IRQs in the order of their total handler time
+	boolean bReported[IRQ_LINES];
+	memset (bReported, 0, sizeof bReported);
+
+	for (unsigned i = 0; i < nMaxIRQs; i++)
+	{
+		unsigned nMaxIRQ = IRQ_LINES;
+		TIRQStatistics MaxStat;
+
+		for (unsigned nIRQ = 0; nIRQ < IRQ_LINES; nIRQ++)
+		{
+			TIRQStatistics Stat;
+			if (   !bReported[nIRQ]
+			    && GetIRQStatistics (nIRQ, &Stat)
+			    && (   nMaxIRQ == IRQ_LINES
+				|| Stat.ullTotalTicks > MaxStat.ullTotalTicks))
+			{
+				nMaxIRQ = nIRQ;
+				MaxStat = Stat;
+			}
+		}
+
+		if (nMaxIRQ == IRQ_LINES)
+		{
+			break;
+		}
+
+		bReported[nMaxIRQ] = TRUE;
+
+		u64 ullPermille = MaxStat.ullTotalTicks * 1000 / ullElapsed;
+
+		CLogger::WriteTo (pTarget, FromIRQStatistics,
+				  "IRQ %3u: %8u calls, avg %7lu ns, max %7lu ns, %3u.%u%% CPU",
+				  nMaxIRQ, MaxStat.nCount,
+				  (unsigned long) (  MaxStat.ullTotalTicks * 1000000
+						   / ullTicksPerMs / MaxStat.nCount),
+				  (unsigned long) (MaxStat.ullMaxTicks * 1000000 / ullTicksPerMs),
+				  (unsigned) (ullPermille / 10), (unsigned) (ullPermille % 10));
+	}
+
+	for (unsigned nCore = 0; nCore < IRQ_STATISTICS_CORES; nCore++)
+	{
+		TIRQCoreStatistics Stat;
+		GetCoreStatistics (nCore, &Stat);
+
+		u64 ullPermille = Stat.ullIRQTicks * 1000 / ullElapsed;
+		if (ullPermille > 1000)		// may happen after Reset() inside a handler
+		{
+			ullPermille = 1000;
+		}
+
+		CLogger::WriteTo (pTarget, FromIRQStatistics,
+				  "Core %u: %3u.%u%% in IRQ, %3u.%u%% at task level, max nesting %u",
+				  nCore, (unsigned) (ullPermille / 10), (unsigned) (ullPermille % 10),
+				  (unsigned) ((1000 - ullPermille) / 10), (unsigned) ((1000 - ullPermille) % 10),
+				  Stat.nMaxNesting);
+	}
+}
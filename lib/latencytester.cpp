@@ -18,6 +18,7 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include <circle/latencytester.h>
+#include <circle/exceptionstub.h>
 #include <circle/bcm2835.h>
 #include <circle/memio.h>
 #include <circle/synchronize.h>
@@ -25,10 +26,15 @@
 #include <circle/debug.h>
 #include <assert.h>
 
+#define LATENCY_MAX_DELAY	((1U << (LATENCY_MAX_EXPONENT+1)) - 1)
+
+static const char FromLatency[] = "latency";
+
 CLatencyTester::CLatencyTester (CInterruptSystem *pInterruptSystem)
 :	m_pInterruptSystem (pInterruptSystem),
 	m_bRunning (FALSE)
 {
+	Reset ();
 }
 
 CLatencyTester::~CLatencyTester (void)
@@ -45,11 +51,7 @@ void CLatencyTester::Start (unsigned nSampleRateHZ)
 
 	m_nWantedDelay = (1000000 + nSampleRateHZ/2) / nSampleRateHZ;
 
-	m_nMinDelay = (unsigned) -1;
-	m_nMaxDelay = 0;
-	m_nDelayAccu = 0;
-	m_nSamples = 0;
-	m_bOverflow = FALSE;
+	Reset ();
 
 	m_bRunning = TRUE;
 
@@ -71,6 +73,25 @@ void CLatencyTester::Stop (void)
 	m_bRunning = FALSE;
 }
 
+void CLatencyTester::Reset (void)
+{
+	m_SpinLock.Acquire ();
+
+	m_nMinDelay = (unsigned) -1;
+	m_nMaxDelay = 0;
+	m_ullDelayAccu = 0;
+	m_nSamples = 0;
+
+	for (unsigned i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++)
+	{
+		m_Histogram[i] = 0;
+	}
+
+	m_nWorstCases = 0;
+
+	m_SpinLock.Release ();
+}
+
 unsigned CLatencyTester::GetMin (void) const
 {
 	return m_nMinDelay;
@@ -85,25 +106,115 @@ unsigned CLatencyTester::GetAvg (void)
 {
 	m_SpinLock.Acquire ();
 
-	if (m_bOverflow)
+	u64 ullDelayAccu = m_ullDelayAccu;
+	unsigned nSamples = m_nSamples;
+
+	m_SpinLock.Release ();
+
+	return nSamples > 0 ? (unsigned) (ullDelayAccu / nSamples) : 0;
+}
+
+unsigned CLatencyTester::GetSamples (void) const
+{
+	return m_nSamples;
+}
+
+unsigned CLatencyTester::GetPercentile (unsigned nPerMille)
+{
+	assert (nPerMille <= 1000);
+
+	m_SpinLock.Acquire ();
+
+	u64 ullWanted = ((u64) m_nSamples * nPerMille + 999) / 1000;
+	if (ullWanted == 0)
+	{
+		ullWanted = 1;
+	}
+
+	unsigned nResult = 0;
+	u64 ullCount = 0;
+	for (unsigned i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++)
+	{
+		ullCount += m_Histogram[i];
+		if (ullCount >= ullWanted)
+		{
+			nResult = GetBucketUpperBound (i);
+
+			break;
+		}
+	}
+
+	if (nResult > m_nMaxDelay)
+	{
+		nResult = m_nMaxDelay;
+	}
+
+	m_SpinLock.Release ();
+
+	return nResult;
+}
+
+boolean CLatencyTester::GetWorstCase (unsigned nIndex, TLatencyWorstCase *pWorstCase)
+{
+	assert (pWorstCase != 0);
+
+	m_SpinLock.Acquire ();
+
+	if (nIndex >= m_nWorstCases)
 	{
 		m_SpinLock.Release ();
 
-		return (unsigned) -1;
+		return FALSE;
 	}
 
-	unsigned nDelayAccu = m_nDelayAccu;
-	unsigned nSamples = m_nSamples;
+	*pWorstCase = m_WorstCase[nIndex];
 
 	m_SpinLock.Release ();
 
-	return nSamples > 0 ? nDelayAccu / nSamples : 0;
+	return TRUE;
 }
 
-void CLatencyTester::Dump (void)
+void CLatencyTester::Dump (boolean bHistogram)
 {
-	CLogger::Get ()->Write ("latency", LogNotice, "IRQ latency: Min %u Max %u Avg %u (us)",
-				GetMin (), GetMax (), GetAvg ());
+	CLogger *pLogger = CLogger::Get ();
+
+	pLogger->Write (FromLatency, LogNotice, "IRQ latency: Min %u Max %u Avg %u (us)",
+			GetMin (), GetMax (), GetAvg ());
+
+	pLogger->Write (FromLatency, LogNotice, "p50 %u p90 %u p99 %u p99.9 %u (us), %u samples",
+			GetPercentile (500), GetPercentile (900), GetPercentile (990),
+			GetPercentile (999), GetSamples ());
+
+	if (!bHistogram)
+	{
+		return;
+	}
+
+	for (unsigned i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++)
+	{
+		unsigned nCount = m_Histogram[i];
+		if (nCount > 0)
+		{
+			pLogger->Write (FromLatency, LogNotice, "%6u-%6u us: %u",
+					GetBucketLowerBound (i), GetBucketUpperBound (i), nCount);
+		}
+	}
+
+	TLatencyWorstCase WorstCase;
+	for (unsigned i = 0; GetWorstCase (i, &WorstCase); i++)
+	{
+		if (WorstCase.nLastIRQ < IRQ_LINES)
+		{
+			pLogger->Write (FromLatency, LogNotice, "Worst %u: %u us at 0x%lX after IRQ %u",
+					i+1, WorstCase.nDelay, (unsigned long) WorstCase.nPC,
+					WorstCase.nLastIRQ);
+		}
+		else
+		{
+			pLogger->Write (FromLatency, LogNotice, "Worst %u: %u us at 0x%lX",
+					i+1, WorstCase.nDelay, (unsigned long) WorstCase.nPC);
+		}
+	}
 }
 
 void CLatencyTester::InterruptHandler (void)
@@ -118,6 +229,13 @@ void CLatencyTester::InterruptHandler (void)
 	//debug_click ();
 #endif
 
+	// The return address of the IRQ shows, where the IRQs have been enabled
+	// again, if a critical section delayed the IRQ. If another IRQ handler
+	// delayed it, this IRQ has been handled before. The timer 1 IRQ is
+	// always handled on core 0.
+	uintptr nPC = IRQProfileContext[0].nPC;
+	unsigned nLastIRQ = m_pInterruptSystem->GetLastIRQ ();
+
 	m_SpinLock.Acquire ();
 
 	if (nDelay < m_nMinDelay)
@@ -130,18 +248,28 @@ void CLatencyTester::InterruptHandler (void)
 		m_nMaxDelay = nDelay;
 	}
 
-	if (!m_bOverflow)
+	if (m_nSamples + 1 != 0)
 	{
-		if (   m_nDelayAccu + nDelay >= m_nDelayAccu
-		    && m_nSamples + 1 != 0)
-		{
-			m_nDelayAccu += nDelay;
-			m_nSamples++;
-		}
-		else
+		m_ullDelayAccu += nDelay;
+		m_nSamples++;
+
+		m_Histogram[GetBucket (nDelay)]++;
+	}
+
+	// insert into the sorted list of worst cases
+	if (   m_nWorstCases < LATENCY_WORST_CASES
+	    || nDelay > m_WorstCase[LATENCY_WORST_CASES-1].nDelay)
+	{
+		unsigned i = m_nWorstCases < LATENCY_WORST_CASES ? m_nWorstCases++
+								 : LATENCY_WORST_CASES-1;
+		for (; i > 0 && m_WorstCase[i-1].nDelay < nDelay; i--)
 		{
-			m_bOverflow = TRUE;
+			m_WorstCase[i] = m_WorstCase[i-1];
 		}
+
+		m_WorstCase[i].nDelay = nDelay;
+		m_WorstCase[i].nPC = nPC;
+		m_WorstCase[i].nLastIRQ = nLastIRQ;
 	}
 
 	m_SpinLock.Release ();
@@ -158,3 +286,50 @@ void CLatencyTester::InterruptStub (void *pParam)
 
 	pTimer->InterruptHandler ();
 }
+
+unsigned CLatencyTester::GetBucket (unsigned nDelay)
+{
+	if (nDelay < LATENCY_SUB_BUCKETS)
+	{
+		return nDelay;
+	}
+
+	if (nDelay > LATENCY_MAX_DELAY)
+	{
+		nDelay = LATENCY_MAX_DELAY;
+	}
+
+	unsigned nExponent = 31 - __builtin_clz (nDelay);	// >= LATENCY_SUB_BUCKET_BITS
+	unsigned nShift = nExponent - LATENCY_SUB_BUCKET_BITS;
+
+	return   (nExponent - LATENCY_SUB_BUCKET_BITS + 1) * LATENCY_SUB_BUCKETS
+	       + (nDelay >> nShift) - LATENCY_SUB_BUCKETS;
+}
+
+unsigned CLatencyTester::GetBucketLowerBound (unsigned nBucket)
+{
+	assert (nBucket < LATENCY_HISTOGRAM_BUCKETS);
+
+	if (nBucket < LATENCY_SUB_BUCKETS)
+	{
+		return nBucket;
+	}
+
+	unsigned nShift = nBucket / LATENCY_SUB_BUCKETS - 1;
+
+	return (LATENCY_SUB_BUCKETS + nBucket % LATENCY_SUB_BUCKETS) << nShift;
+}
+
+unsigned CLatencyTester::GetBucketUpperBound (unsigned nBucket)
+{
+	assert (nBucket < LATENCY_HISTOGRAM_BUCKETS);
+
+	if (nBucket < LATENCY_SUB_BUCKETS)
+	{
+		return nBucket;
+	}
+
+	unsigned nShift = nBucket / LATENCY_SUB_BUCKETS - 1;
+
+	return GetBucketLowerBound (nBucket) + (1U << nShift) - 1;
+}
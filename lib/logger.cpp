@@ -27,9 +27,17 @@
 #include <circle/machineinfo.h>
 #include <circle/version.h>
 #include <circle/debug.h>
+#include <circle/memorymap.h>
+#include <assert.h>
 
 #define LOGGER_BUFSIZE	0x4000
 
+#ifdef ARM_ALLOW_MULTI_CORE
+	#define LOG_BINARY_RINGS	CORES
+#else
+	#define LOG_BINARY_RINGS	1
+#endif
+
 struct TLogEvent
 {
 	TLogSeverity	Severity;
@@ -40,6 +48,37 @@ struct TLogEvent
 	int		nTimeZone;			// minutes diff to UTC
 };
 
+struct TLogBinaryEntry
+{
+	const char	*pSource;
+	const char	*pMessage;
+	unsigned	nTime;				// CTimer::GetTime ()
+	unsigned	nTicks;				// CTimer::GetTicks ()
+	TLogSeverity	Severity;
+	unsigned	nArgs;
+	u64		Arg[LOG_BINARY_MAX_ARGS];
+};
+
+struct TLogBinaryRing
+{
+	TLogBinaryEntry	Entry[LOG_BINARY_ENTRIES];
+	volatile unsigned nInPtr;			// written by the owning core only
+	volatile unsigned nOutPtr;			// written by DrainBinary() only
+	volatile unsigned nDropped;
+};
+
+enum TLogArgType
+{
+	LogArgNone,
+	LogArgInt,
+	LogArgLong,
+	LogArgLongLong,
+	LogArgDouble,
+	LogArgString
+};
+
+static const char *ParseConversion (const char *pFormat, TLogArgType *pType);
+
 CLogger *CLogger::s_pThis = 0;
 
 CLogger::CLogger (unsigned nLogLevel, CTimer *pTimer)
@@ -51,6 +90,8 @@ CLogger::CLogger (unsigned nLogLevel, CTimer *pTimer)
 	m_nOutPtr (0),
 	m_nEventInPtr (0),
 	m_nEventOutPtr (0),
+	m_pBinaryRing (0),
+	m_BinarySpinLock (TASK_LEVEL),
 	m_pEventNotificationHandler (0),
 	m_pPanicHandler (0)
 {
@@ -73,6 +114,9 @@ CLogger::~CLogger (void)
 		}
 	}
 
+	delete [] m_pBinaryRing;
+	m_pBinaryRing = 0;
+
 	delete [] m_pBuffer;
 	m_pBuffer = 0;
 
@@ -218,6 +262,318 @@ void CLogger::WriteNoAlloc (const char *pSource, TLogSeverity Severity, const ch
 	}
 }
 
+void CLogger::WriteTo (CDevice *pTarget, const char *pSource, const char *pMessage, ...)
+{
+	va_list var;
+	va_start (var, pMessage);
+
+	if (pTarget == 0)
+	{
+		assert (s_pThis != 0);
+		s_pThis->WriteV (pSource, LogNotice, pMessage, var);
+	}
+	else
+	{
+		CString Message;
+		Message.FormatV (pMessage, var);
+
+		CString Output;
+		Output.Format ("%s: %s\n", pSource, (const char *) Message);
+
+		pTarget->Write ((const char *) Output, Output.GetLength ());
+	}
+
+	va_end (var);
+}
+
+boolean CLogger::EnableBinaryMode (void)
+{
+	if (m_pBinaryRing != 0)
+	{
+		return TRUE;
+	}
+
+	TLogBinaryRing *pRing = new TLogBinaryRing[LOG_BINARY_RINGS];
+	if (pRing == 0)
+	{
+		return FALSE;
+	}
+
+	for (unsigned i = 0; i < LOG_BINARY_RINGS; i++)
+	{
+		pRing[i].nInPtr = 0;
+		pRing[i].nOutPtr = 0;
+		pRing[i].nDropped = 0;
+	}
+
+	DataSyncBarrier ();
+
+	m_pBinaryRing = pRing;
+
+	return TRUE;
+}
+
+void CLogger::WriteBinary (const char *pSource, TLogSeverity Severity, const char *pMessage, ...)
+{
+	va_list var;
+	va_start (var, pMessage);
+
+	if (   m_pBinaryRing == 0
+	    || Severity == LogPanic)
+	{
+		WriteV (pSource, Severity, pMessage, var);
+
+		va_end (var);
+
+		return;
+	}
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	TLogBinaryRing *pRing = &m_pBinaryRing[CMultiCoreSupport::ThisCore ()];
+#else
+	TLogBinaryRing *pRing = m_pBinaryRing;
+#endif
+
+	// an interrupt handler on this core may log too
+	EnterCritical (IRQ_LEVEL);
+
+	unsigned nInPtr = pRing->nInPtr;
+	unsigned nNextInPtr = (nInPtr + 1) & (LOG_BINARY_ENTRIES-1);
+	if (nNextInPtr == pRing->nOutPtr)
+	{
+		pRing->nDropped++;
+
+		LeaveCritical ();
+
+		va_end (var);
+
+		return;
+	}
+
+	TLogBinaryEntry *pEntry = &pRing->Entry[nInPtr];
+	pEntry->pSource = pSource;
+	pEntry->pMessage = pMessage;
+	pEntry->nTime = m_pTimer != 0 ? m_pTimer->GetTime () : 0;
+	pEntry->nTicks = m_pTimer != 0 ? m_pTimer->GetTicks () : 0;
+	pEntry->Severity = Severity;
+
+	unsigned nArgs = 0;
+	for (const char *p = pMessage; *p != '\0' && nArgs < LOG_BINARY_MAX_ARGS; )
+	{
+		if (*p++ != '%')
+		{
+			continue;
+		}
+
+		TLogArgType Type;
+		p = ParseConversion (p, &Type);
+		if (*p != '\0')
+		{
+			p++;
+		}
+
+		switch (Type)
+		{
+		case LogArgInt:
+			pEntry->Arg[nArgs++] = va_arg (var, unsigned);
+			break;
+
+		case LogArgLong:
+			pEntry->Arg[nArgs++] = va_arg (var, unsigned long);
+			break;
+
+		case LogArgLongLong:
+			pEntry->Arg[nArgs++] = va_arg (var, unsigned long long);
+			break;
+
+		case LogArgDouble: {
+			double fArg = va_arg (var, double);
+			memcpy (&pEntry->Arg[nArgs++], &fArg, sizeof fArg);
+			} break;
+
+		case LogArgString:
+			pEntry->Arg[nArgs++] = (uintptr) va_arg (var, const char *);
+			break;
+
+		default:
+			break;
+		}
+	}
+	pEntry->nArgs = nArgs;
+
+	DataMemBarrier ();
+
+	pRing->nInPtr = nNextInPtr;
+
+	LeaveCritical ();
+
+	va_end (var);
+}
+
+unsigned CLogger::DrainBinary (unsigned nMaxEntries)
+{
+	if (m_pBinaryRing == 0)
+	{
+		return 0;
+	}
+
+	m_BinarySpinLock.Acquire ();
+
+	unsigned nEntries = 0;
+	for (unsigned nRing = 0; nRing < LOG_BINARY_RINGS; nRing++)
+	{
+		TLogBinaryRing *pRing = &m_pBinaryRing[nRing];
+
+		while (   pRing->nOutPtr != pRing->nInPtr
+		       && (nMaxEntries == 0 || nEntries < nMaxEntries))
+		{
+			DataMemBarrier ();
+
+			const TLogBinaryEntry *pEntry = &pRing->Entry[pRing->nOutPtr];
+
+			CString Message;
+			unsigned nArg = 0;
+			for (const char *p = pEntry->pMessage; *p != '\0'; )
+			{
+				const char *pStart = p;
+				while (*p != '\0' && *p != '%')
+				{
+					p++;
+				}
+
+				if (p != pStart)
+				{
+					char Text[LOG_MAX_MESSAGE];
+					size_t nLength = p - pStart;
+					if (nLength >= sizeof Text)
+					{
+						nLength = sizeof Text - 1;
+					}
+
+					memcpy (Text, pStart, nLength);
+					Text[nLength] = '\0';
+
+					Message.Append (Text);
+
+					continue;
+				}
+
+				TLogArgType Type;
+				const char *pEnd = ParseConversion (++p, &Type);
+				if (*pEnd != '\0')
+				{
+					pEnd++;
+				}
+
+				char Spec[16];
+				size_t nLength = pEnd - pStart;
+				if (   Type == LogArgNone
+				    || nArg >= pEntry->nArgs
+				    || nLength >= sizeof Spec)
+				{
+					Message.Append (*p == '%' ? "%" : "?");
+					p = *p == '%' ? p+1 : pEnd;
+
+					continue;
+				}
+
+				memcpy (Spec, pStart, nLength);
+				Spec[nLength] = '\0';
+				p = pEnd;
+
+				u64 ullArg = pEntry->Arg[nArg++];
+
+				CString Conversion;
+				switch (Type)
+				{
+				case LogArgInt:
+					Conversion.Format (Spec, (unsigned) ullArg);
+					break;
+
+				case LogArgLong:
+					Conversion.Format (Spec, (unsigned long) ullArg);
+					break;
+
+				case LogArgLongLong:
+					Conversion.Format (Spec, (unsigned long long) ullArg);
+					break;
+
+				case LogArgDouble: {
+					double fArg;
+					memcpy (&fArg, &ullArg, sizeof fArg);
+					Conversion.Format (Spec, fArg);
+					} break;
+
+				case LogArgString:
+					Conversion.Format (Spec, (const char *) (uintptr) ullArg);
+					break;
+
+				default:
+					break;
+				}
+
+				Message.Append (Conversion);
+			}
+
+			WriteEvent (pEntry->pSource, pEntry->Severity, Message);
+
+			// the entry may be overwritten, after nOutPtr has been updated
+			boolean bWrite = pEntry->Severity <= m_nLogLevel;
+
+			CString Buffer;
+			if (bWrite)
+			{
+				// same format as in WriteV()
+				CString *pTimeString = CTimer::GetTimeString (pEntry->nTime,
+									      pEntry->nTicks);
+				if (pTimeString != 0)
+				{
+					Buffer.Append (*pTimeString);
+					Buffer.Append (" ");
+
+					delete pTimeString;
+				}
+
+				Buffer.Append (pEntry->pSource);
+				Buffer.Append (": ");
+				Buffer.Append (Message);
+				Buffer.Append ("\n");
+			}
+
+			DataMemBarrier ();
+
+			pRing->nOutPtr = (pRing->nOutPtr + 1) & (LOG_BINARY_ENTRIES-1);
+
+			if (bWrite)
+			{
+				Write (Buffer);
+			}
+
+			nEntries++;
+		}
+	}
+
+	m_BinarySpinLock.Release ();
+
+	return nEntries;
+}
+
+unsigned CLogger::GetBinaryDropped (void) const
+{
+	if (m_pBinaryRing == 0)
+	{
+		return 0;
+	}
+
+	unsigned nDropped = 0;
+	for (unsigned nRing = 0; nRing < LOG_BINARY_RINGS; nRing++)
+	{
+		nDropped += m_pBinaryRing[nRing].nDropped;
+	}
+
+	return nDropped;
+}
+
 CLogger *CLogger::Get (void)
 {
 	return s_pThis;
@@ -394,3 +750,55 @@ void CLogger::RegisterPanicHandler (TLogPanicHandler *pHandler)
 {
 	m_pPanicHandler = pHandler;
 }
+
+// pFormat points behind the '%', returns pointer to the conversion character
+static const char *ParseConversion (const char *pFormat, TLogArgType *pType)
+{
+	while (   *pFormat == '#'
+	       || *pFormat == '-'
+	       || *pFormat == '.'
+	       || ('0' <= *pFormat && *pFormat <= '9'))
+	{
+		pFormat++;
+	}
+
+	unsigned nLong = 0;
+	while (*pFormat == 'l')
+	{
+		nLong++;
+
+		pFormat++;
+	}
+
+	switch (*pFormat)
+	{
+	case 'c':
+	case 'd':
+	case 'i':
+	case 'o':
+	case 'u':
+	case 'x':
+	case 'X':
+		*pType =   nLong == 0 ? LogArgInt
+			 : nLong == 1 ? LogArgLong : LogArgLongLong;
+		break;
+
+	case 'p':
+		*pType = LogArgLong;		// pointer fits into unsigned long
+		break;
+
+	case 'f':
+		*pType = LogArgDouble;
+		break;
+
+	case 's':
+		*pType = LogArgString;
+		break;
+
+	default:
+		*pType = LogArgNone;
+		break;
+	}
+
+	return pFormat;
+}
@@ -465,7 +465,11 @@ unsigned CMachineInfo::AllocateDMAChannel (unsigned nChannel)
 	if (!(nChannel & ~DMA_CHANNEL__MASK))
 	{
 		// explicit channel allocation
+#if RASPPI >= 4
+		assert (nChannel <= DMA_CHANNEL_EXT_MAX);
+#else
 		assert (nChannel <=  DMA_CHANNEL_MAX);
+#endif
 		if (m_usDMAChannelMap & (1 << nChannel))
 		{
 			m_usDMAChannelMap &= ~(1 << nChannel);
@@ -509,7 +513,11 @@ void CMachineInfo::FreeDMAChannel (unsigned nChannel)
 		return;
 	}
 
+#if RASPPI >= 4
+	assert (nChannel <= DMA_CHANNEL_EXT_MAX);
+#else
 	assert (nChannel <= DMA_CHANNEL_MAX);
+#endif
 	assert (!(m_usDMAChannelMap & (1 << nChannel)));
 	m_usDMAChannelMap |= 1 << nChannel;
 }
@@ -32,6 +32,7 @@
 #include <circle/macros.h>
 #include <circle/util.h>
 #include <circle/logger.h>
+#include <circle/tracer.h>
 #include <circle/net/in.h>
 #include <assert.h>
 
@@ -459,6 +460,8 @@ int CTCPConnection::Receive (void *pBuffer, int nFlags)
 		}
 	}
 
+	TRACE_POINT (TracePhaseInstant, TRACER_EVENT_TCP_RECEIVE, this, nLength);
+
 	return nLength;
 }
 
@@ -682,6 +685,8 @@ int CTCPConnection::PacketReceived (const void	*pPacket,
 		nSEG_LEN++;
 	}
 	
+	TRACE_POINT (TracePhaseInstant, TRACER_EVENT_TCP_RX, this, nDataLength);
+
 	u32 nSEG_WND = be2le16 (pHeader->nWindow);
 	//u16 nSEG_UP  = be2le16 (pHeader->nUrgentPointer);
 	//u32 nSEG_PRC;	// segment precedence value
@@ -1412,6 +1417,8 @@ boolean CTCPConnection::SendSegment (unsigned nFlags, u32 nSequenceNumber, u32 n
 				nDataLength);
 #endif
 
+	TRACE_POINT (TracePhaseInstant, TRACER_EVENT_TCP_TX, this, nDataLength);
+
 	assert (m_pNetworkLayer != 0);
 	return m_pNetworkLayer->Send (m_ForeignIP, TxBuffer, nPacketLength, IPPROTO_TCP);
 }
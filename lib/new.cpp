@@ -22,24 +22,24 @@
 
 void *operator new (size_t nSize, int nType)
 {
-	return CMemorySystem::HeapAllocate (nSize, nType);
+	return CMemorySystem::HeapAllocate (nSize, nType, HEAP_CALLER);
 }
 
 void *operator new[] (size_t nSize, int nType)
 {
-	return CMemorySystem::HeapAllocate (nSize, nType);
+	return CMemorySystem::HeapAllocate (nSize, nType, HEAP_CALLER);
 }
 
 #if STDLIB_SUPPORT != 3
 
 void *operator new (size_t nSize)
 {
-	return CMemorySystem::HeapAllocate (nSize, HEAP_DEFAULT_NEW);
+	return CMemorySystem::HeapAllocate (nSize, HEAP_DEFAULT_NEW, HEAP_CALLER);
 }
 
 void *operator new[] (size_t nSize)
 {
-	return CMemorySystem::HeapAllocate (nSize, HEAP_DEFAULT_NEW);
+	return CMemorySystem::HeapAllocate (nSize, HEAP_DEFAULT_NEW, HEAP_CALLER);
 }
 
 void operator delete (void *pBlock) noexcept
@@ -19,6 +19,7 @@
 //
 #include <circle/pageallocator.h>
 #include <circle/logger.h>
+#include <circle/util.h>
 #include <assert.h>
 
 #define PAGE_MASK	(PAGE_SIZE-1)
@@ -26,10 +27,15 @@
 CPageAllocator::CPageAllocator (void)
 :	m_pNext (0),
 	m_pLimit (0),
-#ifdef PAGE_DEBUG
+#if defined (PAGE_DEBUG) || defined (HEAP_TRACKING)
 	m_nCount (0),
 	m_nMaxCount (0),
 #endif
+#ifdef HEAP_TRACKING
+	m_pBase (0),
+	m_pCaller (0),
+#endif
+	m_nFreeCount (0),
 	m_pFreeList (0)
 {
 }
@@ -42,6 +48,18 @@ void CPageAllocator::Setup (uintptr nBase, size_t nSize)
 {
 	m_pNext = (u8 *) ((nBase + PAGE_SIZE-1) & ~PAGE_MASK);
 	m_pLimit = (u8 *) ((nBase + nSize) & ~PAGE_MASK);
+
+#ifdef HEAP_TRACKING
+	// the side table is placed in the first page(s) of the region
+	size_t nTableSize = (m_pLimit - m_pNext) / PAGE_SIZE * sizeof (uintptr);
+	nTableSize = (nTableSize + PAGE_SIZE-1) & ~PAGE_MASK;
+
+	m_pCaller = (uintptr *) m_pNext;
+	memset (m_pCaller, 0, nTableSize);
+
+	m_pNext += nTableSize;
+	m_pBase = m_pNext;
+#endif
 }
 
 size_t CPageAllocator::GetFreeSpace (void) const
@@ -49,25 +67,33 @@ size_t CPageAllocator::GetFreeSpace (void) const
 	return m_pLimit - m_pNext;
 }
 
-void *CPageAllocator::Allocate (void)
+size_t CPageAllocator::GetFreeListSpace (void) const
 {
-	assert (m_pNext != 0);
+	return (size_t) m_nFreeCount * PAGE_SIZE;
+}
 
-	m_SpinLock.Acquire ();
+void *CPageAllocator::Allocate (uintptr nCaller)
+{
+	assert (m_pNext != 0);
 
-#ifdef PAGE_DEBUG
-	if (++m_nCount > m_nMaxCount)
+#ifdef HEAP_TRACKING
+	if (nCaller == 0)
 	{
-		m_nMaxCount = m_nCount;
+		nCaller = (uintptr) __builtin_return_address (0);
 	}
 #endif
 
+	m_SpinLock.Acquire ();
+
 	TFreePage *pFreePage;
 	if ((pFreePage = m_pFreeList) != 0)
 	{
 		assert (pFreePage->nMagic == FREEPAGE_MAGIC);
 		m_pFreeList = pFreePage->pNext;
 		pFreePage->nMagic = 0;
+
+		assert (m_nFreeCount > 0);
+		m_nFreeCount--;
 	}
 	else
 	{
@@ -83,6 +109,17 @@ void *CPageAllocator::Allocate (void)
 		}
 	}
 
+#if defined (PAGE_DEBUG) || defined (HEAP_TRACKING)
+	if (++m_nCount > m_nMaxCount)
+	{
+		m_nMaxCount = m_nCount;
+	}
+#endif
+
+#ifdef HEAP_TRACKING
+	m_pCaller[((u8 *) pFreePage - m_pBase) / PAGE_SIZE] = nCaller;
+#endif
+
 	m_SpinLock.Release ();
 
 	return pFreePage;
@@ -103,11 +140,16 @@ void CPageAllocator::Free (void *pPage)
 
 	pFreePage->pNext = m_pFreeList;
 	m_pFreeList = pFreePage;
+	m_nFreeCount++;
 
-#ifdef PAGE_DEBUG
+#if defined (PAGE_DEBUG) || defined (HEAP_TRACKING)
 	m_nCount--;
 #endif
 
+#ifdef HEAP_TRACKING
+	m_pCaller[((u8 *) pFreePage - m_pBase) / PAGE_SIZE] = 0;
+#endif
+
 	m_SpinLock.Release ();
 }
 
@@ -119,3 +161,56 @@ void CPageAllocator::DumpStatus (void)
 }
 
 #endif
+
+#ifdef HEAP_TRACKING
+
+void CPageAllocator::DumpUsage (CDevice *pTarget, unsigned nMaxSites)
+{
+	if (m_pCaller == 0)
+	{
+		return;
+	}
+
+	TAllocationSite *pTable = new TAllocationSite[ALLOCATION_SITES];
+	TAllocationSite *pSnapshot = new TAllocationSite[ALLOCATION_SITES+1];
+	if (   pTable == 0
+	    || pSnapshot == 0)
+	{
+		delete [] pSnapshot;
+		delete [] pTable;
+
+		return;
+	}
+
+	CAllocationSites Sites;
+	Sites.Setup (pTable);
+
+	m_SpinLock.Acquire ();
+
+	unsigned nCount = m_nCount;
+	unsigned nMaxCount = m_nMaxCount;
+	unsigned nFreeCount = m_nFreeCount;
+
+	unsigned nPages = (m_pNext - m_pBase) / PAGE_SIZE;
+	for (unsigned i = 0; i < nPages; i++)
+	{
+		if (m_pCaller[i] != 0)
+		{
+			Sites.Add (m_pCaller[i], PAGE_SIZE);
+		}
+	}
+
+	m_SpinLock.Release ();
+
+	Sites.Snapshot (pSnapshot);
+
+	CLogger::WriteTo (pTarget, "pager", "%lu bytes free, %u pages live (peak %u), %u free",
+			  (unsigned long) GetFreeSpace (), nCount, nMaxCount, nFreeCount);
+
+	CAllocationSites::Report ("pager", pSnapshot, pTarget, nMaxSites);
+
+	delete [] pSnapshot;
+	delete [] pTable;
+}
+
+#endif
@@ -0,0 +1,325 @@
+//
+// perfcounters.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2020  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/perfcounters.h>
+#include <circle/synchronize.h>
+#include <circle/util.h>
+#include <assert.h>
+
+#if RASPPI == 1
+
+// ARM1176 Performance Monitor Control Register (PMNC)
+#define PMNC_E			(1 << 0)
+#define PMNC_P			(1 << 1)	// reset event counters
+#define PMNC_C			(1 << 2)	// reset cycle counter
+#define PMNC_OVERFLOW_FLAGS	(7 << 8)	// write 1 to clear
+#define PMNC_EVTCOUNT0__SHIFT	20
+#define PMNC_EVTCOUNT1__SHIFT	12
+
+#define ARM11_EVENT_CYCLES	0xFF
+#define ARM11_EVENT_NONE	0x100
+
+#define HW_COUNTERS		2
+
+#define CYCLE_COUNTER_MASK	0xFFFFFFFFU
+
+static inline u32 ReadPMNC (void)
+{
+	u32 nValue;
+	asm volatile ("mrc p15, 0, %0, c15, c12, 0" : "=r" (nValue));
+	return nValue;
+}
+
+static inline void WritePMNC (u32 nValue)
+{
+	asm volatile ("mcr p15, 0, %0, c15, c12, 0" : : "r" (nValue));
+}
+
+#else
+
+// Performance Monitors Control Register (PMCR)
+#define PMCR_E			(1 << 0)
+#define PMCR_P			(1 << 1)	// reset event counters
+#define PMCR_C			(1 << 2)	// reset cycle counter
+#define PMCR_LC			(1 << 6)	// 64-bit cycle counter overflow (ARMv8)
+#define PMCR_N__SHIFT		11
+#define PMCR_N__MASK		(0x1F << 11)
+
+#define PMCNTEN_C		(1U << 31)	// cycle counter
+#define PMCNTEN_ALL		0xFFFFFFFFU
+
+#define PMSELR_CYCLE_COUNTER	31		// selects PMCCFILTR
+
+#if AARCH == 32
+	#define PMU_READ(name, value)	\
+		asm volatile ("mrc p15, 0, %0, " name : "=r" (value))
+	#define PMU_WRITE(name, value)	\
+		asm volatile ("mcr p15, 0, %0, " name : : "r" (value))
+
+	#define PMCR		"c9, c12, 0"
+	#define PMCNTENSET	"c9, c12, 1"
+	#define PMCNTENCLR	"c9, c12, 2"
+	#define PMOVSR		"c9, c12, 3"
+	#define PMSELR		"c9, c12, 5"
+	#define PMCEID0		"c9, c12, 6"
+	#define PMXEVTYPER	"c9, c13, 1"
+	#define PMXEVCNTR	"c9, c13, 2"
+#else
+	#define PMU_READ(name, value)	\
+		asm volatile ("mrs %0, " name : "=r" (value))
+	#define PMU_WRITE(name, value)	\
+		asm volatile ("msr " name ", %0" : : "r" (value))
+
+	#define PMCR		"pmcr_el0"
+	#define PMCNTENSET	"pmcntenset_el0"
+	#define PMCNTENCLR	"pmcntenclr_el0"
+	#define PMOVSR		"pmovsclr_el0"
+	#define PMSELR		"pmselr_el0"
+	#define PMCEID0		"pmceid0_el0"
+	#define PMXEVTYPER	"pmxevtyper_el0"
+	#define PMXEVCNTR	"pmxevcntr_el0"
+#endif
+
+#if AARCH == 32 && RASPPI == 2
+	#define CYCLE_COUNTER_MASK	0xFFFFFFFFU
+#else
+	#define CYCLE_COUNTER_MASK	0xFFFFFFFFFFFFFFFFULL
+#endif
+
+#endif
+
+#define EVENT_COUNTER_MASK	0xFFFFFFFFU
+
+CPerformanceCounters::CPerformanceCounters (void)
+:	m_nEvents (0)
+{
+}
+
+CPerformanceCounters::~CPerformanceCounters (void)
+{
+}
+
+#if RASPPI == 1
+
+static unsigned MapEvent (TPerformanceEvent Event)
+{
+	switch (Event)
+	{
+	case PerfEventL1ICacheRefill:	return 0x00;
+	case PerfEventL1ITLBRefill:	return 0x03;
+	case PerfEventL1DTLBRefill:	return 0x04;
+	case PerfEventBranchMispredict:	return 0x06;
+	case PerfEventInstructions:	return 0x07;
+	case PerfEventL1DCacheAccess:	return 0x0A;
+	case PerfEventL1DCacheRefill:	return 0x0B;
+	default:			return ARM11_EVENT_NONE;
+	}
+}
+
+#endif
+
+boolean CPerformanceCounters::Configure (const TPerformanceEvent *pEvents, unsigned nEvents)
+{
+	if (   nEvents > PERF_MAX_EVENTS
+	    || nEvents > GetHardwareCounters ())
+	{
+		return FALSE;
+	}
+
+#if RASPPI != 1
+	uintptr nPMCEID0;
+	PMU_READ (PMCEID0, nPMCEID0);
+#endif
+
+	for (unsigned i = 0; i < nEvents; i++)
+	{
+		assert (pEvents != 0);
+
+#if RASPPI == 1
+		if (MapEvent (pEvents[i]) == ARM11_EVENT_NONE)
+#else
+		if (   pEvents[i] >= 32
+		    || !(nPMCEID0 & (1U << pEvents[i])))
+#endif
+		{
+			return FALSE;
+		}
+
+		m_Event[i] = pEvents[i];
+	}
+
+	m_nEvents = nEvents;
+
+	return TRUE;
+}
+
+void CPerformanceCounters::Start (void)
+{
+#if RASPPI == 1
+	u32 nPMNC = PMNC_E | PMNC_P | PMNC_C | PMNC_OVERFLOW_FLAGS;
+
+	nPMNC |=   (m_nEvents > 0 ? MapEvent (m_Event[0]) : ARM11_EVENT_CYCLES)
+		 << PMNC_EVTCOUNT0__SHIFT;
+	nPMNC |=   (m_nEvents > 1 ? MapEvent (m_Event[1]) : ARM11_EVENT_CYCLES)
+		 << PMNC_EVTCOUNT1__SHIFT;
+
+	WritePMNC (nPMNC);
+#else
+	PMU_WRITE (PMCNTENCLR, (uintptr) PMCNTEN_ALL);
+
+	for (unsigned i = 0; i < m_nEvents; i++)
+	{
+		PMU_WRITE (PMSELR, (uintptr) i);
+		InstructionSyncBarrier ();
+		PMU_WRITE (PMXEVTYPER, (uintptr) m_Event[i]);	// count in all modes
+	}
+
+	// count cycles in all modes
+	PMU_WRITE (PMSELR, (uintptr) PMSELR_CYCLE_COUNTER);
+	InstructionSyncBarrier ();
+	PMU_WRITE (PMXEVTYPER, (uintptr) 0);
+
+	PMU_WRITE (PMOVSR, (uintptr) PMCNTEN_ALL);
+
+	uintptr nPMCR = PMCR_E | PMCR_P | PMCR_C;
+#if RASPPI >= 3
+	nPMCR |= PMCR_LC;
+#endif
+	PMU_WRITE (PMCR, nPMCR);
+	InstructionSyncBarrier ();
+
+	PMU_WRITE (PMCNTENSET, (uintptr) (PMCNTEN_C | ((1U << m_nEvents) - 1)));
+#endif
+
+	InstructionSyncBarrier ();
+}
+
+void CPerformanceCounters::Stop (void)
+{
+#if RASPPI == 1
+	WritePMNC (ReadPMNC () & ~(PMNC_E | PMNC_OVERFLOW_FLAGS));
+#else
+	PMU_WRITE (PMCNTENCLR, (uintptr) PMCNTEN_ALL);
+#endif
+
+	InstructionSyncBarrier ();
+}
+
+void CPerformanceCounters::GetSnapshot (TPerformanceSnapshot *pSnapshot) const
+{
+	assert (pSnapshot != 0);
+	memset (pSnapshot, 0, sizeof *pSnapshot);
+
+	InstructionSyncBarrier ();
+
+#if RASPPI == 1
+	u32 nValue;
+	asm volatile ("mrc p15, 0, %0, c15, c12, 1" : "=r" (nValue));
+	pSnapshot->ullCycles = nValue;
+
+	if (m_nEvents > 0)
+	{
+		asm volatile ("mrc p15, 0, %0, c15, c12, 2" : "=r" (nValue));
+		pSnapshot->ullEvent[0] = nValue;
+	}
+
+	if (m_nEvents > 1)
+	{
+		asm volatile ("mrc p15, 0, %0, c15, c12, 3" : "=r" (nValue));
+		pSnapshot->ullEvent[1] = nValue;
+	}
+#else
+#if AARCH == 64
+	u64 ullCycles;
+	asm volatile ("mrs %0, pmccntr_el0" : "=r" (ullCycles));
+	pSnapshot->ullCycles = ullCycles;
+#elif RASPPI >= 3
+	u32 nLow, nHigh;
+	asm volatile ("mrrc p15, 0, %0, %1, c9" : "=r" (nLow), "=r" (nHigh));
+	pSnapshot->ullCycles = (u64) nHigh << 32 | nLow;
+#else
+	u32 nCycles;
+	asm volatile ("mrc p15, 0, %0, c9, c13, 0" : "=r" (nCycles));
+	pSnapshot->ullCycles = nCycles;
+#endif
+
+	for (unsigned i = 0; i < m_nEvents; i++)
+	{
+		PMU_WRITE (PMSELR, (uintptr) i);
+		InstructionSyncBarrier ();
+
+		uintptr nValue;
+		PMU_READ (PMXEVCNTR, nValue);
+		pSnapshot->ullEvent[i] = nValue & EVENT_COUNTER_MASK;
+	}
+#endif
+}
+
+void CPerformanceCounters::GetDifference (TPerformanceSnapshot *pResult,
+					  const TPerformanceSnapshot *pFrom,
+					  const TPerformanceSnapshot *pTo) const
+{
+	assert (pResult != 0);
+	assert (pFrom != 0);
+	assert (pTo != 0);
+
+	pResult->ullCycles = (pTo->ullCycles - pFrom->ullCycles) & CYCLE_COUNTER_MASK;
+
+	for (unsigned i = 0; i < PERF_MAX_EVENTS; i++)
+	{
+		pResult->ullEvent[i] = (pTo->ullEvent[i] - pFrom->ullEvent[i]) & EVENT_COUNTER_MASK;
+	}
+}
+
+TPerformanceEvent CPerformanceCounters::GetEvent (unsigned nIndex) const
+{
+	assert (nIndex < m_nEvents);
+	return m_Event[nIndex];
+}
+
+const char *CPerformanceCounters::GetEventName (TPerformanceEvent Event)
+{
+	switch (Event)
+	{
+	case PerfEventL1ICacheRefill:		return "L1I refill";
+	case PerfEventL1ITLBRefill:		return "L1I TLB refill";
+	case PerfEventL1DCacheRefill:		return "L1D refill";
+	case PerfEventL1DCacheAccess:		return "L1D access";
+	case PerfEventL1DTLBRefill:		return "L1D TLB refill";
+	case PerfEventInstructions:		return "Instructions";
+	case PerfEventBranchMispredict:		return "Branch mispred";
+	case PerfEventBranchPredictable:	return "Branch predictable";
+	case PerfEventMemoryAccess:		return "Memory access";
+	case PerfEventL2DCacheAccess:		return "L2D access";
+	case PerfEventL2DCacheRefill:		return "L2D refill";
+	default:				return "Unknown";
+	}
+}
+
+unsigned CPerformanceCounters::GetHardwareCounters (void)
+{
+#if RASPPI == 1
+	return HW_COUNTERS;
+#else
+	uintptr nPMCR;
+	PMU_READ (PMCR, nPMCR);
+
+	return (nPMCR & PMCR_N__MASK) >> PMCR_N__SHIFT;
+#endif
+}
@@ -149,7 +149,8 @@
 
 CPWMSoundBaseDevice::CPWMSoundBaseDevice (CInterruptSystem *pInterrupt,
 					  unsigned	    nSampleRate,
-					  unsigned	    nChunkSize)
+					  unsigned	    nChunkSize,
+					  unsigned	    nPeriods)
 :	CSoundBaseDevice (SoundFormatUnsigned32,
 			  (CLOCK_RATE + nSampleRate/2) / nSampleRate, nSampleRate,
 			  CMachineInfo::Get ()->ArePWMChannelsSwapped ()),
@@ -161,17 +162,20 @@ CPWMSoundBaseDevice::CPWMSoundBaseDevice (CInterruptSystem *pInterrupt,
 	m_Clock (GPIOClockPWM),
 	m_bIRQConnected (FALSE),
 	m_State (PWMSoundIdle),
-	m_nDMAChannel (CMachineInfo::Get ()->AllocateDMAChannel (DMA_CHANNEL_LITE))
+	m_nDMAChannel (CMachineInfo::Get ()->AllocateDMAChannel (DMA_CHANNEL_LITE)),
+	m_nPeriods (nPeriods),
+	m_nXRuns (0)
 {
 	assert (m_pInterruptSystem != 0);
 	assert (m_nChunkSize > 0);
 	assert ((m_nChunkSize & 1) == 0);
+	assert (2 <= m_nPeriods && m_nPeriods <= SOUND_MAX_PERIODS);
 
-	// setup and concatenate DMA buffers and control blocks
-	SetupDMAControlBlock (0);
-	SetupDMAControlBlock (1);
-	m_pControlBlock[0]->nNextControlBlockAddress = BUS_ADDRESS ((uintptr) m_pControlBlock[1]);
-	m_pControlBlock[1]->nNextControlBlockAddress = BUS_ADDRESS ((uintptr) m_pControlBlock[0]);
+	// setup DMA buffers and control blocks (concatenated to a ring in Start())
+	for (unsigned i = 0; i < m_nPeriods; i++)
+	{
+		SetupDMAControlBlock (i);
+	}
 
 	// start clock and PWM device
 	RunPWM ();
@@ -231,17 +235,15 @@ CPWMSoundBaseDevice::~CPWMSoundBaseDevice (void)
 	CMachineInfo::Get ()->FreeDMAChannel (m_nDMAChannel);
 
 	// free buffers
-	m_pControlBlock[0] = 0;
-	m_pControlBlock[1] = 0;
-	delete [] m_pControlBlockBuffer[0];
-	m_pControlBlockBuffer[0] = 0;
-	delete [] m_pControlBlockBuffer[1];
-	m_pControlBlockBuffer[1] = 0;
-
-	delete [] m_pDMABuffer[0];
-	m_pDMABuffer[0] = 0;
-	delete [] m_pDMABuffer[1];
-	m_pDMABuffer[1] = 0;
+	for (unsigned i = 0; i < m_nPeriods; i++)
+	{
+		m_pControlBlock[i] = 0;
+		delete [] m_pControlBlockBuffer[i];
+		m_pControlBlockBuffer[i] = 0;
+
+		delete [] m_pDMABuffer[i];
+		m_pDMABuffer[i] = 0;
+	}
 }
 
 int CPWMSoundBaseDevice::GetRangeMin (void) const
@@ -258,6 +260,14 @@ boolean CPWMSoundBaseDevice::Start (void)
 {
 	assert (m_State == PWMSoundIdle);
 
+	// concatenate the control blocks to a ring (may have been opened on termination)
+	for (unsigned i = 0; i < m_nPeriods; i++)
+	{
+		assert (m_pControlBlock[i] != 0);
+		m_pControlBlock[i]->nNextControlBlockAddress =
+			BUS_ADDRESS ((uintptr) m_pControlBlock[(i+1) % m_nPeriods]);
+	}
+
 	// fill buffer 0
 	m_nNextBuffer = 0;
 
@@ -268,6 +278,19 @@ boolean CPWMSoundBaseDevice::Start (void)
 
 	m_State = PWMSoundRunning;
 
+	// fill the other buffers, before the DMA is started
+	while (m_nNextBuffer != 0)
+	{
+		if (!GetNextChunk ())
+		{
+			StopAfterPeriod (m_nNextBuffer-1);
+
+			m_State = PWMSoundTerminating;
+
+			break;
+		}
+	}
+
 	// connect IRQ
 	assert (m_nDMAChannel <= DMA_CHANNEL_MAX);
 
@@ -308,23 +331,6 @@ boolean CPWMSoundBaseDevice::Start (void)
 
 	PeripheralExit ();
 
-	// fill buffer 1
-	if (!GetNextChunk ())
-	{
-		m_SpinLock.Acquire ();
-
-		if (m_State == PWMSoundRunning)
-		{
-			PeripheralEntry ();
-			write32 (ARM_DMACHAN_NEXTCONBK (m_nDMAChannel), 0);
-			PeripheralExit ();
-
-			m_State = PWMSoundTerminating;
-		}
-
-		m_SpinLock.Release ();
-	}
-
 	return TRUE;
 }
 
@@ -363,7 +369,10 @@ boolean CPWMSoundBaseDevice::GetNextChunk (void)
 	CleanAndInvalidateDataCacheRange ((uintptr) m_pDMABuffer[m_nNextBuffer], nTransferLength);
 	CleanAndInvalidateDataCacheRange ((uintptr) m_pControlBlock[m_nNextBuffer], sizeof (TDMAControlBlock));
 
-	m_nNextBuffer ^= 1;
+	if (++m_nNextBuffer == m_nPeriods)
+	{
+		m_nNextBuffer = 0;
+	}
 
 	return TRUE;
 }
@@ -407,11 +416,13 @@ void CPWMSoundBaseDevice::StopPWM (void)
 
 void CPWMSoundBaseDevice::InterruptHandler (void)
 {
-	assert (m_State != PWMSoundIdle);
 	assert (m_nDMAChannel <= DMA_CHANNEL_MAX);
 
 	PeripheralEntry ();
 
+	// read before acknowledging the interrupt, so that no completed period is missed
+	u32 nControlBlockAddress = read32 (ARM_DMACHAN_CONBLK_AD (m_nDMAChannel));
+
 #ifndef NDEBUG
 	u32 nIntStatus = read32 (ARM_DMA_INT_STATUS);
 #endif
@@ -425,6 +436,11 @@ void CPWMSoundBaseDevice::InterruptHandler (void)
 
 	PeripheralExit ();
 
+	if (m_State == PWMSoundIdle)		// completion was already detected in state Terminating
+	{
+		return;
+	}
+
 	if (nCS & CS_ERROR)
 	{
 		m_State = PWMSoundError;
@@ -437,16 +453,22 @@ void CPWMSoundBaseDevice::InterruptHandler (void)
 	switch (m_State)
 	{
 	case PWMSoundRunning:
-		if (GetNextChunk ())
+		if (RefillPeriods (nControlBlockAddress))
 		{
 			break;
 		}
 		// fall through
 
 	case PWMSoundCancelled:
-		PeripheralEntry ();
-		write32 (ARM_DMACHAN_NEXTCONBK (m_nDMAChannel), 0);
-		PeripheralExit ();
+		if (m_State == PWMSoundCancelled)
+		{
+			// stop after the currently active period
+			m_nLastPeriod = m_nPeriods;
+
+			PeripheralEntry ();
+			write32 (ARM_DMACHAN_NEXTCONBK (m_nDMAChannel), 0);
+			PeripheralExit ();
+		}
 
 		// avoid clicks
 		PeripheralEntry ();
@@ -457,7 +479,17 @@ void CPWMSoundBaseDevice::InterruptHandler (void)
 		break;
 
 	case PWMSoundTerminating:
-		m_State = PWMSoundIdle;
+		// more than one period may be pending, wait until the DMA controller stopped
+		PeripheralEntry ();
+
+		if (   !(read32 (ARM_DMACHAN_CS (m_nDMAChannel)) & CS_ACTIVE)
+		    || (   GetPeriodIndex (read32 (ARM_DMACHAN_CONBLK_AD (m_nDMAChannel))) == m_nLastPeriod
+			&& read32 (ARM_DMACHAN_TXFR_LEN (m_nDMAChannel)) == 0))
+		{
+			m_State = PWMSoundIdle;
+		}
+
+		PeripheralExit ();
 		break;
 
 	default:
@@ -468,6 +500,79 @@ void CPWMSoundBaseDevice::InterruptHandler (void)
 	m_SpinLock.Release ();
 }
 
+boolean CPWMSoundBaseDevice::RefillPeriods (u32 nControlBlockAddress)
+{
+	// more than one period has been completed, if the interrupt was handled late
+	unsigned nCompleted = 1;
+
+	unsigned nActive = GetPeriodIndex (nControlBlockAddress);
+	if (nActive < m_nPeriods)
+	{
+		nCompleted = (nActive + m_nPeriods - m_nNextBuffer) % m_nPeriods;
+		if (nCompleted == 0)
+		{
+			// The DMA controller wrapped around and replays the period, which
+			// should have been refilled. Continue with the following one.
+			m_nXRuns++;
+
+			if (++m_nNextBuffer == m_nPeriods)
+			{
+				m_nNextBuffer = 0;
+			}
+
+			nCompleted = m_nPeriods-1;
+		}
+	}
+
+	for (; nCompleted > 0; nCompleted--)
+	{
+		if (!GetNextChunk ())
+		{
+			// no more sound data, stop after the last filled period
+			StopAfterPeriod ((m_nNextBuffer + m_nPeriods-1) % m_nPeriods);
+
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+unsigned CPWMSoundBaseDevice::GetPeriodIndex (u32 nControlBlockAddress) const
+{
+	for (unsigned i = 0; i < m_nPeriods; i++)
+	{
+		assert (m_pControlBlock[i] != 0);
+		if (nControlBlockAddress == (u32) BUS_ADDRESS ((uintptr) m_pControlBlock[i]))
+		{
+			return i;
+		}
+	}
+
+	return m_nPeriods;		// not one of our control blocks (e.g. 0 if stopped)
+}
+
+void CPWMSoundBaseDevice::StopAfterPeriod (unsigned nPeriod)
+{
+	assert (nPeriod < m_nPeriods);
+	m_nLastPeriod = nPeriod;
+
+	assert (m_pControlBlock[nPeriod] != 0);
+	m_pControlBlock[nPeriod]->nNextControlBlockAddress = 0;
+
+	CleanAndInvalidateDataCacheRange ((uintptr) m_pControlBlock[nPeriod], sizeof (TDMAControlBlock));
+
+	// the control block may have been loaded by the DMA controller already
+	PeripheralEntry ();
+
+	if (GetPeriodIndex (read32 (ARM_DMACHAN_CONBLK_AD (m_nDMAChannel))) == nPeriod)
+	{
+		write32 (ARM_DMACHAN_NEXTCONBK (m_nDMAChannel), 0);
+	}
+
+	PeripheralExit ();
+}
+
 void CPWMSoundBaseDevice::InterruptStub (void *pParam)
 {
 	CPWMSoundBaseDevice *pThis = (CPWMSoundBaseDevice *) pParam;
@@ -478,7 +583,7 @@ void CPWMSoundBaseDevice::InterruptStub (void *pParam)
 
 void CPWMSoundBaseDevice::SetupDMAControlBlock (unsigned nID)
 {
-	assert (nID <= 1);
+	assert (nID < SOUND_MAX_PERIODS);
 
 	m_pDMABuffer[nID] = new (HEAP_DMA30) u32[m_nChunkSize];
 	assert (m_pDMABuffer[nID] != 0);
@@ -0,0 +1,69 @@
+//
+// irqreporttask.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2020  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/sched/irqreporttask.h>
+#include <circle/sched/scheduler.h>
+#include <assert.h>
+
+CIRQReportTask::CIRQReportTask (CIRQStatistics *pStatistics, unsigned nIntervalSecs,
+				boolean bReset, CDevice *pTarget, unsigned nMaxIRQs)
+:	m_pStatistics (pStatistics),
+	m_nIntervalSecs (nIntervalSecs),
+	m_bReset (bReset),
+	m_pTarget (pTarget),
+	m_nMaxIRQs (nMaxIRQs),
+	m_bStop (FALSE)
+{
+	assert (m_pStatistics != 0);
+	assert (m_nIntervalSecs > 0);
+}
+
+CIRQReportTask::~CIRQReportTask (void)
+{
+	m_pStatistics = 0;
+	m_pTarget = 0;
+}
+
+void CIRQReportTask::Run (void)
+{
+	assert (m_pStatistics != 0);
+	m_pStatistics->Reset ();
+
+	while (1)
+	{
+		CScheduler::Get ()->Sleep (m_nIntervalSecs);
+
+		if (m_bStop)
+		{
+			break;
+		}
+
+		m_pStatistics->Dump (m_pTarget, m_nMaxIRQs);
+
+		if (m_bReset)
+		{
+			m_pStatistics->Reset ();
+		}
+	}
+}
+
+void CIRQReportTask::Stop (void)
+{
+	m_bStop = TRUE;
+}
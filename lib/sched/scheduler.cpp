@@ -19,6 +19,7 @@
 //
 #include <circle/sched/scheduler.h>
 #include <circle/timer.h>
+#include <circle/tracer.h>
 #include <circle/logger.h>
 #include <assert.h>
 
@@ -63,6 +64,8 @@ void CScheduler::Yield (void)
 		return;
 	}
 	
+	TRACE_POINT (TracePhaseInstant, TRACER_EVENT_TASK_SWITCH, pNext, m_pCurrent);
+
 	TTaskRegisters *pOldRegs = m_pCurrent->GetRegs ();
 	m_pCurrent = pNext;
 	TTaskRegisters *pNewRegs = m_pCurrent->GetRegs ();
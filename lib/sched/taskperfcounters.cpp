@@ -0,0 +1,204 @@
+//
+// taskperfcounters.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2020  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/sched/taskperfcounters.h>
+#include <circle/sched/scheduler.h>
+#include <circle/logger.h>
+#include <circle/util.h>
+#include <assert.h>
+
+static const char FromTaskPerf[] = "taskperf";
+
+CTaskPerformanceCounters *CTaskPerformanceCounters::s_pThis = 0;
+
+CTaskPerformanceCounters::CTaskPerformanceCounters (CPerformanceCounters *pCounters)
+:	m_pCounters (pCounters),
+	m_pCurrentTask (0)
+{
+	assert (m_pCounters != 0);
+
+	assert (s_pThis == 0);
+	s_pThis = this;
+
+	for (unsigned i = 0; i < MAX_TASKS; i++)
+	{
+		m_Account[i].pTask = 0;
+	}
+
+	Reset ();
+
+	CScheduler *pScheduler = CScheduler::Get ();
+	assert (pScheduler != 0);
+	m_pCurrentTask = pScheduler->GetCurrentTask ();
+
+	m_pCounters->Start ();
+	m_pCounters->GetSnapshot (&m_LastSnapshot);
+
+	pScheduler->RegisterTaskSwitchHandler (TaskSwitchStub);
+	pScheduler->RegisterTaskTerminationHandler (TaskTerminationStub);
+}
+
+CTaskPerformanceCounters::~CTaskPerformanceCounters (void)
+{
+	s_pThis = 0;
+
+	m_pCounters = 0;
+}
+
+boolean CTaskPerformanceCounters::GetTaskCounters (CTask *pTask, TPerformanceSnapshot *pResult)
+{
+	assert (pTask != 0);
+	assert (pResult != 0);
+
+	if (pTask == m_pCurrentTask)
+	{
+		Account ();
+	}
+
+	for (unsigned i = 0; i < MAX_TASKS; i++)
+	{
+		if (m_Account[i].pTask == pTask)
+		{
+			memcpy (pResult, &m_Account[i].Counters, sizeof *pResult);
+
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+void CTaskPerformanceCounters::Reset (void)
+{
+	for (unsigned i = 0; i < MAX_TASKS; i++)
+	{
+		memset (&m_Account[i].Counters, 0, sizeof m_Account[i].Counters);
+	}
+}
+
+void CTaskPerformanceCounters::Dump (void)
+{
+	Account ();
+
+	CLogger *pLogger = CLogger::Get ();
+	assert (pLogger != 0);
+
+	assert (m_pCounters != 0);
+	for (unsigned i = 0; i < MAX_TASKS; i++)
+	{
+		if (m_Account[i].pTask == 0)
+		{
+			continue;
+		}
+
+		const TPerformanceSnapshot *pCounters = &m_Account[i].Counters;
+
+		pLogger->Write (FromTaskPerf, LogNotice, "Task %lX: %llu cycles",
+				(unsigned long) (uintptr) m_Account[i].pTask,
+				pCounters->ullCycles);
+
+		for (unsigned j = 0; j < m_pCounters->GetEventCount (); j++)
+		{
+			pLogger->Write (FromTaskPerf, LogNotice, "  %s: %llu",
+					CPerformanceCounters::GetEventName (m_pCounters->GetEvent (j)),
+					pCounters->ullEvent[j]);
+		}
+	}
+}
+
+// adds the counter values since the last call to the account of the current task
+void CTaskPerformanceCounters::Account (void)
+{
+	assert (m_pCounters != 0);
+
+	TPerformanceSnapshot Snapshot;
+	m_pCounters->GetSnapshot (&Snapshot);
+
+	TPerformanceSnapshot Delta;
+	m_pCounters->GetDifference (&Delta, &m_LastSnapshot, &Snapshot);
+
+	m_LastSnapshot = Snapshot;
+
+	assert (m_pCurrentTask != 0);
+	TTaskAccount *pAccount = 0;
+	for (unsigned i = 0; i < MAX_TASKS; i++)
+	{
+		if (m_Account[i].pTask == m_pCurrentTask)
+		{
+			pAccount = &m_Account[i];
+
+			break;
+		}
+
+		if (   pAccount == 0
+		    && m_Account[i].pTask == 0)
+		{
+			pAccount = &m_Account[i];
+		}
+	}
+
+	if (pAccount == 0)
+	{
+		return;
+	}
+
+	if (pAccount->pTask != m_pCurrentTask)
+	{
+		pAccount->pTask = m_pCurrentTask;
+		memset (&pAccount->Counters, 0, sizeof pAccount->Counters);
+	}
+
+	pAccount->Counters.ullCycles += Delta.ullCycles;
+	for (unsigned i = 0; i < PERF_MAX_EVENTS; i++)
+	{
+		pAccount->Counters.ullEvent[i] += Delta.ullEvent[i];
+	}
+}
+
+void CTaskPerformanceCounters::TaskSwitchHandler (CTask *pTask)
+{
+	Account ();
+
+	m_pCurrentTask = pTask;
+}
+
+void CTaskPerformanceCounters::TaskSwitchStub (CTask *pTask)
+{
+	assert (s_pThis != 0);
+	s_pThis->TaskSwitchHandler (pTask);
+}
+
+void CTaskPerformanceCounters::TaskTerminationHandler (CTask *pTask)
+{
+	for (unsigned i = 0; i < MAX_TASKS; i++)
+	{
+		if (m_Account[i].pTask == pTask)
+		{
+			m_Account[i].pTask = 0;
+
+			break;
+		}
+	}
+}
+
+void CTaskPerformanceCounters::TaskTerminationStub (CTask *pTask)
+{
+	assert (s_pThis != 0);
+	s_pThis->TaskTerminationHandler (pTask);
+}
@@ -21,9 +21,18 @@
 #include <circle/devicenameservice.h>
 #include <circle/synchronize.h>
 #include <circle/util.h>
+#include <assert.h>
 
 #define ROTORS		4
 
+#if DEPTH == 8
+	#define COLOR_WORD(color)	((u32) (color) * 0x01010101U)
+#elif DEPTH == 16
+	#define COLOR_WORD(color)	((u32) (color) | (u32) (color) << 16)
+#else
+	#define COLOR_WORD(color)	((u32) (color))
+#endif
+
 #ifndef SCREEN_HEADLESS
 
 enum TScreenState
@@ -45,6 +54,12 @@ CScreenDevice::CScreenDevice (unsigned nWidth, unsigned nHeight, boolean bVirtua
 	m_nDisplay (nDisplay),
 	m_pFrameBuffer (0),
 	m_pBuffer (0),
+#ifdef SCREEN_PAN_FACTOR
+	m_bPanning (FALSE),
+	m_pFrameBase (0),
+	m_nVirtualHeight (0),
+	m_nPanOffset (0),
+#endif
 	m_nState (ScreenStateStart),
 	m_nScrollStart (0),
 	m_nCursorX (0),
@@ -76,10 +91,32 @@ CScreenDevice::~CScreenDevice (void)
 
 boolean CScreenDevice::Initialize (void)
 {
+	// expand each possible character line to the pixel masks of the words in the frame buffer
+	for (unsigned nLine = 0; nLine < 256; nLine++)
+	{
+		for (unsigned i = 0; i < SCREEN_GLYPH_WORDS; i++)
+		{
+			m_GlyphMask[nLine][i] = 0;
+		}
+
+		for (unsigned x = 0; x < SCREEN_GLYPH_WIDTH; x++)
+		{
+			if (nLine & (0x80 >> x))
+			{
+				m_GlyphMask[nLine][x * DEPTH / 32] |=
+					(u32) (TScreenColor) -1 << (x * DEPTH % 32);
+			}
+		}
+	}
+
 	if (!m_bVirtual)
 	{
 		m_pFrameBuffer = new CBcmFrameBuffer (m_nInitWidth, m_nInitHeight, DEPTH,
 						      0, 0, m_nDisplay);
+#ifdef SCREEN_PAN_FACTOR
+		m_pFrameBuffer->SetVirtualSize (m_pFrameBuffer->GetWidth (),
+						m_pFrameBuffer->GetHeight () * SCREEN_PAN_FACTOR);
+#endif
 #if DEPTH == 8
 		m_pFrameBuffer->SetPalette (NORMAL_COLOR, NORMAL_COLOR16);
 		m_pFrameBuffer->SetPalette (HIGH_COLOR,   HIGH_COLOR16);
@@ -106,6 +143,17 @@ boolean CScreenDevice::Initialize (void)
 		{
 			return FALSE;
 		}
+
+#ifdef SCREEN_PAN_FACTOR
+		// the firmware may have granted a smaller virtual buffer
+		m_pFrameBase = m_pBuffer;
+		m_nVirtualHeight = m_nSize / m_nPitch;
+		m_nSize = m_nPitch * m_nHeight;
+
+		m_bPanning =    m_nVirtualHeight >= 2 * m_nHeight
+			     && m_pFrameBuffer->SetVirtualOffset (0, 0);
+#endif
+
 		m_nPitch /= sizeof (TScreenColor);
 	}
 	else
@@ -742,6 +790,18 @@ void CScreenDevice::Tabulator (void)
 
 void CScreenDevice::Scroll (void)
 {
+#ifdef SCREEN_PAN_FACTOR
+	// panning calls the mailbox, which must not be used from IRQ_LEVEL
+	if (   m_bPanning
+	    && CurrentExecutionLevel () == TASK_LEVEL
+	    && m_nScrollStart == 0
+	    && m_nScrollEnd == m_nUsedHeight
+	    && Pan ())
+	{
+		return;
+	}
+#endif
+
 	unsigned nLines = m_CharGen.GetCharHeight ();
 
 	u32 *pTo = (u32 *) (m_pBuffer + m_nScrollStart * m_nPitch);
@@ -750,18 +810,7 @@ void CScreenDevice::Scroll (void)
 	unsigned nSize = m_nPitch * (m_nScrollEnd - m_nScrollStart - nLines) * sizeof (TScreenColor);
 	if (nSize > 0)
 	{
-#ifdef SCREEN_DMA_BURST_LENGTH
-		m_DMAChannel.SetupMemCopy (pTo, pFrom, nSize, SCREEN_DMA_BURST_LENGTH, FALSE);
-
-		m_DMAChannel.Start ();
-		m_DMAChannel.Wait ();
-#else
-		unsigned nSizeBlk = nSize & ~0xF;
-		memcpyblk (pTo, pFrom, nSizeBlk);
-
-		// Handle framebuffers with row lengths not aligned to 16 bytes
-		memcpy ((u8 *) pTo + nSizeBlk, (u8 *) pFrom + nSizeBlk, nSize & 0xF);
-#endif
+		CopyBlock (pTo, pFrom, nSize);
 
 		pTo += nSize / sizeof (u32);
 	}
@@ -773,8 +822,98 @@ void CScreenDevice::Scroll (void)
 	}
 }
 
+#ifdef SCREEN_PAN_FACTOR
+
+// Scrolls the whole screen by moving the visible window one text line down in the
+// virtual frame buffer. The lines, which come into view, are cleared only then.
+
+boolean CScreenDevice::Pan (void)
+{
+	unsigned nLines = m_CharGen.GetCharHeight ();
+
+	unsigned nPanOffset = m_nPanOffset + nLines;
+	if (nPanOffset + m_nHeight > m_nVirtualHeight)
+	{
+		// end of buffer reached, continue at its start (source and destination
+		// do not overlap, because the buffer is at least two screens high)
+		CopyBlock (m_pFrameBase, m_pBuffer + nLines * m_nPitch,
+			   m_nPitch * (m_nHeight - nLines) * sizeof (TScreenColor));
+
+		nPanOffset = 0;
+	}
+
+	ClearLines (nPanOffset + m_nUsedHeight - nLines, nPanOffset + m_nHeight);
+
+	assert (m_pFrameBuffer != 0);
+	if (!m_pFrameBuffer->SetVirtualOffset (0, nPanOffset))
+	{
+		m_bPanning = FALSE;	// the current window is still valid, scroll it
+
+		return FALSE;
+	}
+
+	m_nPanOffset = nPanOffset;
+	m_pBuffer = m_pFrameBase + m_nPanOffset * m_nPitch;
+
+	return TRUE;
+}
+
+void CScreenDevice::ClearLines (unsigned nFromLine, unsigned nToLine)
+{
+	assert (nFromLine <= nToLine);
+	assert (nToLine <= m_nVirtualHeight);
+
+	u32 *pTo = (u32 *) (m_pFrameBase + nFromLine * m_nPitch);
+
+	unsigned nSize = m_nPitch * (nToLine - nFromLine) * sizeof (TScreenColor) / sizeof (u32);
+	while (nSize--)
+	{
+		*pTo++ = BLACK_COLOR;
+	}
+}
+
+#endif
+
+void CScreenDevice::CopyBlock (void *pTo, const void *pFrom, unsigned nSize)
+{
+#ifdef SCREEN_DMA_BURST_LENGTH
+	m_DMAChannel.SetupMemCopy (pTo, pFrom, nSize, SCREEN_DMA_BURST_LENGTH, FALSE);
+
+	m_DMAChannel.Start ();
+	m_DMAChannel.Wait ();
+#else
+	unsigned nSizeBlk = nSize & ~0xF;
+	memcpyblk (pTo, pFrom, nSizeBlk);
+
+	// Handle framebuffers with row lengths not aligned to 16 bytes
+	memcpy ((u8 *) pTo + nSizeBlk, (const u8 *) pFrom + nSizeBlk, nSize & 0xF);
+#endif
+}
+
 void CScreenDevice::DisplayChar (char chChar, unsigned nPosX, unsigned nPosY, TScreenColor Color)
 {
+	if (CanBlitGlyph (nPosX, nPosY))
+	{
+		// write whole words, each line of the character is looked up in the mask table
+		u32 nColor = COLOR_WORD (Color);
+		u32 *pLine = (u32 *) (m_pBuffer + nPosY * m_nPitch + nPosX);
+		unsigned nPitch = m_nPitch * sizeof (TScreenColor) / sizeof (u32);
+
+		for (unsigned y = 0; y < m_CharGen.GetCharHeight (); y++)
+		{
+			const u32 *pMask = m_GlyphMask[m_CharGen.GetPixelLine (chChar, y)];
+
+			for (unsigned i = 0; i < SCREEN_GLYPH_WORDS; i++)
+			{
+				pLine[i] = nColor & pMask[i];
+			}
+
+			pLine += nPitch;
+		}
+
+		return;
+	}
+
 	for (unsigned y = 0; y < m_CharGen.GetCharHeight (); y++)
 	{
 		for (unsigned x = 0; x < m_CharGen.GetCharWidth (); x++)
@@ -787,6 +926,24 @@ void CScreenDevice::DisplayChar (char chChar, unsigned nPosX, unsigned nPosY, TS
 
 void CScreenDevice::EraseChar (unsigned nPosX, unsigned nPosY)
 {
+	if (CanBlitGlyph (nPosX, nPosY))
+	{
+		u32 *pLine = (u32 *) (m_pBuffer + nPosY * m_nPitch + nPosX);
+		unsigned nPitch = m_nPitch * sizeof (TScreenColor) / sizeof (u32);
+
+		for (unsigned y = 0; y < m_CharGen.GetCharHeight (); y++)
+		{
+			for (unsigned i = 0; i < SCREEN_GLYPH_WORDS; i++)
+			{
+				pLine[i] = BLACK_COLOR;
+			}
+
+			pLine += nPitch;
+		}
+
+		return;
+	}
+
 	for (unsigned y = 0; y < m_CharGen.GetCharHeight (); y++)
 	{
 		for (unsigned x = 0; x < m_CharGen.GetCharWidth (); x++)
@@ -796,6 +953,18 @@ void CScreenDevice::EraseChar (unsigned nPosX, unsigned nPosY)
 	}
 }
 
+// The glyph blitter is used, if the character is completely visible and
+// starts at a word boundary in the frame buffer.
+
+boolean CScreenDevice::CanBlitGlyph (unsigned nPosX, unsigned nPosY) const
+{
+	return    m_CharGen.GetCharWidth () == SCREEN_GLYPH_WIDTH
+	       && nPosX * sizeof (TScreenColor) % sizeof (u32) == 0
+	       && m_nPitch * sizeof (TScreenColor) % sizeof (u32) == 0
+	       && nPosX + SCREEN_GLYPH_WIDTH <= m_nWidth
+	       && nPosY + m_CharGen.GetCharHeight () <= m_nHeight;
+}
+
 void CScreenDevice::InvertCursor (void)
 {
 	if (!m_bCursorOn)
@@ -18,6 +18,8 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include <circle/soundbasedevice.h>
+#include <circle/synchronize.h>
+#include <circle/timer.h>
 #include <circle/util.h>
 #include <assert.h>
 
@@ -26,16 +28,25 @@ CSoundBaseDevice::CSoundBaseDevice (TSoundFormat HWFormat, u32 nRange32, unsigne
 :	m_HWFormat (HWFormat),
 	m_nSampleRate (nSampleRate),
 	m_bSwapChannels (bSwapChannels),
-	m_nQueueSize (0),
 	m_nNeedDataThreshold (0),
 	m_WriteFormat (SoundFormatUnknown),
 	m_nWriteChannels (0),
-	m_pQueue (0),
-	m_nInPtr (0),
-	m_nOutPtr (0),
-	m_pCallback (0)
+	m_bQueueUnderrun (TRUE),
+	m_nQueueUnderruns (0),
+	m_WriteSpinLock (IRQ_LEVEL),
+	m_pCallback (0),
+	m_ReadFormat (SoundFormatUnknown),
+	m_nReadChannels (0),
+	m_ullReadFrames (0),
+	m_ullCapturedFrames (0),
+	m_nCaptureTicksBase (0),
+	m_bReadQueueOverrun (FALSE),
+	m_nReadQueueOverruns (0),
+	m_pHaveDataCallback (0)
 {
 	memset (m_NullFrame, 0, sizeof m_NullFrame);
+	memset (&m_Queue, 0, sizeof m_Queue);
+	memset (&m_ReadQueue, 0, sizeof m_ReadQueue);
 
 	switch (m_HWFormat)
 	{
@@ -71,10 +82,14 @@ CSoundBaseDevice::CSoundBaseDevice (TSoundFormat HWFormat, u32 nRange32, unsigne
 
 CSoundBaseDevice::~CSoundBaseDevice (void)
 {
+	m_pHaveDataCallback = 0;
 	m_pCallback = 0;
 
-	delete [] m_pQueue;
-	m_pQueue = 0;
+	delete [] m_ReadQueue.pBuffer;
+	m_ReadQueue.pBuffer = 0;
+
+	delete [] m_Queue.pBuffer;
+	m_Queue.pBuffer = 0;
 }
 
 int CSoundBaseDevice::GetRangeMin (void) const
@@ -89,38 +104,38 @@ int CSoundBaseDevice::GetRangeMax (void) const
 
 boolean CSoundBaseDevice::AllocateQueue (unsigned nSizeMsecs)
 {
-	assert (m_pQueue == 0);
+	assert (m_Queue.pBuffer == 0);
 	assert (1 <= nSizeMsecs && nSizeMsecs <= 1000);
 
 	// 1 byte remains free
-	m_nQueueSize = (m_nHWFrameSize*m_nSampleRate*nSizeMsecs + 999) / 1000 + 1;
+	m_Queue.nSize = (m_nHWFrameSize*m_nSampleRate*nSizeMsecs + 999) / 1000 + 1;
 
-	m_pQueue = new u8[m_nQueueSize];
-	if (m_pQueue == 0)
+	m_Queue.pBuffer = new u8[m_Queue.nSize];
+	if (m_Queue.pBuffer == 0)
 	{
 		return FALSE;
 	}
 
-	m_nNeedDataThreshold = m_nQueueSize / 2;
+	m_nNeedDataThreshold = m_Queue.nSize / 2;
 
 	return TRUE;
 }
 
 boolean CSoundBaseDevice::AllocateQueueFrames (unsigned nSizeFrames)
 {
-	assert (m_pQueue == 0);
+	assert (m_Queue.pBuffer == 0);
 	assert (1 <= nSizeFrames && nSizeFrames <= m_nSampleRate);
 
 	// 1 byte remains free
-	m_nQueueSize = m_nHWFrameSize*nSizeFrames + 1;
+	m_Queue.nSize = m_nHWFrameSize*nSizeFrames + 1;
 
-	m_pQueue = new u8[m_nQueueSize];
-	if (m_pQueue == 0)
+	m_Queue.pBuffer = new u8[m_Queue.nSize];
+	if (m_Queue.pBuffer == 0)
 	{
 		return FALSE;
 	}
 
-	m_nNeedDataThreshold = m_nQueueSize / 2;
+	m_nNeedDataThreshold = m_Queue.nSize / 2;
 
 	return TRUE;
 }
@@ -164,15 +179,17 @@ int CSoundBaseDevice::Write (const void *pBuffer, size_t nCount)
 
 	int nResult = 0;
 
-	m_SpinLock.Acquire ();
+	// the need data callback may call Write() from IRQ_LEVEL, keep one producer only
+	m_WriteSpinLock.Acquire ();
 
 	if (   m_HWFormat == m_WriteFormat
+	    && m_nWriteSampleSize == m_nHWSampleSize		// not with packed 24-bit
 	    && m_nWriteChannels == SOUND_HW_CHANNELS
 	    && !m_bSwapChannels)
 	{
 		// fast path for Stereo samples without bit depth conversion or channel swapping
 
-		unsigned nBytes = GetQueueBytesFree ();
+		unsigned nBytes = GetQueueBytesFree (&m_Queue);
 		if (nBytes > nCount)
 		{
 			nBytes = nCount;
@@ -181,78 +198,67 @@ int CSoundBaseDevice::Write (const void *pBuffer, size_t nCount)
 
 		if (nBytes > 0)
 		{
-			Enqueue (pBuffer, nBytes);
+			Enqueue (&m_Queue, pBuffer, nBytes);
 
 			nResult = nBytes;
 		}
 	}
 	else
 	{
-		while (   nCount >= m_nWriteFrameSize
-		       && GetQueueBytesFree () >= m_nHWFrameSize)
+		unsigned nFrames = nCount / m_nWriteFrameSize;
+		unsigned nFramesFree = GetQueueBytesFree (&m_Queue) / m_nHWFrameSize;
+		if (nFrames > nFramesFree)
 		{
-			u8 Frame[SOUND_MAX_FRAME_SIZE];
+			nFrames = nFramesFree;
+		}
 
-			if (!m_bSwapChannels)
-			{
-				ConvertSoundFormat (Frame, pBuffer8);
-				pBuffer8 += m_nWriteSampleSize;
-
-				if (m_nWriteChannels == 2)
-				{
-					ConvertSoundFormat (Frame+m_nHWSampleSize, pBuffer8);
-					pBuffer8 += m_nWriteSampleSize;
-				}
-				else
-				{
-					memcpy (Frame+m_nHWSampleSize, Frame, m_nHWSampleSize);
-				}
-			}
-			else
+		// convert in blocks, intermediate format is 32-bit signed stereo
+		while (nFrames > 0)
+		{
+			unsigned nBlockFrames = nFrames;
+			if (nBlockFrames > SOUND_CONVERT_FRAMES)
 			{
-				ConvertSoundFormat (Frame+m_nHWSampleSize, pBuffer8);
-				pBuffer8 += m_nWriteSampleSize;
-
-				if (m_nWriteChannels == 2)
-				{
-					ConvertSoundFormat (Frame, pBuffer8);
-					pBuffer8 += m_nWriteSampleSize;
-				}
-				else
-				{
-					memcpy (Frame, Frame+m_nHWSampleSize, m_nHWSampleSize);
-				}
+				nBlockFrames = SOUND_CONVERT_FRAMES;
 			}
 
-			Enqueue (Frame, m_nHWFrameSize);
+			s32 Samples[SOUND_CONVERT_FRAMES * SOUND_HW_CHANNELS];
+			DecodeFrames (Samples, pBuffer8, nBlockFrames,
+				      m_WriteFormat, m_nWriteChannels, m_bSwapChannels);
+
+			u8 Frames[SOUND_CONVERT_FRAMES * SOUND_MAX_FRAME_SIZE];
+			EncodeFrames (Frames, Samples, nBlockFrames);
+
+			Enqueue (&m_Queue, Frames, nBlockFrames * m_nHWFrameSize);
 
-			nCount -= m_nWriteFrameSize;
-			nResult += m_nWriteFrameSize;
+			pBuffer8 += nBlockFrames * m_nWriteFrameSize;
+			nResult += nBlockFrames * m_nWriteFrameSize;
+			nFrames -= nBlockFrames;
 		}
 	}
 
-	m_SpinLock.Release ();
+	m_WriteSpinLock.Release ();
 
 	return nResult;
 }
 
 unsigned CSoundBaseDevice::GetQueueSizeFrames (void)
 {
-	assert (m_nQueueSize > 0);
-	return m_nQueueSize / m_nHWFrameSize;
+	assert (m_Queue.nSize > 0);
+	return m_Queue.nSize / m_nHWFrameSize;
 }
 
 unsigned CSoundBaseDevice::GetQueueFramesAvail (void)
 {
-	assert (m_nQueueSize > 0);
+	assert (m_Queue.nSize > 0);
 
-	m_SpinLock.Acquire ();
-
-	unsigned nQueueBytesAvail = GetQueueBytesAvail ();
+	return GetQueueBytesAvail (&m_Queue) / m_nHWFrameSize;
+}
 
-	m_SpinLock.Release ();
+unsigned CSoundBaseDevice::GetQueueFramesFree (void)
+{
+	assert (m_Queue.nSize > 0);
 
-	return nQueueBytesAvail / m_nHWFrameSize;
+	return GetQueueBytesFree (&m_Queue) / m_nHWFrameSize;
 }
 
 void CSoundBaseDevice::RegisterNeedDataCallback (TSoundNeedDataCallback *pCallback, void *pParam)
@@ -269,6 +275,118 @@ boolean CSoundBaseDevice::AreChannelsSwapped (void) const
 	return m_bSwapChannels;
 }
 
+boolean CSoundBaseDevice::AllocateReadQueue (unsigned nSizeMsecs)
+{
+	assert (m_ReadQueue.pBuffer == 0);
+	assert (1 <= nSizeMsecs && nSizeMsecs <= 1000);
+
+	// 1 byte remains free
+	m_ReadQueue.nSize = (m_nHWFrameSize*m_nSampleRate*nSizeMsecs + 999) / 1000 + 1;
+
+	m_ReadQueue.pBuffer = new u8[m_ReadQueue.nSize];
+	if (m_ReadQueue.pBuffer == 0)
+	{
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+void CSoundBaseDevice::SetReadFormat (TSoundFormat Format, unsigned nChannels)
+{
+	assert (Format < SoundFormatUnsigned32);
+	m_ReadFormat = Format;
+
+	assert (1 <= nChannels && nChannels <= 2);
+	m_nReadChannels = nChannels;
+
+	switch (m_ReadFormat)
+	{
+	case SoundFormatUnsigned8:
+		m_nReadSampleSize = sizeof (u8);
+		break;
+
+	case SoundFormatSigned16:
+		m_nReadSampleSize = sizeof (s16);
+		break;
+
+	case SoundFormatSigned24:
+		m_nReadSampleSize = sizeof (u8)*3;
+		break;
+
+	default:
+		assert (0);
+		break;
+	}
+
+	m_nReadFrameSize = m_nReadChannels * m_nReadSampleSize;
+}
+
+int CSoundBaseDevice::Read (void *pBuffer, size_t nCount, unsigned *pTimestamp)
+{
+	assert (m_ReadFormat < SoundFormatUnknown);
+	assert (m_ReadQueue.pBuffer != 0);
+
+	assert (pBuffer != 0);
+	u8 *pBuffer8 = static_cast<u8 *> (pBuffer);
+
+	unsigned nFrames = nCount / m_nReadFrameSize;
+	unsigned nFramesAvail = GetQueueBytesAvail (&m_ReadQueue) / m_nHWFrameSize;
+	if (nFrames > nFramesAvail)
+	{
+		nFrames = nFramesAvail;
+	}
+
+	if (pTimestamp != 0)
+	{
+		*pTimestamp =   m_nCaptureTicksBase
+			      + (unsigned) (m_ullReadFrames * CLOCKHZ / m_nSampleRate);
+	}
+
+	int nResult = 0;
+
+	// convert in blocks, intermediate format is 32-bit signed stereo
+	while (nFrames > 0)
+	{
+		unsigned nBlockFrames = nFrames;
+		if (nBlockFrames > SOUND_CONVERT_FRAMES)
+		{
+			nBlockFrames = SOUND_CONVERT_FRAMES;
+		}
+
+		u8 Frames[SOUND_CONVERT_FRAMES * SOUND_MAX_FRAME_SIZE];
+		Dequeue (&m_ReadQueue, Frames, nBlockFrames * m_nHWFrameSize);
+
+		s32 Samples[SOUND_CONVERT_FRAMES * SOUND_HW_CHANNELS];
+		DecodeHWFrames (Samples, Frames, nBlockFrames);
+		EncodeReadFrames (pBuffer8, Samples, nBlockFrames);
+
+		m_ullReadFrames += nBlockFrames;
+
+		pBuffer8 += nBlockFrames * m_nReadFrameSize;
+		nResult += nBlockFrames * m_nReadFrameSize;
+		nFrames -= nBlockFrames;
+	}
+
+	return nResult;
+}
+
+unsigned CSoundBaseDevice::GetReadQueueFramesAvail (void)
+{
+	assert (m_ReadQueue.nSize > 0);
+
+	return GetQueueBytesAvail (&m_ReadQueue) / m_nHWFrameSize;
+}
+
+void CSoundBaseDevice::RegisterHaveDataCallback (TSoundHaveDataCallback *pCallback, void *pParam)
+{
+	assert (m_pHaveDataCallback == 0);
+	m_pHaveDataCallback = pCallback;
+	assert (m_pHaveDataCallback != 0);
+
+	m_pHaveDataCallbackParam = pParam;
+}
+
 unsigned CSoundBaseDevice::GetChunk (s16 *pBuffer, unsigned nChunkSize)
 {
 	assert (m_HWFormat == SoundFormatSigned16);
@@ -284,60 +402,197 @@ unsigned CSoundBaseDevice::GetChunk (u32 *pBuffer, unsigned nChunkSize)
 	return GetChunkInternal (pBuffer, nChunkSize);
 }
 
-void CSoundBaseDevice::ConvertSoundFormat (void *pTo, const void *pFrom)
+void CSoundBaseDevice::PutChunk (const s16 *pBuffer, unsigned nChunkSize)
+{
+	assert (m_HWFormat == SoundFormatSigned16);
+
+	PutChunkInternal (pBuffer, nChunkSize);
+}
+
+void CSoundBaseDevice::PutChunk (const u32 *pBuffer, unsigned nChunkSize)
 {
-	s32 nValue = 0;
+	assert (m_HWFormat == SoundFormatSigned24);
 
-	switch (m_WriteFormat)
+	PutChunkInternal (pBuffer, nChunkSize);
+}
+
+void CSoundBaseDevice::DecodeFrames (s32 *pTo, const void *pFrom, unsigned nFrames,
+				     TSoundFormat Format, unsigned nChannels, boolean bSwapChannels)
+{
+	assert (pTo != 0);
+	assert (pFrom != 0);
+	assert (nChannels == 1 || nChannels == 2);
+
+	// channel index of the left and right output sample in the source frame
+	unsigned nLeft = 0;
+	unsigned nRight = 0;
+	if (nChannels == 2)
+	{
+		nLeft = bSwapChannels ? 1 : 0;
+		nRight = bSwapChannels ? 0 : 1;
+	}
+
+	switch (Format)
 	{
 	case SoundFormatUnsigned8: {
-		const u8 *pValue = reinterpret_cast<const u8 *> (pFrom);
-		nValue = *pValue;
-		nValue -= 128;
-		nValue <<= 24;
+		const u8 *pSamples = static_cast<const u8 *> (pFrom);
+		for (unsigned i = 0; i < nFrames; i++)
+		{
+			pTo[2*i]   = ((s32) pSamples[i*nChannels + nLeft] - 128) << 24;
+			pTo[2*i+1] = ((s32) pSamples[i*nChannels + nRight] - 128) << 24;
+		}
 		} break;
 
 	case SoundFormatSigned16: {
-		const s16 *pValue = reinterpret_cast<const s16 *> (pFrom);
-		nValue = *pValue;
-		nValue <<= 16;
+		const s16 *pSamples = static_cast<const s16 *> (pFrom);
+		for (unsigned i = 0; i < nFrames; i++)
+		{
+			pTo[2*i]   = (s32) pSamples[i*nChannels + nLeft] << 16;
+			pTo[2*i+1] = (s32) pSamples[i*nChannels + nRight] << 16;
+		}
 		} break;
 
 	case SoundFormatSigned24: {
-		const u32 *pValue = reinterpret_cast<const u32 *> (pFrom);
-		nValue = *pValue & 0xFFFFFF;
-		nValue <<= 8;
-		} break;
+		// packed format (3 bytes per sample)
+		const u8 *pSamples = static_cast<const u8 *> (pFrom);
+		for (unsigned i = 0; i < nFrames; i++)
+		{
+			const u8 *pLeft = &pSamples[(i*nChannels + nLeft) * 3];
+			const u8 *pRight = &pSamples[(i*nChannels + nRight) * 3];
 
-	case SoundFormatUnknown:
-		memcpy (pTo, pFrom, m_nWriteSampleSize);
-		return;
+			pTo[2*i]   = (s32) (  (u32) pLeft[0] << 8 | (u32) pLeft[1] << 16
+					    | (u32) pLeft[2] << 24);
+			pTo[2*i+1] = (s32) (  (u32) pRight[0] << 8 | (u32) pRight[1] << 16
+					    | (u32) pRight[2] << 24);
+		}
+		} break;
 
 	default:
 		assert (0);
 		break;
 	}
+}
+
+void CSoundBaseDevice::EncodeFrames (void *pTo, const s32 *pFrom, unsigned nFrames)
+{
+	assert (pTo != 0);
+	assert (pFrom != 0);
+
+	unsigned nSamples = nFrames * SOUND_HW_CHANNELS;
 
 	switch (m_HWFormat)
 	{
 	case SoundFormatSigned16: {
-		s16 *pValue = reinterpret_cast<s16 *> (pTo);
-		*pValue = nValue >> 16;
+		s16 *pSamples = static_cast<s16 *> (pTo);
+		for (unsigned i = 0; i < nSamples; i++)
+		{
+			pSamples[i] = pFrom[i] >> 16;
+		}
 		} break;
 
 	case SoundFormatSigned24: {
-		s32 *pValue = reinterpret_cast<s32 *> (pTo);
-		*pValue = nValue >> 8;
+		s32 *pSamples = static_cast<s32 *> (pTo);
+		for (unsigned i = 0; i < nSamples; i++)
+		{
+			pSamples[i] = pFrom[i] >> 8;
+		}
 		} break;
 
 	case SoundFormatUnsigned32: {
-		s64 llValue = (s64) nValue;
-		llValue += 1U << 31;
-		llValue *= m_nRangeMax;
-		llValue >>= 32;
+		// map the signed range to 0..m_nRangeMax
+		u32 *pSamples = static_cast<u32 *> (pTo);
+		u64 ullRange = (u64) m_nRangeMax;
+		for (unsigned i = 0; i < nSamples; i++)
+		{
+			pSamples[i] = (u32) (((u32) pFrom[i] ^ 0x80000000U) * ullRange >> 32);
+		}
+		} break;
 
-		u32 *pValue = reinterpret_cast<u32 *> (pTo);
-		*pValue = (u32) llValue;
+	default:
+		assert (0);
+		break;
+	}
+}
+
+void CSoundBaseDevice::DecodeHWFrames (s32 *pTo, const void *pFrom, unsigned nFrames)
+{
+	assert (pTo != 0);
+	assert (pFrom != 0);
+
+	unsigned nSamples = nFrames * SOUND_HW_CHANNELS;
+
+	switch (m_HWFormat)
+	{
+	case SoundFormatSigned16: {
+		const s16 *pSamples = static_cast<const s16 *> (pFrom);
+		for (unsigned i = 0; i < nSamples; i++)
+		{
+			pTo[i] = (s32) pSamples[i] << 16;
+		}
+		} break;
+
+	case SoundFormatSigned24: {
+		const s32 *pSamples = static_cast<const s32 *> (pFrom);
+		for (unsigned i = 0; i < nSamples; i++)
+		{
+			pTo[i] = (s32) ((u32) pSamples[i] << 8);
+		}
+		} break;
+
+	default:
+		assert (0);
+		break;
+	}
+
+	if (m_bSwapChannels)
+	{
+		for (unsigned i = 0; i < nSamples; i += 2)
+		{
+			s32 nTemp = pTo[i];
+			pTo[i] = pTo[i+1];
+			pTo[i+1] = nTemp;
+		}
+	}
+}
+
+void CSoundBaseDevice::EncodeReadFrames (void *pTo, const s32 *pFrom, unsigned nFrames)
+{
+	assert (pTo != 0);
+	assert (pFrom != 0);
+
+	// mono returns the left channel only
+	unsigned nStep = SOUND_HW_CHANNELS / m_nReadChannels;
+	unsigned nSamples = nFrames * m_nReadChannels;
+
+	switch (m_ReadFormat)
+	{
+	case SoundFormatUnsigned8: {
+		u8 *pSamples = static_cast<u8 *> (pTo);
+		for (unsigned i = 0; i < nSamples; i++)
+		{
+			pSamples[i] = (u8) (((u32) pFrom[i*nStep] >> 24) ^ 0x80);
+		}
+		} break;
+
+	case SoundFormatSigned16: {
+		s16 *pSamples = static_cast<s16 *> (pTo);
+		for (unsigned i = 0; i < nSamples; i++)
+		{
+			pSamples[i] = pFrom[i*nStep] >> 16;
+		}
+		} break;
+
+	case SoundFormatSigned24: {
+		// packed format (3 bytes per sample)
+		u8 *pSamples = static_cast<u8 *> (pTo);
+		for (unsigned i = 0; i < nSamples; i++)
+		{
+			u32 nSample = (u32) pFrom[i*nStep];
+
+			pSamples[i*3]   = (u8) (nSample >> 8);
+			pSamples[i*3+1] = (u8) (nSample >> 16);
+			pSamples[i*3+2] = (u8) (nSample >> 24);
+		}
 		} break;
 
 	default:
@@ -355,9 +610,7 @@ unsigned CSoundBaseDevice::GetChunkInternal (void *pBuffer, unsigned nChunkSize)
 	assert (nChunkSize % SOUND_HW_CHANNELS == 0);
 	unsigned nChunkSizeBytes = nChunkSize * m_nHWSampleSize;
 
-	m_SpinLock.Acquire ();
-
-	unsigned nQueueBytesAvail = GetQueueBytesAvail ();
+	unsigned nQueueBytesAvail = GetQueueBytesAvail (&m_Queue);
 	unsigned nBytes = nQueueBytesAvail;
 	if (nBytes > nChunkSizeBytes)
 	{
@@ -366,13 +619,25 @@ unsigned CSoundBaseDevice::GetChunkInternal (void *pBuffer, unsigned nChunkSize)
 
 	if (nBytes > 0)
 	{
-		Dequeue (pBuffer8, nBytes);
+		Dequeue (&m_Queue, pBuffer8, nBytes);
 
 		pBuffer8 += nBytes;
 		nQueueBytesAvail -= nBytes;
 	}
 
-	m_SpinLock.Release ();
+	// count once, when the queue runs empty, not while it stays empty
+	if (nBytes < nChunkSizeBytes)
+	{
+		if (!m_bQueueUnderrun)
+		{
+			m_bQueueUnderrun = TRUE;
+			m_nQueueUnderruns++;
+		}
+	}
+	else
+	{
+		m_bQueueUnderrun = FALSE;
+	}
 
 	while (nBytes < nChunkSizeBytes)
 	{
@@ -391,66 +656,157 @@ unsigned CSoundBaseDevice::GetChunkInternal (void *pBuffer, unsigned nChunkSize)
 	return nChunkSize;
 }
 
-unsigned CSoundBaseDevice::GetQueueBytesFree (void)
+void CSoundBaseDevice::PutChunkInternal (const void *pBuffer, unsigned nChunkSize)
 {
-	assert (m_nQueueSize > 1);
-	assert (m_nInPtr < m_nQueueSize);
-	assert (m_nOutPtr < m_nQueueSize);
+	assert (pBuffer != 0);
+
+	if (m_ReadQueue.pBuffer == 0)		// capture is not used with Read()
+	{
+		return;
+	}
+
+	assert (nChunkSize > 0);
+	assert (nChunkSize % SOUND_HW_CHANNELS == 0);
+	unsigned nChunkSizeBytes = nChunkSize * m_nHWSampleSize;
+
+	unsigned nBytes = GetQueueBytesFree (&m_ReadQueue);
+	nBytes -= nBytes % m_nHWFrameSize;	// must be a multiple of frame size
+	if (nBytes > nChunkSizeBytes)
+	{
+		nBytes = nChunkSizeBytes;
+	}
 
-	if (m_nOutPtr <= m_nInPtr)
+	if (nBytes > 0)
+	{
+		Enqueue (&m_ReadQueue, pBuffer, nBytes);
+	}
+
+	// count once, when the queue runs full, not while it stays full
+	if (nBytes < nChunkSizeBytes)
+	{
+		if (!m_bReadQueueOverrun)
+		{
+			m_bReadQueueOverrun = TRUE;
+			m_nReadQueueOverruns++;
+		}
+	}
+	else
 	{
-		return m_nQueueSize+m_nOutPtr-m_nInPtr-1;
+		m_bReadQueueOverrun = FALSE;
 	}
 
-	return m_nOutPtr-m_nInPtr-1;
+	// The last frame of the chunk has been captured just now. The time of the first
+	// frame of the read stream is derived from this, frames dropped above included.
+	unsigned nFramesDropped = (nChunkSizeBytes - nBytes) / m_nHWFrameSize;
+	m_ullCapturedFrames += nBytes / m_nHWFrameSize;
+	m_nCaptureTicksBase =   CTimer::GetClockTicks ()
+			      - (unsigned) (  (m_ullCapturedFrames + nFramesDropped) * CLOCKHZ
+					    / m_nSampleRate);
+
+	if (   m_pHaveDataCallback != 0
+	    && nBytes > 0)
+	{
+		(*m_pHaveDataCallback) (m_pHaveDataCallbackParam);
+	}
 }
 
-unsigned CSoundBaseDevice::GetQueueBytesAvail (void)
+unsigned CSoundBaseDevice::GetQueueBytesFree (const TQueue *pQueue)
 {
-	assert (m_nQueueSize > 1);
-	assert (m_nInPtr < m_nQueueSize);
-	assert (m_nOutPtr < m_nQueueSize);
+	// the pointers are read once, the other one may be updated concurrently
+	unsigned nInPtr = pQueue->nInPtr;
+	unsigned nOutPtr = pQueue->nOutPtr;
+
+	assert (pQueue->nSize > 1);
+	assert (nInPtr < pQueue->nSize);
+	assert (nOutPtr < pQueue->nSize);
 
-	if (m_nInPtr < m_nOutPtr)
+	if (nOutPtr <= nInPtr)
 	{
-		return m_nQueueSize+m_nInPtr-m_nOutPtr;
+		return pQueue->nSize+nOutPtr-nInPtr-1;
 	}
 
-	return m_nInPtr-m_nOutPtr;
+	return nOutPtr-nInPtr-1;
 }
 
-void CSoundBaseDevice::Enqueue (const void *pBuffer, unsigned nCount)
+unsigned CSoundBaseDevice::GetQueueBytesAvail (const TQueue *pQueue)
+{
+	unsigned nInPtr = pQueue->nInPtr;
+	unsigned nOutPtr = pQueue->nOutPtr;
+
+	assert (pQueue->nSize > 1);
+	assert (nInPtr < pQueue->nSize);
+	assert (nOutPtr < pQueue->nSize);
+
+	if (nInPtr < nOutPtr)
+	{
+		return pQueue->nSize+nInPtr-nOutPtr;
+	}
+
+	return nInPtr-nOutPtr;
+}
+
+void CSoundBaseDevice::Enqueue (TQueue *pQueue, const void *pBuffer, unsigned nCount)
 {
 	const u8 *p = static_cast<const u8 *> (pBuffer);
 	assert (p != 0);
-	assert (m_pQueue != 0);
+	assert (pQueue->pBuffer != 0);
 
 	assert (nCount > 0);
-	while (nCount-- > 0)
+	assert (nCount <= pQueue->nSize);
+
+	unsigned nInPtr = pQueue->nInPtr;
+
+	unsigned nPart = pQueue->nSize - nInPtr;	// until end of ring buffer
+	if (nPart > nCount)
 	{
-		m_pQueue[m_nInPtr] = *p++;
+		nPart = nCount;
+	}
 
-		if (++m_nInPtr == m_nQueueSize)
-		{
-			m_nInPtr = 0;
-		}
+	DataMemBarrier ();		// order against the read of the other pointer
+
+	memcpy (pQueue->pBuffer + nInPtr, p, nPart);
+	memcpy (pQueue->pBuffer, p + nPart, nCount - nPart);
+
+	nInPtr += nCount;
+	if (nInPtr >= pQueue->nSize)
+	{
+		nInPtr -= pQueue->nSize;
 	}
+
+	DataMemBarrier ();		// data must be complete, before the pointer is updated
+
+	pQueue->nInPtr = nInPtr;
 }
 
-void CSoundBaseDevice::Dequeue (void *pBuffer, unsigned nCount)
+void CSoundBaseDevice::Dequeue (TQueue *pQueue, void *pBuffer, unsigned nCount)
 {
 	u8 *p = static_cast<u8 *> (pBuffer);
 	assert (p != 0);
-	assert (m_pQueue != 0);
+	assert (pQueue->pBuffer != 0);
 
 	assert (nCount > 0);
-	while (nCount-- > 0)
+	assert (nCount <= pQueue->nSize);
+
+	unsigned nOutPtr = pQueue->nOutPtr;
+
+	unsigned nPart = pQueue->nSize - nOutPtr;	// until end of ring buffer
+	if (nPart > nCount)
 	{
-		*p++ = m_pQueue[m_nOutPtr];
+		nPart = nCount;
+	}
 
-		if (++m_nOutPtr == m_nQueueSize)
-		{
-			m_nOutPtr = 0;
-		}
+	DataMemBarrier ();		// order against the read of the other pointer
+
+	memcpy (p, pQueue->pBuffer + nOutPtr, nPart);
+	memcpy (p + nPart, pQueue->pBuffer, nCount - nPart);
+
+	nOutPtr += nCount;
+	if (nOutPtr >= pQueue->nSize)
+	{
+		nOutPtr -= pQueue->nSize;
 	}
+
+	DataMemBarrier ();		// data must be read, before the pointer is updated
+
+	pQueue->nOutPtr = nOutPtr;
 }
@@ -0,0 +1,420 @@
+//
+// soundmixer.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2020  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/soundmixer.h>
+#include <circle/util.h>
+#include <assert.h>
+
+#define SAMPLE_MAX		((1 << 23) - 1)		// internal format is 24-bit
+#define SAMPLE_MIN		(-(1 << 23))
+
+#define MAX_GAIN		(4 * SOUND_MIXER_UNITY_GAIN)
+
+CSoundMixerStream::CSoundMixerStream (unsigned nSampleRate, unsigned nQueueFrames)
+:	m_nSampleRate (nSampleRate),
+	m_nQueueSize (nQueueFrames + 1),		// 1 frame remains free
+	m_nInPtr (0),
+	m_nOutPtr (0),
+	m_WriteFormat (SoundFormatUnknown),
+	m_nWriteChannels (0),
+	m_nWriteFrameSize (0),
+	m_nGain (SOUND_MIXER_UNITY_GAIN),
+	m_nStep (1 << 16),
+	m_nPhase (0),
+	m_SpinLock (TASK_LEVEL)
+{
+	assert (m_nSampleRate > 0);
+	assert (nQueueFrames > 0);
+
+	m_pQueue = new s32[m_nQueueSize * SOUND_HW_CHANNELS];
+	assert (m_pQueue != 0);
+}
+
+CSoundMixerStream::~CSoundMixerStream (void)
+{
+	delete [] m_pQueue;
+	m_pQueue = 0;
+}
+
+void CSoundMixerStream::SetWriteFormat (TSoundFormat Format, unsigned nChannels)
+{
+	assert (1 <= nChannels && nChannels <= 2);
+	m_nWriteChannels = nChannels;
+
+	unsigned nSampleSize = 0;
+	switch (Format)
+	{
+	case SoundFormatUnsigned8:	nSampleSize = sizeof (u8);	break;
+	case SoundFormatSigned16:	nSampleSize = sizeof (s16);	break;
+	case SoundFormatSigned24:	nSampleSize = sizeof (u8)*3;	break;
+
+	default:
+		assert (0);
+		break;
+	}
+
+	m_WriteFormat = Format;
+	m_nWriteFrameSize = m_nWriteChannels * nSampleSize;
+}
+
+int CSoundMixerStream::Write (const void *pBuffer, size_t nCount)
+{
+	assert (m_WriteFormat < SoundFormatUnknown);
+	assert (m_nWriteFrameSize > 0);
+
+	assert (pBuffer != 0);
+	const u8 *pBuffer8 = static_cast<const u8 *> (pBuffer);
+
+	m_SpinLock.Acquire ();
+
+	unsigned nFrames = nCount / m_nWriteFrameSize;
+	unsigned nFramesFree = GetQueueFramesFree ();
+	if (nFrames > nFramesFree)
+	{
+		nFrames = nFramesFree;
+	}
+
+	int nResult = nFrames * m_nWriteFrameSize;
+
+	while (nFrames > 0)
+	{
+		// convert to the end of the block or of the ring buffer
+		unsigned nBlockFrames = nFrames;
+		if (nBlockFrames > SOUND_CONVERT_FRAMES)
+		{
+			nBlockFrames = SOUND_CONVERT_FRAMES;
+		}
+
+		if (nBlockFrames > m_nQueueSize - m_nInPtr)
+		{
+			nBlockFrames = m_nQueueSize - m_nInPtr;
+		}
+
+		s32 *pSamples = &m_pQueue[m_nInPtr * SOUND_HW_CHANNELS];
+		CSoundBaseDevice::DecodeFrames (pSamples, pBuffer8, nBlockFrames,
+						m_WriteFormat, m_nWriteChannels);
+
+		for (unsigned i = 0; i < nBlockFrames * SOUND_HW_CHANNELS; i++)
+		{
+			pSamples[i] >>= 8;
+		}
+
+		m_nInPtr += nBlockFrames;
+		if (m_nInPtr == m_nQueueSize)
+		{
+			m_nInPtr = 0;
+		}
+
+		pBuffer8 += nBlockFrames * m_nWriteFrameSize;
+		nFrames -= nBlockFrames;
+	}
+
+	m_SpinLock.Release ();
+
+	return nResult;
+}
+
+void CSoundMixerStream::SetGain (unsigned nGain)
+{
+	assert (nGain <= MAX_GAIN);
+	m_nGain = nGain;
+}
+
+unsigned CSoundMixerStream::GetQueueFramesAvail (void)
+{
+	m_SpinLock.Acquire ();
+
+	unsigned nFrames = m_nQueueSize - 1 - GetQueueFramesFree ();
+
+	m_SpinLock.Release ();
+
+	return nFrames;
+}
+
+void CSoundMixerStream::SetOutputRate (unsigned nOutputRate)
+{
+	assert (nOutputRate > 0);
+	m_nStep = (u32) (((u64) m_nSampleRate << 16) / nOutputRate);
+	assert (m_nStep > 0);
+
+	m_nPhase = 0;
+}
+
+// An output frame can be generated, if the input frame at the current position and,
+// if the position is between two frames, the next input frame are available.
+
+unsigned CSoundMixerStream::GetFramesReady (void)
+{
+	unsigned nAvail = GetQueueFramesAvail ();
+	if (nAvail == 0)
+	{
+		return 0;
+	}
+
+	u64 ullLast = (u64) (nAvail - 1) << 16;
+	if (m_nPhase > ullLast)
+	{
+		return 0;
+	}
+
+	return (unsigned) ((ullLast - m_nPhase) / m_nStep) + 1;
+}
+
+// Converts the sample rate with linear interpolation, applies the gain and adds the
+// result to pBuffer. If not enough frames are available, the rest is left untouched.
+
+void CSoundMixerStream::Mix (s32 *pBuffer, unsigned nFrames)
+{
+	assert (pBuffer != 0);
+
+	m_SpinLock.Acquire ();
+
+	unsigned nAvail = m_nQueueSize - 1 - GetQueueFramesFree ();
+	s32 nGain = m_nGain;
+	u32 nPhase = m_nPhase;
+
+	for (unsigned i = 0; i < nFrames; i++)
+	{
+		unsigned nPos = nPhase >> 16;
+		u32 nFrac = nPhase & 0xFFFF;
+
+		if (nPos + (nFrac != 0 ? 1 : 0) >= nAvail)
+		{
+			break;
+		}
+
+		unsigned nIndex = m_nOutPtr + nPos;
+		if (nIndex >= m_nQueueSize)
+		{
+			nIndex -= m_nQueueSize;
+		}
+
+		const s32 *pFrame = &m_pQueue[nIndex * SOUND_HW_CHANNELS];
+		s32 nLeft = pFrame[0];
+		s32 nRight = pFrame[1];
+
+		if (nFrac != 0)
+		{
+			if (++nIndex == m_nQueueSize)
+			{
+				nIndex = 0;
+			}
+
+			const s32 *pNext = &m_pQueue[nIndex * SOUND_HW_CHANNELS];
+			nLeft += (s32) (((s64) (pNext[0] - nLeft) * nFrac) >> 16);
+			nRight += (s32) (((s64) (pNext[1] - nRight) * nFrac) >> 16);
+		}
+
+		pBuffer[2*i]   += (s32) (((s64) nLeft * nGain) >> 8);
+		pBuffer[2*i+1] += (s32) (((s64) nRight * nGain) >> 8);
+
+		nPhase += m_nStep;
+	}
+
+	// consume the input frames before the current position
+	unsigned nConsumed = nPhase >> 16;
+	if (nConsumed > nAvail)
+	{
+		nConsumed = nAvail;
+	}
+
+	m_nPhase = nPhase - (nConsumed << 16);
+
+	m_nOutPtr += nConsumed;
+	if (m_nOutPtr >= m_nQueueSize)
+	{
+		m_nOutPtr -= m_nQueueSize;
+	}
+
+	m_SpinLock.Release ();
+}
+
+unsigned CSoundMixerStream::GetQueueFramesFree (void) const
+{
+	assert (m_nInPtr < m_nQueueSize);
+	assert (m_nOutPtr < m_nQueueSize);
+
+	if (m_nOutPtr <= m_nInPtr)
+	{
+		return m_nQueueSize+m_nOutPtr-m_nInPtr-1;
+	}
+
+	return m_nOutPtr-m_nInPtr-1;
+}
+
+CSoundMixer::CSoundMixer (CSoundBaseDevice *pDevice, unsigned nSampleRate, unsigned nChunkFrames)
+:	m_pDevice (pDevice),
+	m_nSampleRate (nSampleRate),
+	m_nChunkFrames (nChunkFrames)
+{
+	assert (m_pDevice != 0);
+	assert (m_nSampleRate > 0);
+	assert (m_nChunkFrames > 0);
+
+	for (unsigned i = 0; i < SOUND_MIXER_MAX_STREAMS; i++)
+	{
+		m_pStream[i] = 0;
+	}
+
+	// 16-bit output is sufficient for devices with a smaller range (e.g. PWM)
+	m_b24Bit = m_pDevice->GetRangeMax () > 32767;
+	m_pDevice->SetWriteFormat (m_b24Bit ? SoundFormatSigned24 : SoundFormatSigned16, 2);
+
+	m_pMixBuffer = new s32[m_nChunkFrames * SOUND_HW_CHANNELS];
+	assert (m_pMixBuffer != 0);
+
+	m_pOutBuffer = new u8[m_nChunkFrames * SOUND_HW_CHANNELS * 3];
+	assert (m_pOutBuffer != 0);
+}
+
+CSoundMixer::~CSoundMixer (void)
+{
+	delete [] m_pOutBuffer;
+	m_pOutBuffer = 0;
+
+	delete [] m_pMixBuffer;
+	m_pMixBuffer = 0;
+
+	m_pDevice = 0;
+}
+
+boolean CSoundMixer::AddStream (CSoundMixerStream *pStream)
+{
+	assert (pStream != 0);
+
+	for (unsigned i = 0; i < SOUND_MIXER_MAX_STREAMS; i++)
+	{
+		if (m_pStream[i] == 0)
+		{
+			pStream->SetOutputRate (m_nSampleRate);
+
+			m_pStream[i] = pStream;
+
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+void CSoundMixer::RemoveStream (CSoundMixerStream *pStream)
+{
+	assert (pStream != 0);
+
+	for (unsigned i = 0; i < SOUND_MIXER_MAX_STREAMS; i++)
+	{
+		if (m_pStream[i] == pStream)
+		{
+			m_pStream[i] = 0;
+		}
+	}
+}
+
+void CSoundMixer::Update (void)
+{
+	assert (m_pDevice != 0);
+
+	unsigned nFramesFree = m_pDevice->GetQueueFramesFree ();
+
+	while (nFramesFree >= m_nChunkFrames)
+	{
+		// mix only if at least one stream can deliver a whole chunk,
+		// streams with less data are filled up with silence
+		boolean bReady = FALSE;
+		for (unsigned i = 0; i < SOUND_MIXER_MAX_STREAMS; i++)
+		{
+			if (   m_pStream[i] != 0
+			    && m_pStream[i]->GetFramesReady () >= m_nChunkFrames)
+			{
+				bReady = TRUE;
+			}
+		}
+
+		if (!bReady)
+		{
+			break;
+		}
+
+		memset (m_pMixBuffer, 0, m_nChunkFrames * SOUND_HW_CHANNELS * sizeof (s32));
+
+		for (unsigned i = 0; i < SOUND_MIXER_MAX_STREAMS; i++)
+		{
+			if (m_pStream[i] != 0)
+			{
+				m_pStream[i]->Mix (m_pMixBuffer, m_nChunkFrames);
+			}
+		}
+
+		Output (m_nChunkFrames);
+
+		nFramesFree -= m_nChunkFrames;
+	}
+}
+
+void CSoundMixer::Output (unsigned nFrames)
+{
+	unsigned nSamples = nFrames * SOUND_HW_CHANNELS;
+
+	for (unsigned i = 0; i < nSamples; i++)
+	{
+		s32 nValue = m_pMixBuffer[i];
+
+		if (nValue > SAMPLE_MAX)
+		{
+			nValue = SAMPLE_MAX;
+		}
+		else if (nValue < SAMPLE_MIN)
+		{
+			nValue = SAMPLE_MIN;
+		}
+
+		m_pMixBuffer[i] = nValue;
+	}
+
+	unsigned nBytes;
+	if (m_b24Bit)
+	{
+		for (unsigned i = 0; i < nSamples; i++)
+		{
+			u32 nValue = (u32) m_pMixBuffer[i];
+
+			m_pOutBuffer[3*i]   = nValue & 0xFF;
+			m_pOutBuffer[3*i+1] = (nValue >> 8) & 0xFF;
+			m_pOutBuffer[3*i+2] = (nValue >> 16) & 0xFF;
+		}
+
+		nBytes = nSamples * 3;
+	}
+	else
+	{
+		s16 *pOutBuffer = (s16 *) m_pOutBuffer;
+		for (unsigned i = 0; i < nSamples; i++)
+		{
+			pOutBuffer[i] = m_pMixBuffer[i] >> 8;
+		}
+
+		nBytes = nSamples * sizeof (s16);
+	}
+
+#ifndef NDEBUG
+	int nResult =
+#endif
+		m_pDevice->Write (m_pOutBuffer, nBytes);
+	assert (nResult == (int) nBytes);
+}
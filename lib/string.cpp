@@ -21,8 +21,7 @@
 //
 #include <circle/string.h>
 #include <circle/util.h>
-
-#define FORMAT_RESERVE		64	// additional bytes to allocate
+#include <assert.h>
 
 #if AARCH == 32
 	#define MAX_NUMBER_LEN		22	// 64 bit octal number
@@ -35,96 +34,111 @@
 #define MAX_FLOAT_LEN		(1+MAX_NUMBER_LEN+1+MAX_PRECISION)
 
 CString::CString (void)
-:	m_pBuffer (0),
-	m_nSize (0)
+:	m_pBuffer (m_InlineBuffer),
+	m_nSize (STRING_INLINE_SIZE),
+	m_pInPtr (m_InlineBuffer),
+	m_bFixed (FALSE)
 {
+	m_InlineBuffer[0] = '\0';
 }
 
 CString::CString (const char *pString)
+:	m_pBuffer (m_InlineBuffer),
+	m_nSize (STRING_INLINE_SIZE),
+	m_pInPtr (m_InlineBuffer),
+	m_bFixed (FALSE)
+{
+	Assign (pString);
+}
+
+CString::CString (const CString &rString)
+:	m_pBuffer (m_InlineBuffer),
+	m_nSize (STRING_INLINE_SIZE),
+	m_pInPtr (m_InlineBuffer),
+	m_bFixed (FALSE)
 {
-	m_nSize = strlen (pString)+1;
+	Assign (rString.m_pBuffer);
+}
+
+CString::CString (CString &&rrString)
+:	m_pBuffer (m_InlineBuffer),
+	m_nSize (STRING_INLINE_SIZE),
+	m_pInPtr (m_InlineBuffer),
+	m_bFixed (FALSE)
+{
+	m_InlineBuffer[0] = '\0';
+
+	Move (rrString);
+}
 
-	m_pBuffer = new char[m_nSize];
+CString::CString (char *pBuffer, size_t nSize)
+:	m_pBuffer (pBuffer),
+	m_nSize (nSize),
+	m_pInPtr (pBuffer),
+	m_bFixed (TRUE)
+{
+	assert (m_pBuffer != 0);
+	assert (m_nSize > 0);
 
-	strcpy (m_pBuffer, pString);
+	m_pBuffer[0] = '\0';
 }
 
 CString::~CString (void)
 {
-	delete [] m_pBuffer;
+	FreeBuffer ();
 	m_pBuffer = 0;
 }
 
 CString::operator const char *(void) const
 {
-	if (m_pBuffer != 0)
-	{
-		return m_pBuffer;
-	}
-
-	return "";
+	return m_pBuffer;
 }
 
 const char *CString::operator = (const char *pString)
 {
-	delete [] m_pBuffer;
-
-	m_nSize = strlen (pString)+1;
-
-	m_pBuffer = new char[m_nSize];
-
-	strcpy (m_pBuffer, pString);
+	Assign (pString);
 
 	return m_pBuffer;
 }
 
 const CString &CString::operator = (const CString &rString)
 {
-	delete [] m_pBuffer;
-
-	m_nSize = strlen (rString)+1;
+	if (&rString != this)
+	{
+		Assign (rString.m_pBuffer);
+	}
 
-	m_pBuffer = new char[m_nSize];
+	return *this;
+}
 
-	strcpy (m_pBuffer, rString);
+const CString &CString::operator = (CString &&rrString)
+{
+	Move (rrString);
 
 	return *this;
 }
 
 size_t CString::GetLength (void) const
 {
-	if (m_pBuffer == 0)
-	{
-		return 0;
-	}
-	
 	return strlen (m_pBuffer);
 }
 
 void CString::Append (const char *pString)
 {
-	m_nSize = 1;		// for terminating '\0'
-	if (m_pBuffer != 0)
+	if (   pString >= m_pBuffer			// appending our own contents?
+	    && pString < m_pBuffer + m_nSize)
 	{
-		m_nSize += strlen (m_pBuffer);
-	}
-	m_nSize += strlen (pString);
-
-	char *pBuffer = new char[m_nSize];
+		CString Copy (pString);
+		Append (Copy);
 
-	if (m_pBuffer != 0)
-	{
-		strcpy (pBuffer, m_pBuffer);
-		delete [] m_pBuffer;
-	}
-	else
-	{
-		*pBuffer = '\0';
+		return;
 	}
 
-	strcat (pBuffer, pString);
+	m_pInPtr = m_pBuffer + strlen (m_pBuffer);
+
+	PutString (pString);
 
-	m_pBuffer = pBuffer;
+	*m_pInPtr = '\0';
 }
 
 int CString::Compare (const char *pString) const
@@ -158,12 +172,8 @@ int CString::Replace (const char *pOld, const char *pNew)
 		return nResult;
 	}
 
-	CString OldString (m_pBuffer);
-
-	delete [] m_pBuffer;
-	m_nSize = FORMAT_RESERVE;
-	m_pBuffer = new char[m_nSize];
-	m_pInPtr = m_pBuffer;
+	CString OldString;
+	OldString.Move (*this);
 
 	const char *pReader = OldString.m_pBuffer;
 	const char *pFound;
@@ -214,10 +224,43 @@ void CString::Format (const char *pFormat, ...)
 
 void CString::FormatV (const char *pFormat, va_list Args)
 {
-	delete [] m_pBuffer;
+	if (m_bFixed)
+	{
+		FormatInPlace (pFormat, Args);
 
-	m_nSize = FORMAT_RESERVE;
-	m_pBuffer = new char[m_nSize];
+		return;
+	}
+
+	// the arguments may refer to our own contents, so format into a temporary
+	// string, which does not need the heap, if the result is short enough
+	CString Result;
+	Result.FormatInPlace (pFormat, Args);
+
+	Move (Result);
+}
+
+size_t CString::FormatBuffer (char *pBuffer, size_t nSize, const char *pFormat, ...)
+{
+	va_list var;
+	va_start (var, pFormat);
+
+	size_t nResult = FormatBufferV (pBuffer, nSize, pFormat, var);
+
+	va_end (var);
+
+	return nResult;
+}
+
+size_t CString::FormatBufferV (char *pBuffer, size_t nSize, const char *pFormat, va_list Args)
+{
+	CString String (pBuffer, nSize);
+	String.FormatInPlace (pFormat, Args);
+
+	return String.m_pInPtr - pBuffer;
+}
+
+void CString::FormatInPlace (const char *pFormat, va_list Args)
+{
 	m_pInPtr = m_pBuffer;
 
 	while (*pFormat != '\0')
@@ -544,9 +587,88 @@ void CString::FormatV (const char *pFormat, va_list Args)
 	*m_pInPtr = '\0';
 }
 
+void CString::Assign (const char *pString)
+{
+	size_t nLength = strlen (pString);
+
+	if (   nLength >= m_nSize
+	    && !m_bFixed)
+	{
+		size_t nNewSize = nLength+1;
+		if (nNewSize < 2*m_nSize)
+		{
+			nNewSize = 2*m_nSize;
+		}
+
+		char *pNewBuffer = new char[nNewSize];
+		memcpy (pNewBuffer, pString, nLength+1);
+
+		FreeBuffer ();		// pString may point into the old buffer
+
+		m_pBuffer = pNewBuffer;
+		m_nSize = nNewSize;
+	}
+	else
+	{
+		if (nLength >= m_nSize)
+		{
+			nLength = m_nSize-1;
+		}
+
+		memmove (m_pBuffer, pString, nLength);
+		m_pBuffer[nLength] = '\0';
+	}
+
+	m_pInPtr = m_pBuffer + nLength;
+}
+
+void CString::Move (CString &rString)
+{
+	if (&rString == this)
+	{
+		return;
+	}
+
+	if (   rString.m_pBuffer == rString.m_InlineBuffer
+	    || rString.m_bFixed
+	    || m_bFixed)
+	{
+		Assign (rString.m_pBuffer);
+
+		rString.m_pBuffer[0] = '\0';
+	}
+	else
+	{
+		FreeBuffer ();
+
+		m_pBuffer = rString.m_pBuffer;		// take over heap block
+		m_nSize = rString.m_nSize;
+		m_pInPtr = m_pBuffer;
+
+		rString.m_pBuffer = rString.m_InlineBuffer;
+		rString.m_nSize = STRING_INLINE_SIZE;
+		rString.m_InlineBuffer[0] = '\0';
+	}
+
+	rString.m_pInPtr = rString.m_pBuffer;
+}
+
+void CString::FreeBuffer (void)
+{
+	if (   m_pBuffer != m_InlineBuffer
+	    && !m_bFixed)
+	{
+		delete [] m_pBuffer;
+
+		m_pBuffer = m_InlineBuffer;
+		m_nSize = STRING_INLINE_SIZE;
+		m_InlineBuffer[0] = '\0';
+	}
+}
+
 void CString::PutChar (char chChar, size_t nCount)
 {
-	ReserveSpace (nCount);
+	nCount = ReserveSpace (nCount);
 
 	while (nCount--)
 	{
@@ -556,41 +678,44 @@ void CString::PutChar (char chChar, size_t nCount)
 
 void CString::PutString (const char *pString)
 {
-	size_t nLen = strlen (pString);
-	
-	ReserveSpace (nLen);
-	
-	strcpy (m_pInPtr, pString);
-	
+	size_t nLen = ReserveSpace (strlen (pString));
+
+	memcpy (m_pInPtr, pString, nLen);
+
 	m_pInPtr += nLen;
 }
 
-void CString::ReserveSpace (size_t nSpace)
+size_t CString::ReserveSpace (size_t nSpace)
 {
-	if (nSpace == 0)
-	{
-		return;
-	}
-	
 	size_t nOffset = m_pInPtr - m_pBuffer;
 	size_t nNewSize = nOffset + nSpace + 1;
 	if (m_nSize >= nNewSize)
 	{
-		return;
+		return nSpace;
 	}
-	
-	nNewSize += FORMAT_RESERVE;
+
+	if (m_bFixed)
+	{
+		assert (m_nSize > nOffset);
+		return m_nSize - nOffset - 1;	// truncate
+	}
+
+	if (nNewSize < 2*m_nSize)		// grow geometrically
+	{
+		nNewSize = 2*m_nSize;
+	}
+
 	char *pNewBuffer = new char[nNewSize];
-		
-	*m_pInPtr = '\0';
-	strcpy (pNewBuffer, m_pBuffer);
-	
-	delete [] m_pBuffer;
+	memcpy (pNewBuffer, m_pBuffer, nOffset);
+
+	FreeBuffer ();
 
 	m_pBuffer = pNewBuffer;
 	m_nSize = nNewSize;
 
 	m_pInPtr = m_pBuffer + nOffset;
+
+	return nSpace;
 }
 
 char *CString::ntoa (char *pDest, unsigned long ulNumber, unsigned nBase, boolean bUpcase)
@@ -233,6 +233,56 @@ unsigned CTimer::GetClockTicks (void)
 #endif
 }
 
+u64 CTimer::GetTicks64 (void)
+{
+#if RASPPI == 1
+	PeripheralEntry ();
+
+	u32 nHigh, nLow;
+	do
+	{
+		nHigh = read32 (ARM_SYSTIMER_CHI);
+		nLow = read32 (ARM_SYSTIMER_CLO);
+	}
+	while (nHigh != read32 (ARM_SYSTIMER_CHI));
+
+	PeripheralExit ();
+
+	return (u64) nHigh << 32 | nLow;
+#elif AARCH == 32
+	InstructionSyncBarrier ();
+
+	u32 nCNTPCTLow, nCNTPCTHigh;
+	asm volatile ("mrrc p15, 0, %0, %1, c14" : "=r" (nCNTPCTLow), "=r" (nCNTPCTHigh));
+
+	return (u64) nCNTPCTHigh << 32 | nCNTPCTLow;
+#else
+	InstructionSyncBarrier ();
+
+	u64 nCNTPCT;
+	asm volatile ("mrs %0, CNTPCT_EL0" : "=r" (nCNTPCT));
+
+	return nCNTPCT;
+#endif
+}
+
+u64 CTimer::GetTicks64Frequency (void)
+{
+#if RASPPI == 1
+	return CLOCKHZ;
+#elif AARCH == 32
+	u32 nCNTFRQ;
+	asm volatile ("mrc p15, 0, %0, c14, c0, 0" : "=r" (nCNTFRQ));
+
+	return nCNTFRQ;
+#else
+	u64 nCNTFRQ;
+	asm volatile ("mrs %0, CNTFRQ_EL0" : "=r" (nCNTFRQ));
+
+	return nCNTFRQ;
+#endif
+}
+
 unsigned CTimer::GetTicks (void) const
 {
 	return m_nTicks;
@@ -312,6 +362,11 @@ CString *CTimer::GetTimeString (void)
 
 	m_TimeSpinLock.Release ();
 
+	return GetTimeString (nTime, nTicks);
+}
+
+CString *CTimer::GetTimeString (unsigned nTime, unsigned nTicks)
+{
 	if (   nTime == 0
 	    && nTicks == 0)
 	{
@@ -2,7 +2,7 @@
 // tracer.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2014  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2014-2020  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -20,34 +20,116 @@
 #include <circle/tracer.h>
 #include <circle/timer.h>
 #include <circle/logger.h>
+#include <circle/string.h>
+#include <assert.h>
+
+#define OUT_BUFFER_SIZE		4096
 
 static const char FromTracer[] = "trace";
 
 CTracer *CTracer::s_pThis = 0;
 
+// CTimer::GetTicks64() is used for timestamps, because it runs synchronously on all
+// cores (the cycle counters do not).
+
+static inline unsigned ThisCore (void)
+{
+#if RASPPI == 1
+	return 0;
+#elif AARCH == 32
+	u32 nMPIDR;
+	asm volatile ("mrc p15, 0, %0, c0, c0, 5" : "=r" (nMPIDR));
+
+	return nMPIDR & (CORES-1);
+#else
+	u64 nMPIDR;
+	asm volatile ("mrs %0, mpidr_el1" : "=r" (nMPIDR));
+
+	return nMPIDR & (CORES-1);
+#endif
+}
+
+// Disables IRQ and FIQ on this core, without using the nesting support of
+// EnterCritical(), so that it can be called from everywhere with low overhead.
+
+static inline uintptr SaveAndDisableInterrupts (void)
+{
+	uintptr nFlags;
+#if AARCH == 32
+	asm volatile ("mrs %0, cpsr" : "=r" (nFlags));
+	asm volatile ("cpsid if");
+#else
+	asm volatile ("mrs %0, daif" : "=r" (nFlags));
+	asm volatile ("msr daifset, #3");
+#endif
+
+	return nFlags;
+}
+
+static inline void RestoreInterrupts (uintptr nFlags)
+{
+#if AARCH == 32
+	asm volatile ("msr cpsr_c, %0" :: "r" (nFlags));
+#else
+	asm volatile ("msr daif, %0" :: "r" (nFlags));
+#endif
+}
+
 CTracer::CTracer (unsigned nDepth, boolean bStopIfFull)
 : 	m_nDepth (nDepth),
 	m_bStopIfFull (bStopIfFull),
 	m_bActive (FALSE),
-	m_nStartTicks (0),
-	m_nEntries (0),
-	m_nCurrent (0)
+	m_ullStartTimestamp (0),
+	m_nEventNames (0),
+	m_pOutputHandler (0),
+	m_pOutputParam (0),
+	m_pOutBuffer (0),
+	m_nOutLength (0)
 {
+	assert (m_nDepth > 0);
+
 	s_pThis = this;
 
-	m_pEntry = new TTraceEntry[nDepth];
+	m_ullTimestampHz = CTimer::GetTicks64Frequency ();
+
+	for (unsigned nCore = 0; nCore < TRACER_CORES; nCore++)
+	{
+		TTraceRing *pRing = &m_Ring[nCore];
+
+		pRing->pEntry = 0;
+#ifdef ARM_ALLOW_MULTI_CORE
+		pRing->pEntry = new TTraceEntry[nDepth];
+#else
+		if (nCore == 0)
+		{
+			pRing->pEntry = new TTraceEntry[nDepth];
+		}
+#endif
+
+		pRing->nEntries = 0;
+		pRing->nCurrent = 0;
+		pRing->nDropped = 0;
+	}
+
+	SetEventName (TRACER_EVENT_STOP, "Stop");
 }
 
 CTracer::~CTracer (void)
 {
-	delete [] m_pEntry;
+	m_bActive = FALSE;
 
 	s_pThis = 0;
+
+	for (unsigned nCore = 0; nCore < TRACER_CORES; nCore++)
+	{
+		delete [] m_Ring[nCore].pEntry;
+		m_Ring[nCore].pEntry = 0;
+	}
 }
 
 void CTracer::Start (void)
 {
-	m_nStartTicks = CTimer::Get ()->GetClockTicks ();
+	m_ullStartTimestamp = CTimer::GetTicks64 ();
 
 	m_bActive = TRUE;
 }
@@ -59,35 +141,124 @@ void CTracer::Stop (void)
 	m_bActive = FALSE;
 }
 
-void CTracer::Event (unsigned nID, unsigned nParam1, unsigned nParam2, unsigned nParam3, unsigned nParam4)
+void CTracer::Event (unsigned nID, uintptr nParam1, uintptr nParam2, uintptr nParam3, uintptr nParam4)
 {
-	if (m_bActive)
+	Write (TracePhaseInstant, nID, nParam1, nParam2, nParam3, nParam4);
+}
+
+void CTracer::EventBegin (unsigned nID, uintptr nParam1, uintptr nParam2)
+{
+	Write (TracePhaseBegin, nID, nParam1, nParam2, 0, 0);
+}
+
+void CTracer::EventEnd (unsigned nID, uintptr nParam1, uintptr nParam2)
+{
+	Write (TracePhaseEnd, nID, nParam1, nParam2, 0, 0);
+}
+
+void CTracer::FlowStart (unsigned nID, uintptr nFlowID, uintptr nParam2)
+{
+	Write (TracePhaseFlowStart, nID, nFlowID, nParam2, 0, 0);
+}
+
+void CTracer::FlowEnd (unsigned nID, uintptr nFlowID, uintptr nParam2)
+{
+	Write (TracePhaseFlowEnd, nID, nFlowID, nParam2, 0, 0);
+}
+
+void CTracer::Write (TTracePhase Phase, unsigned nID,
+		     uintptr nParam1, uintptr nParam2, uintptr nParam3, uintptr nParam4)
+{
+	if (!m_bActive)
 	{
-		if (m_nEntries < m_nDepth)
-		{
-			m_nEntries++;
-		}
-		else if (m_bStopIfFull)
+		return;
+	}
+
+	// Each core writes to its own ring buffer only. Only the reservation of
+	// an entry has to be protected against interrupts on the same core.
+	TTraceRing *pRing = &m_Ring[ThisCore ()];
+	if (pRing->pEntry == 0)
+	{
+		return;
+	}
+
+	uintptr nFlags = SaveAndDisableInterrupts ();
+
+	if (pRing->nEntries < m_nDepth)
+	{
+		pRing->nEntries++;
+	}
+	else if (m_bStopIfFull)
+	{
+		pRing->nDropped++;
+
+		RestoreInterrupts (nFlags);
+
+		return;
+	}
+
+	TTraceEntry *pEntry = pRing->pEntry + pRing->nCurrent;
+
+	if (++pRing->nCurrent == m_nDepth)
+	{
+		pRing->nCurrent = 0;
+	}
+
+	u64 ullTimestamp = CTimer::GetTicks64 ();
+
+	RestoreInterrupts (nFlags);
+
+	pEntry->ullTimestamp = ullTimestamp - m_ullStartTimestamp;
+	pEntry->nEventID     = nID;
+	pEntry->nPhase       = Phase;
+	pEntry->nParam[0]    = nParam1;
+	pEntry->nParam[1]    = nParam2;
+	pEntry->nParam[2]    = nParam3;
+	pEntry->nParam[3]    = nParam4;
+}
+
+void CTracer::SetEventName (unsigned nID, const char *pName)
+{
+	assert (pName != 0);
+
+	for (unsigned i = 0; i < m_nEventNames; i++)
+	{
+		if (m_EventName[i].nID == nID)
 		{
-			m_bActive = FALSE;
+			m_EventName[i].pName = pName;
 
 			return;
 		}
+	}
 
-		TTraceEntry *pEntry = m_pEntry + m_nCurrent;
-
-		pEntry->nClockTicks = CTimer::Get ()->GetClockTicks () - m_nStartTicks;
-		pEntry->nEventID    = nID;
-		pEntry->nParam[0]   = nParam1;
-		pEntry->nParam[1]   = nParam2;
-		pEntry->nParam[2]   = nParam3;
-		pEntry->nParam[3]   = nParam4;
+	if (m_nEventNames < TRACER_MAX_EVENT_NAMES)
+	{
+		m_EventName[m_nEventNames].nID = nID;
+		m_EventName[m_nEventNames].pName = pName;
+		m_nEventNames++;
+	}
+}
 
-		if (++m_nCurrent == m_nDepth)
+const char *CTracer::GetEventName (unsigned nID) const
+{
+	for (unsigned i = 0; i < m_nEventNames; i++)
+	{
+		if (m_EventName[i].nID == nID)
 		{
-			m_nCurrent = 0;
+			return m_EventName[i].pName;
 		}
 	}
+
+	switch (nID)
+	{
+	case TRACER_EVENT_IRQ:		return "IRQ";
+	case TRACER_EVENT_TASK_SWITCH:	return "Task";
+	case TRACER_EVENT_USB_REQUEST:	return "URB";
+	case TRACER_EVENT_TCP_TX:	return "TCP tx";
+	case TRACER_EVENT_TCP_RX:	return "TCP rx";
+	case TRACER_EVENT_TCP_RECEIVE:	return "TCP receive";
+	default:			return 0;
+	}
 }
 
 void CTracer::Dump (void)
@@ -99,22 +270,277 @@ void CTracer::Dump (void)
 	
 	CLogger *pLogger = CLogger::Get ();
 
-	unsigned nEvent = 0;
-	if (m_nEntries == m_nDepth)
+	static const char PhaseChar[] = "IBEsf";
+
+	for (unsigned nCore = 0; nCore < TRACER_CORES; nCore++)
 	{
-		nEvent = m_nCurrent;
+		TTraceRing *pRing = &m_Ring[nCore];
+		if (pRing->nEntries == 0)
+		{
+			continue;
+		}
+
+		unsigned nEvent = 0;
+		if (pRing->nEntries == m_nDepth)
+		{
+			nEvent = pRing->nCurrent;
+		}
+
+		for (unsigned i = 1; i <= pRing->nEntries; i++)
+		{
+			TTraceEntry *pEntry = pRing->pEntry + nEvent;
+
+			unsigned nSeconds = (unsigned) (pEntry->ullTimestamp / m_ullTimestampHz);
+			unsigned nMicroSeconds = (unsigned) (  pEntry->ullTimestamp % m_ullTimestampHz
+							     * 1000000 / m_ullTimestampHz);
+
+			pLogger->Write (FromTracer, LogNotice,
+					"%2u: %u %2u.%06u %08X %c %08lX %08lX %08lX %08lX",
+					i, nCore, nSeconds, nMicroSeconds,
+					pEntry->nEventID, PhaseChar[pEntry->nPhase],
+					(unsigned long) pEntry->nParam[0],
+					(unsigned long) pEntry->nParam[1],
+					(unsigned long) pEntry->nParam[2],
+					(unsigned long) pEntry->nParam[3]);
+
+			nEvent = (nEvent+1) % m_nDepth;
+		}
+
+		if (pRing->nDropped > 0)
+		{
+			pLogger->Write (FromTracer, LogNotice, "Core %u: %u events dropped",
+					nCore, pRing->nDropped);
+		}
 	}
-	
-	for (unsigned i = 1; i <= m_nEntries; i++)
-	{	
-		TTraceEntry *pEntry = m_pEntry + nEvent;
+}
+
+boolean CTracer::ExportChromeJSON (TTracerOutputHandler *pHandler, void *pParam)
+{
+	if (m_bActive)
+	{
+		Stop ();
+	}
+
+	assert (pHandler != 0);
+	m_pOutputHandler = pHandler;
+	m_pOutputParam = pParam;
+
+	assert (m_pOutBuffer == 0);
+	m_pOutBuffer = new char[OUT_BUFFER_SIZE];
+	if (m_pOutBuffer == 0)
+	{
+		return FALSE;
+	}
+	m_nOutLength = 0;
+
+	boolean bOK = Output ("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"
+			      "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,"
+			      "\"args\":{\"name\":\"Circle\"}}");
+
+	for (unsigned nCore = 0; bOK && nCore < TRACER_CORES; nCore++)
+	{
+		TTraceRing *pRing = &m_Ring[nCore];
+		if (pRing->nEntries == 0)
+		{
+			continue;
+		}
+
+		CString Line;
+		Line.Format (",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,"
+			     "\"args\":{\"name\":\"Core %u\"}}", nCore, nCore);
+		bOK = Output (Line);
+
+		unsigned nEvent = 0;
+		if (pRing->nEntries == m_nDepth)
+		{
+			nEvent = pRing->nCurrent;
+		}
+
+		boolean bTaskOpen = FALSE;
+		CString Timestamp;
+
+		for (unsigned i = 1; bOK && i <= pRing->nEntries; i++)
+		{
+			TTraceEntry *pEntry = pRing->pEntry + nEvent;
+			nEvent = (nEvent+1) % m_nDepth;
+
+			// Chrome expects the time stamps in microseconds
+			u64 ullSeconds = pEntry->ullTimestamp / m_ullTimestampHz;
+			u64 ullNanoSeconds =   pEntry->ullTimestamp % m_ullTimestampHz
+					     * 1000000000 / m_ullTimestampHz;
+			Timestamp.Format ("%lu.%03u",
+					  (unsigned long) (ullSeconds * 1000000 + ullNanoSeconds / 1000),
+					  (unsigned) (ullNanoSeconds % 1000));
+
+			CString Common;
+			Common.Format ("\"ts\":%s,\"pid\":0,\"tid\":%u", (const char *) Timestamp, nCore);
+
+			const char *pName = GetEventName (pEntry->nEventID);
+			CString Name;
+			if (pName != 0)
+			{
+				Name = pName;
+			}
+			else
+			{
+				Name.Format ("Event %u", pEntry->nEventID);
+			}
+
+			switch (pEntry->nEventID)
+			{
+			case TRACER_EVENT_IRQ:
+				Line.Format (",\n{\"name\":\"%s %u\",\"cat\":\"irq\",\"ph\":\"%c\",%s}",
+					     (const char *) Name, (unsigned) pEntry->nParam[0],
+					     pEntry->nPhase == TracePhaseBegin ? 'B' : 'E',
+					     (const char *) Common);
+				break;
+
+			case TRACER_EVENT_TASK_SWITCH:
+				// a task switch ends the slice of the previous task
+				Line = "";
+				if (bTaskOpen)
+				{
+					CString End;
+					End.Format (",\n{\"ph\":\"E\",%s}", (const char *) Common);
+					Line.Append (End);
+				}
 
-		pLogger->Write (FromTracer, LogNotice, "%2u: %2u.%06u %2u %08X %08X %08X %08X",
-				i, pEntry->nClockTicks / CLOCKHZ, pEntry->nClockTicks % CLOCKHZ,
-				pEntry->nEventID, pEntry->nParam[0], pEntry->nParam[1], pEntry->nParam[2], pEntry->nParam[3]);
+				{
+					CString Begin;
+					Begin.Format (",\n{\"name\":\"%s %lX\",\"cat\":\"sched\",\"ph\":\"B\",%s}",
+						      (const char *) Name,
+						      (unsigned long) pEntry->nParam[0],
+						      (const char *) Common);
+					Line.Append (Begin);
+				}
 
-		nEvent = (nEvent+1) % m_nDepth;
+				bTaskOpen = TRUE;
+				break;
+
+			default:
+				switch (pEntry->nPhase)
+				{
+				case TracePhaseBegin:
+				case TracePhaseEnd:
+					Line.Format (",\n{\"name\":\"%s\",\"ph\":\"%c\",%s,"
+						     "\"args\":{\"p1\":\"%lX\",\"p2\":\"%lX\"}}",
+						     (const char *) Name,
+						     pEntry->nPhase == TracePhaseBegin ? 'B' : 'E',
+						     (const char *) Common,
+						     (unsigned long) pEntry->nParam[0],
+						     (unsigned long) pEntry->nParam[1]);
+					break;
+
+				case TracePhaseFlowStart:
+				case TracePhaseFlowEnd:
+					// an instant event marks the position, the flow event connects
+					Line.Format (",\n{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",%s,"
+						     "\"args\":{\"id\":\"%lX\",\"p2\":%lu}}"
+						     ",\n{\"name\":\"%s\",\"cat\":\"flow\",\"ph\":\"%s\","
+						     "\"id\":\"%lX\",%s}",
+						     (const char *) Name, (const char *) Common,
+						     (unsigned long) pEntry->nParam[0],
+						     (unsigned long) pEntry->nParam[1],
+						     (const char *) Name,
+						     pEntry->nPhase == TracePhaseFlowStart
+						     ? "s" : "f\",\"bp\":\"e",
+						     (unsigned long) pEntry->nParam[0],
+						     (const char *) Common);
+					break;
+
+				default:
+					Line.Format (",\n{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",%s,"
+						     "\"args\":{\"p1\":\"%lX\",\"p2\":\"%lX\","
+						     "\"p3\":\"%lX\",\"p4\":\"%lX\"}}",
+						     (const char *) Name, (const char *) Common,
+						     (unsigned long) pEntry->nParam[0],
+						     (unsigned long) pEntry->nParam[1],
+						     (unsigned long) pEntry->nParam[2],
+						     (unsigned long) pEntry->nParam[3]);
+					break;
+				}
+				break;
+			}
+
+			bOK = Output (Line);
+
+			if (   bOK
+			    && bTaskOpen
+			    && i == pRing->nEntries)
+			{
+				CString End;
+				End.Format (",\n{\"ph\":\"E\",%s}", (const char *) Common);
+				bOK = Output (End);
+			}
+		}
 	}
+
+	if (bOK)
+	{
+		bOK = Output ("\n]}\n") && Flush ();
+	}
+
+	delete [] m_pOutBuffer;
+	m_pOutBuffer = 0;
+
+	m_pOutputHandler = 0;
+	m_pOutputParam = 0;
+
+	if (!bOK)
+	{
+		CLogger::Get ()->Write (FromTracer, LogError, "Cannot export trace");
+	}
+
+	return bOK;
+}
+
+boolean CTracer::ExportChromeJSON (CDevice *pDevice)
+{
+	assert (pDevice != 0);
+
+	return ExportChromeJSON (DeviceOutputHandler, pDevice);
+}
+
+boolean CTracer::Output (const char *pString)
+{
+	assert (pString != 0);
+
+	while (*pString != '\0')
+	{
+		assert (m_pOutBuffer != 0);
+		m_pOutBuffer[m_nOutLength++] = *pString++;
+
+		if (   m_nOutLength == OUT_BUFFER_SIZE
+		    && !Flush ())
+		{
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+boolean CTracer::Flush (void)
+{
+	if (m_nOutLength == 0)
+	{
+		return TRUE;
+	}
+
+	assert (m_pOutputHandler != 0);
+	boolean bOK = (*m_pOutputHandler) (m_pOutBuffer, m_nOutLength, m_pOutputParam);
+
+	m_nOutLength = 0;
+
+	return bOK;
+}
+
+boolean CTracer::DeviceOutputHandler (const void *pBuffer, unsigned nLength, void *pParam)
+{
+	CDevice *pDevice = (CDevice *) pParam;
+	assert (pDevice != 0);
+
+	return pDevice->Write (pBuffer, nLength) == (int) nLength;
 }
 
 CTracer *CTracer::Get (void)
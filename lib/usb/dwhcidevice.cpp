@@ -28,6 +28,7 @@
 #include <circle/bcmpropertytags.h>
 #include <circle/bcm2835.h>
 #include <circle/synchronize.h>
+#include <circle/tracer.h>
 #include <circle/logger.h>
 #include <circle/koptions.h>
 #include <circle/sysconfig.h>
@@ -66,6 +67,9 @@ CDWHCIDevice::CDWHCIDevice (CInterruptSystem *pInterruptSystem, CTimer *pTimer,
 	m_pTimer (pTimer),
 	m_nChannels (0),
 	m_nChannelAllocated (0),
+#ifdef USE_USB_SOF_INTR
+	m_bSOFInterruptEnabled (FALSE),
+#endif
 	m_nWaitBlockAllocated (0),
 	m_WaitBlockSpinLock (TASK_LEVEL),
 	m_RootPort (this),
@@ -292,6 +296,8 @@ boolean CDWHCIDevice::SubmitAsyncRequest (CUSBRequest *pURB, unsigned nTimeoutMs
 	assert (pURB->GetBufLen () > 0);
 	
 	pURB->SetStatus (0);
+
+	TRACE_POINT (TracePhaseFlowStart, TRACER_EVENT_USB_REQUEST, pURB, pURB->GetBufLen ());
 	
 	boolean bOK = TransferStageAsync (pURB, pURB->GetEndpoint ()->IsDirectionIn (),
 					  FALSE, nTimeoutMs);
@@ -609,11 +615,11 @@ void CDWHCIDevice::EnableHostInterrupts (void)
 	EnableCommonInterrupts ();
 
 	IntMask.Read ();
-	IntMask.Or (  DWHCI_CORE_INT_MASK_HC_INTR
+	IntMask.Or (DWHCI_CORE_INT_MASK_HC_INTR);
 #ifdef USE_USB_SOF_INTR
-		    | DWHCI_CORE_INT_MASK_SOF_INTR
+	// the SOF interrupt is enabled, while transactions are queued only
+	m_bSOFInterruptEnabled = FALSE;
 #endif
-		   );
 	if (IsPlugAndPlay ())
 	{
 		IntMask.Or (  DWHCI_CORE_INT_MASK_PORT_INTR
@@ -804,7 +810,7 @@ void CDWHCIDevice::QueueTransaction (CDWHCITransferStageData *pStageData)
 		usFrameNumber = (usFrameNumber+1) & DWHCI_MAX_FRAME_NUMBER;
 	}
 
-	m_TransactionQueue.Enqueue (pStageData, usFrameNumber);
+	EnqueueTransaction (pStageData, usFrameNumber);
 }
 
 void CDWHCIDevice::QueueDelayedTransaction (CDWHCITransferStageData *pStageData)
@@ -821,7 +827,8 @@ void CDWHCIDevice::QueueDelayedTransaction (CDWHCITransferStageData *pStageData)
 	}
 	assert (usFrameOffset < DWHCI_MAX_FRAME_NUMBER/2);
 
-	u16 usFrameNumber;
+	CDWHCIRegister FrameNumber (DWHCI_HOST_FRM_NUM);
+	u16 usFrameNumber = DWHCI_HOST_FRM_NUM_NUMBER (FrameNumber.Read ());
 
 	if (pStageData->IsSplit ())
 	{
@@ -836,14 +843,47 @@ void CDWHCIDevice::QueueDelayedTransaction (CDWHCITransferStageData *pStageData)
 	}
 	else
 	{
-		CDWHCIRegister FrameNumber (DWHCI_HOST_FRM_NUM);
-		usFrameNumber = DWHCI_HOST_FRM_NUM_NUMBER (FrameNumber.Read ());
+		// move the transaction to a less loaded (micro)frame, if the interval allows it,
+		// split transactions are timed by their frame scheduler instead
+		u16 usMaxSlip = usFrameOffset / 8;
+		if (usMaxSlip > DWHCI_PERIODIC_MAX_SLIP)
+		{
+			usMaxSlip = DWHCI_PERIODIC_MAX_SLIP;
+		}
+
+		if (usMaxSlip > 0)
+		{
+			u16 usTargetFrame = (usFrameNumber+usFrameOffset) & DWHCI_MAX_FRAME_NUMBER;
+			usTargetFrame = m_TransactionQueue.GetLeastLoadedFrame (usTargetFrame,
+										usMaxSlip);
+			usFrameOffset = (usTargetFrame-usFrameNumber) & DWHCI_MAX_FRAME_NUMBER;
+		}
+
 		usFrameNumber = (usFrameNumber+usFrameOffset) & DWHCI_MAX_FRAME_NUMBER;
 
 		pStageData->SetState (StageStateNoSplitTransfer);
 	}
 
+	EnqueueTransaction (pStageData, usFrameNumber);
+}
+
+void CDWHCIDevice::EnqueueTransaction (CDWHCITransferStageData *pStageData, u16 usFrameNumber)
+{
+	m_IntMaskSpinLock.Acquire ();
+
 	m_TransactionQueue.Enqueue (pStageData, usFrameNumber);
+
+	if (!m_bSOFInterruptEnabled)
+	{
+		CDWHCIRegister IntMask (DWHCI_CORE_INT_MASK);
+		IntMask.Read ();
+		IntMask.Or (DWHCI_CORE_INT_MASK_SOF_INTR);
+		IntMask.Write ();
+
+		m_bSOFInterruptEnabled = TRUE;
+	}
+
+	m_IntMaskSpinLock.Release ();
 }
 
 #endif
@@ -1298,15 +1338,37 @@ void CDWHCIDevice::SOFInterruptHandler (void)
 
 	CDWHCIRegister FrameNumber (DWHCI_HOST_FRM_NUM);
 	u16 usFrameNumber = DWHCI_HOST_FRM_NUM_NUMBER (FrameNumber.Read ());
+	u16 usNextFrameNumber = (usFrameNumber+1) & DWHCI_MAX_FRAME_NUMBER;
+
+	unsigned nPeriodicBudget = DWHCI_PERIODIC_XACTS_PER_FRAME;
 
 	CDWHCITransferStageData *pStageData;
 	while ((pStageData = m_TransactionQueue.Dequeue (usFrameNumber)) != 0)
 	{
-		unsigned nChannel = AllocateChannel ();
+		// split transactions have to keep their (micro)frame timing
+		boolean bBudgeted = pStageData->IsPeriodic () && !pStageData->IsSplit ();
+		if (   bBudgeted
+		    && nPeriodicBudget == 0)
+		{
+			EnqueueTransaction (pStageData, usNextFrameNumber);
+
+			continue;
+		}
+
+		unsigned nChannel = AllocateChannel (bBudgeted);
 		if (nChannel >= m_nChannels)
 		{
-			CLogger::Get ()->Write (FromDWHCI, LogPanic, "Too many parallel USB transactions");
+			// all channels busy, retry in the next (micro)frame
+			EnqueueTransaction (pStageData, usNextFrameNumber);
+
+			continue;
+		}
+
+		if (bBudgeted)
+		{
+			nPeriodicBudget--;
 		}
+
 		pStageData->SetChannelNumber (nChannel);
 
 		assert (m_pStageData[nChannel] == 0);
@@ -1316,6 +1378,21 @@ void CDWHCIDevice::SOFInterruptHandler (void)
 
 		StartTransaction (pStageData);
 	}
+
+	// no SOF interrupts are needed, while the queue is empty
+	m_IntMaskSpinLock.Acquire ();
+
+	if (m_TransactionQueue.IsEmpty ())
+	{
+		CDWHCIRegister IntMask (DWHCI_CORE_INT_MASK);
+		IntMask.Read ();
+		IntMask.And (~DWHCI_CORE_INT_MASK_SOF_INTR);
+		IntMask.Write ();
+
+		m_bSOFInterruptEnabled = FALSE;
+	}
+
+	m_IntMaskSpinLock.Release ();
 }
 
 #endif
@@ -1466,10 +1543,31 @@ void CDWHCIDevice::TimerStub (TKernelTimerHandle /* hTimer */, void *pParam, voi
 
 #endif
 
-unsigned CDWHCIDevice::AllocateChannel (void)
+unsigned CDWHCIDevice::AllocateChannel (boolean bPeriodic)
 {
 	m_ChannelSpinLock.Acquire ();
 
+#ifdef USE_USB_SOF_INTR
+	if (bPeriodic)
+	{
+		unsigned nFreeChannels = 0;
+		for (unsigned nChannel = 0; nChannel < m_nChannels; nChannel++)
+		{
+			if (!(m_nChannelAllocated & (1 << nChannel)))
+			{
+				nFreeChannels++;
+			}
+		}
+
+		if (nFreeChannels <= DWHCI_NON_PERIODIC_CHANNELS)
+		{
+			m_ChannelSpinLock.Release ();
+
+			return DWHCI_MAX_CHANNELS;
+		}
+	}
+#endif
+
 	unsigned nChannelMask = 1;
 	for (unsigned nChannel = 0; nChannel < m_nChannels; nChannel++)
 	{
@@ -25,6 +25,11 @@
 
 #define uFRAME			125		// micro seconds
 
+#ifdef USE_USB_SOF_INTR
+#define NAK_BACKOFF_MIN		5		// (micro)frames
+#define NAK_BACKOFF_MAX		40
+#endif
+
 enum TFrameSchedulerState
 {
 	StateStartSplit,
@@ -36,11 +41,13 @@ enum TFrameSchedulerState
 	StateUnknown
 };
 
-CDWHCIFrameSchedulerNonPeriodic::CDWHCIFrameSchedulerNonPeriodic (void)
+CDWHCIFrameSchedulerNonPeriodic::CDWHCIFrameSchedulerNonPeriodic (boolean bBulk)
 :	m_pTimer (CTimer::Get ()),
 	m_nState (StateUnknown)
 #ifdef USE_USB_SOF_INTR
-	, m_usFrameOffset (8)
+	, m_usFrameOffset (8),
+	m_bNAKBackoff (bBulk),
+	m_usNAKBackoff (NAK_BACKOFF_MIN)
 #endif
 {
 	assert (m_pTimer != 0);
@@ -112,6 +119,9 @@ void CDWHCIFrameSchedulerNonPeriodic::TransactionComplete (u32 nStatus)
 	case StateCompleteRetry:
 		if (nStatus & DWHCI_HOST_CHAN_INT_XFER_COMPLETE)
 		{
+#ifdef USE_USB_SOF_INTR
+			m_usNAKBackoff = NAK_BACKOFF_MIN;
+#endif
 			m_nState = StateCompleteSplitComplete;
 		}
 		else if (nStatus & (DWHCI_HOST_CHAN_INT_NYET | DWHCI_HOST_CHAN_INT_ACK))
@@ -135,7 +145,21 @@ void CDWHCIFrameSchedulerNonPeriodic::TransactionComplete (u32 nStatus)
 #ifndef USE_USB_SOF_INTR
 				m_pTimer->usDelay (5 * uFRAME);
 #else
-				m_usFrameOffset = 5;
+				if (m_bNAKBackoff)
+				{
+					// an idle bulk endpoint is polled less often, to reduce the IRQ load
+					m_usFrameOffset = m_usNAKBackoff;
+
+					m_usNAKBackoff *= 2;
+					if (m_usNAKBackoff > NAK_BACKOFF_MAX)
+					{
+						m_usNAKBackoff = NAK_BACKOFF_MAX;
+					}
+				}
+				else
+				{
+					m_usFrameOffset = 5;
+				}
 #endif
 				m_nState = StateCompleteSplitFailed;
 			}
@@ -170,7 +194,7 @@ u16 CDWHCIFrameSchedulerNonPeriodic::GetFrameNumber (void)
 	CDWHCIRegister FrameNumber (DWHCI_HOST_FRM_NUM);
 	u16 usFrameNumber = DWHCI_HOST_FRM_NUM_NUMBER (FrameNumber.Read ());
 
-	assert (m_usFrameOffset < 8);
+	assert (m_usFrameOffset <= NAK_BACKOFF_MAX);
 	return (usFrameNumber+m_usFrameOffset) & DWHCI_MAX_FRAME_NUMBER;
 }
 
@@ -20,6 +20,7 @@
 #include <circle/usb/dwhcixactqueue.h>
 #include <circle/usb/usbrequest.h>
 #include <circle/usb/dwhci.h>
+#include <circle/util.h>
 #include <assert.h>
 
 #ifdef USE_USB_SOF_INTR
@@ -53,6 +54,7 @@ static inline boolean FrameNumberGreater (u16 usFrameNumber1, u16 usFrameNumber2
 
 CDWHCITransactionQueue::CDWHCITransactionQueue (void)
 {
+	memset (m_uchPeriodicLoad, 0, sizeof m_uchPeriodicLoad);
 }
 
 CDWHCITransactionQueue::~CDWHCITransactionQueue (void)
@@ -74,6 +76,8 @@ void CDWHCITransactionQueue::Flush (void)
 		m_List.Remove (pElement);
 
 		assert (pEntry->pStageData != 0);
+		RemoveLoad (pEntry->pStageData, pEntry->usFrameNumber);
+
 		CUSBRequest *pURB = pEntry->pStageData->GetURB ();
 		delete pURB;
 
@@ -111,6 +115,8 @@ void CDWHCITransactionQueue::FlushDevice (CUSBDevice *pUSBDevice)
 			m_List.Remove (pElement);
 
 			assert (pEntry->pStageData != 0);
+			RemoveLoad (pEntry->pStageData, pEntry->usFrameNumber);
+
 			CUSBRequest *pURB = pEntry->pStageData->GetURB ();
 			delete pURB;
 
@@ -143,6 +149,12 @@ void CDWHCITransactionQueue::Enqueue (CDWHCITransferStageData *pStageData, u16 u
 
 	m_SpinLock.Acquire ();
 
+	if (   pStageData->IsPeriodic ()
+	    && m_uchPeriodicLoad[usFrameNumber % DWHCI_XACT_LOAD_FRAMES] < 0xFF)
+	{
+		m_uchPeriodicLoad[usFrameNumber % DWHCI_XACT_LOAD_FRAMES]++;
+	}
+
 	TPtrListElement *pPrevElement = 0;
 	TPtrListElement *pElement = m_List.GetFirst ();
 	while (pElement != 0)
@@ -197,10 +209,11 @@ CDWHCITransferStageData *CDWHCITransactionQueue::Dequeue (u16 usFrameNumber)
 
 	m_List.Remove (pElement);
 
-	m_SpinLock.Release ();
-
 	CDWHCITransferStageData *pStageData = pEntry->pStageData;
 	assert (pStageData != 0);
+	RemoveLoad (pStageData, pEntry->usFrameNumber);
+
+	m_SpinLock.Release ();
 
 #ifndef NDEBUG
 	pEntry->nMagic = 0;
@@ -210,4 +223,46 @@ CDWHCITransferStageData *CDWHCITransactionQueue::Dequeue (u16 usFrameNumber)
 	return pStageData;
 }
 
+boolean CDWHCITransactionQueue::IsEmpty (void)
+{
+	return m_List.GetFirst () == 0;
+}
+
+u16 CDWHCITransactionQueue::GetLeastLoadedFrame (u16 usFrameNumber, u16 usMaxSlip)
+{
+	assert (usFrameNumber <= DWHCI_MAX_FRAME_NUMBER);
+	assert (usMaxSlip < DWHCI_XACT_LOAD_FRAMES);
+
+	m_SpinLock.Acquire ();
+
+	u16 usResult = usFrameNumber;
+	u8 uchMinLoad = m_uchPeriodicLoad[usFrameNumber % DWHCI_XACT_LOAD_FRAMES];
+
+	for (u16 i = 1; i <= usMaxSlip && uchMinLoad > 0; i++)
+	{
+		u16 usFrame = (usFrameNumber + i) & DWHCI_MAX_FRAME_NUMBER;
+		u8 uchLoad = m_uchPeriodicLoad[usFrame % DWHCI_XACT_LOAD_FRAMES];
+		if (uchLoad < uchMinLoad)
+		{
+			uchMinLoad = uchLoad;
+			usResult = usFrame;
+		}
+	}
+
+	m_SpinLock.Release ();
+
+	return usResult;
+}
+
+void CDWHCITransactionQueue::RemoveLoad (CDWHCITransferStageData *pStageData, u16 usFrameNumber)
+{
+	assert (pStageData != 0);
+
+	if (   pStageData->IsPeriodic ()
+	    && m_uchPeriodicLoad[usFrameNumber % DWHCI_XACT_LOAD_FRAMES] > 0)
+	{
+		m_uchPeriodicLoad[usFrameNumber % DWHCI_XACT_LOAD_FRAMES]--;
+	}
+}
+
 #endif
@@ -116,7 +116,8 @@ CDWHCITransferStageData::CDWHCITransferStageData (unsigned	 nChannel,
 		}
 		else
 		{
-			m_pFrameScheduler = new CDWHCIFrameSchedulerNonPeriodic;
+			m_pFrameScheduler = new CDWHCIFrameSchedulerNonPeriodic (m_pEndpoint->GetType ()
+										 == EndpointTypeBulk);
 		}
 
 		assert (m_pFrameScheduler != 0);
@@ -24,6 +24,7 @@
 //
 #include <circle/usb/lan7800.h>
 #include <circle/usb/usbhostcontroller.h>
+#include <circle/usb/usbbulkinring.h>
 #include <circle/bcmpropertytags.h>
 #include <circle/synchronize.h>
 #include <circle/logger.h>
@@ -43,6 +44,8 @@
 
 #define MAX_RX_FRAME_SIZE		(2*6 + 2 + 1500 + 4)
 
+#define RX_BUFFERS			4	// number of burst buffers in RX ring
+
 // USB vendor requests
 #define WRITE_REGISTER			0xA0
 #define READ_REGISTER			0xA1
@@ -232,12 +235,17 @@ static const char FromLAN7800[] = "lan7800";
 CLAN7800Device::CLAN7800Device (CUSBFunction *pFunction)
 :	CUSBFunction (pFunction),
 	m_pEndpointBulkIn (0),
-	m_pEndpointBulkOut (0)
+	m_pEndpointBulkOut (0),
+	m_pRxRing (0),
+	m_nRxOffset (0)
 {
 }
 
 CLAN7800Device::~CLAN7800Device (void)
 {
+	delete m_pRxRing;
+	m_pRxRing = 0;
+
 	delete m_pEndpointBulkOut;
 	m_pEndpointBulkOut = 0;
 
@@ -337,8 +345,8 @@ boolean CLAN7800Device::Configure (void)
 		return FALSE;
 	}
 
-	// enable the LEDs and SEF mode
-	if (!ReadWriteReg (HW_CFG, HW_CFG_LED0_EN | HW_CFG_LED1_EN, ~HW_CFG_MEF))
+	// enable the LEDs and MEF mode (multiple ethernet frames per USB bulk-in transfer)
+	if (!ReadWriteReg (HW_CFG, HW_CFG_LED0_EN | HW_CFG_LED1_EN | HW_CFG_MEF))
 	{
 		return FALSE;
 	}
@@ -414,6 +422,11 @@ boolean CLAN7800Device::Configure (void)
 		return FALSE;
 	}
 
+	assert (m_pRxRing == 0);
+	m_pRxRing = new CUSBBulkInRing (GetHost (), m_pEndpointBulkIn,
+					RX_BUFFERS, DEFAULT_BURST_CAP_SIZE);
+	assert (m_pRxRing != 0);
+
 	AddNetDevice ();
 
 	return TRUE;
@@ -445,46 +458,64 @@ boolean CLAN7800Device::SendFrame (const void *pBuffer, unsigned nLength)
 
 boolean CLAN7800Device::ReceiveFrame (void *pBuffer, unsigned *pResultLength)
 {
-	assert (m_pEndpointBulkIn != 0);
+	assert (m_pRxRing != 0);
 	assert (pBuffer != 0);
-	CUSBRequest URB (m_pEndpointBulkIn, pBuffer, FRAME_BUFFER_SIZE);
 
-	if (!GetHost ()->SubmitBlockingRequest (&URB))
+	// a burst transfer may contain multiple frames, each preceded by RX command A..C
+	// and padded, so that the next RX command A is aligned to four bytes
+	const u8 *pRxBuffer;
+	unsigned nRxLength;
+	while ((pRxBuffer = m_pRxRing->GetBuffer (&nRxLength)) != 0)
 	{
-		return FALSE;
-	}
+		if (m_nRxOffset + RX_HEADER_SIZE > nRxLength)
+		{
+			m_pRxRing->ReleaseBuffer ();
+			m_nRxOffset = 0;
 
-	u32 nResultLength = URB.GetResultLength ();
-	if (nResultLength < RX_HEADER_SIZE)
-	{
-		return FALSE;
-	}
+			continue;
+		}
 
-	u32 nRxStatus = *(u32 *) pBuffer;	// RX command A
-	if (nRxStatus & RX_CMD_A_RED)
-	{
-		CLogger::Get ()->Write (FromLAN7800, LogWarning, "RX error (status 0x%X)", nRxStatus);
+		const u8 *pRxHeader = pRxBuffer + m_nRxOffset;
+		u32 nRxStatus = *(const u32 *) pRxHeader;	// RX command A
+		u32 nFrameLength = nRxStatus & RX_CMD_A_LEN_MASK;
 
-		return FALSE;
-	}
-	
-	u32 nFrameLength = nRxStatus & RX_CMD_A_LEN_MASK;
-	assert (nFrameLength == nResultLength-RX_HEADER_SIZE);
-	assert (nFrameLength > 4);
-	if (nFrameLength <= 4)
-	{
-		return FALSE;
-	}
-	nFrameLength -= 4;	// ignore FCS
+		if (m_nRxOffset + RX_HEADER_SIZE + nFrameLength > nRxLength)
+		{
+			CLogger::Get ()->Write (FromLAN7800, LogWarning, "Truncated frame");
 
-	//CLogger::Get ()->Write (FromLAN7800, LogDebug, "Frame received (status 0x%X)", nRxStatus);
+			m_pRxRing->ReleaseBuffer ();
+			m_nRxOffset = 0;
 
-	memcpy (pBuffer, (u8 *) pBuffer + RX_HEADER_SIZE, nFrameLength); // overwrite RX command A..C
+			continue;
+		}
 
-	assert (pResultLength != 0);
-	*pResultLength = nFrameLength;
-	
-	return TRUE;
+		m_nRxOffset += (RX_HEADER_SIZE + nFrameLength + 3) & ~3;
+
+		if (nRxStatus & RX_CMD_A_RED)
+		{
+			CLogger::Get ()->Write (FromLAN7800, LogWarning, "RX error (status 0x%X)", nRxStatus);
+
+			continue;
+		}
+
+		if (   nFrameLength <= 4
+		    || nFrameLength - 4 > FRAME_BUFFER_SIZE)
+		{
+			continue;
+		}
+		nFrameLength -= 4;	// ignore FCS
+
+		//CLogger::Get ()->Write (FromLAN7800, LogDebug, "Frame received (status 0x%X)", nRxStatus);
+
+		memcpy (pBuffer, pRxHeader + RX_HEADER_SIZE, nFrameLength);
+
+		assert (pResultLength != 0);
+		*pResultLength = nFrameLength;
+
+		return TRUE;
+	}
+
+	return FALSE;
 }
 
 boolean CLAN7800Device::IsLinkUp (void)
@@ -26,6 +26,7 @@
 //
 #include <circle/usb/smsc951x.h>
 #include <circle/usb/usbhostcontroller.h>
+#include <circle/usb/usbbulkinring.h>
 #include <circle/bcmpropertytags.h>
 #include <circle/synchronize.h>
 #include <circle/logger.h>
@@ -35,6 +36,15 @@
 #include <circle/debug.h>
 #include <assert.h>
 
+// Sizes
+#define HS_USB_PKT_SIZE			512
+
+#define DEFAULT_BURST_CAP_SIZE		(16 * 1024 + 5 * HS_USB_PKT_SIZE)
+#define DEFAULT_BULK_IN_DELAY		0x2000
+
+#define RX_HEADER_SIZE			4
+#define RX_BUFFERS			4	// number of burst buffers in RX ring
+
 // USB vendor requests
 #define WRITE_REGISTER			0xA0
 #define READ_REGISTER			0xA1
@@ -47,6 +57,8 @@
 	#define TX_CFG_ON			0x00000004
 #define HW_CFG				0x14
 	#define HW_CFG_BIR			0x00001000
+	#define HW_CFG_MEF			0x00000020
+	#define HW_CFG_BCE			0x00000002
 #define RX_FIFO_INF			0x18
 #define PM_CTRL				0x20
 #define LED_GPIO_CFG			0x24
@@ -129,12 +141,17 @@ static const char FromSMSC951x[] = "smsc951x";
 CSMSC951xDevice::CSMSC951xDevice (CUSBFunction *pFunction)
 :	CUSBFunction (pFunction),
 	m_pEndpointBulkIn (0),
-	m_pEndpointBulkOut (0)
+	m_pEndpointBulkOut (0),
+	m_pRxRing (0),
+	m_nRxOffset (0)
 {
 }
 
 CSMSC951xDevice::~CSMSC951xDevice (void)
 {
+	delete m_pRxRing;
+	m_pRxRing = 0;
+
 	delete m_pEndpointBulkOut;
 	m_pEndpointBulkOut = 0;
 
@@ -228,6 +245,18 @@ boolean CSMSC951xDevice::Configure (void)
 		return FALSE;
 	}
 
+	// enable multiple ethernet frames per USB bulk-in transfer (burst mode)
+	u32 nHWConfig;
+	if (   !ReadReg (HW_CFG, &nHWConfig)
+	    || !WriteReg (HW_CFG, nHWConfig | HW_CFG_MEF | HW_CFG_BCE)
+	    || !WriteReg (BURST_CAP, DEFAULT_BURST_CAP_SIZE / HS_USB_PKT_SIZE)	// for USB high speed
+	    || !WriteReg (BULK_IN_DLY, DEFAULT_BULK_IN_DELAY))
+	{
+		CLogger::Get ()->Write (FromSMSC951x, LogError, "Cannot enable burst mode");
+
+		return FALSE;
+	}
+
 	if (   !WriteReg (LED_GPIO_CFG,   LED_GPIO_CFG_SPD_LED
 					| LED_GPIO_CFG_LNK_LED
 					| LED_GPIO_CFG_FDX_LED)
@@ -242,6 +271,11 @@ boolean CSMSC951xDevice::Configure (void)
 		return FALSE;
 	}
 
+	assert (m_pRxRing == 0);
+	m_pRxRing = new CUSBBulkInRing (GetHost (), m_pEndpointBulkIn,
+					RX_BUFFERS, DEFAULT_BURST_CAP_SIZE);
+	assert (m_pRxRing != 0);
+
 	AddNetDevice ();
 
 	return TRUE;
@@ -273,46 +307,64 @@ boolean CSMSC951xDevice::SendFrame (const void *pBuffer, unsigned nLength)
 
 boolean CSMSC951xDevice::ReceiveFrame (void *pBuffer, unsigned *pResultLength)
 {
-	assert (m_pEndpointBulkIn != 0);
+	assert (m_pRxRing != 0);
 	assert (pBuffer != 0);
-	CUSBRequest URB (m_pEndpointBulkIn, pBuffer, FRAME_BUFFER_SIZE);
 
-	if (!GetHost ()->SubmitBlockingRequest (&URB))
+	// a burst transfer may contain multiple frames, each preceded by its RX status
+	// word and padded to a multiple of four bytes
+	const u8 *pRxBuffer;
+	unsigned nRxLength;
+	while ((pRxBuffer = m_pRxRing->GetBuffer (&nRxLength)) != 0)
 	{
-		return FALSE;
-	}
+		if (m_nRxOffset + RX_HEADER_SIZE > nRxLength)
+		{
+			m_pRxRing->ReleaseBuffer ();
+			m_nRxOffset = 0;
 
-	u32 nResultLength = URB.GetResultLength ();
-	if (nResultLength < 4)				// should not happen with HW_CFG_BIR set
-	{
-		return FALSE;
-	}
+			continue;
+		}
 
-	u32 nRxStatus = *(u32 *) pBuffer;
-	if (nRxStatus & RX_STS_ERROR)
-	{
-		CLogger::Get ()->Write (FromSMSC951x, LogWarning, "RX error (status 0x%X)", nRxStatus);
+		const u8 *pRxHeader = pRxBuffer + m_nRxOffset;
+		u32 nRxStatus = *(const u32 *) pRxHeader;
+		u32 nFrameLength = RX_STS_FRAMELEN (nRxStatus);
 
-		return FALSE;
-	}
-	
-	u32 nFrameLength = RX_STS_FRAMELEN (nRxStatus);
-	assert (nFrameLength == nResultLength-4);
-	assert (nFrameLength > 4);
-	if (nFrameLength <= 4)
-	{
-		return FALSE;
-	}
-	nFrameLength -= 4;	// ignore CRC
+		if (m_nRxOffset + RX_HEADER_SIZE + nFrameLength > nRxLength)
+		{
+			CLogger::Get ()->Write (FromSMSC951x, LogWarning, "Truncated frame");
+
+			m_pRxRing->ReleaseBuffer ();
+			m_nRxOffset = 0;
 
-	//CLogger::Get ()->Write (FromSMSC951x, LogDebug, "Frame received (status 0x%X)", nRxStatus);
+			continue;
+		}
 
-	memcpy (pBuffer, (u8 *) pBuffer + 4, nFrameLength);	// overwrite RX status
+		m_nRxOffset += (RX_HEADER_SIZE + nFrameLength + 3) & ~3;
 
-	assert (pResultLength != 0);
-	*pResultLength = nFrameLength;
-	
-	return TRUE;
+		if (nRxStatus & RX_STS_ERROR)
+		{
+			CLogger::Get ()->Write (FromSMSC951x, LogWarning, "RX error (status 0x%X)", nRxStatus);
+
+			continue;
+		}
+
+		if (   nFrameLength <= 4
+		    || nFrameLength - 4 > FRAME_BUFFER_SIZE)
+		{
+			continue;
+		}
+		nFrameLength -= 4;	// ignore CRC
+
+		//CLogger::Get ()->Write (FromSMSC951x, LogDebug, "Frame received (status 0x%X)", nRxStatus);
+
+		memcpy (pBuffer, pRxHeader + RX_HEADER_SIZE, nFrameLength);
+
+		assert (pResultLength != 0);
+		*pResultLength = nFrameLength;
+
+		return TRUE;
+	}
+
+	return FALSE;
 }
 
 boolean CSMSC951xDevice::IsLinkUp (void)
@@ -0,0 +1,239 @@
+//
+// usbbulkinring.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2020  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/usb/usbbulkinring.h>
+#include <circle/synchronize.h>
+#include <circle/timer.h>
+#include <assert.h>
+
+CUSBBulkInRing::CUSBBulkInRing (CUSBHostController *pHost, CUSBEndpoint *pEndpoint,
+				unsigned nBuffers, unsigned nBufferSize, boolean bCompleteOnNAK)
+:	m_pHost (pHost),
+	m_pEndpoint (pEndpoint),
+	m_nBuffers (nBuffers),
+	m_nBufferSize (nBufferSize),
+	m_bCompleteOnNAK (bCompleteOnNAK),
+	m_nInPtr (0),
+	m_nOutPtr (0),
+	m_nFilled (0),
+	m_bActive (FALSE),
+	m_bShutdown (FALSE),
+	m_nTransferCount (0),
+	m_nOverrunCount (0),
+	m_SpinLock (IRQ_LEVEL)
+{
+	assert (m_pHost != 0);
+	assert (m_pEndpoint != 0);
+	assert (m_nBuffers >= 2);
+	assert (m_nBufferSize > 0);
+
+	m_ppBuffer = new u8 *[m_nBuffers];
+	assert (m_ppBuffer != 0);
+
+	m_pLength = new unsigned[m_nBuffers];
+	assert (m_pLength != 0);
+
+	for (unsigned i = 0; i < m_nBuffers; i++)
+	{
+		// heap blocks are cache-line aligned, as required for DMA
+		m_ppBuffer[i] = new u8[m_nBufferSize];
+		assert (m_ppBuffer[i] != 0);
+
+		m_pLength[i] = 0;
+	}
+}
+
+CUSBBulkInRing::~CUSBBulkInRing (void)
+{
+	m_SpinLock.Acquire ();
+	m_bShutdown = TRUE;		// do not chain further requests
+	m_SpinLock.Release ();
+
+	// A pending request may still write to one of the buffers. Wait for its
+	// completion. Requests, which have been discarded by the host controller
+	// with CancelDeviceTransactions() never complete, therefore the timeout.
+	unsigned nStartTicks = CTimer::GetClockTicks ();
+	while (   m_bActive
+	       && CTimer::GetClockTicks () - nStartTicks < USB_BULK_IN_RING_STOP_TIMEOUT)
+	{
+		// just wait
+	}
+
+	for (unsigned i = 0; i < m_nBuffers; i++)
+	{
+		delete [] m_ppBuffer[i];
+		m_ppBuffer[i] = 0;
+	}
+
+	delete [] m_pLength;
+	m_pLength = 0;
+
+	delete [] m_ppBuffer;
+	m_ppBuffer = 0;
+
+	m_pEndpoint = 0;
+	m_pHost = 0;
+}
+
+const u8 *CUSBBulkInRing::GetBuffer (unsigned *pLength)
+{
+	m_SpinLock.Acquire ();
+
+	boolean bStart = FALSE;
+	if (   !m_bActive
+	    && m_nFilled < m_nBuffers)
+	{
+		m_bActive = TRUE;
+		bStart = TRUE;
+	}
+
+	m_SpinLock.Release ();
+
+	if (bStart)
+	{
+		StartRequest ();
+	}
+
+	if (m_nFilled == 0)
+	{
+		return 0;
+	}
+
+	assert (pLength != 0);
+	*pLength = m_pLength[m_nOutPtr];
+
+	return m_ppBuffer[m_nOutPtr];
+}
+
+void CUSBBulkInRing::ReleaseBuffer (void)
+{
+	m_SpinLock.Acquire ();
+
+	assert (m_nFilled > 0);
+	m_nFilled--;
+
+	if (++m_nOutPtr == m_nBuffers)
+	{
+		m_nOutPtr = 0;
+	}
+
+	boolean bStart = FALSE;
+	if (!m_bActive)
+	{
+		m_bActive = TRUE;
+		bStart = TRUE;
+	}
+
+	m_SpinLock.Release ();
+
+	if (bStart)
+	{
+		StartRequest ();
+	}
+}
+
+boolean CUSBBulkInRing::StartRequest (void)
+{
+	assert (m_bActive);
+	assert (m_nFilled < m_nBuffers);
+
+	CUSBRequest *pURB = new CUSBRequest (m_pEndpoint, m_ppBuffer[m_nInPtr], m_nBufferSize);
+	assert (pURB != 0);
+
+	if (m_bCompleteOnNAK)
+	{
+		pURB->SetCompleteOnNAK ();
+	}
+
+	pURB->SetCompletionRoutine (CompletionStub, 0, this);
+
+	assert (m_pHost != 0);
+	if (!m_pHost->SubmitAsyncRequest (pURB))
+	{
+		delete pURB;
+
+		m_bActive = FALSE;
+
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+void CUSBBulkInRing::CompletionRoutine (CUSBRequest *pURB)
+{
+	assert (pURB != 0);
+
+	boolean bOK = pURB->GetStatus () != 0;
+	unsigned nLength = pURB->GetResultLength ();
+
+	delete pURB;
+
+	m_SpinLock.Acquire ();
+
+	assert (m_bActive);
+
+	boolean bRestart = FALSE;
+	if (   bOK
+	    && nLength > 0
+	    && !m_bShutdown)
+	{
+		m_pLength[m_nInPtr] = nLength;
+
+		if (++m_nInPtr == m_nBuffers)
+		{
+			m_nInPtr = 0;
+		}
+
+		m_nFilled++;
+		m_nTransferCount++;
+
+		// chain the next request immediately, while there is data flowing
+		if (m_nFilled < m_nBuffers)
+		{
+			bRestart = TRUE;
+		}
+		else
+		{
+			m_nOverrunCount++;
+		}
+	}
+
+	// On error or empty response the endpoint stays idle, until the next
+	// call to GetBuffer() polls again. This avoids an interrupt storm.
+	if (!bRestart)
+	{
+		m_bActive = FALSE;
+	}
+
+	m_SpinLock.Release ();
+
+	if (bRestart)
+	{
+		StartRequest ();
+	}
+}
+
+void CUSBBulkInRing::CompletionStub (CUSBRequest *pURB, void *pParam, void *pContext)
+{
+	CUSBBulkInRing *pThis = (CUSBBulkInRing *) pContext;
+	assert (pThis != 0);
+
+	pThis->CompletionRoutine (pURB);
+}
@@ -19,12 +19,16 @@
 //
 #include <circle/usb/usbcdcethernet.h>
 #include <circle/usb/usbhostcontroller.h>
+#include <circle/usb/usbbulkinring.h>
 #include <circle/usb/usbstring.h>
 #include <circle/usb/usb.h>
 #include <circle/logger.h>
 #include <circle/macros.h>
+#include <circle/util.h>
 #include <assert.h>
 
+#define RX_BUFFERS		4		// number of frame buffers in RX ring
+
 struct TEthernetNetworkingFunctionalDescriptor
 {
 	u8	bLength;
@@ -44,12 +48,16 @@ static const char FromCDCEthernet[] = "ucdceth";
 CUSBCDCEthernetDevice::CUSBCDCEthernetDevice (CUSBFunction *pFunction)
 :	CUSBFunction (pFunction),
 	m_pEndpointBulkIn (0),
-	m_pEndpointBulkOut (0)
+	m_pEndpointBulkOut (0),
+	m_pRxRing (0)
 {
 }
 
 CUSBCDCEthernetDevice::~CUSBCDCEthernetDevice (void)
 {
+	delete m_pRxRing;
+	m_pRxRing = 0;
+
 	delete m_pEndpointBulkOut;
 	m_pEndpointBulkOut = 0;
 
@@ -155,6 +163,11 @@ boolean CUSBCDCEthernetDevice::Configure (void)
 		return FALSE;
 	}
 
+	assert (m_pRxRing == 0);
+	m_pRxRing = new CUSBBulkInRing (GetHost (), m_pEndpointBulkIn,
+					RX_BUFFERS, FRAME_BUFFER_SIZE, TRUE);
+	assert (m_pRxRing != 0);
+
 	AddNetDevice ();
 
 	return TRUE;
@@ -175,22 +188,20 @@ boolean CUSBCDCEthernetDevice::SendFrame (const void *pBuffer, unsigned nLength)
 
 boolean CUSBCDCEthernetDevice::ReceiveFrame (void *pBuffer, unsigned *pResultLength)
 {
-	assert (m_pEndpointBulkIn != 0);
+	assert (m_pRxRing != 0);
 	assert (pBuffer != 0);
-	CUSBRequest URB (m_pEndpointBulkIn, pBuffer, FRAME_BUFFER_SIZE);
-
-	URB.SetCompleteOnNAK ();
 
-	if (!GetHost ()->SubmitBlockingRequest (&URB))
+	unsigned nResultLength;
+	const u8 *pRxBuffer = m_pRxRing->GetBuffer (&nResultLength);
+	if (pRxBuffer == 0)
 	{
 		return FALSE;
 	}
 
-	u32 nResultLength = URB.GetResultLength ();
-	if (nResultLength == 0)
-	{
-		return FALSE;
-	}
+	assert (nResultLength <= FRAME_BUFFER_SIZE);
+	memcpy (pBuffer, pRxBuffer, nResultLength);
+
+	m_pRxRing->ReleaseBuffer ();
 
 	assert (pResultLength != 0);
 	*pResultLength = nResultLength;
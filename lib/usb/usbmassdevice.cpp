@@ -162,6 +162,29 @@ struct TSCSIReadCapacityResponse
 }
 PACKED;
 
+struct TSCSIReadCapacity16
+{
+	u8		OperationCode;
+#define SCSI_OP_SERVICE_ACTION_IN16	0x9E
+	u8		ServiceAction		: 5,
+#define SCSI_SA_READ_CAPACITY16		0x10
+			Reserved1		: 3;
+	u64		LogicalBlockAddress;			// set to 0
+	u32		AllocationLength;			// big endian
+	u8		PartialMediumIndicator	: 1,		// set to 0
+			Reserved2		: 7;
+	u8		Control;
+}
+PACKED;
+
+struct TSCSIReadCapacity16Response
+{
+	u64		ReturnedLogicalBlockAddress;		// big endian
+	u32		BlockLengthInBytes;			// big endian
+	u8		Reserved[20];
+}
+PACKED;
+
 struct TSCSIRead10
 {
 	u8		OperationCode,
@@ -189,6 +212,30 @@ struct TSCSIWrite10
 }
 PACKED;
 
+struct TSCSIRead16
+{
+	u8		OperationCode,
+#define SCSI_OP_READ16		0x88
+			Flags;
+	u64		LogicalBlockAddress;			// big endian
+	u32		TransferLength;				// block count, big endian
+	u8		GroupNumber;
+	u8		Control;
+}
+PACKED;
+
+struct TSCSIWrite16
+{
+	u8		OperationCode,
+#define SCSI_OP_WRITE16		0x8A
+			Flags;
+	u64		LogicalBlockAddress;			// big endian
+	u32		TransferLength;				// block count, big endian
+	u8		GroupNumber;
+	u8		Control;
+}
+PACKED;
+
 CNumberPool CUSBBulkOnlyMassStorageDevice::s_DeviceNumberPool (1);
 
 static const char FromUmsd[] = "umsd";
@@ -198,11 +245,13 @@ CUSBBulkOnlyMassStorageDevice::CUSBBulkOnlyMassStorageDevice (CUSBFunction *pFun
 	m_pEndpointIn (0),
 	m_pEndpointOut (0),
 	m_nCWBTag (0),
-	m_nBlockCount (0),
+	m_ullBlockCount (0),
 	m_ullOffset (0),
+	m_nMaxTransferSize (UMSD_MAX_TRANSFER_SIZE),
 	m_pPartitionManager (0),
 	m_nDeviceNumber (0)
 {
+	memset (&m_Statistics, 0, sizeof m_Statistics);
 }
 
 CUSBBulkOnlyMassStorageDevice::~CUSBBulkOnlyMassStorageDevice (void)
@@ -273,6 +322,22 @@ boolean CUSBBulkOnlyMassStorageDevice::Configure (void)
 		return FALSE;
 	}
 
+#ifdef UMSD_MAX_PACKETS
+	// full-speed devices (64 bytes max. packet size) allow less than 64 KByte per transfer
+	unsigned nMaxPacketSize = m_pEndpointIn->GetMaxPacketSize ();
+	if (nMaxPacketSize > m_pEndpointOut->GetMaxPacketSize ())
+	{
+		nMaxPacketSize = m_pEndpointOut->GetMaxPacketSize ();
+	}
+
+	size_t nMaxTransferSize = (UMSD_MAX_PACKETS * nMaxPacketSize) & ~UMSD_BLOCK_MASK;
+	if (nMaxTransferSize < m_nMaxTransferSize)
+	{
+		m_nMaxTransferSize = nMaxTransferSize;
+	}
+	assert (m_nMaxTransferSize >= UMSD_BLOCK_SIZE);
+#endif
+
 	if (!CUSBFunction::Configure ())
 	{
 		CLogger::Get ()->Write (FromUmsd, LogError, "Cannot set interface");
@@ -374,17 +439,42 @@ boolean CUSBBulkOnlyMassStorageDevice::Configure (void)
 		return FALSE;
 	}
 
-	m_nBlockCount = le2be32 (SCSIReadCapacityResponse.ReturnedLogicalBlockAddress);
-	if (m_nBlockCount == (u32) -1)
+	m_ullBlockCount = le2be32 (SCSIReadCapacityResponse.ReturnedLogicalBlockAddress);
+	if (m_ullBlockCount == (u32) -1)
 	{
-		CLogger::Get ()->Write (FromUmsd, LogError, "Unsupported disk size > 2TB");
+		// disk size > 2TB, block count has to be requested with READ CAPACITY (16)
+		TSCSIReadCapacity16 SCSIReadCapacity16;
+		memset (&SCSIReadCapacity16, 0, sizeof SCSIReadCapacity16);
+		SCSIReadCapacity16.OperationCode    = SCSI_OP_SERVICE_ACTION_IN16;
+		SCSIReadCapacity16.ServiceAction    = SCSI_SA_READ_CAPACITY16;
+		SCSIReadCapacity16.AllocationLength = le2be32 (sizeof (TSCSIReadCapacity16Response));
+		SCSIReadCapacity16.Control	    = SCSI_CONTROL;
 
-		return FALSE;
+		TSCSIReadCapacity16Response SCSIReadCapacity16Response;
+		if (Command (&SCSIReadCapacity16, sizeof SCSIReadCapacity16,
+			     &SCSIReadCapacity16Response, sizeof SCSIReadCapacity16Response,
+			     TRUE) != (int) sizeof SCSIReadCapacity16Response)
+		{
+			CLogger::Get ()->Write (FromUmsd, LogError, "Read capacity (16) failed");
+
+			return FALSE;
+		}
+
+		nBlockSize = le2be32 (SCSIReadCapacity16Response.BlockLengthInBytes);
+		if (nBlockSize != UMSD_BLOCK_SIZE)
+		{
+			CLogger::Get ()->Write (FromUmsd, LogError, "Unsupported block size: %u", nBlockSize);
+
+			return FALSE;
+		}
+
+		m_ullBlockCount = le2be64 (SCSIReadCapacity16Response.ReturnedLogicalBlockAddress);
 	}
 
-	m_nBlockCount++;
+	m_ullBlockCount++;
 
-	CLogger::Get ()->Write (FromUmsd, LogDebug, "Capacity is %u MByte", m_nBlockCount / (0x100000 / UMSD_BLOCK_SIZE));
+	CLogger::Get ()->Write (FromUmsd, LogDebug, "Capacity is %llu MByte",
+				m_ullBlockCount / (0x100000 / UMSD_BLOCK_SIZE));
 
 	unsigned nDeviceNumber = s_DeviceNumberPool.AllocateNumber (FALSE);
 	if (nDeviceNumber == CNumberPool::Invalid)
@@ -418,52 +508,100 @@ boolean CUSBBulkOnlyMassStorageDevice::Configure (void)
 
 int CUSBBulkOnlyMassStorageDevice::Read (void *pBuffer, size_t nCount)
 {
-	unsigned nTries = 4;
-
-	int nResult;
+	u8 *pBuffer8 = (u8 *) pBuffer;
+	u64 ullOffset = m_ullOffset;
+	size_t nRemaining = nCount;
 
-	do
+	while (nRemaining > 0)
 	{
-		nResult = TryRead (pBuffer, nCount);
+		size_t nChunkSize = nRemaining;
+		if (nChunkSize > m_nMaxTransferSize)
+		{
+			nChunkSize = m_nMaxTransferSize;
+		}
+
+		unsigned nTries = 4;
 
-		if (nResult != (int) nCount)
+		int nResult;
+
+		do
 		{
-			int nStatus = Reset ();
-			if (nStatus != 0)
+			nResult = TryRead (pBuffer8, nChunkSize, ullOffset);
+
+			if (nResult != (int) nChunkSize)
 			{
-				return nStatus;
+				m_Statistics.nErrors++;
+
+				int nStatus = Reset ();
+				if (nStatus != 0)
+				{
+					return nStatus;
+				}
 			}
 		}
+		while (   nResult != (int) nChunkSize
+		       && --nTries > 0);
+
+		if (nResult != (int) nChunkSize)
+		{
+			return nResult;
+		}
+
+		pBuffer8 += nChunkSize;
+		ullOffset += nChunkSize;
+		nRemaining -= nChunkSize;
 	}
-	while (   nResult != (int) nCount
-	       && --nTries > 0);
 
-	return nResult;
+	return nCount;
 }
 
 int CUSBBulkOnlyMassStorageDevice::Write (const void *pBuffer, size_t nCount)
 {
-	unsigned nTries = 4;
-
-	int nResult;
+	const u8 *pBuffer8 = (const u8 *) pBuffer;
+	u64 ullOffset = m_ullOffset;
+	size_t nRemaining = nCount;
 
-	do
+	while (nRemaining > 0)
 	{
-		nResult = TryWrite (pBuffer, nCount);
+		size_t nChunkSize = nRemaining;
+		if (nChunkSize > m_nMaxTransferSize)
+		{
+			nChunkSize = m_nMaxTransferSize;
+		}
+
+		unsigned nTries = 4;
 
-		if (nResult != (int) nCount)
+		int nResult;
+
+		do
 		{
-			int nStatus = Reset ();
-			if (nStatus != 0)
+			nResult = TryWrite (pBuffer8, nChunkSize, ullOffset);
+
+			if (nResult != (int) nChunkSize)
 			{
-				return nStatus;
+				m_Statistics.nErrors++;
+
+				int nStatus = Reset ();
+				if (nStatus != 0)
+				{
+					return nStatus;
+				}
 			}
 		}
+		while (   nResult != (int) nChunkSize
+		       && --nTries > 0);
+
+		if (nResult != (int) nChunkSize)
+		{
+			return nResult;
+		}
+
+		pBuffer8 += nChunkSize;
+		ullOffset += nChunkSize;
+		nRemaining -= nChunkSize;
 	}
-	while (   nResult != (int) nCount
-	       && --nTries > 0);
 
-	return nResult;
+	return nCount;
 }
 
 u64 CUSBBulkOnlyMassStorageDevice::Seek (u64 ullOffset)
@@ -475,80 +613,143 @@ u64 CUSBBulkOnlyMassStorageDevice::Seek (u64 ullOffset)
 
 unsigned CUSBBulkOnlyMassStorageDevice::GetCapacity (void) const
 {
-	return m_nBlockCount;
+	if (m_ullBlockCount > 0xFFFFFFFFU)
+	{
+		return 0xFFFFFFFFU;
+	}
+
+	return (unsigned) m_ullBlockCount;
+}
+
+u64 CUSBBulkOnlyMassStorageDevice::GetCapacity64 (void) const
+{
+	return m_ullBlockCount;
+}
+
+const TUMSDStatistics *CUSBBulkOnlyMassStorageDevice::GetStatistics (void) const
+{
+	return &m_Statistics;
 }
 
-int CUSBBulkOnlyMassStorageDevice::TryRead (void *pBuffer, size_t nCount)
+int CUSBBulkOnlyMassStorageDevice::TryRead (void *pBuffer, size_t nCount, u64 ullOffset)
 {
 	assert (pBuffer != 0);
 
-	if (   (m_ullOffset & UMSD_BLOCK_MASK) != 0
-	    || m_ullOffset > UMSD_MAX_OFFSET)
+	if ((ullOffset & UMSD_BLOCK_MASK) != 0)
 	{
 		return -1;
 	}
-	u32 nBlockAddress = (u32) (m_ullOffset >> UMSD_BLOCK_SHIFT);
+	u64 ullBlockAddress = ullOffset >> UMSD_BLOCK_SHIFT;
 
-	if ((nCount & UMSD_BLOCK_MASK) != 0)
+	if (   (nCount & UMSD_BLOCK_MASK) != 0
+	    || nCount > m_nMaxTransferSize)
 	{
 		return -1;
 	}
-	u16 usTransferLength = (u16) (nCount >> UMSD_BLOCK_SHIFT);
+	u32 nTransferLength = (u32) (nCount >> UMSD_BLOCK_SHIFT);
 
-	//CLogger::Get ()->Write (FromUmsd, LogDebug, "TryRead %u/0x%X/%u", nBlockAddress, (unsigned) pBuffer, (unsigned) usTransferLength);
+	//CLogger::Get ()->Write (FromUmsd, LogDebug, "TryRead %llu/0x%X/%u", ullBlockAddress, (unsigned) pBuffer, nTransferLength);
 
-	TSCSIRead10 SCSIRead;
-	SCSIRead.OperationCode		= SCSI_OP_READ;
-	SCSIRead.Reserved1		= 0;
-	SCSIRead.LogicalBlockAddress	= le2be32 (nBlockAddress);
-	SCSIRead.Reserved2		= 0;
-	SCSIRead.TransferLength		= le2be16 (usTransferLength);
-	SCSIRead.Control		= SCSI_CONTROL;
+	unsigned nStartTicks = CTimer::GetClockTicks ();
 
-	if (Command (&SCSIRead, sizeof SCSIRead, pBuffer, nCount, TRUE) != (int) nCount)
+	int nResult;
+	if (ullOffset + nCount <= UMSD_MAX_OFFSET+1)
+	{
+		TSCSIRead10 SCSIRead;
+		SCSIRead.OperationCode		= SCSI_OP_READ;
+		SCSIRead.Reserved1		= 0;
+		SCSIRead.LogicalBlockAddress	= le2be32 ((u32) ullBlockAddress);
+		SCSIRead.Reserved2		= 0;
+		SCSIRead.TransferLength		= le2be16 ((u16) nTransferLength);
+		SCSIRead.Control		= SCSI_CONTROL;
+
+		nResult = Command (&SCSIRead, sizeof SCSIRead, pBuffer, nCount, TRUE);
+	}
+	else
+	{
+		TSCSIRead16 SCSIRead;
+		SCSIRead.OperationCode		= SCSI_OP_READ16;
+		SCSIRead.Flags			= 0;
+		SCSIRead.LogicalBlockAddress	= le2be64 (ullBlockAddress);
+		SCSIRead.TransferLength		= le2be32 (nTransferLength);
+		SCSIRead.GroupNumber		= 0;
+		SCSIRead.Control		= SCSI_CONTROL;
+
+		nResult = Command (&SCSIRead, sizeof SCSIRead, pBuffer, nCount, TRUE);
+	}
+
+	if (nResult != (int) nCount)
 	{
 		CLogger::Get ()->Write (FromUmsd, LogError, "TryRead failed");
 
 		return -1;
 	}
 
+	m_Statistics.ullReadMicros += CTimer::GetClockTicks () - nStartTicks;
+	m_Statistics.ullBytesRead += nCount;
+	m_Statistics.nReadCommands++;
+
 	return nCount;
 }
 
-int CUSBBulkOnlyMassStorageDevice::TryWrite (const void *pBuffer, size_t nCount)
+int CUSBBulkOnlyMassStorageDevice::TryWrite (const void *pBuffer, size_t nCount, u64 ullOffset)
 {
 	assert (pBuffer != 0);
 
-	if (   (m_ullOffset & UMSD_BLOCK_MASK) != 0
-	    || m_ullOffset > UMSD_MAX_OFFSET)
+	if ((ullOffset & UMSD_BLOCK_MASK) != 0)
 	{
 		return -1;
 	}
-	u32 nBlockAddress = (u32) (m_ullOffset >> UMSD_BLOCK_SHIFT);
+	u64 ullBlockAddress = ullOffset >> UMSD_BLOCK_SHIFT;
 
-	if ((nCount & UMSD_BLOCK_MASK) != 0)
+	if (   (nCount & UMSD_BLOCK_MASK) != 0
+	    || nCount > m_nMaxTransferSize)
 	{
 		return -1;
 	}
-	u16 usTransferLength = (u16) (nCount >> UMSD_BLOCK_SHIFT);
+	u32 nTransferLength = (u32) (nCount >> UMSD_BLOCK_SHIFT);
+
+	//CLogger::Get ()->Write (FromUmsd, LogDebug, "TryWrite %llu/0x%X/%u", ullBlockAddress, (unsigned) pBuffer, nTransferLength);
+
+	unsigned nStartTicks = CTimer::GetClockTicks ();
+
+	int nResult;
+	if (ullOffset + nCount <= UMSD_MAX_OFFSET+1)
+	{
+		TSCSIWrite10 SCSIWrite;
+		SCSIWrite.OperationCode		= SCSI_OP_WRITE;
+		SCSIWrite.Flags			= SCSI_WRITE_FUA;
+		SCSIWrite.LogicalBlockAddress	= le2be32 ((u32) ullBlockAddress);
+		SCSIWrite.Reserved		= 0;
+		SCSIWrite.TransferLength	= le2be16 ((u16) nTransferLength);
+		SCSIWrite.Control		= SCSI_CONTROL;
 
-	//CLogger::Get ()->Write (FromUmsd, LogDebug, "TryWrite %u/0x%X/%u", nBlockAddress, (unsigned) pBuffer, (unsigned) usTransferLength);
+		nResult = Command (&SCSIWrite, sizeof SCSIWrite, (void *) pBuffer, nCount, FALSE);
+	}
+	else
+	{
+		TSCSIWrite16 SCSIWrite;
+		SCSIWrite.OperationCode		= SCSI_OP_WRITE16;
+		SCSIWrite.Flags			= SCSI_WRITE_FUA;
+		SCSIWrite.LogicalBlockAddress	= le2be64 (ullBlockAddress);
+		SCSIWrite.TransferLength	= le2be32 (nTransferLength);
+		SCSIWrite.GroupNumber		= 0;
+		SCSIWrite.Control		= SCSI_CONTROL;
 
-	TSCSIWrite10 SCSIWrite;
-	SCSIWrite.OperationCode		= SCSI_OP_WRITE;
-	SCSIWrite.Flags			= SCSI_WRITE_FUA;
-	SCSIWrite.LogicalBlockAddress	= le2be32 (nBlockAddress);
-	SCSIWrite.Reserved		= 0;
-	SCSIWrite.TransferLength	= le2be16 (usTransferLength);
-	SCSIWrite.Control		= SCSI_CONTROL;
+		nResult = Command (&SCSIWrite, sizeof SCSIWrite, (void *) pBuffer, nCount, FALSE);
+	}
 
-	if (Command (&SCSIWrite, sizeof SCSIWrite, (void *) pBuffer, nCount, FALSE) < 0)
+	if (nResult < 0)
 	{
 		CLogger::Get ()->Write (FromUmsd, LogError, "TryWrite failed");
 
 		return -1;
 	}
 
+	m_Statistics.ullWriteMicros += CTimer::GetClockTicks () - nStartTicks;
+	m_Statistics.ullBytesWritten += nCount;
+	m_Statistics.nWriteCommands++;
+
 	return nCount;
 }
 
@@ -18,6 +18,7 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include <circle/usb/usbrequest.h>
+#include <circle/tracer.h>
 #include <assert.h>
 
 CUSBRequest::CUSBRequest (CUSBEndpoint *pEndpoint, void *pBuffer, u32 nBufLen, TSetupData *pSetupData)
@@ -118,7 +119,9 @@ void CUSBRequest::SetCompletionRoutine (TURBCompletionRoutine *pRoutine, void *p
 void CUSBRequest::CallCompletionRoutine (void)
 {
 	assert (m_pCompletionRoutine != 0);
-	
+
+	TRACE_POINT (TracePhaseFlowEnd, TRACER_EVENT_USB_REQUEST, this, m_nResultLen);
+
 	(*m_pCompletionRoutine) (this, m_pCompletionParam, m_pCompletionContext);
 }
 
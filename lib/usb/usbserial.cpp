@@ -23,9 +23,27 @@
 #include <circle/usb/usbhostcontroller.h>
 #include <circle/usb/usbrequest.h>
 #include <circle/devicenameservice.h>
+#include <circle/timer.h>
 #include <circle/logger.h>
+#include <circle/sysconfig.h>
 #include <assert.h>
 
+#ifdef NO_BUSY_WAIT
+	#include <circle/sched/scheduler.h>
+#endif
+
+#define XON		0x11
+#define XOFF		0x13
+
+#define RX_RING_MASK	(USB_SERIAL_RX_RING_SIZE-1)
+#define TX_RING_MASK	(USB_SERIAL_TX_RING_SIZE-1)
+
+#define RX_FILL(in, out)	(((in) - (out)) & RX_RING_MASK)
+#define RX_FREE(in, out)	(RX_RING_MASK - RX_FILL (in, out))
+
+#define RX_HIGH_WATER	(USB_SERIAL_RX_RING_SIZE * 3 / 4)	// send XOFF above this
+#define RX_LOW_WATER	(USB_SERIAL_RX_RING_SIZE / 4)		// send XON below this
+
 CNumberPool CUSBSerialDevice::s_DeviceNumberPool (1);
 
 static const char FromSerial[] = "userial";
@@ -37,20 +55,37 @@ CUSBSerialDevice::CUSBSerialDevice (CUSBFunction *pFunction, size_t nReadHeaderB
 	m_nDataBits (USBSerialDataBits8),
 	m_nParity (USBSerialParityNone),
 	m_nStopBits (USBSerialStopBits1),
+	m_FlowControl (USBSerialFlowControlNone),
 	m_nReadHeaderBytes (nReadHeaderBytes),
 	m_pEndpointIn (0),
 	m_pEndpointOut (0),
 	m_pBufferIn (0),
 	m_nBufferInSize (0),
-	m_nBufferInValid (0),
-	m_nBufferInPtr (0),
-	m_bInRequestActive (FALSE),
+	m_nRxIn (0),
+	m_nRxOut (0),
+	m_bRxActive (FALSE),
+	m_hRxTimer (0),
+	m_bXOFFSent (FALSE),
+	m_pBufferOut (0),
+	m_nBufferOutSize (0),
+	m_nTxIn (0),
+	m_nTxOut (0),
+	m_bTxActive (FALSE),
+	m_bTxStopped (FALSE),
+	m_uchTxControlChar (0),
 	m_nDeviceNumber (0)
 {
+	memset (&m_Statistics, 0, sizeof m_Statistics);
 }
 
 CUSBSerialDevice::~CUSBSerialDevice (void)
 {
+	if (m_hRxTimer != 0)
+	{
+		CTimer::Get ()->CancelKernelTimer (m_hRxTimer);
+		m_hRxTimer = 0;
+	}
+
 	if (m_nDeviceNumber != 0)
 	{
 		CDeviceNameService::Get ()->RemoveDevice (DevicePrefix, m_nDeviceNumber, FALSE);
@@ -64,6 +99,10 @@ CUSBSerialDevice::~CUSBSerialDevice (void)
 	delete m_pEndpointIn;
 	m_pEndpointIn = 0;
 
+	delete [] m_pBufferOut;
+	m_pBufferOut = 0;
+	m_nBufferOutSize = 0;
+
 	delete [] m_pBufferIn;
 	m_pBufferIn = 0;
 	m_nBufferInSize = 0;
@@ -109,10 +148,15 @@ boolean CUSBSerialDevice::Configure (void)
 		return FALSE;
 	}
 
-	m_nBufferInSize = m_pEndpointIn->GetMaxPacketSize ();
+	m_nBufferInSize = m_pEndpointIn->GetMaxPacketSize () * USB_SERIAL_MAX_PACKETS;
+	assert (m_nBufferInSize < USB_SERIAL_RX_RING_SIZE);
 	m_pBufferIn = new u8[m_nBufferInSize];
 	assert (m_pBufferIn != 0);
 
+	m_nBufferOutSize = m_pEndpointOut->GetMaxPacketSize () * USB_SERIAL_MAX_PACKETS;
+	m_pBufferOut = new u8[m_nBufferOutSize];
+	assert (m_pBufferOut != 0);
+
 	if (!CUSBFunction::Configure ())
 	{
 		CLogger::Get ()->Write (FromSerial, LogError, "Cannot set interface");
@@ -132,80 +176,99 @@ int CUSBSerialDevice::Write (const void *pBuffer, size_t nCount)
 {
 	assert (pBuffer != 0);
 	assert (nCount > 0);
-	
-	CUSBHostController *pHost = GetHost ();
-	assert (pHost != 0);
 
-	DMA_BUFFER (u8, BufferOut, nCount);
-	memcpy (BufferOut, pBuffer, nCount);
+	const u8 *pData = (const u8 *) pBuffer;
+	size_t nQueued = 0;
 
-	assert (m_pEndpointOut != 0);
-	int nActual = pHost->Transfer (m_pEndpointOut, BufferOut, nCount);
-	if (nActual < 0)
+	unsigned nStartTicks = CTimer::GetClockTicks ();
+	while (1)
 	{
-		CLogger::Get ()->Write (FromSerial, LogWarning, "USB write failed");
-	}
+		m_TxSpinLock.Acquire ();
 
-	return nActual;
-}
+		while (nQueued < nCount)
+		{
+			unsigned nNextIn = (m_nTxIn + 1) & TX_RING_MASK;
+			if (nNextIn == m_nTxOut)
+			{
+				break;
+			}
 
-int CUSBSerialDevice::Read (void *pBuffer, size_t nCount)
-{
-	assert (pBuffer != 0);
-	assert (nCount > 0);
+			m_TxRing[m_nTxIn] = pData[nQueued++];
+			m_nTxIn = nNextIn;
+		}
 
-	DataMemBarrier ();
+		m_TxSpinLock.Release ();
 
-	if (m_bInRequestActive)
-	{
-		return 0;
-	}
+		KickTransmission ();
 
-	assert (m_pBufferIn != 0);
-	assert (m_nBufferInSize > 0);
-	assert (m_nBufferInValid <= m_nBufferInSize);
-	assert (m_nBufferInPtr <= m_nBufferInValid);
+		if (nQueued == nCount)
+		{
+			break;
+		}
 
-	if (m_nBufferInPtr == m_nBufferInValid)		// buffer empty?
-	{
-		CUSBHostController *pHost = GetHost ();
-		assert (pHost != 0);
+		if (CTimer::GetClockTicks () - nStartTicks >= USB_SERIAL_WRITE_TIMEOUT_MS * 1000)
+		{
+			m_Statistics.nTxDropped += nCount - nQueued;
 
-		assert (m_pEndpointIn != 0);
-		CUSBRequest *pURB = new CUSBRequest (m_pEndpointIn, m_pBufferIn, m_nBufferInSize);
-		assert (pURB != 0);
+			if (nQueued == 0)
+			{
+				CLogger::Get ()->Write (FromSerial, LogWarning, "USB write failed");
 
-		// do not retry if request cannot be served immediately
-		pURB->SetCompleteOnNAK ();
+				return -1;
+			}
 
-		pURB->SetCompletionRoutine (CompletionStub, 0, this);
-		m_bInRequestActive = TRUE;
+			break;
+		}
 
-		if (!pHost->SubmitAsyncRequest (pURB))
+#ifdef NO_BUSY_WAIT
+		// the TX completion frees space in the ring meanwhile
+		if (   CScheduler::IsActive ()
+		    && CurrentExecutionLevel () == TASK_LEVEL)
 		{
-			CLogger::Get ()->Write (FromSerial, LogWarning, "USB read failed");
+			CScheduler::Get ()->Yield ();
+		}
+#endif
+	}
+
+	return nQueued;
+}
 
-			m_bInRequestActive = FALSE;
+int CUSBSerialDevice::Read (void *pBuffer, size_t nCount)
+{
+	assert (pBuffer != 0);
+	assert (nCount > 0);
 
-			delete pURB;
+	u8 *pData = (u8 *) pBuffer;
+	size_t nResult = 0;
 
-			return -1;
-		}
+	unsigned nIn = m_nRxIn;
+	unsigned nOut = m_nRxOut;
+	DataMemBarrier ();
 
-		return 0;
+	while (   nResult < nCount
+	       && nOut != nIn)
+	{
+		pData[nResult++] = m_RxRing[nOut];
+
+		nOut = (nOut + 1) & RX_RING_MASK;
 	}
 
-	size_t nRemain = m_nBufferInValid - m_nBufferInPtr;
-	if (nRemain < nCount)
+	DataMemBarrier ();
+	m_nRxOut = nOut;
+
+	if (   m_FlowControl == USBSerialFlowControlSoftware
+	    && m_bXOFFSent
+	    && RX_FILL (m_nRxIn, nOut) < RX_LOW_WATER)
 	{
-		nCount = nRemain;
+		m_bXOFFSent = FALSE;
+
+		SendFlowControlChar (XON);
 	}
 
-	assert (nCount > 0);
-	memcpy (pBuffer, m_pBufferIn + m_nBufferInPtr, nCount);
-	m_nBufferInPtr += nCount;
+	// (re)start reception, if it is not running
+	StartReception ();
 
-	return nCount;
+	return nResult;
 }
 
 boolean CUSBSerialDevice::SetBaudRate (unsigned nBaudRate)
@@ -224,42 +287,328 @@ boolean CUSBSerialDevice::SetLineProperties (TUSBSerialDataBits nDataBits,
 	return TRUE;
 }
 
-void CUSBSerialDevice::CompletionRoutine (CUSBRequest *pURB)
+boolean CUSBSerialDevice::SetFlowControl (TUSBSerialFlowControl FlowControl)
 {
+	if (!SetHardwareFlowControl (FlowControl == USBSerialFlowControlHardware))
+	{
+		CLogger::Get ()->Write (FromSerial, LogError, "Cannot set flow control %u",
+					(unsigned) FlowControl);
+
+		return FALSE;
+	}
+
+	m_FlowControl = FlowControl;
+
+	m_bXOFFSent = FALSE;
+	m_bTxStopped = FALSE;
+	DataSyncBarrier ();
+
+	KickTransmission ();
+
+	return TRUE;
+}
+
+boolean CUSBSerialDevice::SetHardwareFlowControl (boolean bEnable)
+{
+	return !bEnable;
+}
+
+size_t CUSBSerialDevice::GetTxPending (void) const
+{
+	return (m_nTxIn - m_nTxOut) & TX_RING_MASK;
+}
+
+void CUSBSerialDevice::GetStatistics (TUSBSerialStatistics *pStatistics) const
+{
+	assert (pStatistics != 0);
+	memcpy (pStatistics, &m_Statistics, sizeof *pStatistics);
+}
+
+void CUSBSerialDevice::StartReception (void)
+{
+	m_RxSpinLock.Acquire ();
+
+	if (   m_bRxActive
+	    || RX_FREE (m_nRxIn, m_nRxOut) < m_nBufferInSize)
+	{
+		m_RxSpinLock.Release ();
+
+		return;
+	}
+
+	m_bRxActive = TRUE;
+
+	m_RxSpinLock.Release ();
+
+	SubmitReception ();
+}
+
+void CUSBSerialDevice::SubmitReception (void)
+{
+	assert (m_bRxActive);
+
+	assert (m_pEndpointIn != 0);
+	assert (m_pBufferIn != 0);
+	CUSBRequest *pURB = new CUSBRequest (m_pEndpointIn, m_pBufferIn, m_nBufferInSize);
 	assert (pURB != 0);
-	assert (m_bInRequestActive);
-	assert (m_nBufferInValid == m_nBufferInPtr);
 
-	if (pURB->GetStatus () != 0)
+	// do not retry if request cannot be served immediately, so that the host
+	// channel is not occupied, while the device has nothing to send
+	pURB->SetCompleteOnNAK ();
+
+	pURB->SetCompletionRoutine (RxCompletionStub, 0, this);
+
+	CUSBHostController *pHost = GetHost ();
+	assert (pHost != 0);
+	if (!pHost->SubmitAsyncRequest (pURB))
+	{
+		delete pURB;
+
+		m_Statistics.nRxErrors++;
+
+		m_bRxActive = FALSE;
+	}
+}
+
+void CUSBSerialDevice::KickTransmission (void)
+{
+	m_TxSpinLock.Acquire ();
+
+	if (m_bTxActive)
+	{
+		m_TxSpinLock.Release ();
+
+		return;
+	}
+
+	// batch all queued data up to the transfer buffer size
+	assert (m_pBufferOut != 0);
+	size_t nLength = 0;
+	if (m_uchTxControlChar != 0)
+	{
+		m_pBufferOut[nLength++] = m_uchTxControlChar;
+		m_uchTxControlChar = 0;
+	}
+	else if (!m_bTxStopped)
 	{
-		m_nBufferInValid = pURB->GetResultLength ();
-		m_nBufferInPtr = m_nReadHeaderBytes;
+		while (   nLength < m_nBufferOutSize
+		       && m_nTxOut != m_nTxIn)
+		{
+			m_pBufferOut[nLength++] = m_TxRing[m_nTxOut];
+
+			m_nTxOut = (m_nTxOut + 1) & TX_RING_MASK;
+		}
+	}
+
+	if (nLength == 0)
+	{
+		m_TxSpinLock.Release ();
+
+		return;
+	}
+
+	m_bTxActive = TRUE;
+
+	m_TxSpinLock.Release ();
+
+	assert (m_pEndpointOut != 0);
+	CUSBRequest *pURB = new CUSBRequest (m_pEndpointOut, m_pBufferOut, nLength);
+	assert (pURB != 0);
+
+	pURB->SetCompletionRoutine (TxCompletionStub, 0, this);
 
-		if (   m_nBufferInValid == 0
-		    || m_nBufferInValid == m_nBufferInPtr)
+	CUSBHostController *pHost = GetHost ();
+	assert (pHost != 0);
+	if (!pHost->SubmitAsyncRequest (pURB))
+	{
+		delete pURB;
+
+		m_Statistics.nTxErrors++;
+
+		m_bTxActive = FALSE;
+	}
+}
+
+void CUSBSerialDevice::SendFlowControlChar (u8 uchChar)
+{
+	m_TxSpinLock.Acquire ();
+
+	m_uchTxControlChar = uchChar;
+
+	m_TxSpinLock.Release ();
+
+	KickTransmission ();
+}
+
+void CUSBSerialDevice::RxCompletionRoutine (CUSBRequest *pURB)
+{
+	assert (pURB != 0);
+	assert (m_bRxActive);
+
+	boolean bOK = pURB->GetStatus () != 0;
+	size_t nLength = pURB->GetResultLength ();
+
+	delete pURB;
+
+	boolean bTxStopped = m_bTxStopped;
+
+	// the device NAKed, no data is available, poll again later
+	if (   bOK
+	    && nLength == 0)
+	{
+		assert (m_hRxTimer == 0);
+		m_hRxTimer = CTimer::Get ()->StartKernelTimer (MSEC2HZ (USB_SERIAL_RX_POLL_MS),
+							      RxTimerStub, 0, this);
+		assert (m_hRxTimer != 0);
+
+		return;
+	}
+
+	if (bOK)
+	{
+		m_Statistics.nRxTransfers++;
+
+		// StartReception() ensures, that the whole transfer fits into the ring
+		unsigned nIn = m_nRxIn;
+
+		assert (m_pEndpointIn != 0);
+		size_t nPacketSize = m_pEndpointIn->GetMaxPacketSize ();
+		for (size_t nOffset = 0; nOffset < nLength; nOffset += nPacketSize)
 		{
-			m_nBufferInValid = 0;
-			m_nBufferInPtr = 0;
+			size_t nPacketLength = nLength - nOffset;
+			if (nPacketLength > nPacketSize)
+			{
+				nPacketLength = nPacketSize;
+			}
+
+			// some devices prepend a header to each packet
+			if (nPacketLength < m_nReadHeaderBytes)
+			{
+				CLogger::Get ()->Write (FromSerial, LogWarning, "Missing read header");
+
+				break;
+			}
+
+			for (size_t i = m_nReadHeaderBytes; i < nPacketLength; i++)
+			{
+				u8 uchChar = m_pBufferIn[nOffset + i];
+
+				if (   m_FlowControl == USBSerialFlowControlSoftware
+				    && (uchChar == XON || uchChar == XOFF))
+				{
+					m_bTxStopped = uchChar == XOFF;
+
+					continue;
+				}
+
+				m_RxRing[nIn] = uchChar;
+				nIn = (nIn + 1) & RX_RING_MASK;
+
+				m_Statistics.ullBytesReceived++;
+			}
 		}
-		else if (m_nBufferInValid < m_nBufferInPtr)
+
+		DataMemBarrier ();
+		m_nRxIn = nIn;
+
+		if (   m_FlowControl == USBSerialFlowControlSoftware
+		    && !m_bXOFFSent
+		    && RX_FILL (nIn, m_nRxOut) > RX_HIGH_WATER)
 		{
-			CLogger::Get ()->Write (FromSerial, LogWarning, "Missing read header");
+			m_bXOFFSent = TRUE;
+
+			SendFlowControlChar (XOFF);
+		}
+	}
+	else
+	{
+		m_Statistics.nRxErrors++;
+	}
+
+	m_RxSpinLock.Acquire ();
 
-			m_nBufferInValid = 0;
-			m_nBufferInPtr = 0;
+	m_bRxActive = FALSE;
+
+	// On error the reception is restarted with the next Read() to prevent
+	// an interrupt storm. Otherwise the next transfer is started immediately,
+	// if there is enough space in the ring.
+	boolean bRestart = FALSE;
+	if (bOK)
+	{
+		if (RX_FREE (m_nRxIn, m_nRxOut) >= m_nBufferInSize)
+		{
+			bRestart = TRUE;
 		}
+		else
+		{
+			m_Statistics.nRxOverruns++;
+		}
+	}
+
+	m_RxSpinLock.Release ();
+
+	if (bRestart)
+	{
+		StartReception ();
+	}
+
+	if (bTxStopped && !m_bTxStopped)
+	{
+		KickTransmission ();		// XON received
+	}
+}
+
+void CUSBSerialDevice::RxCompletionStub (CUSBRequest *pURB, void *pParam, void *pContext)
+{
+	CUSBSerialDevice *pThis = (CUSBSerialDevice *) pContext;
+	assert (pThis != 0);
+
+	pThis->RxCompletionRoutine (pURB);
+}
+
+void CUSBSerialDevice::RxTimerHandler (TKernelTimerHandle hTimer)
+{
+	assert (m_hRxTimer == hTimer);
+	m_hRxTimer = 0;
+
+	SubmitReception ();
+}
+
+void CUSBSerialDevice::RxTimerStub (TKernelTimerHandle hTimer, void *pParam, void *pContext)
+{
+	CUSBSerialDevice *pThis = (CUSBSerialDevice *) pContext;
+	assert (pThis != 0);
+
+	pThis->RxTimerHandler (hTimer);
+}
+
+void CUSBSerialDevice::TxCompletionRoutine (CUSBRequest *pURB)
+{
+	assert (pURB != 0);
+	assert (m_bTxActive);
+
+	if (pURB->GetStatus () != 0)
+	{
+		m_Statistics.nTxTransfers++;
+		m_Statistics.ullBytesSent += pURB->GetResultLength ();
+	}
+	else
+	{
+		m_Statistics.nTxErrors++;
 	}
 
 	delete pURB;
 
-	m_bInRequestActive = FALSE;
+	m_bTxActive = FALSE;
 	DataSyncBarrier ();
+
+	KickTransmission ();
 }
 
-void CUSBSerialDevice::CompletionStub (CUSBRequest *pURB, void *pParam, void *pContext)
+void CUSBSerialDevice::TxCompletionStub (CUSBRequest *pURB, void *pParam, void *pContext)
 {
 	CUSBSerialDevice *pThis = (CUSBSerialDevice *) pContext;
 	assert (pThis != 0);
 
-	pThis->CompletionRoutine (pURB);
+	pThis->TxCompletionRoutine (pURB);
 }
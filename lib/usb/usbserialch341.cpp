@@ -36,6 +36,9 @@ static const char FromCh341[] = "ch341";
 #define CH341_REQ_SERIAL_INIT  0xA1
 #define CH341_REQ_MODEM_CTRL   0xA4
 
+#define CH341_REG_FLOW_CTRL    0x2727
+#define CH341_FLOW_CTRL_RTSCTS 0x0101
+
 #define CH341_LCR_ENABLE_RX    0x80
 #define CH341_LCR_ENABLE_TX    0x40
 #define CH341_LCR_PAR_EVEN     0x10
@@ -249,6 +252,26 @@ boolean CUSBSerialCH341Device::SetLineProperties (TUSBSerialDataBits nDataBits,
 	return TRUE;
 }
 
+boolean CUSBSerialCH341Device::SetHardwareFlowControl (boolean bEnable)
+{
+	CUSBHostController *pHost = GetHost ();
+	assert (pHost != 0);
+
+	if (pHost->ControlMessage (GetEndpoint0 (),
+				   REQUEST_OUT | REQUEST_VENDOR | REQUEST_TO_DEVICE,
+				   CH341_REQ_WRITE_REG,
+				   CH341_REG_FLOW_CTRL,
+				   bEnable ? CH341_FLOW_CTRL_RTSCTS : 0,
+				   0, 0) < 0)
+	{
+		CLogger::Get ()->Write (FromCh341, LogError, "Cannot set flow control");
+
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
 const TUSBDeviceID *CUSBSerialCH341Device::GetDeviceIDTable (void)
 {
 	static const TUSBDeviceID DeviceIDTable[] =
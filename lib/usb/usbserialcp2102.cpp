@@ -31,6 +31,7 @@ static const char FromCp2102[] = "cp2102";
 // Config request codes
 #define CP210X_IFC_ENABLE	0x00
 #define CP210X_SET_LINE_CTL	0x03
+#define CP210X_SET_FLOW		0x13
 #define CP210X_SET_BAUDRATE	0x1E
 #define CP210X_VENDOR_SPECIFIC	0xFF
 
@@ -51,6 +52,23 @@ static const char FromCp2102[] = "cp2102";
 #define BITS_STOP_1		0x0000
 #define BITS_STOP_2		0x0002
 
+// CP210X_SET_FLOW
+struct TCP210XFlowControl
+{
+	u32	ulControlHandshake;
+#define SERIAL_DTR_ACTIVE	0x00000001
+#define SERIAL_CTS_HANDSHAKE	0x00000008
+	u32	ulFlowReplace;
+#define SERIAL_RTS_ACTIVE	0x00000040
+#define SERIAL_RTS_FLOW_CTL	0x00000080
+	u32	ulXonLimit;
+	u32	ulXoffLimit;
+}
+PACKED;
+
+#define FLOW_XON_LIMIT		128
+#define FLOW_XOFF_LIMIT		128
+
 // CP210X_VENDOR_SPECIFIC values
 #define CP210X_GET_PARTNUM	0x370B
 
@@ -230,6 +248,37 @@ boolean CUSBSerialCP2102Device::SetLineProperties (TUSBSerialDataBits nDataBits,
 	return TRUE;
 }
 
+boolean CUSBSerialCP2102Device::SetHardwareFlowControl (boolean bEnable)
+{
+	CUSBHostController *pHost = GetHost ();
+	assert (pHost != 0);
+
+	DMA_BUFFER (TCP210XFlowControl, FlowControl, 1);
+	FlowControl[0].ulControlHandshake = SERIAL_DTR_ACTIVE;
+	FlowControl[0].ulFlowReplace = SERIAL_RTS_ACTIVE;
+	if (bEnable)
+	{
+		FlowControl[0].ulControlHandshake |= SERIAL_CTS_HANDSHAKE;
+		FlowControl[0].ulFlowReplace = SERIAL_RTS_FLOW_CTL;
+	}
+	FlowControl[0].ulXonLimit = FLOW_XON_LIMIT;
+	FlowControl[0].ulXoffLimit = FLOW_XOFF_LIMIT;
+
+	if (pHost->ControlMessage (GetEndpoint0 (),
+				   REQUEST_OUT | REQUEST_VENDOR | REQUEST_TO_INTERFACE,
+				   CP210X_SET_FLOW,
+				   0,
+				   0,
+				   FlowControl, sizeof FlowControl[0]) < 0)
+	{
+		CLogger::Get ()->Write (FromCp2102, LogError, "Cannot set flow control");
+
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
 const TUSBDeviceID *CUSBSerialCP2102Device::GetDeviceIDTable (void)
 {
 	static const TUSBDeviceID DeviceIDTable[] =
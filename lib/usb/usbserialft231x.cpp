@@ -34,6 +34,7 @@ static const char FromFt231x[] = "ft231x";
 #define FTDI_SIO_RESET_SIO		0x0
 #define FTDI_SIO_SET_FLOW_CTRL		2
 #define FTDI_SIO_DISABLE_FLOW_CTRL	0x0
+#define FTDI_SIO_RTS_CTS_HS		(0x1 << 8)
 #define FTDI_SIO_SET_BAUD_RATE		3
 #define FTDI_SIO_SET_DATA		4
 #define FTDI_SIO_SET_DATA_PARITY_NONE	(0x0 << 8)
@@ -237,6 +238,26 @@ boolean CUSBSerialFT231XDevice::SetLineProperties (TUSBSerialDataBits nDataBits,
 	return TRUE;
 }
 
+boolean CUSBSerialFT231XDevice::SetHardwareFlowControl (boolean bEnable)
+{
+	CUSBHostController *pHost = GetHost ();
+	assert (pHost != 0);
+
+	if (pHost->ControlMessage (GetEndpoint0 (),
+				   REQUEST_OUT | REQUEST_VENDOR | REQUEST_TO_DEVICE,
+				   FTDI_SIO_SET_FLOW_CTRL,
+				   0,
+				   bEnable ? FTDI_SIO_RTS_CTS_HS : FTDI_SIO_DISABLE_FLOW_CTRL,
+				   0, 0) < 0)
+	{
+		CLogger::Get ()->Write (FromFt231x, LogError, "Cannot set flow control");
+
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
 const TUSBDeviceID *CUSBSerialFT231XDevice::GetDeviceIDTable (void)
 {
 	static const TUSBDeviceID DeviceIDTable[] =
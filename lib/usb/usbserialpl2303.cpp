@@ -35,8 +35,13 @@ static const char FromPl2303[] = "pl2303";
 #define GET_LINE_REQUEST	0x21
 #define SET_LINE_REQUEST	0x20
 
+// register 0 values
+#define FLOW_CTRL_RTSCTS	0x61
+#define FLOW_CTRL_RTSCTS_LEGACY	0x41
+
 CUSBSerialPL2303Device::CUSBSerialPL2303Device (CUSBFunction *pFunction)
-:	CUSBSerialDevice (pFunction)
+:	CUSBSerialDevice (pFunction),
+	m_bLegacyType (TRUE)
 {
 }
 
@@ -63,6 +68,7 @@ boolean CUSBSerialPL2303Device::Configure (void)
 	else if (deviceDesc->bMaxPacketSize0 == 0x40)
 	{
 		type = "HX";
+		m_bLegacyType = FALSE;
 	}
 	else if (deviceDesc->bDeviceClass == 0x00 || deviceDesc->bDeviceClass == 0xFF)
 	{
@@ -366,6 +372,32 @@ boolean CUSBSerialPL2303Device::SetLineProperties (TUSBSerialDataBits nDataBits,
 	return TRUE;
 }
 
+boolean CUSBSerialPL2303Device::SetHardwareFlowControl (boolean bEnable)
+{
+	CUSBHostController *pHost = GetHost ();
+	assert (pHost != 0);
+
+	u16 usValue = 0;
+	if (bEnable)
+	{
+		usValue = m_bLegacyType ? FLOW_CTRL_RTSCTS_LEGACY : FLOW_CTRL_RTSCTS;
+	}
+
+	if (pHost->ControlMessage (GetEndpoint0 (),
+				   REQUEST_OUT | REQUEST_VENDOR | REQUEST_TO_DEVICE,
+				   VENDOR_WRITE_REQUEST,
+				   0,
+				   usValue,
+				   0, 0) < 0)
+	{
+		CLogger::Get ()->Write (FromPl2303, LogError, "Cannot set flow control");
+
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
 const TUSBDeviceID *CUSBSerialPL2303Device::GetDeviceIDTable (void)
 {
 	static const TUSBDeviceID DeviceIDTable[] =
@@ -24,6 +24,7 @@
 #include <circle/memory.h>
 #include <circle/util.h>
 #include <circle/bcmpropertytags.h>
+#include <circle/tracer.h>
 #include <assert.h>
 
 static const char From[] = "xhci";
@@ -43,6 +44,7 @@ CXHCIDevice::CXHCIDevice (CInterruptSystem *pInterruptSystem, CTimer *pTimer, bo
 	m_pRootHub (0),
 	m_bShutdown (FALSE)
 {
+	memset (&m_Statistics, 0, sizeof m_Statistics);
 }
 
 CXHCIDevice::~CXHCIDevice (void)
@@ -254,6 +256,8 @@ boolean CXHCIDevice::SubmitAsyncRequest (CUSBRequest *pURB, unsigned nTimeoutMs)
 	CXHCIEndpoint *pEndpoint = pURB->GetEndpoint ()->GetXHCIEndpoint ();
 	assert (pEndpoint != 0);
 
+	TRACE_POINT (TracePhaseFlowStart, TRACER_EVENT_USB_REQUEST, pURB, pURB->GetBufLen ());
+
 	return pEndpoint->TransferAsync (pURB, nTimeoutMs);
 }
 
@@ -301,6 +305,45 @@ void CXHCIDevice::FreeSharedMem (void *pBlock)
 	m_SharedMemAllocator.Free (pBlock);
 }
 
+void CXHCIDevice::SetInterruptModeration (unsigned nMicroseconds)
+{
+	unsigned nInterval = nMicroseconds * 4;		// 250ns units
+	if (nInterval > XHCI_REG_RT_IR_IMOD_IMODI__MASK)
+	{
+		nInterval = XHCI_REG_RT_IR_IMOD_IMODI__MASK;
+	}
+
+	assert (m_pEventManager != 0);
+	m_pEventManager->SetInterruptModeration ((u16) nInterval);
+}
+
+void CXHCIDevice::GetStatistics (TXHCIStatistics *pStatistics) const
+{
+	assert (pStatistics != 0);
+	memcpy (pStatistics, &m_Statistics, sizeof *pStatistics);
+}
+
+void CXHCIDevice::ResetStatistics (void)
+{
+	memset (&m_Statistics, 0, sizeof m_Statistics);
+}
+
+void CXHCIDevice::CountTransferDescriptor (unsigned nTRBs)
+{
+	m_Statistics.nTransferDescriptors++;
+	m_Statistics.nTransferTRBs += nTRBs;
+
+	if (nTRBs > m_Statistics.nMaxTRBsPerTD)
+	{
+		m_Statistics.nMaxTRBsPerTD = nTRBs;
+	}
+}
+
+void CXHCIDevice::CountRingExpansion (void)
+{
+	m_Statistics.nRingExpansions++;
+}
+
 void CXHCIDevice::InterruptHandler (unsigned nVector)
 {
 #ifdef XHCI_DEBUG2
@@ -326,10 +369,19 @@ void CXHCIDevice::InterruptHandler (unsigned nVector)
 
 	TXHCITRB *pEventTRB = 0;
 	TXHCITRB *pNextEventTRB;
+	unsigned nEvents = 0;
 	assert (m_pEventManager != 0);
 	while ((pNextEventTRB = m_pEventManager->HandleEvents ()) != 0)
 	{
 		pEventTRB = pNextEventTRB;
+		nEvents++;
+	}
+
+	m_Statistics.nInterrupts++;
+	m_Statistics.nEvents += nEvents;
+	if (nEvents > m_Statistics.nMaxEventsPerInterrupt)
+	{
+		m_Statistics.nMaxEventsPerInterrupt = nEvents;
 	}
 
 	if (pEventTRB != 0)
@@ -390,6 +442,14 @@ void CXHCIDevice::DumpStatus (void)
 
 	CLogger::Get ()->Write (From, LogDebug, "%u KB shared memory free",
 				(unsigned) (m_SharedMemAllocator.GetFreeSpace () / 1024));
+
+	CLogger::Get ()->Write (From, LogDebug,
+				"%u interrupts, %u events (max %u), %u TDs, %u TRBs (max %u), "
+				"%u ring expansions",
+				m_Statistics.nInterrupts, m_Statistics.nEvents,
+				m_Statistics.nMaxEventsPerInterrupt, m_Statistics.nTransferDescriptors,
+				m_Statistics.nTransferTRBs, m_Statistics.nMaxTRBsPerTD,
+				m_Statistics.nRingExpansions);
 }
 
 #endif
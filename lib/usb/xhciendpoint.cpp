@@ -42,6 +42,8 @@ CXHCIEndpoint::CXHCIEndpoint (CXHCIUSBDevice *pDevice, CXHCIDevice *pXHCIDevice)
 	m_uchEndpointType (XHCI_EP_CONTEXT_EP_TYPE_CONTROL),
 	m_pURB (0),
 	m_bTransferCompleted (TRUE),
+	m_pFirstTDTRB (0),
+	m_pLastTDTRB (0),
 	m_pInputContextBuffer (0)
 {
 	m_pTransferRing = new CXHCIRing (XHCIRingTypeTransfer,
@@ -68,6 +70,8 @@ CXHCIEndpoint::CXHCIEndpoint (CXHCIUSBDevice *pDevice, const TUSBEndpointDescrip
 	m_uchEndpointType (0),
 	m_pURB (0),
 	m_bTransferCompleted (TRUE),
+	m_pFirstTDTRB (0),
+	m_pLastTDTRB (0),
 	m_pInputContextBuffer (0)
 {
 	m_pTransferRing = new CXHCIRing (XHCIRingTypeTransfer,
@@ -245,11 +249,7 @@ boolean CXHCIEndpoint::TransferAsync (CUSBRequest *pURB, unsigned nTimeoutMs)
 		assert ((uintptr) pBuffer > MEM_KERNEL_END);
 		CleanAndInvalidateDataCacheRange ((uintptr) pBuffer, nBufLen);
 
-		if (!EnqueueTRB (  XHCI_TRB_TYPE_NORMAL << XHCI_TRB_CONTROL_TRB_TYPE__SHIFT
-				 | XHCI_TRANSFER_TRB_CONTROL_IOC,
-		     		 nBufLen | 0 << XHCI_TRANSFER_TRB_STATUS_TD_SIZE__SHIFT,
-				 XHCI_TO_DMA_LO (pBuffer),
-				 XHCI_TO_DMA_HI (pBuffer)))
+		if (!EnqueueNormalTD (pBuffer, nBufLen))
 		{
 			return FALSE;
 		}
@@ -258,6 +258,9 @@ boolean CXHCIEndpoint::TransferAsync (CUSBRequest *pURB, unsigned nTimeoutMs)
 	{
 		assert (m_uchEndpointType == 4);	// control EP
 
+		m_pFirstTDTRB = 0;
+		m_pLastTDTRB = 0;
+
 		TSetupData *pSetup = pURB->GetSetupData ();
 		assert (pSetup != 0);
 
@@ -328,6 +331,7 @@ boolean CXHCIEndpoint::TransferAsync (CUSBRequest *pURB, unsigned nTimeoutMs)
 
 	DataSyncBarrier ();
 
+	// one doorbell for all TRBs of the TD
 	assert (m_pDevice != 0);
 	assert (XHCI_IS_ENDPOINTID (m_uchEndpointID));
 	m_pMMIO->db_write32 (m_pDevice->GetSlotID (), XHCI_REG_DB_TARGET_EP0 + m_uchEndpointID-1);
@@ -335,7 +339,8 @@ boolean CXHCIEndpoint::TransferAsync (CUSBRequest *pURB, unsigned nTimeoutMs)
 	return TRUE;
 }
 
-void CXHCIEndpoint::TransferEvent (u8 uchCompletionCode, u32 nTransferLength)
+void CXHCIEndpoint::TransferEvent (u8 uchCompletionCode, u32 nTransferLength,
+				   TXHCITRB *pTransferTRB)
 {
 
 #ifdef XHCI_DEBUG2
@@ -347,22 +352,55 @@ void CXHCIEndpoint::TransferEvent (u8 uchCompletionCode, u32 nTransferLength)
 
 	DataMemBarrier ();
 
-	assert (m_pURB != 0);
+	// A short packet on a TRB with ISP set, which is not the last TRB of the TD,
+	// may be followed by a second event for the last TRB. This is ignored here.
 	CUSBRequest *pURB = m_pURB;
+	if (pURB == 0)
+	{
+		return;
+	}
+
+	u32 nBufLen = pURB->GetBufLen ();
+	u32 nResultLen;
+	if (m_pFirstTDTRB != 0)
+	{
+		// sum up the lengths of the TRBs, which have been completed before
+		assert (m_pTransferRing != 0);
+		nResultLen = 0;
+		TXHCITRB *pTRB;
+		for (pTRB = m_pFirstTDTRB; pTRB != pTransferTRB;
+		     pTRB = m_pTransferRing->GetNextTRB (pTRB))
+		{
+			if (pTRB == m_pLastTDTRB)
+			{
+				return;			// event does not belong to current TD
+			}
+
+			nResultLen += pTRB->Status & XHCI_TRANSFER_TRB_STATUS_TRB_TRANSFER_LENGTH__MASK;
+		}
+
+		u32 nTRBLength = pTRB->Status & XHCI_TRANSFER_TRB_STATUS_TRB_TRANSFER_LENGTH__MASK;
+		assert (nTransferLength <= nTRBLength);
+		nResultLen += nTRBLength - nTransferLength;
+	}
+	else
+	{
+		assert (nTransferLength <= nBufLen);
+		nResultLen = nBufLen - nTransferLength;
+	}
 
 	if (   XHCI_TRB_SUCCESS (uchCompletionCode)
 	    || uchCompletionCode == XHCI_TRB_COMPLETION_CODE_SHORT_PACKET)
 	{
 		void *pBuffer = pURB->GetBuffer ();
-		u32 nBufLen = pURB->GetBufLen ();
 		if (pBuffer != 0)
 		{
 			assert (nBufLen > 0);
 			CleanAndInvalidateDataCacheRange ((uintptr) pBuffer, nBufLen);
 		}
 
-		assert (nTransferLength <= nBufLen);
-		pURB->SetResultLen (nBufLen - nTransferLength);
+		assert (nResultLen <= nBufLen);
+		pURB->SetResultLen (nResultLen);
 
 		pURB->SetStatus (1);
 	}
@@ -414,7 +452,97 @@ void CXHCIEndpoint::CompletionRoutine (CUSBRequest *pURB, void *pParam, void *pC
 	pThis->m_bTransferCompleted = TRUE;
 }
 
-boolean CXHCIEndpoint::EnqueueTRB (u32 nControl, u32 nStatus, u32 nParameter1, u32 nParameter2)
+boolean CXHCIEndpoint::EnqueueNormalTD (void *pBuffer, u32 nBufLen)
+{
+	assert (pBuffer != 0);
+	assert (nBufLen > 0);
+	assert (m_usMaxPacketSize > 0);
+
+	// count the TRBs, the buffer of a TRB must not cross a 64K boundary
+	unsigned nTRBs = 0;
+	uintptr nAddress = (uintptr) pBuffer;
+	uintptr nEndAddress = nAddress + nBufLen;
+	while (nAddress < nEndAddress)
+	{
+		nAddress = (nAddress + XHCI_TRANSFER_TRB_MAX_LENGTH) & ~(XHCI_TRANSFER_TRB_MAX_LENGTH-1);
+		nTRBs++;
+	}
+
+	// the ring is idle here, so it can be safely expanded, if the TD does not fit
+	assert (m_pURB == 0);
+	assert (m_pTransferRing != 0);
+	while (m_pTransferRing->GetCapacity () < nTRBs)
+	{
+		if (!m_pTransferRing->Expand ())
+		{
+			CLogger::Get ()->Write (From, LogError,
+						"Cannot expand transfer ring (%u TRBs required)", nTRBs);
+
+			return FALSE;
+		}
+
+		assert (m_pXHCIDevice != 0);
+		m_pXHCIDevice->CountRingExpansion ();
+	}
+
+	m_pXHCIDevice->CountTransferDescriptor (nTRBs);
+
+	u32 nControl = XHCI_TRB_TYPE_NORMAL << XHCI_TRB_CONTROL_TRB_TYPE__SHIFT;
+	if (   nTRBs > 1
+	    && (   m_uchEndpointType == XHCI_EP_CONTEXT_EP_TYPE_BULK_IN
+		|| m_uchEndpointType == XHCI_EP_CONTEXT_EP_TYPE_INTERRUPT_IN))
+	{
+		nControl |= XHCI_TRANSFER_TRB_CONTROL_ISP;	// get an event on short packet
+	}
+
+	u8 *pData = (u8 *) pBuffer;
+	u32 nRemaining = nBufLen;
+	for (unsigned i = 0; i < nTRBs; i++)
+	{
+		u32 nLength =   XHCI_TRANSFER_TRB_MAX_LENGTH
+			      - ((uintptr) pData & (XHCI_TRANSFER_TRB_MAX_LENGTH-1));
+		if (nLength > nRemaining)
+		{
+			nLength = nRemaining;
+		}
+
+		nRemaining -= nLength;
+
+		// TD Size is the number of packets, which remain after this TRB
+		u32 nTDSize = (nRemaining + m_usMaxPacketSize-1) / m_usMaxPacketSize;
+		if (nTDSize > 31)
+		{
+			nTDSize = 31;
+		}
+
+		TXHCITRB *pTRB = EnqueueTRB (  nControl
+					     | (  nRemaining > 0
+						? XHCI_TRANSFER_TRB_CONTROL_CH
+						: XHCI_TRANSFER_TRB_CONTROL_IOC),
+					     nLength | nTDSize << XHCI_TRANSFER_TRB_STATUS_TD_SIZE__SHIFT,
+					     XHCI_TO_DMA_LO (pData),
+					     XHCI_TO_DMA_HI (pData));
+		if (pTRB == 0)
+		{
+			return FALSE;
+		}
+
+		if (i == 0)
+		{
+			m_pFirstTDTRB = pTRB;
+		}
+
+		m_pLastTDTRB = pTRB;
+
+		pData += nLength;
+	}
+
+	assert (nRemaining == 0);
+
+	return TRUE;
+}
+
+TXHCITRB *CXHCIEndpoint::EnqueueTRB (u32 nControl, u32 nStatus, u32 nParameter1, u32 nParameter2)
 {
 	assert (m_pTransferRing != 0);
 	TXHCITRB *pTransferTRB = m_pTransferRing->GetEnqueueTRB ();
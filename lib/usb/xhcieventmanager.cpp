@@ -99,7 +99,8 @@ TXHCITRB *CXHCIEventManager::HandleEvents (void)
 			pEventTRB->Status & XHCI_TRANSFER_EVENT_TRB_STATUS_TRB_TRANSFER_LENGTH__MASK,
 			pEventTRB->Control >> XHCI_CMD_COMPLETION_EVENT_TRB_CONTROL_SLOTID__SHIFT,
 			   (pEventTRB->Control & XHCI_TRANSFER_EVENT_TRB_CONTROL_ENDPOINTID__MASK)
-			>> XHCI_TRANSFER_EVENT_TRB_CONTROL_ENDPOINTID__SHIFT);
+			>> XHCI_TRANSFER_EVENT_TRB_CONTROL_ENDPOINTID__SHIFT,
+			(TXHCITRB *) XHCI_FROM_DMA (pEventTRB->Parameter));
 		break;
 
 	case XHCI_TRB_TYPE_EVENT_CMD_COMPLETION:
@@ -136,6 +137,12 @@ TXHCITRB *CXHCIEventManager::HandleEvents (void)
 	return pEventTRB;
 }
 
+void CXHCIEventManager::SetInterruptModeration (u16 usInterval)
+{
+	assert (m_pMMIO != 0);
+	m_pMMIO->rt_write32 (0, XHCI_REG_RT_IR_IMOD, usInterval & XHCI_REG_RT_IR_IMOD_IMODI__MASK);
+}
+
 #ifndef NDEBUG
 
 void CXHCIEventManager::DumpStatus (void)
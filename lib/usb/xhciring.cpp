@@ -19,6 +19,7 @@
 //
 #include <circle/usb/xhciring.h>
 #include <circle/usb/xhcidevice.h>
+#include <circle/synchronize.h>
 #include <circle/logger.h>
 #include <circle/debug.h>
 #include <assert.h>
@@ -32,7 +33,9 @@ CXHCIRing::CXHCIRing (TXHCIRingType Type, unsigned nTRBCount, CXHCIDevice *pAllo
 	m_pFirstTRB (0),
 	m_nEnqueueIndex (0),
 	m_nDequeueIndex (0),
-	m_nCycleState (XHCI_TRB_CONTROL_C)
+	m_nCycleState (XHCI_TRB_CONTROL_C),
+	m_nSegments (0),
+	m_nEnqueueSegment (0)
 {
 	assert (m_nTRBCount >= 16);
 	assert (m_nTRBCount % 4 == 0);
@@ -45,6 +48,9 @@ CXHCIRing::CXHCIRing (TXHCIRingType Type, unsigned nTRBCount, CXHCIDevice *pAllo
 		return;
 	}
 
+	m_pSegment[0] = m_pFirstTRB;
+	m_nSegments = 1;
+
 	if (m_Type != XHCIRingTypeEvent)
 	{
 		TXHCITRB *pLinkTRB = &m_pFirstTRB[m_nTRBCount - 1];
@@ -58,12 +64,15 @@ CXHCIRing::CXHCIRing (TXHCIRingType Type, unsigned nTRBCount, CXHCIDevice *pAllo
 
 CXHCIRing::~CXHCIRing (void)
 {
-	if (m_pFirstTRB != 0)
+	for (unsigned i = 0; i < m_nSegments; i++)
 	{
-		m_pAllocator->FreeSharedMem (m_pFirstTRB);
+		m_pAllocator->FreeSharedMem (m_pSegment[i]);
 
-		m_pFirstTRB = 0;
+		m_pSegment[i] = 0;
 	}
+
+	m_nSegments = 0;
+	m_pFirstTRB = 0;
 }
 
 boolean CXHCIRing::IsValid (void) const
@@ -102,13 +111,15 @@ TXHCITRB *CXHCIRing::GetEnqueueTRB (void)
 {
 	assert (m_pFirstTRB != 0);
 	assert (m_nEnqueueIndex < m_nTRBCount);
+	assert (m_nEnqueueSegment < m_nSegments);
 
-	if ((m_pFirstTRB[m_nEnqueueIndex].Control & XHCI_TRB_CONTROL_C) == m_nCycleState)
+	TXHCITRB *pSegment = m_pSegment[m_nEnqueueSegment];
+	if ((pSegment[m_nEnqueueIndex].Control & XHCI_TRB_CONTROL_C) == m_nCycleState)
 	{
 		return 0;		// ring is full
 	}
 
-	return &m_pFirstTRB[m_nEnqueueIndex];
+	return &pSegment[m_nEnqueueIndex];
 }
 
 TXHCITRB *CXHCIRing::IncrementDequeue (void)
@@ -135,13 +146,16 @@ void CXHCIRing::IncrementEnqueue (void)
 	assert (m_pFirstTRB != 0);
 	assert (m_Type != XHCIRingTypeEvent);
 	assert (m_nEnqueueIndex < m_nTRBCount);
+	assert (m_nEnqueueSegment < m_nSegments);
+
+	TXHCITRB *pSegment = m_pSegment[m_nEnqueueSegment];
 
-	assert (   (m_pFirstTRB[m_nEnqueueIndex].Control & XHCI_TRB_CONTROL_C)
+	assert (   (pSegment[m_nEnqueueIndex].Control & XHCI_TRB_CONTROL_C)
 		== m_nCycleState);	// Cycle state must be already set
 
 	if (++m_nEnqueueIndex == m_nTRBCount-1)		// last index is used for Link TRB
 	{
-		TXHCITRB *pLinkTRB = &m_pFirstTRB[m_nEnqueueIndex];
+		TXHCITRB *pLinkTRB = &pSegment[m_nEnqueueIndex];
 
 		pLinkTRB->Control ^= XHCI_TRB_CONTROL_C;
 
@@ -151,6 +165,11 @@ void CXHCIRing::IncrementEnqueue (void)
 		}
 
 		m_nEnqueueIndex = 0;
+
+		if (++m_nEnqueueSegment == m_nSegments)
+		{
+			m_nEnqueueSegment = 0;
+		}
 	}
 }
 
@@ -161,19 +180,104 @@ u32 CXHCIRing::GetCycleState (void) const
 	return m_nCycleState;
 }
 
+TXHCITRB *CXHCIRing::GetNextTRB (TXHCITRB *pTRB)
+{
+	assert (m_Type == XHCIRingTypeTransfer);
+	assert (pTRB != 0);
+
+	TXHCITRB *pNextTRB = pTRB + 1;
+	if (   (pNextTRB->Control & XHCI_TRB_CONTROL_TRB_TYPE__MASK)
+	    == XHCI_TRB_TYPE_LINK << XHCI_TRB_CONTROL_TRB_TYPE__SHIFT)
+	{
+		pNextTRB = (TXHCITRB *) XHCI_FROM_DMA (pNextTRB->Parameter);
+	}
+
+	return pNextTRB;
+}
+
+unsigned CXHCIRing::GetCapacity (void) const
+{
+	assert (m_pFirstTRB != 0);
+	assert (m_Type == XHCIRingTypeTransfer);
+
+	// one TRB is kept free, so that the ring never runs completely full
+	return m_nSegments * (m_nTRBCount-1) - 1;
+}
+
+boolean CXHCIRing::Expand (void)
+{
+	assert (m_pFirstTRB != 0);
+	assert (m_Type == XHCIRingTypeTransfer);
+
+	if (m_nSegments >= XHCI_CONFIG_MAX_RING_SEGMENTS)
+	{
+		return FALSE;
+	}
+
+	assert (m_pAllocator != 0);
+	TXHCITRB *pNewSegment =
+		(TXHCITRB *) m_pAllocator->AllocateSharedMem (m_nTRBCount * sizeof (TXHCITRB),
+							      64, 0x10000);
+	if (pNewSegment == 0)
+	{
+		return FALSE;
+	}
+
+	// The xHC reaches the new segment with the current cycle state, before it
+	// crosses a Link TRB with TC set. Therefore all TRBs of the new segment
+	// (including its Link TRB) are initialized as not owned by the xHC.
+	u32 nNotOwned = m_nCycleState ^ XHCI_TRB_CONTROL_C;
+	for (unsigned i = 0; i < m_nTRBCount-1; i++)
+	{
+		pNewSegment[i].Control = nNotOwned;
+	}
+
+	assert (m_nEnqueueSegment < m_nSegments);
+	TXHCITRB *pLinkTRB = &m_pSegment[m_nEnqueueSegment][m_nTRBCount-1];
+	TXHCITRB *pNewLinkTRB = &pNewSegment[m_nTRBCount-1];
+
+	pNewLinkTRB->Parameter = pLinkTRB->Parameter;
+	pNewLinkTRB->Status = 0;
+	pNewLinkTRB->Control =   XHCI_TRB_TYPE_LINK << XHCI_TRB_CONTROL_TRB_TYPE__SHIFT
+			       | (pLinkTRB->Control & XHCI_LINK_TRB_CONTROL_TC)
+			       | nNotOwned;
+
+	pLinkTRB->Parameter = XHCI_TO_DMA (pNewSegment);
+	pLinkTRB->Control &= ~XHCI_LINK_TRB_CONTROL_TC;
+
+	for (unsigned i = m_nSegments; i > m_nEnqueueSegment+1; i--)
+	{
+		m_pSegment[i] = m_pSegment[i-1];
+	}
+
+	m_pSegment[m_nEnqueueSegment+1] = pNewSegment;
+	m_nSegments++;
+
+	DataSyncBarrier ();
+
+	return TRUE;
+}
+
+unsigned CXHCIRing::GetSegmentCount (void) const
+{
+	return m_nSegments;
+}
+
 #ifndef NDEBUG
 
 void CXHCIRing::DumpStatus (const char *pFrom)
 {
-	CLogger::Get ()->Write (pFrom != 0 ? pFrom : From, LogDebug, "Count %u, %s %u, Cycle %u",
-				m_nTRBCount,
+	CLogger::Get ()->Write (pFrom != 0 ? pFrom : From, LogDebug,
+				"Count %u, Segments %u, %s %u/%u, Cycle %u",
+				m_nTRBCount, m_nSegments,
 				m_Type == XHCIRingTypeEvent ? "Dequeue" : "Enqueue",
+				m_Type == XHCIRingTypeEvent ? 0 : m_nEnqueueSegment,
 				m_Type == XHCIRingTypeEvent ? m_nDequeueIndex : m_nEnqueueIndex,
 				m_nCycleState);
 
-	if (m_pFirstTRB != 0)
+	for (unsigned i = 0; i < m_nSegments; i++)
 	{
-		debug_hexdump (m_pFirstTRB, m_nTRBCount * sizeof (TXHCITRB),
+		debug_hexdump (m_pSegment[i], m_nTRBCount * sizeof (TXHCITRB),
 			       pFrom != 0 ? pFrom : From);
 	}
 }
@@ -100,12 +100,13 @@ void CXHCISlotManager::AssignScratchpadBufferArray (u64 *pScratchpadBufferArray)
 }
 
 void CXHCISlotManager::TransferEvent (u8 uchCompletionCode, u32 nTransferLength,
-				      u8 uchSlotID, u8 uchEndpointID)
+				      u8 uchSlotID, u8 uchEndpointID, TXHCITRB *pTransferTRB)
 {
 	assert (XHCI_IS_SLOTID (uchSlotID));
 	assert (m_pUSBDevice[uchSlotID-1] != 0);
 
-	m_pUSBDevice[uchSlotID-1]->TransferEvent (uchCompletionCode, nTransferLength, uchEndpointID);
+	m_pUSBDevice[uchSlotID-1]->TransferEvent (uchCompletionCode, nTransferLength, uchEndpointID,
+						  pTransferTRB);
 }
 
 #ifndef NDEBUG
@@ -188,11 +188,13 @@ void CXHCIUSBDevice::RegisterEndpoint (u8 uchEndpointID, CXHCIEndpoint *pEndpoin
 	m_pEndpoint[uchEndpointID-1] = pEndpoint;
 }
 
-void CXHCIUSBDevice::TransferEvent (u8 uchCompletionCode, u32 nTransferLength, u8 uchEndpointID)
+void CXHCIUSBDevice::TransferEvent (u8 uchCompletionCode, u32 nTransferLength, u8 uchEndpointID,
+				    TXHCITRB *pTransferTRB)
 {
 	assert (XHCI_IS_ENDPOINTID (uchEndpointID));
 	assert (m_pEndpoint[uchEndpointID-1] != 0);
-	m_pEndpoint[uchEndpointID-1]->TransferEvent (uchCompletionCode, nTransferLength);
+	m_pEndpoint[uchEndpointID-1]->TransferEvent (uchCompletionCode, nTransferLength,
+						     pTransferTRB);
 }
 
 #ifndef NDEBUG
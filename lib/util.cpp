@@ -19,33 +19,62 @@
 //
 #include <circle/util.h>
 
+// The following functions operate on machine words (32 or 64 bits) in their
+// main loops, after the pointers have been aligned byte by byte. NEON is not
+// used, because the floating point registers are not saved on IRQ entry by
+// default (see SAVE_VFP_REGS_ON_IRQ) and these functions are called from
+// interrupt handlers too.
+
+typedef uintptr TWord MAYALIAS;
+
+#define WORD_SIZE	sizeof (TWord)
+#define WORD_MASK	(WORD_SIZE-1)
+
+#define ONES		((TWord) -1 / 0xFF)		// 0x0101...01
+#define HIGHS		(ONES << 7)			// 0x8080...80
+
+// non-zero, if any byte of w is zero
+#define HAS_ZERO_BYTE(w)	(((w) - ONES) & ~(w) & HIGHS)
+
 void *memset (void *pBuffer, int nValue, size_t nLength)
 {
-	u32 *p32 = (u32 *) pBuffer;
+	u8 *p = (u8 *) pBuffer;
 
-	if (   ((uintptr) p32 & 3) == 0
-	    && nLength >= 16)
+	if (nLength >= 2*WORD_SIZE)
 	{
-		u32 nValue32 = nValue | nValue << 8;
-		nValue32 |= nValue32 << 16;
+		while ((uintptr) p & WORD_MASK)
+		{
+			*p++ = (u8) nValue;
+			nLength--;
+		}
 
-		do
+		TWord nWord = (u8) nValue * ONES;
+		TWord *pWord = (TWord *) p;
+
+		while (nLength >= 4*WORD_SIZE)
 		{
-			*p32++ = nValue32;
-			*p32++ = nValue32;
-			*p32++ = nValue32;
-			*p32++ = nValue32;
+			pWord[0] = nWord;
+			pWord[1] = nWord;
+			pWord[2] = nWord;
+			pWord[3] = nWord;
+			pWord += 4;
 
-			nLength -= 16;
+			nLength -= 4*WORD_SIZE;
 		}
-		while (nLength >= 16);
-	}
 
-	char *p = (char *) p32;
+		while (nLength >= WORD_SIZE)
+		{
+			*pWord++ = nWord;
+
+			nLength -= WORD_SIZE;
+		}
+
+		p = (u8 *) pWord;
+	}
 
 	while (nLength--)
 	{
-		*p++ = (char) nValue;
+		*p++ = (u8) nValue;
 	}
 
 	return pBuffer;
@@ -55,8 +84,8 @@ void *memset (void *pBuffer, int nValue, size_t nLength)
 
 void *memmove (void *pDest, const void *pSrc, size_t nLength)
 {
-	char *pchDest = (char *) pDest;
-	const char *pchSrc = (const char *) pSrc;
+	u8 *pchDest = (u8 *) pDest;
+	const u8 *pchSrc = (const u8 *) pSrc;
 
 	if (   pchSrc < pchDest
 	    && pchDest < pchSrc + nLength)
@@ -64,6 +93,47 @@ void *memmove (void *pDest, const void *pSrc, size_t nLength)
 		pchSrc += nLength;
 		pchDest += nLength;
 
+		// copy backwards, word-wise if both pointers can be aligned
+		if (   nLength >= 2*WORD_SIZE
+		    && (((uintptr) pchSrc ^ (uintptr) pchDest) & WORD_MASK) == 0)
+		{
+			while ((uintptr) pchDest & WORD_MASK)
+			{
+				*--pchDest = *--pchSrc;
+				nLength--;
+			}
+
+			TWord *pWordDest = (TWord *) pchDest;
+			const TWord *pWordSrc = (const TWord *) pchSrc;
+
+			while (nLength >= 4*WORD_SIZE)
+			{
+				pWordSrc -= 4;
+				pWordDest -= 4;
+
+				TWord nWord3 = pWordSrc[3];
+				TWord nWord2 = pWordSrc[2];
+				pWordDest[3] = nWord3;
+				pWordDest[2] = nWord2;
+				TWord nWord1 = pWordSrc[1];
+				TWord nWord0 = pWordSrc[0];
+				pWordDest[1] = nWord1;
+				pWordDest[0] = nWord0;
+
+				nLength -= 4*WORD_SIZE;
+			}
+
+			while (nLength >= WORD_SIZE)
+			{
+				*--pWordDest = *--pWordSrc;
+
+				nLength -= WORD_SIZE;
+			}
+
+			pchDest = (u8 *) pWordDest;
+			pchSrc = (const u8 *) pWordSrc;
+		}
+
 		while (nLength--)
 		{
 			*--pchDest = *--pchSrc;
@@ -79,7 +149,39 @@ int memcmp (const void *pBuffer1, const void *pBuffer2, size_t nLength)
 {
 	const unsigned char *p1 = (const unsigned char *) pBuffer1;
 	const unsigned char *p2 = (const unsigned char *) pBuffer2;
-	
+
+	// skip equal words, the differing word is compared byte-wise below
+	if (   nLength >= 2*WORD_SIZE
+	    && (((uintptr) p1 ^ (uintptr) p2) & WORD_MASK) == 0)
+	{
+		while ((uintptr) p1 & WORD_MASK)
+		{
+			if (*p1 != *p2)
+			{
+				return *p1 > *p2 ? 1 : -1;
+			}
+
+			p1++;
+			p2++;
+			nLength--;
+		}
+
+		const TWord *pWord1 = (const TWord *) p1;
+		const TWord *pWord2 = (const TWord *) p2;
+
+		while (   nLength >= WORD_SIZE
+		       && *pWord1 == *pWord2)
+		{
+			pWord1++;
+			pWord2++;
+
+			nLength -= WORD_SIZE;
+		}
+
+		p1 = (const unsigned char *) pWord1;
+		p2 = (const unsigned char *) pWord2;
+	}
+
 	while (nLength-- > 0)
 	{
 		if (*p1 > *p2)
@@ -100,18 +202,64 @@ int memcmp (const void *pBuffer1, const void *pBuffer2, size_t nLength)
 
 size_t strlen (const char *pString)
 {
-	size_t nResult = 0;
+	const char *p = pString;
 
-	while (*pString++)
+	while ((uintptr) p & WORD_MASK)
 	{
-		nResult++;
+		if (*p == '\0')
+		{
+			return p - pString;
+		}
+
+		p++;
 	}
 
-	return nResult;
+	// an aligned word never crosses a page boundary, so reading behind
+	// the terminating zero is safe
+	const TWord *pWord = (const TWord *) p;
+	while (!HAS_ZERO_BYTE (*pWord))
+	{
+		pWord++;
+	}
+
+	p = (const char *) pWord;
+	while (*p != '\0')
+	{
+		p++;
+	}
+
+	return p - pString;
 }
 
 int strcmp (const char *pString1, const char *pString2)
 {
+	if ((((uintptr) pString1 ^ (uintptr) pString2) & WORD_MASK) == 0)
+	{
+		while (   ((uintptr) pString1 & WORD_MASK) != 0
+		       && *pString1 != '\0'
+		       && *pString1 == *pString2)
+		{
+			pString1++;
+			pString2++;
+		}
+
+		if (((uintptr) pString1 & WORD_MASK) == 0)
+		{
+			// skip equal words without a terminating zero
+			const TWord *pWord1 = (const TWord *) pString1;
+			const TWord *pWord2 = (const TWord *) pString2;
+			while (   *pWord1 == *pWord2
+			       && !HAS_ZERO_BYTE (*pWord1))
+			{
+				pWord1++;
+				pWord2++;
+			}
+
+			pString1 = (const char *) pWord1;
+			pString2 = (const char *) pWord2;
+		}
+	}
+
 	while (   *pString1 != '\0'
 	       && *pString2 != '\0')
 	{
@@ -720,4 +868,10 @@ u32 bswap32 (u32 ulValue)
 		| ((ulValue & 0xFF000000) >> 24);
 }
 
+u64 bswap64 (u64 ullValue)
+{
+	return    (u64) bswap32 ((u32) ullValue) << 32
+		| bswap32 ((u32) (ullValue >> 32));
+}
+
 #endif
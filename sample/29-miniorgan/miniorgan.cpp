@@ -69,7 +69,7 @@ const TNoteInfo CMiniOrgan::s_Keys[] =
 CMiniOrgan *CMiniOrgan::s_pThis = 0;
 
 CMiniOrgan::CMiniOrgan (CInterruptSystem *pInterrupt)
-:	SOUND_CLASS (pInterrupt, SAMPLE_RATE),
+:	SOUND_CLASS (pInterrupt, SAMPLE_RATE, CHUNK_SIZE, DMA_PERIODS),
 	m_pMIDIDevice (0),
 	m_pKeyboard (0),
 	m_Serial (pInterrupt, TRUE),
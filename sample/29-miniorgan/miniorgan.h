@@ -26,12 +26,16 @@
 	#include <circle/i2ssoundbasedevice.h>
 	#define SOUND_CLASS	CI2SSoundBaseDevice
 	#define SAMPLE_RATE	192000
+	#define CHUNK_SIZE	256		// 0.67 ms per period
 #else
 	#include <circle/pwmsoundbasedevice.h>
 	#define SOUND_CLASS	CPWMSoundBaseDevice
 	#define SAMPLE_RATE	48000
+	#define CHUNK_SIZE	64		// 0.67 ms per period
 #endif
 
+#define DMA_PERIODS	3			// latency about 1.3 ms
+
 #include <circle/interrupt.h>
 #include <circle/usb/usbmidi.h>
 #include <circle/usb/usbkeyboard.h>
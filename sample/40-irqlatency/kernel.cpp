@@ -19,6 +19,7 @@
 //
 #include "kernel.h"
 #include <circle/synchronize.h>
+#include <assert.h>
 
 #define SAMPLE_RATE_HZ		25000		// IRQs per second
 
@@ -37,6 +38,9 @@ CKernel::CKernel (void)
 	m_Timer (&m_Interrupt),
 	m_Logger (m_Options.GetLogLevel (), &m_Timer),
 	m_USBHCI (&m_Interrupt, &m_Timer, TRUE),
+#ifdef LOAD_SD
+	m_EMMC (&m_Interrupt, &m_Timer, &m_ActLED),
+#endif
 	m_Latency (&m_Interrupt)
 {
 	s_pThis = this;
@@ -89,6 +93,20 @@ boolean CKernel::Initialize (void)
 		bOK = m_USBHCI.Initialize ();
 	}
 
+#ifdef LOAD_SD
+	if (bOK)
+	{
+		bOK = m_EMMC.Initialize ();
+	}
+#endif
+
+#ifdef LOAD_NET
+	if (bOK)
+	{
+		bOK = m_Net.Initialize (FALSE);		// do not wait for DHCP here
+	}
+#endif
+
 	return bOK;
 }
 
@@ -96,13 +114,48 @@ TShutdownMode CKernel::Run (void)
 {
 	m_Logger.Write (FromKernel, LogNotice, "Compile time: " __DATE__ " " __TIME__);
 
+#ifdef LOAD_NET
+	CLoadTask *pLoadTask = new CLoadTask (&m_Net);
+#else
+	CLoadTask *pLoadTask = new CLoadTask (0);
+#endif
+	assert (pLoadTask != 0);
+
 	m_Latency.Start (SAMPLE_RATE_HZ);
 
 	// start timer to elapse after 5 seconds
 	m_Timer.StartKernelTimer (5 * HZ, TimerHandler, 0, this);
 
-	unsigned nTime = m_Timer.GetTime ();
 	while (1)
+	{
+		RunPhase (pLoadTask, LoadNone);
+#ifdef LOAD_SD
+		RunPhase (pLoadTask, LoadSD);
+#endif
+#ifdef LOAD_USB
+		RunPhase (pLoadTask, LoadUSB);
+#endif
+#ifdef LOAD_NET
+		RunPhase (pLoadTask, LoadNet);
+#endif
+	}
+
+	return ShutdownHalt;
+}
+
+void CKernel::RunPhase (CLoadTask *pLoadTask, TLoadType Load)
+{
+	assert (pLoadTask != 0);
+	pLoadTask->SetLoad (Load);
+
+	m_Logger.Write (FromKernel, LogNotice, "Running with load \"%s\" for %u seconds",
+			CLoadTask::GetName (Load), PHASE_SECONDS);
+
+	m_Latency.Reset ();
+
+	unsigned nStartTime = m_Timer.GetTime ();
+	unsigned nTime = nStartTime;
+	while (nTime - nStartTime < PHASE_SECONDS)
 	{
 		while (nTime == m_Timer.GetTime ())		// wait a second
 		{
@@ -111,19 +164,23 @@ TShutdownMode CKernel::Run (void)
 #ifdef USE_BUFFERED_SCREEN
 			m_Screen.Update ();
 #endif
+
+			m_Scheduler.Yield ();			// let the load task run
 		}
 
 		nTime = m_Timer.GetTime ();
 
-#if 1
-		m_Logger.Write (FromKernel, LogNotice, "Maximum IRQ latency was %u us",
+		m_Logger.Write (FromKernel, LogDebug, "Maximum IRQ latency was %u us",
 				m_Latency.GetMax ());
-#else
-		m_Latency.Dump ();
-#endif
 	}
 
-	return ShutdownHalt;
+	pLoadTask->SetLoad (LoadNone);
+
+	m_Logger.Write (FromKernel, LogNotice, "Results with load \"%s\" (%u ops, %u errors):",
+			CLoadTask::GetName (Load),
+			pLoadTask->GetOperations (), pLoadTask->GetErrors ());
+
+	m_Latency.Dump (TRUE);
 }
 
 void CKernel::TimerHandler (TKernelTimerHandle hTimer, void *pParam, void *pContext)
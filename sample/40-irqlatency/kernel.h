@@ -31,11 +31,22 @@
 #include <circle/timer.h>
 #include <circle/logger.h>
 #include <circle/usb/usbhcidevice.h>
+#include <circle/sched/scheduler.h>
+#include <circle/net/netsubsystem.h>
 #include <circle/latencytester.h>
 #include <circle/types.h>
+#include <SDCard/emmc.h>
+#include "loadtask.h"
 
 #define USE_BUFFERED_SCREEN
 
+// background loads, which are applied one after another (comment out to disable)
+#define LOAD_SD				// read from SD card
+#define LOAD_USB			// read from USB mass-storage device (if attached)
+#define LOAD_NET			// send UDP broadcast packets
+
+#define PHASE_SECONDS		30	// duration of each benchmark phase
+
 enum TShutdownMode
 {
 	ShutdownNone,
@@ -54,6 +65,8 @@ public:
 	TShutdownMode Run (void);
 	
 private:
+	void RunPhase (CLoadTask *pLoadTask, TLoadType Load);
+
 	static void TimerHandler (TKernelTimerHandle hTimer, void *pParam, void *pContext);
 
 #ifdef USE_BUFFERED_SCREEN
@@ -77,6 +90,13 @@ private:
 	CTimer			m_Timer;
 	CLogger			m_Logger;
 	CUSBHCIDevice		m_USBHCI;
+	CScheduler		m_Scheduler;
+#ifdef LOAD_SD
+	CEMMCDevice		m_EMMC;
+#endif
+#ifdef LOAD_NET
+	CNetSubSystem		m_Net;
+#endif
 
 	CLatencyTester		m_Latency;
 
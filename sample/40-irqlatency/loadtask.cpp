@@ -0,0 +1,189 @@
+//
+// loadtask.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2020  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "loadtask.h"
+#include <circle/sched/scheduler.h>
+#include <circle/devicenameservice.h>
+#include <circle/device.h>
+#include <circle/net/in.h>
+#include <circle/util.h>
+#include <assert.h>
+
+#define READ_SIZE		0x10000			// bytes per read operation
+#define READ_AREA		(64 * 0x100000)		// wrap read offset after this
+
+#define PACKET_SIZE		1024
+#define PACKET_PORT		9			// "discard" service
+
+CLoadTask::CLoadTask (CNetSubSystem *pNetSubSystem)
+:	m_pNetSubSystem (pNetSubSystem),
+	m_Load (LoadNone),
+	m_nOperations (0),
+	m_nErrors (0),
+	m_ullOffset (0),
+	m_pBuffer (0),
+	m_pSocket (0)
+{
+	m_BroadcastIP.SetBroadcast ();
+}
+
+CLoadTask::~CLoadTask (void)
+{
+	delete m_pSocket;
+	m_pSocket = 0;
+
+	delete [] m_pBuffer;
+	m_pBuffer = 0;
+
+	m_pNetSubSystem = 0;
+}
+
+void CLoadTask::SetLoad (TLoadType Load)
+{
+	assert (Load < LoadUnknown);
+	m_Load = Load;
+
+	m_nOperations = 0;
+	m_nErrors = 0;
+}
+
+unsigned CLoadTask::GetOperations (void) const
+{
+	return m_nOperations;
+}
+
+unsigned CLoadTask::GetErrors (void) const
+{
+	return m_nErrors;
+}
+
+void CLoadTask::Run (void)
+{
+	m_pBuffer = new u8[READ_SIZE];
+	assert (m_pBuffer != 0);
+	memset (m_pBuffer, 0x55, READ_SIZE);
+
+	while (1)
+	{
+		boolean bOK = TRUE;
+
+		switch (m_Load)
+		{
+		case LoadSD:
+			bOK = ReadBlockDevice ("emmc1");
+			break;
+
+		case LoadUSB:
+			bOK = ReadBlockDevice ("umsd1");
+			break;
+
+		case LoadNet:
+			bOK = SendPacket ();
+			break;
+
+		default:
+			CScheduler::Get ()->MsSleep (10);
+			continue;
+		}
+
+		if (bOK)
+		{
+			m_nOperations++;
+
+			CScheduler::Get ()->Yield ();
+		}
+		else
+		{
+			m_nErrors++;
+
+			CScheduler::Get ()->MsSleep (100);	// device not available yet
+		}
+	}
+}
+
+boolean CLoadTask::ReadBlockDevice (const char *pName)
+{
+	CDevice *pDevice = CDeviceNameService::Get ()->GetDevice (pName, TRUE);
+	if (pDevice == 0)
+	{
+		return FALSE;
+	}
+
+	if (m_ullOffset >= READ_AREA)
+	{
+		m_ullOffset = 0;
+	}
+
+	if (pDevice->Seek (m_ullOffset) != m_ullOffset)
+	{
+		return FALSE;
+	}
+
+	assert (m_pBuffer != 0);
+	if (pDevice->Read (m_pBuffer, READ_SIZE) != READ_SIZE)
+	{
+		m_ullOffset = 0;		// device may be smaller
+
+		return FALSE;
+	}
+
+	m_ullOffset += READ_SIZE;
+
+	return TRUE;
+}
+
+boolean CLoadTask::SendPacket (void)
+{
+	if (   m_pNetSubSystem == 0
+	    || !m_pNetSubSystem->IsRunning ())
+	{
+		return FALSE;
+	}
+
+	if (m_pSocket == 0)
+	{
+		m_pSocket = new CSocket (m_pNetSubSystem, IPPROTO_UDP);
+		assert (m_pSocket != 0);
+
+		if (   m_pSocket->Bind (PACKET_PORT) < 0
+		    || m_pSocket->SetOptionBroadcast (TRUE) < 0)
+		{
+			delete m_pSocket;
+			m_pSocket = 0;
+
+			return FALSE;
+		}
+	}
+
+	assert (m_pBuffer != 0);
+	return m_pSocket->SendTo (m_pBuffer, PACKET_SIZE, MSG_DONTWAIT,
+				  m_BroadcastIP, PACKET_PORT) == PACKET_SIZE;
+}
+
+const char *CLoadTask::GetName (TLoadType Load)
+{
+	switch (Load)
+	{
+	case LoadNone:	return "none";
+	case LoadSD:	return "SD card";
+	case LoadUSB:	return "USB storage";
+	case LoadNet:	return "network";
+	default:	return "unknown";
+	}
+}
@@ -0,0 +1,71 @@
+//
+// loadtask.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2020  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _loadtask_h
+#define _loadtask_h
+
+#include <circle/sched/task.h>
+#include <circle/net/netsubsystem.h>
+#include <circle/net/socket.h>
+#include <circle/net/ipaddress.h>
+#include <circle/types.h>
+
+enum TLoadType
+{
+	LoadNone,		// idle system
+	LoadSD,			// continuously read from SD card
+	LoadUSB,		// continuously read from USB mass-storage device
+	LoadNet,		// continuously send UDP broadcast packets
+	LoadUnknown
+};
+
+class CLoadTask : public CTask		// generates background load for the benchmark
+{
+public:
+	CLoadTask (CNetSubSystem *pNetSubSystem);	// pNetSubSystem may be 0
+	~CLoadTask (void);
+
+	void SetLoad (TLoadType Load);
+
+	unsigned GetOperations (void) const;		// since last SetLoad()
+	unsigned GetErrors (void) const;
+
+	void Run (void);
+
+	static const char *GetName (TLoadType Load);
+
+private:
+	boolean ReadBlockDevice (const char *pName);
+	boolean SendPacket (void);
+
+private:
+	CNetSubSystem *m_pNetSubSystem;
+
+	volatile TLoadType m_Load;
+	volatile unsigned m_nOperations;
+	volatile unsigned m_nErrors;
+
+	u64 m_ullOffset;
+	u8 *m_pBuffer;
+
+	CSocket *m_pSocket;
+	CIPAddress m_BroadcastIP;
+};
+
+#endif
@@ -0,0 +1,217 @@
+//
+// kernel.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2020  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "kernel.h"
+#include "workloadtask.h"
+#include <circle/sched/taskperfcounters.h>
+#include <circle/string.h>
+#include <assert.h>
+
+#define TASK_ROUNDS	5
+
+static const char FromKernel[] = "kernel";
+
+// the first two events are used, if the PMU has only two counters
+static const TPerformanceEvent Events[] =
+{
+	PerfEventInstructions,
+	PerfEventL1DCacheRefill,
+	PerfEventL1DCacheAccess,
+	PerfEventBranchMispredict
+};
+
+#define EVENT_INSTRUCTIONS	0		// index into Events[]
+#define EVENT_L1D_REFILL	1
+#define EVENT_L1D_ACCESS	2
+#define EVENT_BRANCH_MISPRED	3
+
+CKernel::CKernel (void)
+:	m_Screen (m_Options.GetWidth (), m_Options.GetHeight ()),
+	m_Timer (&m_Interrupt),
+	m_Logger (m_Options.GetLogLevel (), &m_Timer)
+{
+	m_ActLED.Blink (5);	// show we are alive
+}
+
+CKernel::~CKernel (void)
+{
+}
+
+boolean CKernel::Initialize (void)
+{
+	boolean bOK = TRUE;
+
+	if (bOK)
+	{
+		bOK = m_Screen.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Serial.Initialize (115200);
+	}
+
+	if (bOK)
+	{
+		CDevice *pTarget = m_DeviceNameService.GetDevice (m_Options.GetLogDevice (), FALSE);
+		if (pTarget == 0)
+		{
+			pTarget = &m_Screen;
+		}
+
+		bOK = m_Logger.Initialize (pTarget);
+	}
+
+	if (bOK)
+	{
+		bOK = m_Interrupt.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Timer.Initialize ();
+	}
+
+	return bOK;
+}
+
+TShutdownMode CKernel::Run (void)
+{
+	m_Logger.Write (FromKernel, LogNotice, "Compile time: " __DATE__ " " __TIME__);
+
+	m_Logger.Write (FromKernel, LogNotice, "PMU has %u event counters",
+			CPerformanceCounters::GetHardwareCounters ());
+
+	if (   !m_Counters.Configure (Events, sizeof Events / sizeof Events[0])
+	    && !m_Counters.Configure (Events, 2))
+	{
+		m_Logger.Write (FromKernel, LogPanic, "Cannot configure performance counters");
+	}
+
+	// measure each workload in the main task
+	u32 *pBuffer = new u32[WORKLOAD_WORDS];
+	assert (pBuffer != 0);
+	for (unsigned i = 0; i < WORKLOAD_WORDS; i++)
+	{
+		pBuffer[i] = i * 2654435761U;		// pseudo random
+	}
+
+	m_Counters.Start ();
+
+	for (unsigned i = 0; i < WorkloadUnknown; i++)
+	{
+		TWorkload Workload = (TWorkload) i;
+
+		TPerformanceSnapshot Start, End, Diff;
+		m_Counters.GetSnapshot (&Start);
+
+		CWorkloadTask::Execute (Workload, pBuffer);
+
+		m_Counters.GetSnapshot (&End);
+		m_Counters.GetDifference (&Diff, &Start, &End);
+
+		Report (CWorkloadTask::GetName (Workload), &Diff);
+	}
+
+	m_Counters.Stop ();
+
+	delete [] pBuffer;
+
+	// run the workloads in parallel tasks and accumulate the counters per task
+	CTaskPerformanceCounters TaskCounters (&m_Counters);
+
+	CWorkloadTask *pTask[WorkloadUnknown];
+	for (unsigned i = 0; i < WorkloadUnknown; i++)
+	{
+		pTask[i] = new CWorkloadTask ((TWorkload) i, TASK_ROUNDS);
+		assert (pTask[i] != 0);
+	}
+
+	for (unsigned i = 0; i < WorkloadUnknown; i++)
+	{
+		while (!pTask[i]->IsDone ())
+		{
+			m_Scheduler.Yield ();
+		}
+	}
+
+	for (unsigned i = 0; i < WorkloadUnknown; i++)
+	{
+		TPerformanceSnapshot Counters;
+		if (TaskCounters.GetTaskCounters (pTask[i], &Counters))
+		{
+			CString Name;
+			Name.Format ("%s task", CWorkloadTask::GetName (pTask[i]->GetWorkload ()));
+
+			Report (Name, &Counters);
+		}
+	}
+
+	TaskCounters.Dump ();
+
+	m_Logger.Write (FromKernel, LogNotice, "Done");
+
+	while (1)
+	{
+		m_Scheduler.Sleep (1);
+	}
+
+	return ShutdownHalt;
+}
+
+void CKernel::Report (const char *pName, const TPerformanceSnapshot *pCounters)
+{
+	assert (pCounters != 0);
+
+	u64 ullCycles = pCounters->ullCycles;
+	u64 ullInstructions = pCounters->ullEvent[EVENT_INSTRUCTIONS];
+	if (ullCycles == 0)
+	{
+		return;
+	}
+
+	unsigned nIPC100 = (unsigned) (ullInstructions * 100 / ullCycles);
+
+	m_Logger.Write (FromKernel, LogNotice, "%s: %llu cycles, %llu instructions, IPC %u.%02u",
+			pName, ullCycles, ullInstructions, nIPC100 / 100, nIPC100 % 100);
+
+	if (m_Counters.GetEventCount () < 4)
+	{
+		unsigned nRefillsPerKI =   ullInstructions != 0
+					 ? (unsigned) (pCounters->ullEvent[EVENT_L1D_REFILL] * 1000
+						       / ullInstructions) : 0;
+
+		m_Logger.Write (FromKernel, LogNotice, "%s: %u L1D refills per 1000 instructions",
+				pName, nRefillsPerKI);
+
+		return;
+	}
+
+	u64 ullAccesses = pCounters->ullEvent[EVENT_L1D_ACCESS];
+	unsigned nMissRate1000 =   ullAccesses != 0
+				 ? (unsigned) (pCounters->ullEvent[EVENT_L1D_REFILL] * 1000 / ullAccesses)
+				 : 0;
+
+	unsigned nMispredPerKI =   ullInstructions != 0
+				 ? (unsigned) (pCounters->ullEvent[EVENT_BRANCH_MISPRED] * 1000
+					       / ullInstructions) : 0;
+
+	m_Logger.Write (FromKernel, LogNotice, "%s: L1D miss rate %u.%u%%, %u branch mispredicts per 1000 instructions",
+			pName, nMissRate1000 / 10, nMissRate1000 % 10, nMispredPerKI);
+}
@@ -0,0 +1,119 @@
+//
+// workloadtask.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2020  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "workloadtask.h"
+#include <circle/sched/scheduler.h>
+#include <assert.h>
+
+CWorkloadTask::CWorkloadTask (TWorkload Workload, unsigned nRounds)
+:	m_Workload (Workload),
+	m_nRounds (nRounds),
+	m_bDone (FALSE),
+	m_pBuffer (0)
+{
+	m_pBuffer = new u32[WORKLOAD_WORDS];
+	assert (m_pBuffer != 0);
+
+	for (unsigned i = 0; i < WORKLOAD_WORDS; i++)
+	{
+		m_pBuffer[i] = i * 2654435761U;		// pseudo random
+	}
+}
+
+CWorkloadTask::~CWorkloadTask (void)
+{
+	delete [] m_pBuffer;
+	m_pBuffer = 0;
+}
+
+void CWorkloadTask::Run (void)
+{
+	for (unsigned i = 0; i < m_nRounds; i++)
+	{
+		Execute (m_Workload, m_pBuffer);
+
+		CScheduler::Get ()->Yield ();
+	}
+
+	m_bDone = TRUE;
+
+	// stay alive, so that the counters of this task can be read
+	while (1)
+	{
+		CScheduler::Get ()->Sleep (60);
+	}
+}
+
+const char *CWorkloadTask::GetName (TWorkload Workload)
+{
+	switch (Workload)
+	{
+	case WorkloadSequential:	return "sequential";
+	case WorkloadRandom:		return "random";
+	case WorkloadBranches:		return "branches";
+	default:			return "unknown";
+	}
+}
+
+u32 CWorkloadTask::Execute (TWorkload Workload, u32 *pBuffer)
+{
+	assert (pBuffer != 0);
+
+	volatile u32 *pData = pBuffer;
+	u32 nResult = 0;
+
+	switch (Workload)
+	{
+	case WorkloadSequential:
+		for (unsigned i = 0; i < WORKLOAD_WORDS; i++)
+		{
+			nResult += pData[i];
+		}
+		break;
+
+	case WorkloadRandom: {
+		u32 nIndex = 0;
+		for (unsigned i = 0; i < WORKLOAD_WORDS / 16; i++)
+		{
+			nIndex = (nIndex * 1103515245U + 12345U) % WORKLOAD_WORDS;
+			nResult += pData[nIndex];
+		}
+		} break;
+
+	case WorkloadBranches:
+		for (unsigned i = 0; i < WORKLOAD_WORDS / 16; i++)
+		{
+			if (pData[i] & 0x10000)
+			{
+				nResult += 3;
+			}
+			else
+			{
+				nResult ^= i;
+			}
+		}
+		break;
+
+	default:
+		assert (0);
+		break;
+	}
+
+	return nResult;
+}
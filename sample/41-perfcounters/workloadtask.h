@@ -0,0 +1,60 @@
+//
+// workloadtask.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2020  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _workloadtask_h
+#define _workloadtask_h
+
+#include <circle/sched/task.h>
+#include <circle/types.h>
+
+#define WORKLOAD_WORDS		(4 * 1024 * 1024 / sizeof (u32))	// 4 MByte
+
+enum TWorkload
+{
+	WorkloadSequential,		// sum of a buffer, cache and prefetch friendly
+	WorkloadRandom,			// random accesses to a buffer, many cache misses
+	WorkloadBranches,		// data dependent branches, many mispredicts
+	WorkloadUnknown
+};
+
+class CWorkloadTask : public CTask
+{
+public:
+	CWorkloadTask (TWorkload Workload, unsigned nRounds);
+	~CWorkloadTask (void);
+
+	void Run (void);
+
+	TWorkload GetWorkload (void) const	{ return m_Workload; }
+	boolean IsDone (void) const		{ return m_bDone; }
+
+	static const char *GetName (TWorkload Workload);
+
+	// executes one round of the workload in the calling task
+	static u32 Execute (TWorkload Workload, u32 *pBuffer);
+
+private:
+	TWorkload m_Workload;
+	unsigned m_nRounds;
+	volatile boolean m_bDone;
+
+	u32 *m_pBuffer;
+};
+
+#endif
@@ -0,0 +1,161 @@
+//
+// benchmark.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2020  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "benchmark.h"
+#include <circle/machineinfo.h>
+#include <circle/logger.h>
+#include <circle/timer.h>
+#include <circle/string.h>
+#include <circle/stdarg.h>
+#include <circle/util.h>
+#include <assert.h>
+
+static const char FromBenchmark[] = "bench";
+
+CBenchmarkSuite::CBenchmarkSuite (CDevice *pResultFile, unsigned nRepetitions)
+:	m_pResultFile (pResultFile),
+	m_nRepetitions (nRepetitions),
+	m_nTickFrequency (CTimer::GetTicks64Frequency ()),
+	m_nResults (0),
+	m_bWriteError (FALSE)
+{
+	assert (m_pResultFile != 0);
+	assert (0 < m_nRepetitions && m_nRepetitions <= BENCHMARK_MAX_REPETITIONS);
+}
+
+CBenchmarkSuite::~CBenchmarkSuite (void)
+{
+	m_pResultFile = 0;
+}
+
+void CBenchmarkSuite::Begin (void)
+{
+	CMachineInfo *pMachineInfo = CMachineInfo::Get ();
+	assert (pMachineInfo != 0);
+
+	Write ("{\n");
+	Write ("\t\"suite\": \"circle-benchmark\",\n");
+	Write ("\t\"machine\": \"%s\",\n", pMachineInfo->GetMachineName ());
+	Write ("\t\"aarch\": %u,\n", AARCH);
+	Write ("\t\"raspi\": %u,\n", RASPPI);
+	Write ("\t\"compile_time\": \"" __DATE__ " " __TIME__ "\",\n");
+	Write ("\t\"tick_frequency\": %lu,\n", (unsigned long) m_nTickFrequency);
+	Write ("\t\"repetitions\": %u,\n", m_nRepetitions);
+	Write ("\t\"results\": [");
+}
+
+void CBenchmarkSuite::Run (const char *pName, TBenchmarkFunction *pFunction, void *pParam,
+			   unsigned nIterations, unsigned nBytesPerIteration)
+{
+	assert (pName != 0);
+	assert (pFunction != 0);
+	assert (nIterations > 0);
+
+	(*pFunction) (pParam, nIterations);		// warm-up caches and heap
+
+	for (unsigned i = 0; i < m_nRepetitions; i++)
+	{
+		u64 nStart = CTimer::GetTicks64 ();
+		(*pFunction) (pParam, nIterations);
+		u64 nTicks = CTimer::GetTicks64 () - nStart;
+
+		u64 nNanoseconds = nTicks * 1000000000ULL / m_nTickFrequency;
+		u64 nPicoseconds = nNanoseconds * 1000 / nIterations;
+
+		// insertion sort, for the median
+		unsigned j;
+		for (j = i; j > 0 && m_Picoseconds[j-1] > nPicoseconds; j--)
+		{
+			m_Picoseconds[j] = m_Picoseconds[j-1];
+		}
+
+		m_Picoseconds[j] = nPicoseconds;
+	}
+
+	u64 nSum = 0;
+	for (unsigned i = 0; i < m_nRepetitions; i++)
+	{
+		nSum += m_Picoseconds[i];
+	}
+
+	u64 nMin = m_Picoseconds[0];
+	u64 nMedian = m_Picoseconds[m_nRepetitions / 2];
+	u64 nMean = nSum / m_nRepetitions;
+	u64 nMax = m_Picoseconds[m_nRepetitions-1];
+
+	Write ("%s\n\t\t{\"name\": \"%s\", \"iterations\": %u, ", m_nResults > 0 ? "," : "",
+	       pName, nIterations);
+	Write ("\"min_ns\": %lu.%03lu, \"median_ns\": %lu.%03lu, ",
+	       (unsigned long) (nMin / 1000), (unsigned long) (nMin % 1000),
+	       (unsigned long) (nMedian / 1000), (unsigned long) (nMedian % 1000));
+	Write ("\"mean_ns\": %lu.%03lu, \"max_ns\": %lu.%03lu",
+	       (unsigned long) (nMean / 1000), (unsigned long) (nMean % 1000),
+	       (unsigned long) (nMax / 1000), (unsigned long) (nMax % 1000));
+
+	unsigned long ulMBytesPerSecond = 0;
+	if (   nBytesPerIteration > 0
+	    && nMedian > 0)
+	{
+		// bytes per picosecond * 10^6 = MByte per second
+		ulMBytesPerSecond = (unsigned long) (nBytesPerIteration * 1000000ULL / nMedian);
+
+		Write (", \"mbytes_per_s\": %lu", ulMBytesPerSecond);
+	}
+
+	Write ("}");
+
+	m_nResults++;
+
+	if (nBytesPerIteration > 0)
+	{
+		CLogger::Get ()->Write (FromBenchmark, LogNotice, "%-24s %8lu.%03lu ns %6lu MB/s",
+					pName, (unsigned long) (nMedian / 1000),
+					(unsigned long) (nMedian % 1000), ulMBytesPerSecond);
+	}
+	else
+	{
+		CLogger::Get ()->Write (FromBenchmark, LogNotice, "%-24s %8lu.%03lu ns",
+					pName, (unsigned long) (nMedian / 1000),
+					(unsigned long) (nMedian % 1000));
+	}
+}
+
+boolean CBenchmarkSuite::End (void)
+{
+	Write ("\n\t]\n}\n");
+
+	return !m_bWriteError;
+}
+
+void CBenchmarkSuite::Write (const char *pFormat, ...)
+{
+	va_list var;
+	va_start (var, pFormat);
+
+	char Buffer[200];
+	size_t nLength = CString::FormatBufferV (Buffer, sizeof Buffer, pFormat, var);
+
+	va_end (var);
+
+	assert (m_pResultFile != 0);
+	if (m_pResultFile->Write (Buffer, nLength) != (int) nLength)
+	{
+		m_bWriteError = TRUE;
+	}
+}
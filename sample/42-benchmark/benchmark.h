@@ -0,0 +1,60 @@
+//
+// benchmark.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2020  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _benchmark_h
+#define _benchmark_h
+
+#include <circle/device.h>
+#include <circle/types.h>
+
+#define BENCHMARK_MAX_REPETITIONS	31
+
+// executes nIterations times the operation to be measured
+typedef void TBenchmarkFunction (void *pParam, unsigned nIterations);
+
+class CBenchmarkSuite		// runs benchmarks and writes the results as JSON
+{
+public:
+	CBenchmarkSuite (CDevice *pResultFile, unsigned nRepetitions = 11);
+	~CBenchmarkSuite (void);
+
+	void Begin (void);
+
+	// the function is called once for warm-up and then nRepetitions times,
+	// nBytesPerIteration != 0 adds the throughput to the result
+	void Run (const char *pName, TBenchmarkFunction *pFunction, void *pParam,
+		  unsigned nIterations, unsigned nBytesPerIteration = 0);
+
+	boolean End (void);			// returns FALSE on write error
+
+private:
+	void Write (const char *pFormat, ...);
+
+private:
+	CDevice *m_pResultFile;
+	unsigned m_nRepetitions;
+
+	u64 m_nTickFrequency;
+	unsigned m_nResults;
+	boolean m_bWriteError;
+
+	u64 m_Picoseconds[BENCHMARK_MAX_REPETITIONS];	// per iteration
+};
+
+#endif
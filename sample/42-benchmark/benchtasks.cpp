@@ -0,0 +1,86 @@
+//
+// benchtasks.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2020  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "benchtasks.h"
+#include <circle/sched/scheduler.h>
+
+CYieldTask::CYieldTask (void)
+:	m_bStop (FALSE)
+{
+}
+
+CYieldTask::~CYieldTask (void)
+{
+}
+
+void CYieldTask::Run (void)
+{
+	while (!m_bStop)
+	{
+		CScheduler::Get ()->Yield ();
+	}
+}
+
+void CYieldTask::Stop (void)
+{
+	m_bStop = TRUE;
+
+	WaitForTermination ();			// the task object is deleted afterwards
+}
+
+CPingPongTask::CPingPongTask (void)
+:	m_bStop (FALSE)
+{
+}
+
+CPingPongTask::~CPingPongTask (void)
+{
+}
+
+void CPingPongTask::Run (void)
+{
+	while (1)
+	{
+		m_PingEvent.Wait ();
+		m_PingEvent.Clear ();
+
+		if (m_bStop)
+		{
+			break;
+		}
+
+		m_PongEvent.Set ();
+	}
+}
+
+void CPingPongTask::Ping (void)
+{
+	m_PingEvent.Set ();
+
+	m_PongEvent.Wait ();
+	m_PongEvent.Clear ();
+}
+
+void CPingPongTask::Stop (void)
+{
+	m_bStop = TRUE;
+	m_PingEvent.Set ();
+
+	WaitForTermination ();			// the task object is deleted afterwards
+}
@@ -0,0 +1,60 @@
+//
+// benchtasks.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2020  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _benchtasks_h
+#define _benchtasks_h
+
+#include <circle/sched/task.h>
+#include <circle/sched/synchronizationevent.h>
+#include <circle/types.h>
+
+class CYieldTask : public CTask		// yields until stopped, for measuring task switches
+{
+public:
+	CYieldTask (void);
+	~CYieldTask (void);
+
+	void Run (void);
+
+	void Stop (void);
+
+private:
+	volatile boolean m_bStop;
+};
+
+class CPingPongTask : public CTask	// answers each Ping event with a Pong event
+{
+public:
+	CPingPongTask (void);
+	~CPingPongTask (void);
+
+	void Run (void);
+
+	void Ping (void);			// sends ping and waits for pong (from other task)
+
+	void Stop (void);
+
+private:
+	CSynchronizationEvent m_PingEvent;
+	CSynchronizationEvent m_PongEvent;
+
+	volatile boolean m_bStop;
+};
+
+#endif
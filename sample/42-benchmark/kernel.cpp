@@ -0,0 +1,276 @@
+//
+// kernel.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2020  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "kernel.h"
+#include "benchmark.h"
+#include "benchtasks.h"
+#include "ramdisk.h"
+#include <circle/fs/fat/fatcache.h>
+#include <circle/net/checksumcalculator.h>
+#include <circle/alloc.h>
+#include <circle/qemu.h>
+#include <circle/util.h>
+#include <assert.h>
+
+#define FAT_CACHE_SECTORS	4		// working set of the FAT cache benchmark
+
+static const char FromKernel[] = "kernel";
+
+struct TMemoryParam
+{
+	u8	*pTo;
+	u8	*pFrom;
+	size_t	nSize;
+};
+
+CKernel::CKernel (void)
+:	m_Timer (&m_Interrupt),
+	m_Logger (m_Options.GetLogLevel (), &m_Timer)
+{
+	m_ActLED.Blink (5);	// show we are alive
+}
+
+CKernel::~CKernel (void)
+{
+}
+
+boolean CKernel::Initialize (void)
+{
+	boolean bOK = TRUE;
+
+	if (bOK)
+	{
+		bOK = m_Logger.Initialize (&m_LogFile);
+	}
+
+	if (bOK)
+	{
+		bOK = m_Interrupt.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Timer.Initialize ();
+	}
+
+	return bOK;
+}
+
+TShutdownMode CKernel::Run (void)
+{
+	m_Logger.Write (FromKernel, LogNotice, "Compile time: " __DATE__ " " __TIME__);
+
+	CQEMUHostFile ResultFile (RESULT_FILE, TRUE);
+	if (!ResultFile.IsOpen ())
+	{
+		m_Logger.Write (FromKernel, LogPanic, "Cannot create %s (semihosting enabled?)",
+				RESULT_FILE);
+	}
+
+	CBenchmarkSuite Suite (&ResultFile);
+	Suite.Begin ();
+
+	// memory functions
+	u8 *pTo = new u8[0x10000 + 16];
+	u8 *pFrom = new u8[0x10000 + 16];
+	assert (pTo != 0);
+	assert (pFrom != 0);
+	memset (pFrom, 0x55, 0x10000 + 16);
+
+	TMemoryParam Memory = {pTo, pFrom, 64};
+	Suite.Run ("memcpy_64", MemcpyBenchmark, &Memory, 10000, 64);
+	Memory.nSize = 0x1000;
+	Suite.Run ("memcpy_4k", MemcpyBenchmark, &Memory, 1000, 0x1000);
+	Memory.nSize = 0x10000;
+	Suite.Run ("memcpy_64k", MemcpyBenchmark, &Memory, 100, 0x10000);
+
+	TMemoryParam Unaligned = {pTo + 1, pFrom + 3, 0x1000};
+	Suite.Run ("memcpy_4k_unaligned", MemcpyBenchmark, &Unaligned, 1000, 0x1000);
+
+	Memory.nSize = 0x1000;
+	Suite.Run ("memset_4k", MemsetBenchmark, &Memory, 1000, 0x1000);
+
+	delete [] pFrom;
+	delete [] pTo;
+
+	// heap
+	size_t nBlockSize = 64;
+	Suite.Run ("new_delete_64", NewDeleteBenchmark, &nBlockSize, 10000);
+	Suite.Run ("malloc_free_64", MallocFreeBenchmark, &nBlockSize, 10000);
+	nBlockSize = 0x1000;
+	Suite.Run ("new_delete_4k", NewDeleteBenchmark, &nBlockSize, 10000);
+
+	// scheduler
+	CYieldTask *pYieldTask = new CYieldTask;
+	assert (pYieldTask != 0);
+	Suite.Run ("task_yield_roundtrip", YieldBenchmark, 0, 10000);
+	pYieldTask->Stop ();
+
+	CPingPongTask *pPingPongTask = new CPingPongTask;
+	assert (pPingPongTask != 0);
+	Suite.Run ("event_ping_pong", PingPongBenchmark, pPingPongTask, 10000);
+	pPingPongTask->Stop ();
+
+	// timer
+	Suite.Run ("kernel_timer_start_cancel", KernelTimerBenchmark, &m_Timer, 10000);
+
+	// network
+	u8 Frame[1500];
+	memset (Frame, 0xAA, sizeof Frame);
+	Suite.Run ("checksum_1500", ChecksumBenchmark, Frame, 10000, sizeof Frame);
+
+	// FAT buffer cache (hit path)
+	CRAMDisk RAMDisk (FAT_CACHE_SECTORS * FAT_SECTOR_SIZE);
+	CFATCache Cache;
+	if (!Cache.Open (&RAMDisk))
+	{
+		m_Logger.Write (FromKernel, LogPanic, "Cannot open FAT cache");
+	}
+
+	Suite.Run ("fat_cache_hit", FATCacheBenchmark, &Cache, 10000);
+
+	Cache.Close ();
+
+	boolean bOK = Suite.End ();
+	if (!bOK)
+	{
+		m_Logger.Write (FromKernel, LogError, "Cannot write %s", RESULT_FILE);
+	}
+	else
+	{
+		m_Logger.Write (FromKernel, LogNotice, "Results written to %s", RESULT_FILE);
+	}
+
+	// the result file requires semihosting anyway, so we can exit QEMU here
+	SemihostingExit (bOK ? 0 : 1);
+
+	return ShutdownHalt;
+}
+
+void CKernel::MemcpyBenchmark (void *pParam, unsigned nIterations)
+{
+	TMemoryParam *pMemory = (TMemoryParam *) pParam;
+	assert (pMemory != 0);
+
+	while (nIterations--)
+	{
+		memcpy (pMemory->pTo, pMemory->pFrom, pMemory->nSize);
+	}
+}
+
+void CKernel::MemsetBenchmark (void *pParam, unsigned nIterations)
+{
+	TMemoryParam *pMemory = (TMemoryParam *) pParam;
+	assert (pMemory != 0);
+
+	while (nIterations--)
+	{
+		memset (pMemory->pTo, nIterations, pMemory->nSize);
+	}
+}
+
+void CKernel::NewDeleteBenchmark (void *pParam, unsigned nIterations)
+{
+	size_t nSize = *(size_t *) pParam;
+
+	while (nIterations--)
+	{
+		u8 * volatile pBlock = new u8[nSize];
+		assert (pBlock != 0);
+		delete [] pBlock;
+	}
+}
+
+void CKernel::MallocFreeBenchmark (void *pParam, unsigned nIterations)
+{
+	size_t nSize = *(size_t *) pParam;
+
+	while (nIterations--)
+	{
+		void * volatile pBlock = malloc (nSize);
+		assert (pBlock != 0);
+		free (pBlock);
+	}
+}
+
+void CKernel::YieldBenchmark (void *pParam, unsigned nIterations)
+{
+	CScheduler *pScheduler = CScheduler::Get ();
+	assert (pScheduler != 0);
+
+	while (nIterations--)
+	{
+		pScheduler->Yield ();		// to CYieldTask and back
+	}
+}
+
+void CKernel::PingPongBenchmark (void *pParam, unsigned nIterations)
+{
+	CPingPongTask *pTask = (CPingPongTask *) pParam;
+	assert (pTask != 0);
+
+	while (nIterations--)
+	{
+		pTask->Ping ();
+	}
+}
+
+void CKernel::KernelTimerBenchmark (void *pParam, unsigned nIterations)
+{
+	CTimer *pTimer = (CTimer *) pParam;
+	assert (pTimer != 0);
+
+	while (nIterations--)
+	{
+		TKernelTimerHandle hTimer = pTimer->StartKernelTimer (HZ, TimerHandler);
+		pTimer->CancelKernelTimer (hTimer);
+	}
+}
+
+void CKernel::ChecksumBenchmark (void *pParam, unsigned nIterations)
+{
+	assert (pParam != 0);
+
+	while (nIterations--)
+	{
+		volatile u16 usChecksum = CChecksumCalculator::SimpleCalculate (pParam, 1500);
+		(void) usChecksum;
+	}
+}
+
+void CKernel::FATCacheBenchmark (void *pParam, unsigned nIterations)
+{
+	CFATCache *pCache = (CFATCache *) pParam;
+	assert (pCache != 0);
+
+	while (nIterations--)
+	{
+		for (unsigned nSector = 0; nSector < FAT_CACHE_SECTORS; nSector++)
+		{
+			TFATBuffer *pBuffer = pCache->GetSector (nSector, 0);
+			assert (pBuffer != 0);
+			pCache->FreeSector (pBuffer, 0);
+		}
+	}
+}
+
+void CKernel::TimerHandler (TKernelTimerHandle hTimer, void *pParam, void *pContext)
+{
+	assert (0);		// never elapses, is cancelled before
+}
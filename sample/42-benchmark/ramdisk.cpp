@@ -0,0 +1,75 @@
+//
+// ramdisk.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2020  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "ramdisk.h"
+#include <circle/util.h>
+#include <assert.h>
+
+CRAMDisk::CRAMDisk (size_t nSize)
+:	m_pData (new u8[nSize]),
+	m_nSize (nSize),
+	m_nOffset (0)
+{
+	assert (m_pData != 0);
+	memset (m_pData, 0, m_nSize);
+}
+
+CRAMDisk::~CRAMDisk (void)
+{
+	delete [] m_pData;
+	m_pData = 0;
+}
+
+int CRAMDisk::Read (void *pBuffer, size_t nCount)
+{
+	if (m_nOffset + nCount > m_nSize)
+	{
+		return -1;
+	}
+
+	memcpy (pBuffer, m_pData + m_nOffset, nCount);
+	m_nOffset += nCount;
+
+	return nCount;
+}
+
+int CRAMDisk::Write (const void *pBuffer, size_t nCount)
+{
+	if (m_nOffset + nCount > m_nSize)
+	{
+		return -1;
+	}
+
+	memcpy (m_pData + m_nOffset, pBuffer, nCount);
+	m_nOffset += nCount;
+
+	return nCount;
+}
+
+u64 CRAMDisk::Seek (u64 ullOffset)
+{
+	if (ullOffset > m_nSize)
+	{
+		return (u64) -1;
+	}
+
+	m_nOffset = (size_t) ullOffset;
+
+	return m_nOffset;
+}
@@ -0,0 +1,377 @@
+/*
+ * utiltest.cpp
+ *
+ * Checks the word-wise memset(), memmove(), memcmp(), strlen() and strcmp()
+ * from lib/util.cpp on the host against the C library, or compares their
+ * speed with the C library for a sweep of sizes (with -b).
+ *
+ * Build and run it with tools/runutiltest.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// the functions of lib/util.cpp get a prefix, so that they do not collide
+// with the C library, memcpy() is taken from the C library (util_fast.S)
+#define memset		circle_memset
+#define memmove		circle_memmove
+#define memcmp		circle_memcmp
+#define strlen		circle_strlen
+#define strcmp		circle_strcmp
+#define strcasecmp	circle_strcasecmp
+#define strncmp		circle_strncmp
+#define strncasecmp	circle_strncasecmp
+#define strcpy		circle_strcpy
+#define strncpy		circle_strncpy
+#define strcat		circle_strcat
+#define strchr		circle_strchr
+#define strstr		circle_strstr
+#define strtok_r	circle_strtok_r
+#define strtoul		circle_strtoul
+#define strtoull	circle_strtoull
+#define atoi		circle_atoi
+#define char2int	circle_char2int
+#define toupper		circle_toupper
+
+#include "../lib/util.cpp"
+
+#undef memset
+#undef memmove
+#undef memcmp
+#undef strlen
+#undef strcmp
+
+#define MAX_OFFSET	16
+#define MAX_LENGTH	200
+#define GUARD		64
+#define BUFSIZE		(GUARD + 2*MAX_OFFSET + 2*MAX_LENGTH + GUARD)
+
+#define BENCH_MAX_SIZE	0x10000
+#define BENCH_BYTES	(64*1024*1024)		// processed per function and size
+
+static unsigned s_nErrors = 0;
+
+static void Fail (const char *pFunction, size_t nOffset1, size_t nOffset2, size_t nLength)
+{
+	if (s_nErrors++ < 20)
+	{
+		fprintf (stderr, "%s failed (offsets %lu/%lu, length %lu)\n", pFunction,
+			 (unsigned long) nOffset1, (unsigned long) nOffset2, (unsigned long) nLength);
+	}
+}
+
+static void Fill (unsigned char *pBuffer, size_t nLength)
+{
+	for (size_t i = 0; i < nLength; i++)
+	{
+		pBuffer[i] = (unsigned char) (rand () % 255 + 1);	// no zero
+	}
+}
+
+static int Sign (int nValue)
+{
+	return nValue > 0 ? 1 : (nValue < 0 ? -1 : 0);
+}
+
+static void TestMemset (void)
+{
+	static unsigned char Buffer[BUFSIZE], Reference[BUFSIZE];
+
+	for (size_t nOffset = 0; nOffset < MAX_OFFSET; nOffset++)
+	{
+		for (size_t nLength = 0; nLength < MAX_LENGTH; nLength++)
+		{
+			Fill (Reference, BUFSIZE);
+			memcpy (Buffer, Reference, BUFSIZE);
+
+			int nValue = rand () % 256 | (rand () % 2 ? 0x100 : 0);	// only low byte used
+
+			memset (Reference + GUARD + nOffset, nValue, nLength);
+			void *pResult = circle_memset (Buffer + GUARD + nOffset, nValue, nLength);
+
+			if (   pResult != Buffer + GUARD + nOffset
+			    || memcmp (Buffer, Reference, BUFSIZE) != 0)
+			{
+				Fail ("memset", nOffset, 0, nLength);
+			}
+		}
+	}
+}
+
+static void TestMemmove (void)
+{
+	static unsigned char Buffer[BUFSIZE], Reference[BUFSIZE];
+
+	// source and destination are overlapping in both directions, or not
+	for (size_t nSrcOffset = 0; nSrcOffset < 2*MAX_OFFSET; nSrcOffset++)
+	{
+		for (size_t nDestOffset = 0; nDestOffset < 2*MAX_OFFSET; nDestOffset++)
+		{
+			for (size_t nLength = 0; nLength < MAX_LENGTH; nLength++)
+			{
+				Fill (Reference, BUFSIZE);
+				memcpy (Buffer, Reference, BUFSIZE);
+
+				size_t nDest = GUARD + nDestOffset;
+				size_t nSrc = GUARD + nSrcOffset;
+				if (nLength % 3 == 0)
+				{
+					nSrc += MAX_LENGTH;	// no overlap
+				}
+
+				memmove (Reference + nDest, Reference + nSrc, nLength);
+				void *pResult = circle_memmove (Buffer + nDest, Buffer + nSrc, nLength);
+
+				if (   pResult != Buffer + nDest
+				    || memcmp (Buffer, Reference, BUFSIZE) != 0)
+				{
+					Fail ("memmove", nSrc, nDest, nLength);
+				}
+			}
+		}
+	}
+}
+
+static void TestMemcmp (void)
+{
+	static unsigned char Buffer1[BUFSIZE], Buffer2[BUFSIZE];
+
+	for (size_t nOffset1 = 0; nOffset1 < MAX_OFFSET; nOffset1++)
+	{
+		for (size_t nOffset2 = 0; nOffset2 < MAX_OFFSET; nOffset2++)
+		{
+			for (size_t nLength = 0; nLength < MAX_LENGTH; nLength++)
+			{
+				unsigned char *p1 = Buffer1 + GUARD + nOffset1;
+				unsigned char *p2 = Buffer2 + GUARD + nOffset2;
+
+				Fill (p1, nLength + GUARD);
+				memcpy (p2, p1, nLength);
+				p2[nLength] = p1[nLength] ^ 0xFF;	// behind the compared range
+
+				// equal, then one differing byte at each position
+				for (size_t nPos = 0; nPos <= nLength; nPos++)
+				{
+					unsigned char uchSave = p2[nPos];
+					if (nPos < nLength)
+					{
+						p2[nPos] = (unsigned char) rand ();
+					}
+
+					if (   Sign (circle_memcmp (p1, p2, nLength))
+					    != Sign (memcmp (p1, p2, nLength)))
+					{
+						Fail ("memcmp", nOffset1, nOffset2, nLength);
+					}
+
+					p2[nPos] = uchSave;
+				}
+			}
+		}
+	}
+}
+
+static void TestStrlen (void)
+{
+	static char Buffer[BUFSIZE];
+
+	for (size_t nOffset = 0; nOffset < MAX_OFFSET; nOffset++)
+	{
+		for (size_t nLength = 0; nLength < MAX_LENGTH; nLength++)
+		{
+			Fill ((unsigned char *) Buffer, BUFSIZE);
+
+			char *pString = Buffer + GUARD + nOffset;
+			pString[nLength] = '\0';
+
+			if (circle_strlen (pString) != nLength)
+			{
+				Fail ("strlen", nOffset, 0, nLength);
+			}
+		}
+	}
+}
+
+static void TestStrcmp (void)
+{
+	static char Buffer1[BUFSIZE], Buffer2[BUFSIZE];
+
+	for (size_t nOffset1 = 0; nOffset1 < MAX_OFFSET; nOffset1++)
+	{
+		for (size_t nOffset2 = 0; nOffset2 < MAX_OFFSET; nOffset2++)
+		{
+			for (size_t nLength = 0; nLength < MAX_LENGTH; nLength++)
+			{
+				char *p1 = Buffer1 + GUARD + nOffset1;
+				char *p2 = Buffer2 + GUARD + nOffset2;
+
+				Fill ((unsigned char *) p1, nLength + GUARD);
+				Fill ((unsigned char *) p2, nLength + GUARD);
+				memcpy (p2, p1, nLength);
+				p1[nLength] = '\0';
+				p2[nLength] = '\0';
+
+				// equal, one string shorter, or one differing character
+				for (size_t nPos = 0; nPos <= nLength; nPos++)
+				{
+					for (unsigned nCase = 0; nCase < 3; nCase++)
+					{
+						char *p = nCase == 1 ? p1 : p2;
+						char chSave = p[nPos];
+
+						switch (nCase)
+						{
+						case 0:
+							if (nPos < nLength)
+							{
+								p[nPos] = (char) (rand () % 255 + 1);
+							}
+							break;
+
+						default:
+							p[nPos] = '\0';
+							break;
+						}
+
+						if (   Sign (circle_strcmp (p1, p2))
+						    != Sign (strcmp (p1, p2)))
+						{
+							Fail ("strcmp", nOffset1, nOffset2, nLength);
+						}
+
+						p[nPos] = chSave;
+					}
+				}
+			}
+		}
+	}
+}
+
+static double GetSeconds (void)
+{
+	struct timespec Time;
+	clock_gettime (CLOCK_MONOTONIC, &Time);
+
+	return Time.tv_sec + Time.tv_nsec / 1e9;
+}
+
+static volatile size_t s_nSink;
+
+static double Bench (unsigned nFunction, int bLibC, unsigned char *p1, unsigned char *p2,
+		     size_t nSize)
+{
+	size_t nIterations = BENCH_BYTES / nSize;
+
+	double fStart = GetSeconds ();
+
+	for (size_t i = 0; i < nIterations; i++)
+	{
+		size_t nResult = 0;
+
+		switch (nFunction)
+		{
+		case 0:
+			bLibC ? memset (p1, (int) i, nSize) : circle_memset (p1, (int) i, nSize);
+			break;
+
+		case 1:
+			// overlapping backwards, word-wise
+			bLibC ? memmove (p1 + WORD_SIZE, p1, nSize)
+			      : circle_memmove (p1 + WORD_SIZE, p1, nSize);
+			break;
+
+		case 2:
+			nResult = bLibC ? memcmp (p1, p2, nSize) : circle_memcmp (p1, p2, nSize);
+			break;
+
+		case 3:
+			nResult = bLibC ? strlen ((char *) p1) : circle_strlen ((char *) p1);
+			break;
+
+		case 4:
+			nResult = bLibC ? strcmp ((char *) p1, (char *) p2)
+					: circle_strcmp ((char *) p1, (char *) p2);
+			break;
+		}
+
+		s_nSink = nResult;
+		asm volatile ("" : : "r" (p1), "r" (p2) : "memory");
+	}
+
+	return (GetSeconds () - fStart) * 1e9 / nIterations;
+}
+
+static void Benchmark (void)
+{
+	static const char *Name[] = {"memset", "memmove", "memcmp", "strlen", "strcmp"};
+
+	unsigned char *p1 = (unsigned char *) malloc (BENCH_MAX_SIZE + 2*WORD_SIZE);
+	unsigned char *p2 = (unsigned char *) malloc (BENCH_MAX_SIZE + 2*WORD_SIZE);
+	if (p1 == 0 || p2 == 0)
+	{
+		fprintf (stderr, "Out of memory\n");
+
+		exit (1);
+	}
+
+	printf ("%-8s %8s %12s %12s %7s\n", "function", "size", "circle ns", "libc ns", "ratio");
+
+	for (unsigned nFunction = 0; nFunction < 5; nFunction++)
+	{
+		for (size_t nSize = 1; nSize <= BENCH_MAX_SIZE; nSize *= 2)
+		{
+			// equal data, the string functions see the terminating zero at nSize
+			memset (p1, 'x', BENCH_MAX_SIZE + 2*WORD_SIZE);
+			memset (p2, 'x', BENCH_MAX_SIZE + 2*WORD_SIZE);
+			p1[nSize] = '\0';
+			p2[nSize] = '\0';
+
+			double fCircle = Bench (nFunction, 0, p1, p2, nSize);
+			double fLibC = Bench (nFunction, 1, p1, p2, nSize);
+
+			printf ("%-8s %8lu %12.1f %12.1f %7.2f\n", Name[nFunction],
+				(unsigned long) nSize, fCircle, fLibC, fCircle / fLibC);
+		}
+	}
+
+	free (p1);
+	free (p2);
+}
+
+int main (int nArgC, char **ppArgV)
+{
+	if (   nArgC == 2
+	    && strcmp (ppArgV[1], "-b") == 0)
+	{
+		Benchmark ();
+
+		return 0;
+	}
+
+	if (nArgC != 1)
+	{
+		fprintf (stderr, "\nUsage: %s [-b]\n\n", ppArgV[0]);
+
+		return 1;
+	}
+
+	srand (1);
+
+	TestMemset ();
+	TestMemmove ();
+	TestMemcmp ();
+	TestStrlen ();
+	TestStrcmp ();
+
+	if (s_nErrors > 0)
+	{
+		printf ("%u errors (%lu-bit words)\n", s_nErrors, (unsigned long) WORD_SIZE*8);
+
+		return 1;
+	}
+
+	printf ("All tests passed (%lu-bit words)\n", (unsigned long) WORD_SIZE*8);
+
+	return 0;
+}